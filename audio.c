@@ -0,0 +1,289 @@
+/*
+   CPong
+   Sound effects mixed on the audio thread. See audio.h.
+*/
+
+/* Standard C includes */
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* SFML includes */
+#include <SFML/Audio.h>
+
+/* Local includes */
+#include "audio.h"
+#include "pong.h"
+
+/* Cache line size used to keep the two ends of the ring apart */
+#define CACHE_LINE 64
+
+/* Synthesized effects reach a quarter of full scale so a few voices can overlap without clipping */
+#define SYNTH_AMPLITUDE 8192.0f
+
+#define QUEUE_MASK (AUDIO_QUEUE_SIZE - 1)
+
+/* Define the 'AudioTrigger' struct, one queued effect */
+typedef struct AudioTrigger{
+
+	unsigned char sound;
+	unsigned char left;			/* Channel gains out of 255 */
+	unsigned char right;
+
+} AudioTrigger;
+
+/* Define the 'AudioVoice' struct, an effect being mixed */
+typedef struct AudioVoice{
+
+	const sfInt16 *samples;			/* NULL while the voice is free */
+	unsigned int length;
+	unsigned int position;
+	int left;
+	int right;
+
+} AudioVoice;
+
+/* Define the 'Audio' struct */
+struct Audio{
+
+	/* Trigger ring. The game thread owns 'head', the mixer owns 'tail'. */
+	atomic_size_t head;
+	char headPadding[CACHE_LINE];
+	atomic_size_t tail;
+	char tailPadding[CACHE_LINE];
+	AudioTrigger queue[AUDIO_QUEUE_SIZE];
+	unsigned long long dropped;
+
+	/* Effect pool, filled once at startup */
+	sfInt16 *effects[SOUND_COUNT];
+	unsigned int lengths[SOUND_COUNT];
+
+	/* Mixer state, only touched by the streaming thread */
+	AudioVoice voices[AUDIO_VOICES];
+	int mix[AUDIO_BLOCK * 2];
+	sfInt16 block[AUDIO_BLOCK * 2];
+	atomic_ullong played;
+	atomic_ullong stolen;
+
+	sfSoundStream *stream;
+
+};
+
+/* Static function declarations */
+static sfBool Audio_getData(sfSoundStreamChunk *chunk, void *arg);
+static void Audio_seek(sfTime offset, void *arg);
+static void Audio_startVoice(Audio *audio, const AudioTrigger *trigger);
+static int loadEffect(Audio *audio, Sound sound, const char *directory);
+static int synthesizeEffect(Audio *audio, Sound sound);
+
+/* File names of the effects in a sound directory */
+static const char *effectFiles[SOUND_COUNT] = {"paddle.wav", "wall.wav", "score.wav"};
+
+/* Loads the effects and starts the mixer */
+Audio *Audio_create(const char *directory){
+
+	Audio *audio = calloc(1, sizeof(Audio));
+	if(!audio) return NULL;
+	atomic_init(&audio->head, 0);
+	atomic_init(&audio->tail, 0);
+	atomic_init(&audio->played, 0);
+	atomic_init(&audio->stolen, 0);
+
+	for(int sound = 0; sound < SOUND_COUNT; ++sound){
+		int loaded = directory ? loadEffect(audio, (Sound)sound, directory) : synthesizeEffect(audio, (Sound)sound);
+		if(!loaded){
+			Audio_destroy(audio);
+			return NULL;
+		}
+	}
+
+	audio->stream = sfSoundStream_create(Audio_getData, Audio_seek, 2, AUDIO_SAMPLE_RATE, audio);
+	if(!audio->stream){
+		Audio_destroy(audio);
+		return NULL;
+	}
+	sfSoundStream_play(audio->stream);
+	return audio;
+
+}
+
+/* Queues an effect without waiting on the mixer */
+void Audio_play(Audio *audio, Sound sound, float pan, float volume){
+
+	if(!audio || sound < 0 || sound >= SOUND_COUNT) return;
+
+	size_t head = atomic_load_explicit(&audio->head, memory_order_relaxed);
+	if(head - atomic_load_explicit(&audio->tail, memory_order_acquire) >= AUDIO_QUEUE_SIZE){
+		++audio->dropped;
+		return;
+	}
+
+	pan = MAX(MIN(pan, 1.0f), -1.0f);
+	volume = MAX(MIN(volume, 1.0f), 0.0f);
+	AudioTrigger *trigger = &audio->queue[head & QUEUE_MASK];
+	trigger->sound = (unsigned char)sound;
+	trigger->left = (unsigned char)(255.0f * volume * MIN(1.0f - pan, 1.0f) + 0.5f);
+	trigger->right = (unsigned char)(255.0f * volume * MIN(1.0f + pan, 1.0f) + 0.5f);
+	atomic_store_explicit(&audio->head, head + 1, memory_order_release);
+
+}
+
+/* Reads the counts */
+void Audio_getStats(Audio *audio, AudioStats *stats){
+
+	stats->played = atomic_load_explicit(&audio->played, memory_order_relaxed);
+	stats->dropped = audio->dropped;
+	stats->stolen = atomic_load_explicit(&audio->stolen, memory_order_relaxed);
+
+}
+
+/* Stops the mixer and frees the effects */
+void Audio_destroy(Audio *audio){
+
+	if(!audio) return;
+
+	/* Stopping joins the streaming thread, so the mixer is done with the effects afterwards */
+	if(audio->stream){
+		sfSoundStream_stop(audio->stream);
+		sfSoundStream_destroy(audio->stream);
+	}
+	for(int sound = 0; sound < SOUND_COUNT; ++sound) free(audio->effects[sound]);
+	free(audio);
+
+}
+
+/* Mixes the next block on the streaming thread. The stream never ends; it plays silence while no voice is active. */
+static sfBool Audio_getData(sfSoundStreamChunk *chunk, void *arg){
+
+	Audio *audio = arg;
+
+	/* Start every effect queued since the last block */
+	size_t tail = atomic_load_explicit(&audio->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&audio->head, memory_order_acquire);
+	for(; tail != head; ++tail) Audio_startVoice(audio, &audio->queue[tail & QUEUE_MASK]);
+	atomic_store_explicit(&audio->tail, tail, memory_order_release);
+
+	memset(audio->mix, 0, sizeof(audio->mix));
+	for(int i = 0; i < AUDIO_VOICES; ++i){
+		AudioVoice *voice = &audio->voices[i];
+		if(!voice->samples) continue;
+
+		unsigned int frames = MIN(voice->length - voice->position, AUDIO_BLOCK);
+		const sfInt16 *samples = voice->samples + voice->position;
+		for(unsigned int frame = 0; frame < frames; ++frame){
+			audio->mix[2 * frame] += samples[frame] * voice->left;
+			audio->mix[2 * frame + 1] += samples[frame] * voice->right;
+		}
+		voice->position += frames;
+		if(voice->position == voice->length) voice->samples = NULL;
+	}
+
+	for(int i = 0; i < AUDIO_BLOCK * 2; ++i){
+		int sample = audio->mix[i] / 255;
+		audio->block[i] = (sfInt16)MAX(MIN(sample, 32767), -32768);
+	}
+
+	chunk->samples = audio->block;
+	chunk->sampleCount = AUDIO_BLOCK * 2;
+	return sfTrue;
+
+}
+
+/* The stream has no position to seek to */
+static void Audio_seek(sfTime offset, void *arg){
+
+	(void)offset;
+	(void)arg;
+
+}
+
+/* Starts an effect in a free voice, or in the one closest to finishing when none is free */
+static void Audio_startVoice(Audio *audio, const AudioTrigger *trigger){
+
+	AudioVoice *voice = NULL;
+	unsigned int shortest = 0;
+	for(int i = 0; i < AUDIO_VOICES; ++i){
+		AudioVoice *candidate = &audio->voices[i];
+		if(!candidate->samples){
+			voice = candidate;
+			break;
+		}
+		unsigned int remaining = candidate->length - candidate->position;
+		if(!voice || remaining < shortest){
+			voice = candidate;
+			shortest = remaining;
+		}
+	}
+	if(voice->samples) atomic_fetch_add_explicit(&audio->stolen, 1, memory_order_relaxed);
+
+	voice->samples = audio->effects[trigger->sound];
+	voice->length = audio->lengths[trigger->sound];
+	voice->position = 0;
+	voice->left = trigger->left;
+	voice->right = trigger->right;
+	atomic_fetch_add_explicit(&audio->played, 1, memory_order_relaxed);
+
+}
+
+/* Decodes an effect file, mixed down to mono and resampled to the mixer rate */
+static int loadEffect(Audio *audio, Sound sound, const char *directory){
+
+	char path[1024];
+	if(snprintf(path, sizeof(path), "%s/%s", directory, effectFiles[sound]) >= (int)sizeof(path)) return 0;
+	sfSoundBuffer *buffer = sfSoundBuffer_createFromFile(path);
+	if(!buffer){
+		fprintf(stderr, "Could not load sound %s\n", path);
+		return 0;
+	}
+
+	const sfInt16 *samples = sfSoundBuffer_getSamples(buffer);
+	unsigned int channels = sfSoundBuffer_getChannelCount(buffer);
+	unsigned int rate = sfSoundBuffer_getSampleRate(buffer);
+	unsigned long long frames = sfSoundBuffer_getSampleCount(buffer) / channels;
+	unsigned long long length = frames * AUDIO_SAMPLE_RATE / rate;
+
+	audio->effects[sound] = malloc(sizeof(sfInt16) * (size_t)MAX(length, 1));
+	if(!audio->effects[sound]){
+		sfSoundBuffer_destroy(buffer);
+		return 0;
+	}
+	for(unsigned long long i = 0; i < length; ++i){
+		const sfInt16 *frame = samples + i * rate / AUDIO_SAMPLE_RATE * channels;
+		int sum = 0;
+		for(unsigned int channel = 0; channel < channels; ++channel) sum += frame[channel];
+		audio->effects[sound][i] = (sfInt16)(sum / (int)channels);
+	}
+	audio->lengths[sound] = (unsigned int)length;
+
+	sfSoundBuffer_destroy(buffer);
+	return length > 0;
+
+}
+
+/* Synthesizes a decaying square wave effect: short blips for bounces and a falling tone for a point */
+static int synthesizeEffect(Audio *audio, Sound sound){
+
+	static const float durations[SOUND_COUNT] = {0.06f, 0.04f, 0.35f};
+	static const float startPitches[SOUND_COUNT] = {480.0f, 240.0f, 600.0f};
+	static const float endPitches[SOUND_COUNT] = {480.0f, 240.0f, 150.0f};
+
+	unsigned int length = (unsigned int)(durations[sound] * AUDIO_SAMPLE_RATE);
+	sfInt16 *samples = malloc(sizeof(sfInt16) * length);
+	if(!samples) return 0;
+
+	float phase = 0.0f;
+	for(unsigned int i = 0; i < length; ++i){
+		float t = (float)i / (float)length;
+		phase += (startPitches[sound] + (endPitches[sound] - startPitches[sound]) * t) / AUDIO_SAMPLE_RATE;
+		phase -= floorf(phase);
+		float envelope = (1.0f - t) * (1.0f - t);
+		samples[i] = (sfInt16)(((phase < 0.5f) ? SYNTH_AMPLITUDE : -SYNTH_AMPLITUDE) * envelope);
+	}
+
+	audio->effects[sound] = samples;
+	audio->lengths[sound] = length;
+	return 1;
+
+}
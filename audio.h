@@ -0,0 +1,67 @@
+/*
+   CPong
+   Sound effects mixed on the audio thread.
+
+   Every effect is decoded once by 'Audio_create' into a pool of sample
+   buffers, either from the WAV files of a directory or synthesized when
+   none is given. The game loop only calls 'Audio_play', which writes a
+   small trigger into a lock-free single-producer, single-consumer ring
+   and returns; it never locks, allocates or waits on the mixer. The
+   mixer runs on the streaming thread of an SFML sound stream, takes the
+   queued triggers at the start of every block and sums the active voices
+   into it.
+
+   At most 'AUDIO_VOICES' effects sound at once. A trigger arriving while
+   every voice is busy takes over the voice closest to finishing, so a
+   burst of collisions cuts the tails of older effects instead of piling
+   up. A trigger arriving while the ring is full is dropped.
+*/
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+/* Mixer property definitions */
+#define AUDIO_SAMPLE_RATE 44100
+#define AUDIO_VOICES 16
+#define AUDIO_QUEUE_SIZE 256			/* Triggers in flight, a power of two */
+#define AUDIO_BLOCK 512				/* Frames mixed per callback, about 12 ms */
+
+/* Sound effect type */
+typedef enum Sound{
+
+	SOUND_PADDLE,
+	SOUND_WALL,
+	SOUND_SCORE,
+	SOUND_COUNT
+
+} Sound;
+
+/* Define the 'AudioStats' struct with counts since the start */
+typedef struct AudioStats{
+
+	unsigned long long played;		/* Triggers that reached the mixer */
+	unsigned long long dropped;		/* Triggers lost to a full ring */
+	unsigned long long stolen;		/* Voices taken over before their effect ended */
+
+} AudioStats;
+
+/* Opaque audio type */
+typedef struct Audio Audio;
+
+/* Audio function declarations */
+
+/* Loads the effects and starts the mixer. 'directory' holds paddle.wav, wall.wav and score.wav;
+   NULL synthesizes them. Returns NULL if the effects or the audio device are unavailable. */
+Audio *Audio_create(const char *directory);
+
+/* Queues an effect. 'pan' runs from -1 at the left to 1 at the right and 'volume' from 0 to 1.
+   Only one thread may call this. */
+void Audio_play(Audio *audio, Sound sound, float pan, float volume);
+
+/* Reads the counts */
+void Audio_getStats(Audio *audio, AudioStats *stats);
+
+/* Stops the mixer and frees the effects */
+void Audio_destroy(Audio *audio);
+
+#endif
@@ -0,0 +1,303 @@
+/*
+   CPong
+   Many-ball mode with a uniform grid broadphase. See balls.h.
+*/
+
+/* Standard C includes */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "balls.h"
+
+/* Fraction of the playfield the default ball size covers */
+#define BALL_FIELD_COVERAGE 0.05f
+
+/* Static function declarations */
+static int BallField_random(BallField *field);
+static int BallField_getCell(const BallField *field, size_t ball);
+static void BallField_link(BallField *field, int ball, int cell);
+static void BallField_unlink(BallField *field, int ball);
+static void BallField_movePaddles(BallField *field, Input input);
+static void BallField_moveBalls(BallField *field);
+static void BallField_collidePaddle(BallField *field, const Paddle *paddle, float direction);
+static void BallField_collidePairs(BallField *field);
+static void BallField_collide(BallField *field, int a, int b);
+
+/* Returns a ball size that keeps the field about equally crowded for any ball count */
+float BallField_getDefaultSize(size_t count){
+
+	float size = sqrtf(BALL_FIELD_COVERAGE * WINDOW_WIDTH * WINDOW_HEIGHT / (float)MAX(count, (size_t)1));
+	return MAX(MIN(size, BALL_SIZE), 1.0f);
+
+}
+
+/* Creates a field of balls with random positions and directions, all moving at the normal ball speed */
+int BallField_create(BallField *field, size_t count, float size, unsigned int seed){
+
+	memset(field, 0, sizeof(*field));
+	field->count = count;
+	field->size = size;
+	field->rng = seed;
+	field->p1.position = (Point){SCALAR(P1_START_X), SCALAR(P1_START_Y)};
+	field->p2.position = (Point){SCALAR(P2_START_X), SCALAR(P2_START_Y)};
+
+	/* Cells one ball wide; overlapping balls then never lie more than one cell apart */
+	field->cellSize = size;
+	field->columns = (int)ceilf(WINDOW_WIDTH / size);
+	field->rows = (int)ceilf(WINDOW_HEIGHT / size);
+	size_t cells = (size_t)field->columns * (size_t)field->rows;
+
+	field->x = malloc(sizeof(float) * count);
+	field->y = malloc(sizeof(float) * count);
+	field->sx = malloc(sizeof(float) * count);
+	field->sy = malloc(sizeof(float) * count);
+	field->cellHeads = malloc(sizeof(int) * cells);
+	field->next = malloc(sizeof(int) * count);
+	field->prev = malloc(sizeof(int) * count);
+	field->cell = malloc(sizeof(int) * count);
+	if(!field->x || !field->y || !field->sx || !field->sy || !field->cellHeads || !field->next || !field->prev || !field->cell){
+		BallField_destroy(field);
+		return 0;
+	}
+
+	for(size_t i = 0; i < cells; ++i) field->cellHeads[i] = -1;
+
+	for(size_t i = 0; i < count; ++i){
+		field->x[i] = (float)BallField_random(field) / MATCH_RAND_MAX * (WINDOW_WIDTH - size);
+		field->y[i] = (float)BallField_random(field) / MATCH_RAND_MAX * (WINDOW_HEIGHT - size);
+
+		/* Random direction from a normalized vector rather than trigonometry, which differs between C libraries */
+		float dx = (float)BallField_random(field) - MATCH_RAND_MAX / 2, dy = (float)BallField_random(field) - MATCH_RAND_MAX / 2;
+		float length = sqrtf(dx * dx + dy * dy);
+		if(length == 0.0f){ dx = 1.0f; length = 1.0f; }
+		field->sx[i] = dx / length * BALL_SPEED;
+		field->sy[i] = dy / length * BALL_SPEED;
+		BallField_link(field, (int)i, BallField_getCell(field, i));
+	}
+
+	return 1;
+
+}
+
+/* Frees the field's arrays */
+void BallField_destroy(BallField *field){
+
+	free(field->x);
+	free(field->y);
+	free(field->sx);
+	free(field->sy);
+	free(field->cellHeads);
+	free(field->next);
+	free(field->prev);
+	free(field->cell);
+	memset(field, 0, sizeof(*field));
+
+}
+
+/* Advances the field by one tick using the paddle bits of the input */
+void BallField_tick(BallField *field, Input input){
+
+	memset(&field->stats, 0, sizeof(field->stats));
+
+	BallField_movePaddles(field, input);
+	BallField_moveBalls(field);
+
+	/* Relink only the balls that moved into another cell, so the grid matches the positions tested next */
+	for(size_t i = 0; i < field->count; ++i){
+		int cell = BallField_getCell(field, i);
+		if(cell == field->cell[i]) continue;
+		BallField_unlink(field, (int)i);
+		BallField_link(field, (int)i, cell);
+		++field->stats.cellMoves;
+	}
+
+	BallField_collidePaddle(field, &field->p1, 1.0f);
+	BallField_collidePaddle(field, &field->p2, -1.0f);
+	BallField_collidePairs(field);
+
+}
+
+/* Returns a pseudo random number between 0 and MATCH_RAND_MAX, using the same generator as a match */
+static int BallField_random(BallField *field){
+
+	field->rng = field->rng * 214013u + 2531011u;
+	return (int)((field->rng >> 16) & MATCH_RAND_MAX);
+
+}
+
+/* Returns the grid cell holding a ball's top-left corner */
+static int BallField_getCell(const BallField *field, size_t ball){
+
+	int column = (int)(field->x[ball] / field->cellSize);
+	int row = (int)(field->y[ball] / field->cellSize);
+	column = MAX(MIN(column, field->columns - 1), 0);
+	row = MAX(MIN(row, field->rows - 1), 0);
+	return row * field->columns + column;
+
+}
+
+/* Puts a ball at the head of a cell's list */
+static void BallField_link(BallField *field, int ball, int cell){
+
+	int head = field->cellHeads[cell];
+	field->prev[ball] = -1;
+	field->next[ball] = head;
+	if(head >= 0) field->prev[head] = ball;
+	field->cellHeads[cell] = ball;
+	field->cell[ball] = cell;
+
+}
+
+/* Takes a ball out of its cell's list */
+static void BallField_unlink(BallField *field, int ball){
+
+	int prev = field->prev[ball], next = field->next[ball];
+	if(prev >= 0) field->next[prev] = next;
+	else field->cellHeads[field->cell[ball]] = next;
+	if(next >= 0) field->prev[next] = prev;
+
+}
+
+/* Moves both paddles like in a match */
+static void BallField_movePaddles(BallField *field, Input input){
+
+	Paddle *paddles[2] = {&field->p1, &field->p2};
+	int up[2] = {input & INPUT_P1_UP, input & INPUT_P2_UP};
+	int down[2] = {input & INPUT_P1_DOWN, input & INPUT_P2_DOWN};
+
+	for(int i = 0; i < 2; ++i){
+		Scalar y = paddles[i]->position.y;
+		if(up[i]) y -= SCALAR(PADDLE_SPEED);
+		if(down[i]) y += SCALAR(PADDLE_SPEED);
+		paddles[i]->position.y = MAX(MIN(y, SCALAR(WINDOW_HEIGHT - PADDLE_HEIGHT)), 0);
+	}
+
+}
+
+/* Moves every ball and bounces it off the field's edges */
+static void BallField_moveBalls(BallField *field){
+
+	float maxX = WINDOW_WIDTH - field->size, maxY = WINDOW_HEIGHT - field->size;
+
+	for(size_t i = 0; i < field->count; ++i){
+
+		float x = field->x[i] + field->sx[i], y = field->y[i] + field->sy[i];
+
+		if(y < 0.0f || y > maxY){
+			y = (y < 0.0f) ? -y : 2.0f * maxY - y;
+			field->sy[i] = -field->sy[i];
+			++field->stats.wallBounces;
+		}
+
+		/* The side walls bounce too, scoring a point for the player on the other side */
+		if(x < 0.0f || x > maxX){
+			if(x < 0.0f) ++field->p2.score;
+			else ++field->p1.score;
+			x = (x < 0.0f) ? -x : 2.0f * maxX - x;
+			field->sx[i] = -field->sx[i];
+			++field->stats.wallBounces;
+		}
+
+		field->x[i] = x;
+		field->y[i] = y;
+
+	}
+
+}
+
+/* Pushes balls overlapping a paddle out of its front face. 'direction' is the way the face points. */
+static void BallField_collidePaddle(BallField *field, const Paddle *paddle, float direction){
+
+	float left = Scalar_toFloat(paddle->position.x), right = left + PADDLE_WIDTH;
+	float top = Scalar_toFloat(paddle->position.y), bottom = top + PADDLE_HEIGHT;
+
+	/* Only the cells the paddle covers can hold overlapping balls */
+	int firstColumn = MAX((int)((left - field->size) / field->cellSize), 0);
+	int lastColumn = MIN((int)(right / field->cellSize), field->columns - 1);
+	int firstRow = MAX((int)((top - field->size) / field->cellSize), 0);
+	int lastRow = MIN((int)(bottom / field->cellSize), field->rows - 1);
+
+	for(int row = firstRow; row <= lastRow; ++row){
+		for(int column = firstColumn; column <= lastColumn; ++column){
+			for(int i = field->cellHeads[row * field->columns + column]; i >= 0; i = field->next[i]){
+
+				float x = field->x[i], y = field->y[i];
+				if(x >= right || x + field->size <= left || y >= bottom || y + field->size <= top) continue;
+
+				field->x[i] = (direction > 0.0f) ? right : left - field->size;
+				field->sx[i] = fabsf(field->sx[i]) * direction;
+				++field->stats.paddleHits;
+
+			}
+		}
+	}
+
+}
+
+/* Tests every ball against the balls in its own cell and in the neighbouring cells after it.
+   Visiting only the forward half of the neighbours tests each pair once. */
+static void BallField_collidePairs(BallField *field){
+
+	static const int offsets[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+	int columns = field->columns, rows = field->rows;
+
+	for(int row = 0; row < rows; ++row){
+		for(int column = 0; column < columns; ++column){
+
+			int head = field->cellHeads[row * columns + column];
+			if(head < 0) continue;
+
+			for(int a = head; a >= 0; a = field->next[a]){
+
+				for(int b = field->next[a]; b >= 0; b = field->next[b]) BallField_collide(field, a, b);
+
+				for(int n = 0; n < 4; ++n){
+					int c = column + offsets[n][0], r = row + offsets[n][1];
+					if(c < 0 || c >= columns || r >= rows) continue;
+					for(int b = field->cellHeads[r * columns + c]; b >= 0; b = field->next[b]) BallField_collide(field, a, b);
+				}
+
+			}
+
+		}
+	}
+
+}
+
+/* Resolves an overlap between two balls of equal mass. They are separated along the axis of least
+   overlap and, if they are moving towards each other, exchange their speeds along that axis. */
+static void BallField_collide(BallField *field, int a, int b){
+
+	++field->stats.pairsTested;
+
+	float dx = field->x[b] - field->x[a], dy = field->y[b] - field->y[a];
+	float overlapX = field->size - fabsf(dx), overlapY = field->size - fabsf(dy);
+	if(overlapX <= 0.0f || overlapY <= 0.0f) return;
+
+	++field->stats.contacts;
+
+	if(overlapX < overlapY){
+		float push = (dx >= 0.0f) ? overlapX * 0.5f : -overlapX * 0.5f;
+		field->x[a] -= push;
+		field->x[b] += push;
+		if((field->sx[a] - field->sx[b]) * dx > 0.0f){
+			float swap = field->sx[a]; field->sx[a] = field->sx[b]; field->sx[b] = swap;
+		}
+	}else{
+		float push = (dy >= 0.0f) ? overlapY * 0.5f : -overlapY * 0.5f;
+		field->y[a] -= push;
+		field->y[b] += push;
+		if((field->sy[a] - field->sy[b]) * dy > 0.0f){
+			float swap = field->sy[a]; field->sy[a] = field->sy[b]; field->sy[b] = swap;
+		}
+	}
+
+	/* Separation must not push a ball out of the field */
+	field->x[a] = MAX(MIN(field->x[a], WINDOW_WIDTH - field->size), 0.0f);
+	field->x[b] = MAX(MIN(field->x[b], WINDOW_WIDTH - field->size), 0.0f);
+	field->y[a] = MAX(MIN(field->y[a], WINDOW_HEIGHT - field->size), 0.0f);
+	field->y[b] = MAX(MIN(field->y[b], WINDOW_HEIGHT - field->size), 0.0f);
+
+}
@@ -0,0 +1,66 @@
+/*
+   CPong
+   Many-ball mode. A field of up to hundreds of thousands of balls that
+   bounce off the walls, both paddles and each other.
+
+   Ball pairs are found with a uniform grid whose cells are one ball wide,
+   so two overlapping balls are always in the same or neighbouring cells.
+   Each cell keeps a doubly linked list of the balls inside it. The grid
+   is updated incrementally: after moving, only balls that crossed into a
+   different cell are unlinked and relinked, which is a small fraction at
+   normal speeds. The cost of a tick grows with the number of balls and
+   of nearby pairs instead of with the square of the ball count.
+
+   Balls that reach the left or right edge bounce back and score a point
+   for the other player, so the field never empties.
+*/
+
+#ifndef BALLS_H
+#define BALLS_H
+
+#include <stddef.h>
+
+#include "pong.h"
+
+/* Define the 'BallFieldStats' struct with the counts of the last tick */
+typedef struct BallFieldStats{
+
+	unsigned long long pairsTested;		/* Narrow phase overlap tests */
+	unsigned long long contacts;		/* Ball pairs that collided */
+	unsigned long long cellMoves;		/* Balls relinked to another cell */
+	unsigned long long paddleHits;
+	unsigned long long wallBounces;
+
+} BallFieldStats;
+
+/* Define the 'BallField' struct. Ball data is stored as separate arrays. */
+typedef struct BallField{
+
+	size_t count;
+	float size;				/* Side length of every ball */
+	float *x, *y;
+	float *sx, *sy;
+	Paddle p1;
+	Paddle p2;
+	unsigned int rng;
+
+	/* Broadphase grid */
+	float cellSize;
+	int columns;
+	int rows;
+	int *cellHeads;				/* First ball in each cell, or -1 */
+	int *next;
+	int *prev;
+	int *cell;				/* Cell each ball is linked into */
+
+	BallFieldStats stats;
+
+} BallField;
+
+/* Ball field function declarations. Functions returning int return nonzero on success. */
+float BallField_getDefaultSize(size_t count);
+int BallField_create(BallField *field, size_t count, float size, unsigned int seed);
+void BallField_destroy(BallField *field);
+void BallField_tick(BallField *field, Input input);
+
+#endif
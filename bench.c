@@ -0,0 +1,1058 @@
+/*
+   CPong
+   Benchmark and golden-trace suite for the collision code.
+
+   Times 'Point_getDistance', the one-contact 'getPaddleCollision' and
+   'getWallCollision' the tick no longer uses, their batched SIMD kernels
+   and the full per-tick update over several
+   sets of trajectories, including adversarial ones, and the many-ball
+   mode from 1 to 100000 balls. The swept collision solver is run at
+   ball speeds up to 'BALL_MAX_SPEED' and checked for tunnelling. Arena
+   layouts of 10 to 10000 obstacles time the tree sweep against testing
+   every obstacle, which it must agree with exactly. Golden traces hash
+   the exact results of the collision functions and of whole simulated
+   matches, so an optimization that changes behaviour fails the run.
+   Telemetry of bot matches is written, read back and compared row by
+   row, so a change to the encoding that loses a bit fails it as well.
+
+   Built with PONG_FIXED the suite runs on the fixed point backend. Its
+   golden traces are stored under a "fixed/" prefix next to the float ones
+   in the same file, and the JSON names the backend, so the throughput of
+   both backends can be compared entry by entry.
+
+   Usage: bench [-json <file>] [-golden <file>] [-update-golden]
+
+   Results are written as JSON to stdout or the given file. Build with
+   PONG_BRANCH_STATS to include per-branch hit counts; the counts come
+   from one untimed pass over each trajectory set.
+*/
+
+/* Standard C includes */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "pong.h"
+#include "balls.h"
+#include "collide_simd.h"
+#include "layout.h"
+#include "telemetry.h"
+#include "timer.h"
+
+/* Benchmark property definitions */
+#define BATCH_SIZE 4096
+#define MIN_BENCH_TIME 0.25
+#define TICK_MATCHES 1024
+#define GOLDEN_MATCHES 64
+#define GOLDEN_TICKS 20000
+#define DEFAULT_GOLDEN_PATH "golden.txt"
+#define MAX_GOLDEN 32
+#define BALL_COUNTS 6				/* Ball counts 1, 10, ... 100000 */
+#define MIN_BALL_TICKS 10
+#define GOLDEN_BALLS 1000
+#define GOLDEN_BALL_TICKS 600
+#define SWEEP_SPEEDS 5				/* Ball speeds from 'BALL_SPEED' up to 'BALL_MAX_SPEED' */
+#define LAYOUT_COUNTS 4				/* Obstacle counts 10, 100, 1000 and 10000 */
+#define LAYOUT_QUERIES 4096
+#define LAYOUT_FILL 0.2f			/* Share of the space between the paddle lanes covered by obstacles */
+#define GOLDEN_LAYOUT_OBSTACLES 100
+#define GOLDEN_LAYOUT_TICKS 5000
+#define TELEMETRY_MATCHES 16
+#define TELEMETRY_TICKS 4000
+#define TELEMETRY_CHANNELS 3
+#define TELEMETRY_INTERLEAVED 2			/* Channels the first half of the matches alternate between, each interleaving several */
+#define TELEMETRY_ENCODERS 2
+#define TELEMETRY_PATH "bench-telemetry.tmp"
+
+/* Name of the scalar backend and the prefix of its golden traces */
+#ifdef PONG_FIXED
+#define BACKEND_NAME "fixed"
+#define GOLDEN_PREFIX "fixed/"
+#else
+#define BACKEND_NAME "float"
+#define GOLDEN_PREFIX ""
+#endif
+
+/* Trajectory sets used by the benchmarks */
+typedef enum {SET_RANDOM, SET_CORNER, SET_STEEP, SET_VERTICAL, SET_COUNT} TrajectorySet;
+
+/* Define the 'TelemetryCheck' struct holding what one tick of the telemetry check should decode to */
+typedef struct TelemetryCheck{
+
+	unsigned int events;
+	Scalar values[TELEMETRY_VALUES];
+	int bounceCount;
+	MatchContact bounces[MATCH_MAX_CONTACTS];
+	int ticksRead;
+	int bouncesRead;
+
+} TelemetryCheck;
+
+/* Define the 'TelemetryReadback' struct, the state of reading the check's file back */
+typedef struct TelemetryReadback{
+
+	TelemetryCheck *checks;
+	unsigned long long rows;
+	unsigned long long mismatches;
+
+} TelemetryReadback;
+
+/* Define a 'Golden' struct holding one named trace hash */
+typedef struct Golden{
+
+	char name[64];
+	unsigned long long hash;
+
+} Golden;
+
+/* Define the 'Suite' struct holding the state of a benchmark run */
+typedef struct Suite{
+
+	FILE *out;
+	int failed;
+	int firstEntry;
+	Golden expected[MAX_GOLDEN];
+	int expectedCount;
+	Golden actual[MAX_GOLDEN];
+	int actualCount;
+
+} Suite;
+
+/* Function declarations */
+unsigned int nextRandom(unsigned int *state);
+float randomRange(unsigned int *state, float min, float max);
+void fillBatch(BallBatch *balls, unsigned int seed, TrajectorySet set);
+size_t countMismatches(const CollisionBatch *a, const CollisionBatch *b, size_t count);
+void allocBatch(BallBatch *balls, CollisionBatch *out, size_t count);
+void freeBatch(BallBatch *balls, CollisionBatch *out);
+unsigned long long hashBytes(unsigned long long hash, const void *bytes, size_t size);
+unsigned long long hashCollision(unsigned long long hash, Collision collision, Point newPosition);
+unsigned long long hashMatch(unsigned long long hash, const Match *match);
+Input trackingInput(const Match *match);
+void beginEntry(Suite *suite);
+void benchScalar(Suite *suite, const BallBatch *balls, TrajectorySet set);
+void benchSimd(Suite *suite, const BallBatch *balls, TrajectorySet set);
+void benchTick(Suite *suite);
+void benchBalls(Suite *suite, size_t count);
+void benchSweep(Suite *suite, float speed);
+int makeLayout(Layout *layout, size_t count, unsigned int seed);
+int sweepEveryObstacle(const Layout *layout, const Ball *ball, Scalar limit, Scalar *time, Side *side);
+void benchLayout(Suite *suite, size_t count);
+void addGolden(Suite *suite, const char *name, unsigned long long hash);
+void goldenCollisions(Suite *suite, const BallBatch *balls, TrajectorySet set);
+void goldenMatches(Suite *suite, const char *name, int inputMode);
+void goldenBalls(Suite *suite);
+void goldenLayout(Suite *suite);
+void checkTelemetry(Suite *suite);
+void compareTelemetryRow(const TelemetryRow *row, void *arg);
+unsigned long long recordTelemetryTick(Telemetry *telemetry, TelemetryCheck *checks, Match *match, int index, int tick);
+int telemetryChannel(int match);
+int sameValue(double value, Scalar expected);
+int loadGolden(Suite *suite, const char *path);
+int saveGolden(const Suite *suite, const char *path);
+
+/* Printable names of the trajectory sets and branches */
+static const char *setNames[SET_COUNT] = {"random", "corner", "steep", "vertical"};
+static const char *branchNames[BRANCH_COUNT] = {
+	"paddle_no_slope", "paddle_past", "paddle_horizontal", "paddle_vertical", "paddle_both", "paddle_miss",
+	"wall_no_slope", "wall_horizontal", "wall_vertical", "wall_both", "wall_miss"
+};
+
+/* Keeps benchmark results alive so the compiler cannot drop the measured calls */
+static volatile float sink;
+
+/* Program entrypoint */
+int main(int argc, char **argv){
+
+	const char *jsonPath = NULL, *goldenPath = DEFAULT_GOLDEN_PATH;
+	int updateGolden = 0;
+
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "-json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+		else if(strcmp(argv[i], "-golden") == 0 && i + 1 < argc) goldenPath = argv[++i];
+		else if(strcmp(argv[i], "-update-golden") == 0) updateGolden = 1;
+		else{
+			fprintf(stderr, "Usage: %s [-json <file>] [-golden <file>] [-update-golden]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	Suite suite;
+	memset(&suite, 0, sizeof(suite));
+	suite.out = jsonPath ? fopen(jsonPath, "w") : stdout;
+	if(!suite.out){
+		fprintf(stderr, "Could not create %s\n", jsonPath);
+		return EXIT_FAILURE;
+	}
+	if(!loadGolden(&suite, goldenPath) && !updateGolden)
+		fprintf(stderr, "Could not read golden traces from %s\n", goldenPath);
+
+	BallBatch balls;
+	allocBatch(&balls, NULL, BATCH_SIZE);
+
+	fprintf(suite.out, "{\n  \"version\": 1,\n  \"backend\": \"%s\",\n", BACKEND_NAME);
+#ifdef PONG_BRANCH_STATS
+	fprintf(suite.out, "  \"branch_stats\": true,\n");
+#else
+	fprintf(suite.out, "  \"branch_stats\": false,\n");
+#endif
+
+	/* Scalar function benchmarks */
+	fprintf(suite.out, "  \"benchmarks\": [");
+	suite.firstEntry = 1;
+	for(int set = 0; set < SET_COUNT; ++set){
+		fillBatch(&balls, 1, (TrajectorySet)set);
+		benchScalar(&suite, &balls, (TrajectorySet)set);
+	}
+	benchTick(&suite);
+	fprintf(suite.out, "\n  ],\n");
+
+	/* Batched kernel benchmarks */
+	fprintf(suite.out, "  \"simd\": [");
+	suite.firstEntry = 1;
+	for(int set = 0; set < SET_COUNT; ++set){
+		fillBatch(&balls, 1, (TrajectorySet)set);
+		benchSimd(&suite, &balls, (TrajectorySet)set);
+	}
+	fprintf(suite.out, "\n  ],\n");
+
+	/* Many-ball mode, frame time against ball count */
+	fprintf(suite.out, "  \"balls\": [");
+	suite.firstEntry = 1;
+	for(size_t count = 1, i = 0; i < BALL_COUNTS; count *= 10, ++i) benchBalls(&suite, count);
+	fprintf(suite.out, "\n  ],\n");
+
+	/* Swept collision solver, tick cost and tunnelling against ball speed */
+	static const float sweepSpeeds[SWEEP_SPEEDS] = {BALL_SPEED, 4.0f * BALL_SPEED, 10.0f * BALL_SPEED, 15.0f * BALL_SPEED, BALL_MAX_SPEED};
+	fprintf(suite.out, "  \"sweep\": [");
+	suite.firstEntry = 1;
+	for(int i = 0; i < SWEEP_SPEEDS; ++i) benchSweep(&suite, sweepSpeeds[i]);
+	fprintf(suite.out, "\n  ],\n");
+
+	/* Arena layouts, sweep and tick cost against obstacle count */
+	fprintf(suite.out, "  \"layout\": [");
+	suite.firstEntry = 1;
+	for(size_t count = 10, i = 0; i < LAYOUT_COUNTS; count *= 10, ++i) benchLayout(&suite, count);
+	fprintf(suite.out, "\n  ],\n");
+
+	/* Telemetry file round trip */
+	checkTelemetry(&suite);
+
+	/* Golden traces */
+	for(int set = 0; set < SET_COUNT; ++set){
+		fillBatch(&balls, 2, (TrajectorySet)set);
+		goldenCollisions(&suite, &balls, (TrajectorySet)set);
+	}
+	goldenMatches(&suite, "match/tracking", 0);
+	goldenMatches(&suite, "match/random_input", 1);
+	goldenMatches(&suite, "match/idle", 2);
+	goldenBalls(&suite);
+	goldenLayout(&suite);
+
+	fprintf(suite.out, "  \"golden\": [");
+	suite.firstEntry = 1;
+	for(int i = 0; i < suite.actualCount; ++i){
+
+		const Golden *actual = &suite.actual[i];
+		const Golden *expected = NULL;
+		for(int j = 0; j < suite.expectedCount; ++j)
+			if(strcmp(suite.expected[j].name, actual->name) == 0) expected = &suite.expected[j];
+
+		int pass = updateGolden || (expected && expected->hash == actual->hash);
+		if(!pass){
+			suite.failed = 1;
+			fprintf(stderr, "Golden trace mismatch: %s\n", actual->name);
+		}
+
+		beginEntry(&suite);
+		fprintf(suite.out, "{\"name\": \"%s\", \"expected\": \"%016llx\", \"actual\": \"%016llx\", \"pass\": %s}",
+			actual->name, expected ? expected->hash : 0ull, actual->hash, pass ? "true" : "false");
+
+	}
+	fprintf(suite.out, "\n  ],\n  \"passed\": %s\n}\n", suite.failed ? "false" : "true");
+
+	if(updateGolden && !saveGolden(&suite, goldenPath)){
+		fprintf(stderr, "Could not write golden traces to %s\n", goldenPath);
+		suite.failed = 1;
+	}
+
+	if(jsonPath) fclose(suite.out);
+	freeBatch(&balls, NULL);
+	return suite.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+
+}
+
+/* Small xorshift generator so the generated data does not depend on the C library */
+unsigned int nextRandom(unsigned int *state){
+
+	unsigned int x = *state;
+	x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+	return *state = x;
+
+}
+
+/* Returns a random float in [min, max) */
+float randomRange(unsigned int *state, float min, float max){
+
+	return min + (max - min) * ((float)(nextRandom(state) >> 8) / 16777216.0f);
+
+}
+
+/* Fills the batch with balls from the given trajectory set:
+
+   random     Balls placed close to a paddle or a wall so a good share collide
+   corner     Balls whose leading vertex passes exactly through a paddle or field corner
+   steep      Near-vertical paths with a tiny horizontal speed
+   vertical   Paths with no horizontal speed, taking the 'slopeD == 0' early return */
+void fillBatch(BallBatch *balls, unsigned int seed, TrajectorySet set){
+
+	unsigned int state = seed * 2654435761u + (unsigned int)set * 40503u + 1u;
+
+	for(size_t i = 0; i < balls->count; ++i){
+
+		float sx = randomRange(&state, -20.0f, 20.0f);
+		float sy = randomRange(&state, -20.0f, 20.0f);
+		if(set == SET_STEEP) sx = randomRange(&state, 0.0001f, 0.01f) * ((sx < 0.0f) ? -1.0f : 1.0f);
+		else if(set == SET_VERTICAL) sx = 0.0f;
+
+		int towardP2 = (sx >= 0.0f);
+		float paddleX = towardP2 ? P2_START_X : P1_START_X;
+
+		float py = randomRange(&state, 0.0f, WINDOW_HEIGHT - PADDLE_HEIGHT), x, y;
+		balls->px[i] = Scalar_fromFloat(paddleX);
+		balls->py[i] = Scalar_fromFloat(py);
+		balls->sx[i] = Scalar_fromFloat(sx);
+		balls->sy[i] = Scalar_fromFloat(sy);
+
+		if(set == SET_CORNER){
+
+			/* Aim the leading vertex at a paddle corner, or at a field corner one time in four */
+			float targetX, targetY;
+			if(nextRandom(&state) % 4){
+				targetX = paddleX + ((nextRandom(&state) % 2) ? PADDLE_WIDTH : 0.0f);
+				targetY = py + ((nextRandom(&state) % 2) ? PADDLE_HEIGHT : 0.0f);
+			}else{
+				targetX = towardP2 ? WINDOW_WIDTH : 0.0f;
+				targetY = (sy >= 0.0f) ? WINDOW_HEIGHT : 0.0f;
+			}
+			float t = randomRange(&state, 0.0f, 1.0f);
+			balls->x[i] = Scalar_fromFloat(targetX - (towardP2 ? BALL_SIZE : 0.0f) - sx * t);
+			balls->y[i] = Scalar_fromFloat(targetY - ((sy >= 0.0f) ? BALL_SIZE : 0.0f) - sy * t);
+			continue;
+
+		}
+
+		switch(nextRandom(&state) % 3){
+			case 0:		/* Near the paddle it is heading toward */
+				x = paddleX + (towardP2 ? -BALL_SIZE : PADDLE_WIDTH) + randomRange(&state, -20.0f, 20.0f);
+				y = py + randomRange(&state, -BALL_SIZE - 20.0f, PADDLE_HEIGHT + 20.0f);
+				break;
+			case 1:		/* Near the top or bottom wall */
+				x = randomRange(&state, 0.0f, WINDOW_WIDTH - BALL_SIZE);
+				y = (sy >= 0.0f) ? WINDOW_HEIGHT - BALL_SIZE - randomRange(&state, 0.0f, 20.0f) :
+					randomRange(&state, 0.0f, 20.0f);
+				break;
+			default:	/* Anywhere on the field */
+				x = randomRange(&state, 0.0f, WINDOW_WIDTH - BALL_SIZE);
+				y = randomRange(&state, 0.0f, WINDOW_HEIGHT - BALL_SIZE);
+				break;
+		}
+		balls->x[i] = Scalar_fromFloat(x);
+		balls->y[i] = Scalar_fromFloat(y);
+
+	}
+
+}
+
+/* Counts the balls whose results differ in any bit */
+size_t countMismatches(const CollisionBatch *a, const CollisionBatch *b, size_t count){
+
+	size_t mismatches = 0;
+
+	for(size_t i = 0; i < count; ++i){
+		if(a->collides[i] != b->collides[i] || a->side[i] != b->side[i] ||
+			memcmp(&a->x[i], &b->x[i], sizeof(Scalar)) || memcmp(&a->y[i], &b->y[i], sizeof(Scalar)) ||
+			memcmp(&a->nx[i], &b->nx[i], sizeof(Scalar)) || memcmp(&a->ny[i], &b->ny[i], sizeof(Scalar)))
+			++mismatches;
+	}
+
+	return mismatches;
+
+}
+
+/* Allocates the arrays of a ball batch and of a collision batch. Either pointer may be NULL. */
+void allocBatch(BallBatch *balls, CollisionBatch *out, size_t count){
+
+	if(balls){
+		Scalar **arrays[6] = {&balls->x, &balls->y, &balls->sx, &balls->sy, &balls->px, &balls->py};
+		for(int i = 0; i < 6; ++i) *arrays[i] = calloc(count, sizeof(Scalar));
+		balls->count = count;
+	}
+
+	if(out){
+		Scalar **arrays[4] = {&out->x, &out->y, &out->nx, &out->ny};
+		for(int i = 0; i < 4; ++i) *arrays[i] = calloc(count, sizeof(Scalar));
+		out->collides = calloc(count, sizeof(int));
+		out->side = calloc(count, sizeof(int));
+	}
+
+}
+
+/* Frees the arrays allocated by 'allocBatch' */
+void freeBatch(BallBatch *balls, CollisionBatch *out){
+
+	if(balls){
+		free(balls->x); free(balls->y); free(balls->sx);
+		free(balls->sy); free(balls->px); free(balls->py);
+	}
+
+	if(out){
+		free(out->x); free(out->y); free(out->nx); free(out->ny);
+		free(out->collides); free(out->side);
+	}
+
+}
+
+/* 64 bit FNV-1a hash, continued from the passed hash value */
+unsigned long long hashBytes(unsigned long long hash, const void *bytes, size_t size){
+
+	const unsigned char *data = bytes;
+	for(size_t i = 0; i < size; ++i){
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+
+}
+
+/* Hashes every field of a collision result */
+unsigned long long hashCollision(unsigned long long hash, Collision collision, Point newPosition){
+
+	int side = (int)collision.side;
+	hash = hashBytes(hash, &collision.collides, sizeof(int));
+	hash = hashBytes(hash, &side, sizeof(int));
+	hash = hashBytes(hash, &collision.position.x, sizeof(Scalar));
+	hash = hashBytes(hash, &collision.position.y, sizeof(Scalar));
+	hash = hashBytes(hash, &newPosition.x, sizeof(Scalar));
+	return hashBytes(hash, &newPosition.y, sizeof(Scalar));
+
+}
+
+/* Hashes every field of a match */
+unsigned long long hashMatch(unsigned long long hash, const Match *match){
+
+	const Scalar scalars[8] = {match->ball.position.x, match->ball.position.y, match->ball.speed.x, match->ball.speed.y,
+		match->p1.position.x, match->p1.position.y, match->p2.position.x, match->p2.position.y};
+	const int ints[6] = {match->p1.score, match->p2.score, match->gameState, match->gameStarting, match->countdown,
+		(int)match->events};
+
+	hash = hashBytes(hash, scalars, sizeof(scalars));
+	hash = hashBytes(hash, ints, sizeof(ints));
+	return hashBytes(hash, &match->rng, sizeof(match->rng));
+
+}
+
+/* Input of two simple bots that keep their paddle centered on the ball and always press start */
+Input trackingInput(const Match *match){
+
+	Input input = INPUT_START;
+	float ballY = Scalar_toFloat(match->ball.position.y) + BALL_SIZE * 0.5f;
+	float p1Y = Scalar_toFloat(match->p1.position.y) + PADDLE_HEIGHT * 0.5f;
+	float p2Y = Scalar_toFloat(match->p2.position.y) + PADDLE_HEIGHT * 0.5f;
+
+	if(ballY < p1Y - 10.0f) input |= INPUT_P1_UP;
+	else if(ballY > p1Y + 10.0f) input |= INPUT_P1_DOWN;
+	if(ballY < p2Y - 30.0f) input |= INPUT_P2_UP;
+	else if(ballY > p2Y + 30.0f) input |= INPUT_P2_DOWN;
+	return input;
+
+}
+
+/* Writes the separator before a JSON array entry */
+void beginEntry(Suite *suite){
+
+	fprintf(suite->out, suite->firstEntry ? "\n    " : ",\n    ");
+	suite->firstEntry = 0;
+
+}
+
+/* Times the scalar collision functions over a trajectory set */
+void benchScalar(Suite *suite, const BallBatch *balls, TrajectorySet set){
+
+	const char *names[3] = {"Point_getDistance", "getPaddleCollision", "getWallCollision"};
+
+	for(int function = 0; function < 3; ++function){
+
+		unsigned long long hits[BRANCH_COUNT] = {0};
+		unsigned long long passes = 0, start = Timer_now(), elapsed = 0;
+		float total = 0.0f;
+
+		do{
+
+#ifdef PONG_BRANCH_STATS
+			memset(branchHits, 0, sizeof(branchHits));
+#endif
+
+			for(size_t i = 0; i < balls->count; ++i){
+
+				Ball ball = {{balls->x[i], balls->y[i]}, {balls->sx[i], balls->sy[i]}};
+				Paddle paddle = {{balls->px[i], balls->py[i]}, 0};
+				Point newPosition = {0, 0};
+
+				if(function == 0) total += Scalar_toFloat(Point_getDistance(ball.position, paddle.position));
+				else if(function == 1) total += (float)getPaddleCollision(&ball, &paddle, &newPosition).collides;
+				else total += (float)getWallCollision(&ball, &newPosition).collides;
+
+			}
+
+#ifdef PONG_BRANCH_STATS
+			if(passes == 0) memcpy(hits, branchHits, sizeof(hits));
+#endif
+
+			++passes;
+			elapsed = Timer_now() - start;
+
+		}while(Timer_toSeconds(elapsed) < MIN_BENCH_TIME);
+
+		sink = total;
+		unsigned long long ops = passes * balls->count;
+
+		beginEntry(suite);
+		fprintf(suite->out, "{\"name\": \"%s\", \"trajectories\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.3f, \"branches\": {",
+			names[function], setNames[set], ops, (double)elapsed / (double)ops);
+		int first = 1;
+		for(int branch = 0; branch < BRANCH_COUNT; ++branch){
+			if(!hits[branch]) continue;
+			fprintf(suite->out, "%s\"%s\": %llu", first ? "" : ", ", branchNames[branch], hits[branch]);
+			first = 0;
+		}
+		fprintf(suite->out, "}}");
+
+	}
+
+}
+
+/* Times the batched kernels at every supported instruction set level and checks them against the scalar path */
+void benchSimd(Suite *suite, const BallBatch *balls, TrajectorySet set){
+
+	const char *names[2] = {"wall", "paddle"};
+	void (*kernels[2])(const BallBatch*, CollisionBatch*, SimdLevel) = {getWallCollisionBatch, getPaddleCollisionBatch};
+	CollisionBatch reference, out;
+	allocBatch(NULL, &reference, balls->count);
+	allocBatch(NULL, &out, balls->count);
+
+	for(int k = 0; k < 2; ++k){
+
+		kernels[k](balls, &reference, SIMD_SCALAR);
+
+		for(int level = SIMD_SCALAR; level < SIMD_LEVEL_COUNT; ++level){
+
+			if(!Simd_isSupported((SimdLevel)level)) continue;
+
+			kernels[k](balls, &out, (SimdLevel)level);
+			size_t mismatches = countMismatches(&reference, &out, balls->count);
+			if(mismatches){
+				suite->failed = 1;
+				fprintf(stderr, "%s kernel at %s differs from the scalar path on %zu %s balls\n",
+					names[k], Simd_getName((SimdLevel)level), mismatches, setNames[set]);
+			}
+
+			unsigned long long passes = 0, start = Timer_now(), elapsed = 0;
+			do{
+				for(int i = 0; i < 64; ++i) kernels[k](balls, &out, (SimdLevel)level);
+				passes += 64;
+				elapsed = Timer_now() - start;
+			}while(Timer_toSeconds(elapsed) < MIN_BENCH_TIME);
+
+			beginEntry(suite);
+			fprintf(suite->out, "{\"kernel\": \"%s\", \"isa\": \"%s\", \"trajectories\": \"%s\", "
+				"\"balls_per_second\": %.0f, \"mismatches\": %zu}",
+				names[k], Simd_getName((SimdLevel)level), setNames[set],
+				(double)(passes * balls->count) / Timer_toSeconds(elapsed), mismatches);
+
+		}
+
+	}
+
+	freeBatch(NULL, &reference);
+	freeBatch(NULL, &out);
+
+}
+
+/* Times the full per-tick update on many matches played by tracking bots */
+void benchTick(Suite *suite){
+
+	static Match matches[TICK_MATCHES];
+	static Input inputs[TICK_MATCHES];
+	for(int i = 0; i < TICK_MATCHES; ++i) Match_init(&matches[i], (unsigned int)i);
+
+	unsigned long long ticks = 0, elapsed = 0, wall = Timer_now();
+
+	do{
+		for(int i = 0; i < TICK_MATCHES; ++i) inputs[i] = trackingInput(&matches[i]);
+		unsigned long long start = Timer_now();
+		Match_step(matches, inputs, TICK_MATCHES);
+		elapsed += Timer_now() - start;
+		ticks += TICK_MATCHES;
+	}while(Timer_toSeconds(Timer_now() - wall) < MIN_BENCH_TIME);
+
+	beginEntry(suite);
+	fprintf(suite->out, "{\"name\": \"Match_tick\", \"trajectories\": \"tracking_bots\", \"ops\": %llu, "
+		"\"ns_per_op\": %.3f, \"branches\": {}}", ticks, (double)elapsed / (double)ticks);
+
+}
+
+/* Times ticks of a ball field of the given size, with the default ball size for that count */
+void benchBalls(Suite *suite, size_t count){
+
+	BallField field;
+	if(!BallField_create(&field, count, BallField_getDefaultSize(count), 1)) return;
+
+	unsigned long long ticks = 0, elapsed = 0, pairs = 0, contacts = 0, moves = 0, wall = Timer_now();
+	do{
+		unsigned long long start = Timer_now();
+		BallField_tick(&field, 0);
+		elapsed += Timer_now() - start;
+		pairs += field.stats.pairsTested;
+		contacts += field.stats.contacts;
+		moves += field.stats.cellMoves;
+		++ticks;
+	}while(ticks < MIN_BALL_TICKS || Timer_toSeconds(Timer_now() - wall) < MIN_BENCH_TIME);
+
+	/* All pairs is what a broadphase-free test would have to check */
+	beginEntry(suite);
+	fprintf(suite->out, "{\"balls\": %zu, \"size\": %.2f, \"ticks\": %llu, \"ms_per_tick\": %.4f, "
+		"\"pairs_tested\": %.1f, \"all_pairs\": %.0f, \"contacts\": %.1f, \"cell_moves\": %.1f}",
+		count, field.size, ticks, (double)elapsed / 1e6 / (double)ticks, (double)pairs / (double)ticks,
+		(double)count * (double)(count - 1) / 2.0, (double)contacts / (double)ticks, (double)moves / (double)ticks);
+
+	BallField_destroy(&field);
+
+}
+
+/* Plays matches between tracking bots with every serve sped up to the given horizontal speed in units per
+   tick. After each tick the ball must lie inside the field and, unless a paddle moved into it, outside both
+   paddles; every other outcome counts as a tunnel. */
+void benchSweep(Suite *suite, float speed){
+
+	static Match matches[TICK_MATCHES];
+	static Input inputs[TICK_MATCHES];
+	for(int i = 0; i < TICK_MATCHES; ++i) Match_init(&matches[i], (unsigned int)i);
+
+	unsigned long long ticks = 0, roundTicks = 0, elapsed = 0, contacts = 0, tunnels = 0, wall = Timer_now();
+
+	do{
+
+		static Match before[TICK_MATCHES];
+		for(int i = 0; i < TICK_MATCHES; ++i){
+			inputs[i] = trackingInput(&matches[i]);
+			before[i] = matches[i];
+		}
+
+		unsigned long long start = Timer_now();
+		Match_step(matches, inputs, TICK_MATCHES);
+		elapsed += Timer_now() - start;
+		ticks += TICK_MATCHES;
+
+		for(int i = 0; i < TICK_MATCHES; ++i){
+
+			Match *match = &matches[i];
+			if(match->events & MATCH_EVENT_ROUND_START)
+				match->ball.speed.x = Scalar_fromFloat((match->ball.speed.x < 0) ? -speed : speed);
+			if(before[i].gameState != 1) continue;
+
+			++roundTicks;
+			contacts += ((match->events & MATCH_EVENT_PADDLE_HIT) != 0) + ((match->events & MATCH_EVENT_WALL_BOUNCE) != 0);
+
+			const Ball *ball = &match->ball;
+			int outside = ball->position.x < 0 || ball->position.y < 0 ||
+				Ball_getBound(ball, RIGHT) > SCALAR(WINDOW_WIDTH) || Ball_getBound(ball, BOTTOM) > SCALAR(WINDOW_HEIGHT);
+			int inside = (Paddle_intersectsBall(&match->p1, ball) && !Paddle_intersectsBall(&match->p1, &before[i].ball)) ||
+				(Paddle_intersectsBall(&match->p2, ball) && !Paddle_intersectsBall(&match->p2, &before[i].ball));
+			if(outside || (inside && match->p1.position.y == before[i].p1.position.y && match->p2.position.y == before[i].p2.position.y))
+				++tunnels;
+
+		}
+
+	}while(Timer_toSeconds(Timer_now() - wall) < MIN_BENCH_TIME);
+
+	if(tunnels) suite->failed = 1;
+
+	beginEntry(suite);
+	fprintf(suite->out, "{\"speed\": %.1f, \"speed_per_second\": %.0f, \"ticks\": %llu, \"ns_per_tick\": %.3f, "
+		"\"round_ticks\": %llu, \"contacts\": %llu, \"tunnels\": %llu}",
+		speed, speed * TICK_RATE, ticks, (double)elapsed / (double)ticks, roundTicks, contacts, tunnels);
+
+}
+
+/* Builds a layout of random walls, bumpers and a few goals between the paddle lanes, sized so they cover about
+   'LAYOUT_FILL' of that space whatever their count, and leaving the serve clear */
+int makeLayout(Layout *layout, size_t count, unsigned int seed){
+
+	Obstacle *obstacles = malloc(sizeof(Obstacle) * count);
+	if(!obstacles) return 0;
+
+	unsigned int state = seed * 2654435761u + 1u;
+	float left = P1_START_X + PADDLE_WIDTH + BALL_SIZE, right = P2_START_X - BALL_SIZE;
+	float side = sqrtf(LAYOUT_FILL * (right - left) * WINDOW_HEIGHT / (float)count);
+
+	for(size_t i = 0; i < count; ){
+
+		float width = side * randomRange(&state, 0.5f, 1.5f), height = side * randomRange(&state, 0.5f, 1.5f);
+		float x = randomRange(&state, left, right - width), y = randomRange(&state, 0.0f, WINDOW_HEIGHT - height);
+		unsigned int kind = nextRandom(&state) % 16;
+		if(x < BALL_START_X + 2.0f * BALL_SIZE && x + width > BALL_START_X - BALL_SIZE &&
+			y < BALL_START_Y + 2.0f * BALL_SIZE && y + height > BALL_START_Y - BALL_SIZE) continue;
+
+		Obstacle *obstacle = &obstacles[i++];
+		obstacle->min = (Point){Scalar_fromFloat(x), Scalar_fromFloat(y)};
+		obstacle->max = (Point){Scalar_fromFloat(x + width), Scalar_fromFloat(y + height)};
+		obstacle->kind = (kind == 0) ? OBSTACLE_GOAL : (kind < 6) ? OBSTACLE_BUMPER : OBSTACLE_WALL;
+		obstacle->player = (kind == 0) ? 1 + (int)(nextRandom(&state) % 2) : 0;
+
+	}
+
+	int ok = Layout_create(layout, obstacles, count);
+	free(obstacles);
+	return ok;
+
+}
+
+/* Sweeps the ball against every obstacle of the layout in turn, the reference for 'Layout_sweep' */
+int sweepEveryObstacle(const Layout *layout, const Ball *ball, Scalar limit, Scalar *time, Side *side){
+
+	int hit = -1;
+	for(size_t i = 0; i < layout->count; ++i){
+		Scalar obstacleTime; Side obstacleSide;
+		if(Ball_sweepRect(ball, layout->obstacles[i].min, layout->obstacles[i].max, limit, &obstacleTime, &obstacleSide) &&
+			(hit < 0 || obstacleTime < *time)){
+			*time = obstacleTime;
+			*side = obstacleSide;
+			hit = (int)i;
+		}
+	}
+	return hit;
+
+}
+
+/* Times ball sweeps through a random layout of the given size against testing every obstacle, which must find
+   the same hits, and the full tick of matches between tracking bots played in it */
+void benchLayout(Suite *suite, size_t count){
+
+	Layout layout;
+	if(!makeLayout(&layout, count, (unsigned int)count)) return;
+
+	/* Sweeps from anywhere in the field at up to four times the serve speed */
+	static Ball queries[LAYOUT_QUERIES];
+	unsigned int state = 99u;
+	for(int i = 0; i < LAYOUT_QUERIES; ++i){
+		queries[i].position = (Point){Scalar_fromFloat(randomRange(&state, 0.0f, WINDOW_WIDTH - BALL_SIZE)),
+			Scalar_fromFloat(randomRange(&state, 0.0f, WINDOW_HEIGHT - BALL_SIZE))};
+		queries[i].speed = (Point){Scalar_fromFloat(randomRange(&state, -4.0f, 4.0f) * BALL_SPEED),
+			Scalar_fromFloat(randomRange(&state, -4.0f, 4.0f) * BALL_SPEED)};
+	}
+
+	unsigned long long mismatches = 0, hits = 0;
+	for(int i = 0; i < LAYOUT_QUERIES; ++i){
+		Scalar treeTime = 0, allTime = 0; Side treeSide = TOP, allSide = TOP;
+		int tree = Layout_sweep(&layout, &queries[i], SCALAR(1.0f), &treeTime, &treeSide);
+		int all = sweepEveryObstacle(&layout, &queries[i], SCALAR(1.0f), &allTime, &allSide);
+		hits += (tree >= 0);
+		if(tree != all || (tree >= 0 && (treeTime != allTime || treeSide != allSide))) ++mismatches;
+	}
+	if(mismatches) suite->failed = 1;
+
+	double sweepTimes[2];
+	for(int method = 0; method < 2; ++method){
+		unsigned long long sweeps = 0, start = Timer_now();
+		do{
+			int found = 0;
+			for(int i = 0; i < LAYOUT_QUERIES; ++i){
+				Scalar time; Side side;
+				found += (method ? sweepEveryObstacle(&layout, &queries[i], SCALAR(1.0f), &time, &side) :
+					Layout_sweep(&layout, &queries[i], SCALAR(1.0f), &time, &side)) >= 0;
+			}
+			sink = (float)found;
+			sweeps += LAYOUT_QUERIES;
+		}while(Timer_toSeconds(Timer_now() - start) < MIN_BENCH_TIME);
+		sweepTimes[method] = (double)(Timer_now() - start) / (double)sweeps;
+	}
+
+	/* Whole ticks of bot matches in the layout */
+	static Match matches[TICK_MATCHES];
+	static Input inputs[TICK_MATCHES];
+	for(int i = 0; i < TICK_MATCHES; ++i) Match_init(&matches[i], (unsigned int)i);
+	unsigned long long ticks = 0, elapsed = 0, obstacleHits = 0, wall = Timer_now();
+	do{
+		for(int i = 0; i < TICK_MATCHES; ++i) inputs[i] = trackingInput(&matches[i]);
+		unsigned long long start = Timer_now();
+		for(int i = 0; i < TICK_MATCHES; ++i) Match_tickLayout(&matches[i], &layout, inputs[i], NULL);
+		elapsed += Timer_now() - start;
+		for(int i = 0; i < TICK_MATCHES; ++i) obstacleHits += (matches[i].events & MATCH_EVENT_OBSTACLE_HIT) != 0;
+		ticks += TICK_MATCHES;
+	}while(Timer_toSeconds(Timer_now() - wall) < MIN_BENCH_TIME);
+
+	beginEntry(suite);
+	fprintf(suite->out, "{\"obstacles\": %zu, \"depth\": %d, \"queries\": %d, \"hits\": %llu, \"mismatches\": %llu, "
+		"\"ns_per_sweep\": %.3f, \"ns_per_linear_sweep\": %.3f, \"ns_per_tick\": %.3f, \"ticks_with_obstacle_hits\": %llu}",
+		count, layout.depth, LAYOUT_QUERIES, hits, mismatches, sweepTimes[0], sweepTimes[1],
+		(double)elapsed / (double)ticks, obstacleHits);
+
+	Layout_destroy(&layout);
+
+}
+
+/* Records the hash of a golden trace */
+void addGolden(Suite *suite, const char *name, unsigned long long hash){
+
+	if(suite->actualCount == MAX_GOLDEN) return;
+	Golden *golden = &suite->actual[suite->actualCount++];
+	snprintf(golden->name, sizeof(golden->name), "%s%s", GOLDEN_PREFIX, name);
+	golden->hash = hash;
+
+}
+
+/* Hashes the exact results of both scalar collision functions over a trajectory set */
+void goldenCollisions(Suite *suite, const BallBatch *balls, TrajectorySet set){
+
+	unsigned long long hash = 14695981039346656037ull;
+
+	for(size_t i = 0; i < balls->count; ++i){
+
+		Ball ball = {{balls->x[i], balls->y[i]}, {balls->sx[i], balls->sy[i]}};
+		Paddle paddle = {{balls->px[i], balls->py[i]}, 0};
+		Point newPosition = {0, 0};
+
+		Collision collision = getPaddleCollision(&ball, &paddle, &newPosition);
+		hash = hashCollision(hash, collision, newPosition);
+
+		newPosition = (Point){0, 0};
+		collision = getWallCollision(&ball, &newPosition);
+		hash = hashCollision(hash, collision, newPosition);
+
+	}
+
+	char name[48];
+	snprintf(name, sizeof(name), "collision/%s", setNames[set]);
+	addGolden(suite, name, hash);
+
+}
+
+/* Hashes the state of seeded matches after every tick. Input mode 0 uses tracking bots,
+   1 presses random keys and 2 only presses start so every rally ends in a score. */
+void goldenMatches(Suite *suite, const char *name, int inputMode){
+
+	static Match matches[GOLDEN_MATCHES];
+	unsigned long long hash = 14695981039346656037ull;
+	unsigned int state = 12345u;
+
+	for(int i = 0; i < GOLDEN_MATCHES; ++i) Match_init(&matches[i], (unsigned int)i * 7919u);
+
+	for(int tick = 0; tick < GOLDEN_TICKS; ++tick){
+		for(int i = 0; i < GOLDEN_MATCHES; ++i){
+
+			Input input = INPUT_START;
+			if(inputMode == 0) input = trackingInput(&matches[i]);
+			else if(inputMode == 1) input = (Input)(nextRandom(&state) & 0x1f);
+
+			Match_tick(&matches[i], input);
+			hash = hashMatch(hash, &matches[i]);
+
+		}
+	}
+
+	addGolden(suite, name, hash);
+
+}
+
+/* Hashes every ball position and speed of a crowded ball field over time */
+void goldenBalls(Suite *suite){
+
+	BallField field;
+	if(!BallField_create(&field, GOLDEN_BALLS, BallField_getDefaultSize(GOLDEN_BALLS), 1)) return;
+
+	unsigned long long hash = 14695981039346656037ull;
+	for(int tick = 0; tick < GOLDEN_BALL_TICKS; ++tick){
+		BallField_tick(&field, (tick / 60) % 2 ? INPUT_P1_UP | INPUT_P2_DOWN : INPUT_P1_DOWN | INPUT_P2_UP);
+		hash = hashBytes(hash, field.x, sizeof(float) * field.count);
+		hash = hashBytes(hash, field.y, sizeof(float) * field.count);
+		hash = hashBytes(hash, field.sx, sizeof(float) * field.count);
+		hash = hashBytes(hash, field.sy, sizeof(float) * field.count);
+	}
+
+	addGolden(suite, "balls/1000", hash);
+	BallField_destroy(&field);
+
+}
+
+/* Hashes the state of seeded matches between tracking bots played in a random layout after every tick */
+void goldenLayout(Suite *suite){
+
+	Layout layout;
+	if(!makeLayout(&layout, GOLDEN_LAYOUT_OBSTACLES, 7u)) return;
+
+	static Match matches[GOLDEN_MATCHES];
+	unsigned long long hash = 14695981039346656037ull;
+	for(int i = 0; i < GOLDEN_MATCHES; ++i) Match_init(&matches[i], (unsigned int)i * 7919u);
+
+	for(int tick = 0; tick < GOLDEN_LAYOUT_TICKS; ++tick){
+		for(int i = 0; i < GOLDEN_MATCHES; ++i){
+			Match_tickLayout(&matches[i], &layout, trackingInput(&matches[i]), NULL);
+			hash = hashMatch(hash, &matches[i]);
+		}
+	}
+
+	addGolden(suite, "layout/100", hash);
+	Layout_destroy(&layout);
+
+}
+
+/* Writes the telemetry of bot matches through the encoder threads, reads the file back and compares every row with
+   the state that was logged. A row lost, added or changed fails the run. */
+void checkTelemetry(Suite *suite){
+
+	static Match matches[TELEMETRY_MATCHES];
+	TelemetryCheck *checks = calloc((size_t)TELEMETRY_MATCHES * TELEMETRY_TICKS, sizeof(TelemetryCheck));
+	Telemetry *telemetry = checks ? Telemetry_open(TELEMETRY_PATH, TELEMETRY_CHANNELS, TELEMETRY_ENCODERS) : NULL;
+	if(!telemetry){
+		fprintf(stderr, "Could not create %s\n", TELEMETRY_PATH);
+		free(checks);
+		suite->failed = 1;
+		return;
+	}
+
+	for(int i = 0; i < TELEMETRY_MATCHES; ++i) Match_init(&matches[i], (unsigned int)i * 7919u);
+
+	/* Blocks of interleaved matches and blocks of one match after another are coded differently */
+	unsigned long long bounces = 0;
+	for(int tick = 0; tick < TELEMETRY_TICKS; ++tick)
+		for(int i = 0; i < TELEMETRY_MATCHES / 2; ++i) bounces += recordTelemetryTick(telemetry, checks, &matches[i], i, tick);
+	for(int i = TELEMETRY_MATCHES / 2; i < TELEMETRY_MATCHES; ++i)
+		for(int tick = 0; tick < TELEMETRY_TICKS; ++tick) bounces += recordTelemetryTick(telemetry, checks, &matches[i], i, tick);
+
+	TelemetryStats stats;
+	TelemetryReadback readback = {checks, 0, 0};
+	int written = Telemetry_close(telemetry, &stats);
+	int read = written && Telemetry_read(TELEMETRY_PATH, compareTelemetryRow, &readback);
+	remove(TELEMETRY_PATH);
+
+	/* Every tick and bounce must have been read exactly once */
+	unsigned long long missing = 0;
+	for(size_t i = 0; i < (size_t)TELEMETRY_MATCHES * TELEMETRY_TICKS; ++i)
+		if(checks[i].ticksRead != 1 || checks[i].bouncesRead != checks[i].bounceCount) ++missing;
+
+	int pass = read && readback.mismatches == 0 && missing == 0;
+	if(!pass){
+		suite->failed = 1;
+		fprintf(stderr, "Telemetry round trip failed: %llu rows differ, %llu ticks missing or repeated\n", readback.mismatches, missing);
+	}
+
+	fprintf(suite->out, "  \"telemetry\": {\"ticks\": %d, \"bounces\": %llu, \"rows_read\": %llu, \"bytes_per_row\": %.2f, "
+		"\"mismatches\": %llu, \"missing\": %llu, \"pass\": %s},\n", TELEMETRY_MATCHES * TELEMETRY_TICKS, bounces, readback.rows,
+		stats.rows ? (double)stats.bytes / (double)stats.rows : 0.0, readback.mismatches, missing, pass ? "true" : "false");
+	free(checks);
+
+}
+
+/* Plays a tick of a match, logs it and keeps what was logged, returning the bounces */
+unsigned long long recordTelemetryTick(Telemetry *telemetry, TelemetryCheck *checks, Match *match, int index, int tick){
+
+	MatchContacts contacts;
+	Match_tickContacts(match, trackingInput(match), &contacts);
+	TelemetryChannel_record(Telemetry_getChannel(telemetry, telemetryChannel(index)), (uint32_t)index, (uint32_t)tick, match, &contacts);
+
+	TelemetryCheck *check = &checks[(size_t)index * TELEMETRY_TICKS + tick];
+	const Scalar values[TELEMETRY_VALUES] = {match->ball.position.x, match->ball.position.y, match->ball.speed.x,
+		match->ball.speed.y, match->p1.position.y, match->p2.position.y};
+	check->events = match->events;
+	memcpy(check->values, values, sizeof(values));
+	check->bounceCount = contacts.count;
+	memcpy(check->bounces, contacts.contacts, sizeof(MatchContact) * (size_t)contacts.count);
+	return (unsigned long long)contacts.count;
+
+}
+
+/* Returns the telemetry channel a match of the check is logged to */
+int telemetryChannel(int match){
+
+	return (match < TELEMETRY_MATCHES / 2) ? match % TELEMETRY_INTERLEAVED : TELEMETRY_INTERLEAVED;
+
+}
+
+/* Telemetry visitor: compares one decoded row with the state logged for it */
+void compareTelemetryRow(const TelemetryRow *row, void *arg){
+
+	TelemetryReadback *readback = arg;
+	++readback->rows;
+	if(row->match >= TELEMETRY_MATCHES || row->tick >= TELEMETRY_TICKS || row->channel != (uint32_t)telemetryChannel((int)row->match)){
+		++readback->mismatches;
+		return;
+	}
+
+	TelemetryCheck *check = &readback->checks[(size_t)row->match * TELEMETRY_TICKS + row->tick];
+	int same = 1;
+	if(row->kind == TELEMETRY_TICK){
+		++check->ticksRead;
+		same = (row->flags == check->events);
+		for(int i = 0; i < TELEMETRY_VALUES; ++i) same = same && sameValue(row->values[i], check->values[i]);
+	}else if(check->bouncesRead < check->bounceCount){
+		const MatchContact *bounce = &check->bounces[check->bouncesRead++];
+		same = row->flags == (unsigned int)bounce->side && row->paddle == bounce->paddle &&
+			sameValue(row->values[0], bounce->position.x) && sameValue(row->values[1], bounce->position.y) &&
+			sameValue(row->values[2], bounce->speed.x) && sameValue(row->values[3], bounce->speed.y);
+	}else{
+		same = 0;
+	}
+	if(!same) ++readback->mismatches;
+
+}
+
+/* Returns nonzero if a decoded value has exactly the bits of the scalar logged */
+int sameValue(double value, Scalar expected){
+
+#ifdef PONG_FIXED
+	Scalar decoded = (Scalar)(value * 65536.0);
+#else
+	Scalar decoded = (Scalar)value;
+#endif
+	return memcmp(&decoded, &expected, sizeof(Scalar)) == 0;
+
+}
+
+/* Reads a golden file with one "name hash" pair per line. Returns 0 if the file cannot be read. */
+int loadGolden(Suite *suite, const char *path){
+
+	FILE *file = fopen(path, "r");
+	if(!file) return 0;
+
+	char line[128];
+	while(suite->expectedCount < MAX_GOLDEN && fgets(line, sizeof(line), file)){
+		Golden *golden = &suite->expected[suite->expectedCount];
+		if(sscanf(line, "%63s %llx", golden->name, &golden->hash) == 2) ++suite->expectedCount;
+	}
+
+	fclose(file);
+	return 1;
+
+}
+
+/* Writes the traces of this run as the new golden file. Traces of the other backend are kept. */
+int saveGolden(const Suite *suite, const char *path){
+
+	FILE *file = fopen(path, "w");
+	if(!file) return 0;
+
+	for(int i = 0; i < suite->expectedCount; ++i){
+		const char *name = suite->expected[i].name;
+		int fixed = strncmp(name, "fixed/", 6) == 0;
+		if(fixed != (GOLDEN_PREFIX[0] != '\0'))
+			fprintf(file, "%s %016llx\n", name, suite->expected[i].hash);
+	}
+	for(int i = 0; i < suite->actualCount; ++i)
+		fprintf(file, "%s %016llx\n", suite->actual[i].name, suite->actual[i].hash);
+
+	return fclose(file) == 0;
+
+}
@@ -0,0 +1,272 @@
+/*
+   CPong
+   Built-in paddle controllers. See bot.h.
+*/
+
+/* Standard C includes */
+#include <math.h>
+#include <string.h>
+
+/* Local includes */
+#include "bot.h"
+
+/* Define the memory used by the jitter controller */
+typedef struct JitterState{
+
+	unsigned int rng;
+	int approaching;
+	float offset;
+
+} JitterState;
+
+/* Define the memory used by the predictor controllers. The intercept is cached together with
+   the ball speed it was computed for and only recomputed when that speed changes. */
+typedef struct PredictorState{
+
+	unsigned int rng;
+	int valid;			/* Nonzero once an intercept has been computed */
+	float speedX;			/* Ball speed the cached intercept belongs to */
+	float speedY;
+	float intercept;		/* Latest prediction, including the aim error */
+	float target;			/* Where the paddle is heading, lagging the prediction */
+	int reaction;			/* Ticks left before the target follows the prediction */
+	float budget;			/* Movement allowed by the speed limit, in whole ticks */
+
+} PredictorState;
+
+/* Static function declarations */
+static void resetNothing(const Controller *controller, ControllerState *state, unsigned int seed);
+static int moveIdle(const Controller *controller, ControllerState *state, const Match *match, int player);
+static int moveTracker(const Controller *controller, ControllerState *state, const Match *match, int player);
+static int moveLazy(const Controller *controller, ControllerState *state, const Match *match, int player);
+static void resetJitter(const Controller *controller, ControllerState *state, unsigned int seed);
+static int moveJitter(const Controller *controller, ControllerState *state, const Match *match, int player);
+static void resetPredictor(const Controller *controller, ControllerState *state, unsigned int seed);
+static int movePredictor(const Controller *controller, ControllerState *state, const Match *match, int player);
+static float predictIntercept(const Match *match, int player);
+static int moveToward(const Paddle *paddle, float targetY, float deadzone);
+static int isApproaching(const Match *match, int player);
+
+/* Built-in controllers.
+   tracker      Follows the ball. params[0] is the deadzone around the paddle center.
+   lazy         Follows the ball only while it approaches, otherwise returns to the middle.
+   jitter       Follows the ball aiming at a random offset, picked again after every return.
+                params[1] is the largest offset from the paddle center.
+   predictor    Moves to where the ball will cross the paddle, following its bounces off the walls.
+                params[0] is the reaction delay in ticks, params[1] the largest aim error,
+                params[2] the top speed as a fraction of the paddle speed and params[3] the deadzone. */
+static const Controller controllers[] = {
+	{"idle", resetNothing, moveIdle, {0.0f}},
+	{"tracker", resetNothing, moveTracker, {10.0f}},
+	{"tracker-wide", resetNothing, moveTracker, {30.0f}},
+	{"lazy", resetNothing, moveLazy, {10.0f}},
+	{"jitter", resetJitter, moveJitter, {4.0f, 45.0f}},
+	{"predictor", resetPredictor, movePredictor, {0.0f, 0.0f, 1.0f, 4.0f}},
+	{"predictor-hard", resetPredictor, movePredictor, {6.0f, 20.0f, 0.9f, 6.0f}},
+	{"predictor-medium", resetPredictor, movePredictor, {12.0f, 40.0f, 0.75f, 8.0f}},
+	{"predictor-easy", resetPredictor, movePredictor, {20.0f, 70.0f, 0.6f, 10.0f}},
+};
+
+/* Returns the built-in controller with the given name, or NULL */
+const Controller *Controller_find(const char *name){
+
+	for(int i = 0; i < Controller_getCount(); ++i)
+		if(strcmp(controllers[i].name, name) == 0) return &controllers[i];
+	return NULL;
+
+}
+
+/* Returns the number of built-in controllers */
+int Controller_getCount(void){
+
+	return (int)(sizeof(controllers) / sizeof(controllers[0]));
+
+}
+
+/* Returns the built-in controller at an index */
+const Controller *Controller_get(int index){
+
+	return &controllers[index];
+
+}
+
+/* Resets a controller's state at the start of a match */
+void Controller_reset(const Controller *controller, ControllerState *state, unsigned int seed){
+
+	memset(state, 0, sizeof(*state));
+	controller->reset(controller, state, seed);
+
+}
+
+/* Returns the direction the controller moves the given player's paddle in */
+int Controller_move(const Controller *controller, ControllerState *state, const Match *match, int player){
+
+	return controller->move(controller, state, match, player);
+
+}
+
+/* Combines the moves of both players into the input of one tick */
+Input Controller_getInput(const Controller *p1, ControllerState *p1State,
+	const Controller *p2, ControllerState *p2State, const Match *match){
+
+	Input input = INPUT_START;
+
+	int p1Move = Controller_move(p1, p1State, match, 1);
+	if(p1Move < 0) input |= INPUT_P1_UP;
+	else if(p1Move > 0) input |= INPUT_P1_DOWN;
+
+	int p2Move = Controller_move(p2, p2State, match, 2);
+	if(p2Move < 0) input |= INPUT_P2_UP;
+	else if(p2Move > 0) input |= INPUT_P2_DOWN;
+
+	return input;
+
+}
+
+/* Reset function for controllers without state */
+static void resetNothing(const Controller *controller, ControllerState *state, unsigned int seed){
+
+	(void)controller; (void)state; (void)seed;
+
+}
+
+/* Never moves */
+static int moveIdle(const Controller *controller, ControllerState *state, const Match *match, int player){
+
+	(void)controller; (void)state; (void)match; (void)player;
+	return 0;
+
+}
+
+/* Keeps the paddle centered on the ball */
+static int moveTracker(const Controller *controller, ControllerState *state, const Match *match, int player){
+
+	(void)state;
+	return moveToward(Match_getPaddle(match, player), Scalar_toFloat(match->ball.position.y) + BALL_SIZE * 0.5f, controller->params[0]);
+
+}
+
+/* Follows the ball while it approaches and drifts back to the middle otherwise */
+static int moveLazy(const Controller *controller, ControllerState *state, const Match *match, int player){
+
+	(void)state;
+	float targetY = isApproaching(match, player) ? Scalar_toFloat(match->ball.position.y) + BALL_SIZE * 0.5f : WINDOW_HEIGHT * 0.5f;
+	return moveToward(Match_getPaddle(match, player), targetY, controller->params[0]);
+
+}
+
+/* Seeds the jitter controller's generator */
+static void resetJitter(const Controller *controller, ControllerState *state, unsigned int seed){
+
+	(void)controller;
+	JitterState *jitter = (JitterState*)state->bytes;
+	jitter->rng = seed | 1u;
+
+}
+
+/* Follows the ball with a random aim offset that changes whenever the ball turns toward the paddle */
+static int moveJitter(const Controller *controller, ControllerState *state, const Match *match, int player){
+
+	JitterState *jitter = (JitterState*)state->bytes;
+	int approaching = isApproaching(match, player);
+
+	if(approaching && !jitter->approaching){
+		jitter->rng ^= jitter->rng << 13; jitter->rng ^= jitter->rng >> 17; jitter->rng ^= jitter->rng << 5;
+		float unit = (float)(jitter->rng >> 8) / 16777216.0f;
+		jitter->offset = (unit * 2.0f - 1.0f) * controller->params[1];
+	}
+	jitter->approaching = approaching;
+
+	return moveToward(Match_getPaddle(match, player),
+		Scalar_toFloat(match->ball.position.y) + BALL_SIZE * 0.5f + jitter->offset, controller->params[0]);
+
+}
+
+/* Seeds the predictor's generator and starts it aiming at the middle */
+static void resetPredictor(const Controller *controller, ControllerState *state, unsigned int seed){
+
+	(void)controller;
+	PredictorState *predictor = (PredictorState*)state->bytes;
+	predictor->rng = seed | 1u;
+	predictor->intercept = WINDOW_HEIGHT * 0.5f;
+	predictor->target = WINDOW_HEIGHT * 0.5f;
+
+}
+
+/* Moves toward the predicted intercept of an approaching ball, or back to the middle otherwise.
+   A wall bounce only flips the sign of the ball's vertical speed and leaves the intercept where it
+   was, so the prediction is only redone after a paddle hit or a serve changes the ball's speed.
+   Every other tick costs a comparison and a few arithmetic operations. */
+static int movePredictor(const Controller *controller, ControllerState *state, const Match *match, int player){
+
+	PredictorState *predictor = (PredictorState*)state->bytes;
+	const Ball *ball = &match->ball;
+	float speedX = Scalar_toFloat(ball->speed.x), speedY = fabsf(Scalar_toFloat(ball->speed.y));
+
+	if(!predictor->valid || speedX != predictor->speedX || speedY != predictor->speedY ||
+		(match->events & (MATCH_EVENT_ROUND_START | MATCH_EVENT_PADDLE_HIT))){
+
+		predictor->valid = 1;
+		predictor->speedX = speedX;
+		predictor->speedY = speedY;
+
+		if(match->gameState == 1 && isApproaching(match, player)){
+			predictor->rng ^= predictor->rng << 13; predictor->rng ^= predictor->rng >> 17; predictor->rng ^= predictor->rng << 5;
+			float unit = (float)(predictor->rng >> 8) / 16777216.0f;
+			predictor->intercept = predictIntercept(match, player) + (unit * 2.0f - 1.0f) * controller->params[1];
+		}else predictor->intercept = WINDOW_HEIGHT * 0.5f;
+		predictor->reaction = (int)controller->params[0];
+
+	}
+
+	/* The paddle keeps heading for its old target until the reaction delay has passed */
+	if(predictor->reaction > 0) --predictor->reaction;
+	else predictor->target = predictor->intercept;
+
+	/* The speed limit lets the paddle move on only a fraction of the ticks */
+	int direction = moveToward(Match_getPaddle(match, player), predictor->target, controller->params[3]);
+	if(direction == 0) return 0;
+	predictor->budget = MIN(predictor->budget + controller->params[2], 1.0f);
+	if(predictor->budget < 1.0f) return 0;
+	predictor->budget -= 1.0f;
+	return direction;
+
+}
+
+/* Returns the height at which the ball's center crosses the given player's paddle face. The straight
+   path is folded back into the field, which gives the same result as following every wall bounce. */
+static float predictIntercept(const Match *match, int player){
+
+	const Ball *ball = &match->ball;
+	const Paddle *paddle = Match_getPaddle(match, player);
+	float y = Scalar_toFloat(ball->position.y);
+	if(ball->speed.x == 0) return y + BALL_SIZE * 0.5f;
+
+	float distance = Scalar_toFloat((player == 1) ? Ball_getBound(ball, LEFT) - Paddle_getBound(paddle, RIGHT) :
+		Paddle_getBound(paddle, LEFT) - Ball_getBound(ball, RIGHT));
+	float ticks = MAX(distance, 0.0f) / fabsf(Scalar_toFloat(ball->speed.x));
+
+	float range = WINDOW_HEIGHT - BALL_SIZE;
+	y = fmodf(y + Scalar_toFloat(ball->speed.y) * ticks, 2.0f * range);
+	if(y < 0.0f) y += 2.0f * range;
+	if(y > range) y = 2.0f * range - y;
+	return y + BALL_SIZE * 0.5f;
+
+}
+
+/* Returns the direction that brings the paddle's center to the target, or 0 inside the deadzone */
+static int moveToward(const Paddle *paddle, float targetY, float deadzone){
+
+	float centerY = Scalar_toFloat(paddle->position.y) + PADDLE_HEIGHT * 0.5f;
+	if(targetY < centerY - deadzone) return -1;
+	if(targetY > centerY + deadzone) return 1;
+	return 0;
+
+}
+
+/* Returns nonzero if the ball is moving toward the given player's paddle */
+static int isApproaching(const Match *match, int player){
+
+	return (player == 1) ? match->ball.speed.x < 0 : match->ball.speed.x >= 0;
+
+}
@@ -0,0 +1,56 @@
+/*
+   CPong
+   Paddle controllers for headless matches.
+
+   A controller decides how one paddle moves each tick, in the same terms
+   as the keyboard: up, down or not at all. Per-match memory lives in a
+   fixed size 'ControllerState' owned by the caller, so running a
+   controller never allocates.
+*/
+
+#ifndef BOT_H
+#define BOT_H
+
+#include "pong.h"
+
+/* Size of the per-match memory available to a controller */
+#define CONTROLLER_STATE_SIZE 128
+
+/* Define the 'ControllerState' union, aligned for any member type a controller may store */
+typedef union ControllerState{
+
+	unsigned char bytes[CONTROLLER_STATE_SIZE];
+	double alignDouble;
+	void *alignPointer;
+
+} ControllerState;
+
+/* Define the 'Controller' struct. 'params' tune the behaviour and mean different things per controller. */
+typedef struct Controller{
+
+	const char *name;
+	void (*reset)(const struct Controller *controller, ControllerState *state, unsigned int seed);
+	int (*move)(const struct Controller *controller, ControllerState *state, const Match *match, int player);
+	float params[4];
+
+} Controller;
+
+/* Returns the built-in controller with the given name, or NULL */
+const Controller *Controller_find(const char *name);
+
+/* Returns the number of built-in controllers and the controller at an index */
+int Controller_getCount(void);
+const Controller *Controller_get(int index);
+
+/* Resets a controller's state at the start of a match */
+void Controller_reset(const Controller *controller, ControllerState *state, unsigned int seed);
+
+/* Returns the direction the controller moves the given player's paddle in:
+   -1 for up, 1 for down and 0 to stay */
+int Controller_move(const Controller *controller, ControllerState *state, const Match *match, int player);
+
+/* Combines the moves of both players into the input of one tick. The start input is always set. */
+Input Controller_getInput(const Controller *p1, ControllerState *p1State,
+	const Controller *p2, ControllerState *p2State, const Match *match);
+
+#endif
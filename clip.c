@@ -0,0 +1,356 @@
+/*
+   CPong
+   Headless match to video export. Plays a replay back without a window,
+   draws every frame with the software rasterizer on all cores and
+   streams the frames to an uncompressed Y4M or raw RGB file, for clips
+   that are then cut and encoded with other tools.
+
+   Usage: clip -replay <file> -out <file|-> [-format y4m|raw]
+               [-from <seconds>] [-seconds <length>] [-fps <rate>]
+               [-size <width>x<height>] [-threads <count>]
+
+   Frames are exported in batches. The main thread steps the replay to
+   each frame of a batch and keeps the two ticks around it, the pool then
+   draws one frame per task straight into its place in the batch's file
+   data, in the file's own pixel format, and a writer thread
+   writes the batch out while the next one is stepped and drawn. Frame
+   rates other than the tick rate blend positions between ticks like the
+   game window does.
+
+   Raw files hold packed 8-bit RGB frames with no header. An output of
+   '-' writes to the standard output, for example to pipe the frames into
+   an encoder, and the report goes to the standard error instead.
+*/
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Platform includes */
+#include <pthread.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+/* Local includes */
+#include "pong.h"
+#include "pool.h"
+#include "raster.h"
+#include "replay.h"
+#include "timer.h"
+
+/* Export property definitions */
+#define FRAMES_PER_THREAD 4			/* Frames in a batch per pool thread */
+#define Y4M_FRAME_HEADER "FRAME\n"
+
+/* Output formats */
+typedef enum {FORMAT_Y4M, FORMAT_RAW} Format;
+
+/* Define the 'Frame' struct, the two ticks a frame is drawn between */
+typedef struct Frame{
+
+	Match previous;
+	Match current;
+	float alpha;
+
+} Frame;
+
+/* Define the 'Batch' struct, frames drawn together and written together */
+typedef struct Batch{
+
+	Frame *frames;
+	unsigned char *data;			/* 'count' encoded frames of 'frameSize' bytes */
+	size_t count;
+
+} Batch;
+
+/* Define the 'Export' struct */
+typedef struct Export{
+
+	Format format;
+	int width;
+	int height;
+	size_t frameSize;			/* Bytes of one frame in the file, its header included */
+	size_t headerSize;
+	Batch batches[2];
+	Batch *drawing;				/* Batch the pool is drawing */
+
+	/* Writer thread */
+	FILE *file;
+	pthread_t writer;
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+	Batch *pending;				/* Batch handed to the writer, NULL once written */
+	int stop;
+	int failed;
+	unsigned long long writeTime;
+
+} Export;
+
+/* Function declarations */
+void drawFrame(void *arg, size_t index, int worker);
+void *writeBatches(void *arg);
+int handBatch(Export *export, Batch *batch);
+int parseSize(const char *text, int *width, int *height);
+
+/* Program entrypoint */
+int main(int argc, char **argv){
+
+	Export export;
+	memset(&export, 0, sizeof(export));
+	export.format = FORMAT_Y4M;
+	export.width = WINDOW_WIDTH;
+	export.height = WINDOW_HEIGHT;
+
+	const char *replayPath = NULL, *outPath = NULL;
+	double from = 0.0, seconds = -1.0;
+	int fps = TICK_RATE, threads = Pool_getCpuCount();
+
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "-replay") == 0 && i + 1 < argc) replayPath = argv[++i];
+		else if(strcmp(argv[i], "-out") == 0 && i + 1 < argc) outPath = argv[++i];
+		else if(strcmp(argv[i], "-format") == 0 && i + 1 < argc){
+			++i;
+			if(strcmp(argv[i], "y4m") == 0) export.format = FORMAT_Y4M;
+			else if(strcmp(argv[i], "raw") == 0) export.format = FORMAT_RAW;
+			else{ fprintf(stderr, "Unknown format %s\n", argv[i]); return EXIT_FAILURE; }
+		}
+		else if(strcmp(argv[i], "-from") == 0 && i + 1 < argc) from = atof(argv[++i]);
+		else if(strcmp(argv[i], "-seconds") == 0 && i + 1 < argc) seconds = atof(argv[++i]);
+		else if(strcmp(argv[i], "-fps") == 0 && i + 1 < argc) fps = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-size") == 0 && i + 1 < argc){
+			if(!parseSize(argv[++i], &export.width, &export.height)){ fprintf(stderr, "Invalid size %s\n", argv[i]); return EXIT_FAILURE; }
+		}
+		else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+		else{
+			fprintf(stderr, "Usage: %s -replay file -out file|- [-format y4m|raw] [-from seconds] [-seconds length] "
+				"[-fps rate] [-size widthxheight] [-threads n]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(!replayPath || !outPath){
+		fprintf(stderr, "A replay and an output file are needed\n");
+		return EXIT_FAILURE;
+	}
+	if(fps < 1 || threads < 1 || from < 0.0){
+		fprintf(stderr, "The frame rate and thread count must be positive and the start not negative\n");
+		return EXIT_FAILURE;
+	}
+	if(export.format == FORMAT_Y4M && (export.width % 2 || export.height % 2)){
+		fprintf(stderr, "Y4M frames need an even width and height\n");
+		return EXIT_FAILURE;
+	}
+
+	/* The report goes to the standard error when the frames go to the standard output */
+	int toStdout = strcmp(outPath, "-") == 0;
+	FILE *report = toStdout ? stderr : stdout;
+
+	Replay replay;
+	ReplayCursor cursor;
+	if(!Replay_open(&replay, replayPath)){
+		fprintf(stderr, "Could not open replay file %s\n", replayPath);
+		return EXIT_FAILURE;
+	}
+	unsigned int startTick = (unsigned int)MIN(from * TICK_RATE + 0.5, (double)replay.tickCount);
+	unsigned int endTick = replay.tickCount;
+	if(seconds >= 0.0) endTick = (unsigned int)MIN(startTick + seconds * TICK_RATE + 0.5, (double)replay.tickCount);
+	size_t frameCount = (size_t)((unsigned long long)(endTick - startTick) * fps / TICK_RATE);
+	if(!Replay_seek(&replay, &cursor, startTick)){
+		fprintf(stderr, "Could not seek to tick %u of %s\n", startTick, replayPath);
+		Replay_close(&replay);
+		return EXIT_FAILURE;
+	}
+
+	/* Every buffer is allocated up front */
+	Pool *pool = Pool_create(threads);
+	size_t batchSize = (size_t)threads * FRAMES_PER_THREAD;
+	export.headerSize = (export.format == FORMAT_Y4M) ? strlen(Y4M_FRAME_HEADER) : 0;
+	export.frameSize = export.headerSize + Framebuffer_getSize(export.width, export.height,
+		(export.format == FORMAT_Y4M) ? FRAMEBUFFER_YUV420 : FRAMEBUFFER_RGB);
+	int ok = pool != NULL;
+	for(int i = 0; ok && i < 2; ++i){
+		export.batches[i].frames = malloc(sizeof(Frame) * batchSize);
+		export.batches[i].data = malloc(export.frameSize * batchSize);
+		ok = export.batches[i].frames && export.batches[i].data;
+	}
+	if(!ok){
+		fprintf(stderr, "Out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	if(toStdout){
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		export.file = stdout;
+	}else{
+		export.file = fopen(outPath, "wb");
+		if(!export.file){
+			fprintf(stderr, "Could not create %s\n", outPath);
+			return EXIT_FAILURE;
+		}
+	}
+	if(export.format == FORMAT_Y4M)
+		fprintf(export.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", export.width, export.height, fps);
+
+	pthread_mutex_init(&export.mutex, NULL);
+	pthread_cond_init(&export.changed, NULL);
+	if(pthread_create(&export.writer, NULL, writeBatches, &export) != 0){
+		fprintf(stderr, "Could not start the writer thread\n");
+		return EXIT_FAILURE;
+	}
+
+	unsigned long long start = Timer_now(), startCpu = Timer_getCpuTime(), stepTime = 0, drawTime = 0;
+	Match previous = cursor.match;
+	size_t frame = 0;
+	for(int next = 0; ok && frame < frameCount; next ^= 1){
+
+		/* Step the replay to every frame of the batch. The frame at 'position' is drawn between tick 'tick' and the
+		   one after it. */
+		unsigned long long phase = Timer_now();
+		Batch *batch = &export.batches[next];
+		batch->count = 0;
+		while(ok && batch->count < batchSize && frame < frameCount){
+			unsigned long long position = (unsigned long long)frame * TICK_RATE;
+			unsigned int tick = startTick + (unsigned int)(position / fps);
+			while(ok && cursor.tick < tick + 1){
+				Input input;
+				previous = cursor.match;
+				ok = ReplayCursor_next(&cursor, &input);
+			}
+			Frame *target = &batch->frames[batch->count++];
+			target->previous = previous;
+			target->current = cursor.match;
+			target->alpha = (float)(position % fps) / fps;
+			++frame;
+		}
+		if(!ok){
+			fprintf(stderr, "The replay ends early at tick %u\n", cursor.tick);
+			break;
+		}
+
+		unsigned long long drawStart = Timer_now();
+		export.drawing = batch;
+		Pool_run(pool, batch->count, drawFrame, &export);
+		unsigned long long drawEnd = Timer_now();
+		stepTime += drawStart - phase;
+		drawTime += drawEnd - drawStart;
+
+		ok = handBatch(&export, batch);
+
+	}
+
+	/* Wait for the last batch and stop the writer */
+	pthread_mutex_lock(&export.mutex);
+	while(export.pending) pthread_cond_wait(&export.changed, &export.mutex);
+	export.stop = 1;
+	pthread_cond_broadcast(&export.changed);
+	pthread_mutex_unlock(&export.mutex);
+	pthread_join(export.writer, NULL);
+
+	if(fflush(export.file) != 0) export.failed = 1;
+	if(!toStdout && fclose(export.file) != 0) export.failed = 1;
+	double wallSeconds = Timer_toSeconds(Timer_now() - start), cpuSeconds = Timer_toSeconds(Timer_getCpuTime() - startCpu);
+	if(export.failed){
+		fprintf(stderr, "Could not write %s\n", outPath);
+		ok = 0;
+	}
+
+	if(ok){
+		double clipSeconds = (double)frame / fps;
+		fprintf(report, "%zu frames (%.1f s at %d fps) of %dx%d to %s in %.3f s on %d threads\n",
+			frame, clipSeconds, fps, export.width, export.height, toStdout ? "the standard output" : outPath, wallSeconds, threads);
+		fprintf(report, "%.0f frames/s, %.1fx real time, %.1f MB/s\n", frame / wallSeconds, clipSeconds / wallSeconds,
+			(double)frame * export.frameSize / wallSeconds / 1e6);
+		fprintf(report, "%.0f frames/s per core (%.3f s of processor time)\n", frame / MAX(cpuSeconds, 1e-9), cpuSeconds);
+		fprintf(report, "step %.3f s, draw %.3f s, write %.3f s (overlapped with the next batch)\n",
+			Timer_toSeconds(stepTime), Timer_toSeconds(drawTime), Timer_toSeconds(export.writeTime));
+	}
+
+	for(int i = 0; i < 2; ++i){
+		free(export.batches[i].frames);
+		free(export.batches[i].data);
+	}
+	pthread_mutex_destroy(&export.mutex);
+	pthread_cond_destroy(&export.changed);
+	Pool_destroy(pool);
+	Replay_close(&replay);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
+
+/* Pool task: draws one frame of the batch straight into its place in the file */
+void drawFrame(void *arg, size_t index, int worker){
+
+	(void)worker;
+	Export *export = arg;
+	const Frame *frame = &export->drawing->frames[index];
+	unsigned char *out = export->drawing->data + index * export->frameSize;
+
+	Framebuffer target;
+	memcpy(out, Y4M_FRAME_HEADER, export->headerSize);
+	Framebuffer_wrap(&target, out + export->headerSize, export->width, export->height,
+		(export->format == FORMAT_Y4M) ? FRAMEBUFFER_YUV420 : FRAMEBUFFER_RGB);
+	Framebuffer_drawMatch(&target, &frame->previous, &frame->current, frame->alpha);
+
+}
+
+/* Writer thread: writes each batch handed to it, then marks it written */
+void *writeBatches(void *arg){
+
+	Export *export = arg;
+	pthread_mutex_lock(&export->mutex);
+	for(;;){
+
+		while(!export->pending && !export->stop) pthread_cond_wait(&export->changed, &export->mutex);
+		if(!export->pending) break;
+		Batch *batch = export->pending;
+		pthread_mutex_unlock(&export->mutex);
+
+		unsigned long long start = Timer_now();
+		int written = fwrite(batch->data, export->frameSize, batch->count, export->file) == batch->count;
+		export->writeTime += Timer_now() - start;
+
+		pthread_mutex_lock(&export->mutex);
+		if(!written) export->failed = 1;
+		export->pending = NULL;
+		pthread_cond_broadcast(&export->changed);
+
+	}
+	pthread_mutex_unlock(&export->mutex);
+	return NULL;
+
+}
+
+/* Waits for the writer to finish the previous batch and hands it this one. Returns 0 if a write has failed. */
+int handBatch(Export *export, Batch *batch){
+
+	pthread_mutex_lock(&export->mutex);
+	while(export->pending) pthread_cond_wait(&export->changed, &export->mutex);
+	int ok = !export->failed;
+	if(ok){
+		export->pending = batch;
+		pthread_cond_broadcast(&export->changed);
+	}
+	pthread_mutex_unlock(&export->mutex);
+	return ok;
+
+}
+
+/* Parses "<width>x<height>" */
+int parseSize(const char *text, int *width, int *height){
+
+	int w, h, read;
+	if(sscanf(text, "%dx%d%n", &w, &h, &read) != 2 || text[read] != '\0' || w < 1 || h < 1 || w > 16384 || h > 16384) return 0;
+	*width = w;
+	*height = h;
+	return 1;
+
+}
@@ -0,0 +1,282 @@
+/*
+   CPong
+   Vectorized collision detection. See collide_simd.h.
+*/
+
+/* Standard C includes */
+#include <string.h>
+
+/* Local includes */
+#include "pong.h"
+#include "collide_simd.h"
+
+/* The vector kernels rely on GCC vector extensions. Other compilers get the scalar path only. */
+#if defined(__GNUC__)
+#define SIMD_VECTOR_EXTENSIONS
+#endif
+
+#if defined(SIMD_VECTOR_EXTENSIONS) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#endif
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* Static function declarations */
+static void getWallCollisionScalar(const BallBatch *balls, CollisionBatch *out, size_t start, size_t end);
+static void getPaddleCollisionScalar(const BallBatch *balls, CollisionBatch *out, size_t start, size_t end);
+static void storeCollision(CollisionBatch *out, size_t i, Collision collision, Point newPosition);
+
+#ifdef SIMD_VECTOR_EXTENSIONS
+
+/* 128 bit kernel. On x86-64 this is baseline SSE2, elsewhere the compiler maps it to the native vector unit.
+   Each kernel also gets half width int and full width 64 bit vector types for fixed point arithmetic. */
+typedef Scalar vs4 __attribute__((vector_size(16)));
+typedef int vi4 __attribute__((vector_size(16)));
+typedef int vh4 __attribute__((vector_size(8)));
+typedef long long vl4 __attribute__((vector_size(16)));
+typedef double vd4 __attribute__((vector_size(16)));
+#define KERNEL(name) name##_sse2
+#define KERNEL_TARGET
+#define VS vs4
+#define VI vi4
+#define VH vh4
+#define VL vl4
+#define VD vd4
+#define WIDTH 4
+#define LOW_LANES 0, 1
+#define HIGH_LANES 2, 3
+#define ALL_LANES 0, 1, 2, 3
+#include "collide_kernel.inc"
+#undef KERNEL
+#undef KERNEL_TARGET
+#undef VS
+#undef VI
+#undef VH
+#undef VL
+#undef VD
+#undef WIDTH
+#undef LOW_LANES
+#undef HIGH_LANES
+#undef ALL_LANES
+
+#endif
+
+#ifdef SIMD_X86
+
+/* 256 bit AVX2 kernel */
+typedef Scalar vs8 __attribute__((vector_size(32)));
+typedef int vi8 __attribute__((vector_size(32)));
+typedef int vh8 __attribute__((vector_size(16)));
+typedef long long vl8 __attribute__((vector_size(32)));
+typedef double vd8 __attribute__((vector_size(32)));
+#define KERNEL(name) name##_avx2
+#define KERNEL_TARGET __attribute__((target("avx2")))
+#define VS vs8
+#define VI vi8
+#define VH vh8
+#define VL vl8
+#define VD vd8
+#define WIDTH 8
+#define LOW_LANES 0, 1, 2, 3
+#define HIGH_LANES 4, 5, 6, 7
+#define ALL_LANES 0, 1, 2, 3, 4, 5, 6, 7
+#define MUL_EPI32(a, b) ((VL)_mm256_mul_epi32((__m256i)(a), (__m256i)(b)))
+#include "collide_kernel.inc"
+#undef KERNEL
+#undef KERNEL_TARGET
+#undef VS
+#undef VI
+#undef VH
+#undef VL
+#undef VD
+#undef WIDTH
+#undef LOW_LANES
+#undef HIGH_LANES
+#undef ALL_LANES
+#undef MUL_EPI32
+
+/* 512 bit AVX-512 kernel */
+typedef Scalar vs16 __attribute__((vector_size(64)));
+typedef int vi16 __attribute__((vector_size(64)));
+typedef int vh16 __attribute__((vector_size(32)));
+typedef long long vl16 __attribute__((vector_size(64)));
+typedef double vd16 __attribute__((vector_size(64)));
+#define KERNEL(name) name##_avx512
+#define KERNEL_TARGET __attribute__((target("avx512f")))
+#define VS vs16
+#define VI vi16
+#define VH vh16
+#define VL vl16
+#define VD vd16
+#define WIDTH 16
+#define LOW_LANES 0, 1, 2, 3, 4, 5, 6, 7
+#define HIGH_LANES 8, 9, 10, 11, 12, 13, 14, 15
+#define ALL_LANES 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+#define MUL_EPI32(a, b) ((VL)_mm512_mul_epi32((__m512i)(a), (__m512i)(b)))
+#include "collide_kernel.inc"
+#undef KERNEL
+#undef KERNEL_TARGET
+#undef VS
+#undef VI
+#undef VH
+#undef VL
+#undef VD
+#undef WIDTH
+#undef LOW_LANES
+#undef HIGH_LANES
+#undef ALL_LANES
+#undef MUL_EPI32
+
+#endif
+
+/* Returns the widest level supported by the running CPU */
+SimdLevel Simd_getLevel(void){
+
+	for(int level = SIMD_LEVEL_COUNT - 1; level > SIMD_SCALAR; --level)
+		if(Simd_isSupported((SimdLevel)level)) return (SimdLevel)level;
+	return SIMD_SCALAR;
+
+}
+
+/* Returns nonzero if the given level can be used on the running CPU */
+int Simd_isSupported(SimdLevel level){
+
+	switch(level){
+		case SIMD_SCALAR:
+			return 1;
+#ifdef SIMD_VECTOR_EXTENSIONS
+		case SIMD_SSE2:
+			return 1;
+#endif
+#ifdef SIMD_X86
+		case SIMD_AVX2:
+			return __builtin_cpu_supports("avx2");
+		case SIMD_AVX512:
+			return __builtin_cpu_supports("avx512f");
+#endif
+		default:
+			return 0;
+	}
+
+}
+
+/* Returns a printable name for the level */
+const char *Simd_getName(SimdLevel level){
+
+	switch(level){
+		case SIMD_SCALAR:
+			return "scalar";
+		case SIMD_SSE2:
+			return "sse2";
+		case SIMD_AVX2:
+			return "avx2";
+		case SIMD_AVX512:
+			return "avx512";
+		default:
+			return "unknown";
+	}
+
+}
+
+/* Tests every ball in the batch against the stage boundaries */
+void getWallCollisionBatch(const BallBatch *balls, CollisionBatch *out, SimdLevel level){
+
+	if(!Simd_isSupported(level)) level = Simd_getLevel();
+	size_t vectorEnd = 0;
+
+	switch(level){
+#ifdef SIMD_X86
+		case SIMD_AVX512:
+			vectorEnd = balls->count & ~(size_t)15;
+			getWallCollisionLanes_avx512(balls, out, 0, vectorEnd);
+			break;
+		case SIMD_AVX2:
+			vectorEnd = balls->count & ~(size_t)7;
+			getWallCollisionLanes_avx2(balls, out, 0, vectorEnd);
+			break;
+#endif
+#ifdef SIMD_VECTOR_EXTENSIONS
+		case SIMD_SSE2:
+			vectorEnd = balls->count & ~(size_t)3;
+			getWallCollisionLanes_sse2(balls, out, 0, vectorEnd);
+			break;
+#endif
+		default:
+			break;
+	}
+
+	/* Remaining balls go through the scalar function */
+	getWallCollisionScalar(balls, out, vectorEnd, balls->count);
+
+}
+
+/* Tests every ball in the batch against its paddle */
+void getPaddleCollisionBatch(const BallBatch *balls, CollisionBatch *out, SimdLevel level){
+
+	if(!Simd_isSupported(level)) level = Simd_getLevel();
+	size_t vectorEnd = 0;
+
+	switch(level){
+#ifdef SIMD_X86
+		case SIMD_AVX512:
+			vectorEnd = balls->count & ~(size_t)15;
+			getPaddleCollisionLanes_avx512(balls, out, 0, vectorEnd);
+			break;
+		case SIMD_AVX2:
+			vectorEnd = balls->count & ~(size_t)7;
+			getPaddleCollisionLanes_avx2(balls, out, 0, vectorEnd);
+			break;
+#endif
+#ifdef SIMD_VECTOR_EXTENSIONS
+		case SIMD_SSE2:
+			vectorEnd = balls->count & ~(size_t)3;
+			getPaddleCollisionLanes_sse2(balls, out, 0, vectorEnd);
+			break;
+#endif
+		default:
+			break;
+	}
+
+	/* Remaining balls go through the scalar function */
+	getPaddleCollisionScalar(balls, out, vectorEnd, balls->count);
+
+}
+
+/* Runs 'getWallCollision' on balls [start, end) */
+static void getWallCollisionScalar(const BallBatch *balls, CollisionBatch *out, size_t start, size_t end){
+
+	for(size_t i = start; i < end; ++i){
+		Ball ball = {{balls->x[i], balls->y[i]}, {balls->sx[i], balls->sy[i]}};
+		Point newPosition = {0, 0};
+		Collision collision = getWallCollision(&ball, &newPosition);
+		storeCollision(out, i, collision, newPosition);
+	}
+
+}
+
+/* Runs 'getPaddleCollision' on balls [start, end) */
+static void getPaddleCollisionScalar(const BallBatch *balls, CollisionBatch *out, size_t start, size_t end){
+
+	for(size_t i = start; i < end; ++i){
+		Ball ball = {{balls->x[i], balls->y[i]}, {balls->sx[i], balls->sy[i]}};
+		Paddle paddle = {{balls->px[i], balls->py[i]}, 0};
+		Point newPosition = {0, 0};
+		Collision collision = getPaddleCollision(&ball, &paddle, &newPosition);
+		storeCollision(out, i, collision, newPosition);
+	}
+
+}
+
+/* Writes one scalar collision result into the batch */
+static void storeCollision(CollisionBatch *out, size_t i, Collision collision, Point newPosition){
+
+	out->collides[i] = collision.collides;
+	out->side[i] = collision.side;
+	out->x[i] = collision.position.x;
+	out->y[i] = collision.position.y;
+	out->nx[i] = newPosition.x;
+	out->ny[i] = newPosition.y;
+
+}
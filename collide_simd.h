@@ -0,0 +1,79 @@
+/*
+   CPong
+   Vectorized collision detection for many balls at once.
+
+   These are batch versions of the one-contact tests 'getWallCollision'
+   and 'getPaddleCollision', which the simulation no longer runs: a tick
+   sweeps the ball with 'Ball_sweepRect' and can take several contacts.
+   Nothing but bench calls the kernels. They are kept as a throughput
+   baseline for the two backends and for their golden traces, and say
+   nothing about the cost of 'Match_tick' or 'Match_step'.
+
+   Balls are stored as a structure of arrays and tested 4, 8 or 16 at a
+   time depending on the instruction set. Each ball carries the position
+   of the paddle it is tested against, which is normally the paddle it is
+   heading toward.
+
+   Results match 'getWallCollision' and 'getPaddleCollision' bit for bit,
+   not what 'Match_tick' would do with the same ball.
+   Direction and side selection are done with lane masks. The rare lanes
+   where a ball crosses a horizontal and a vertical edge in the same tick
+   pick the closer contact with 'Point_getDistance' itself, so ties are
+   broken exactly as in the scalar code.
+
+   The lanes hold the core's 'Scalar' type. In fixed point builds products
+   are formed in integer lanes with the 32 x 32 to 64 bit multiply of
+   AVX2 and AVX-512, and saturated like 'Scalar_mul'. Quotients, and at
+   SSE2 products too, are formed in double lanes, since no level has an
+   integer vector division. The division keeps the fixed point kernels at
+   about half the throughput of the float ones.
+*/
+
+#ifndef COLLIDE_SIMD_H
+#define COLLIDE_SIMD_H
+
+#include <stddef.h>
+
+#include "pong.h"
+
+/* Instruction set levels, in increasing order of width */
+typedef enum {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, SIMD_LEVEL_COUNT} SimdLevel;
+
+/* Structure-of-arrays storage for a batch of balls */
+typedef struct BallBatch{
+
+	Scalar *x, *y;		/* Ball positions */
+	Scalar *sx, *sy;	/* Ball speeds */
+	Scalar *px, *py;	/* Position of the paddle each ball is tested against */
+	size_t count;
+
+} BallBatch;
+
+/* Structure-of-arrays collision results, one entry per ball.
+   Entries for balls that do not collide hold the same values the scalar
+   functions return: no collision, a zero position and the TOP side. The
+   new position is zero as well. */
+typedef struct CollisionBatch{
+
+	int *collides;
+	int *side;
+	Scalar *x, *y;		/* Collision position */
+	Scalar *nx, *ny;	/* New ball position */
+
+} CollisionBatch;
+
+/* Returns the widest level supported by the running CPU */
+SimdLevel Simd_getLevel(void);
+
+/* Returns nonzero if the given level can be used on the running CPU */
+int Simd_isSupported(SimdLevel level);
+
+/* Returns a printable name for the level */
+const char *Simd_getName(SimdLevel level);
+
+/* Batched versions of 'getWallCollision' and 'getPaddleCollision', for bench only.
+   An unsupported level falls back to the widest supported one. */
+void getWallCollisionBatch(const BallBatch *balls, CollisionBatch *out, SimdLevel level);
+void getPaddleCollisionBatch(const BallBatch *balls, CollisionBatch *out, SimdLevel level);
+
+#endif
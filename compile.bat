@@ -1,3 +1,29 @@
 @echo off
-gcc main.c -o ./main -L"./" -lcsfml-graphics-2 -lcsfml-window-2 -lcsfml-system-2 -lm
+set CFLAGS=-O2 -ffp-contract=off
+gcc %CFLAGS% -c pong.c -o pong.o
+gcc %CFLAGS% -c layout.c -o layout.o
+gcc %CFLAGS% -c collide_simd.c -o collide_simd.o
+gcc %CFLAGS% -c timer.c -o timer.o
+gcc %CFLAGS% -c replay.c -o replay.o
+gcc %CFLAGS% -c bot.c -o bot.o
+gcc %CFLAGS% -std=c11 -c pool.c -o pool.o
+gcc %CFLAGS% -c netplay.c -o netplay.o
+gcc %CFLAGS% -c profile.c -o profile.o
+gcc %CFLAGS% -c balls.c -o balls.o
+gcc %CFLAGS% -std=c11 -c mcts.c -o mcts.o
+gcc %CFLAGS% -c snapshot.c -o snapshot.o
+gcc %CFLAGS% -std=c11 -c env.c -o env.o
+gcc %CFLAGS% -std=c11 -c telemetry.c -o telemetry.o
+gcc %CFLAGS% -c raster.c -o raster.o
+gcc %CFLAGS% -std=c11 -c triplebuffer.c -o triplebuffer.o
+ar rcs libpong.a pong.o layout.o collide_simd.o timer.o replay.o bot.o pool.o netplay.o profile.o balls.o mcts.o snapshot.o env.o telemetry.o raster.o triplebuffer.o
+gcc main.c input.c overlay.c render.c hud.c audio.c -o ./main -L"./" -lpong -lcsfml-graphics-2 -lcsfml-window-2 -lcsfml-audio-2 -lcsfml-system-2 -lws2_32 -lpthread -lm
+gcc %CFLAGS% -DPONG_BRANCH_STATS bench.c pong.c layout.c balls.c collide_simd.c timer.c telemetry.c -o ./bench -lpthread -lm
+gcc %CFLAGS% -DPONG_FIXED -DPONG_BRANCH_STATS bench.c pong.c layout.c balls.c collide_simd.c timer.c telemetry.c -o ./bench-fixed -lpthread -lm
+gcc %CFLAGS% tournament.c -o ./tournament -L"./" -lpong -lpthread -lm
+gcc %CFLAGS% clip.c -o ./clip -L"./" -lpong -lpthread -lm
+gcc %CFLAGS% nettest.c -o ./nettest -L"./" -lpong -lws2_32 -lm
+gcc %CFLAGS% mctsbench.c -o ./mctsbench -L"./" -lpong -lpthread -lm
+gcc %CFLAGS% -std=c11 envbench.c -o ./envbench -L"./" -lpong -lpthread -lm
+gcc %CFLAGS% -std=c11 -shared env.c pong.c layout.c bot.c pool.c collide_simd.c timer.c -o ./pongenv.dll -lpthread -lm
 pause
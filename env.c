@@ -0,0 +1,262 @@
+/*
+   CPong
+   Vectorized reinforcement learning environment. See env.h.
+*/
+
+/* Standard C includes */
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "env.h"
+#include "pong.h"
+#include "bot.h"
+#include "pool.h"
+
+/* Environment property definitions */
+#define ENV_CHUNK 256				/* Matches stepped by one pool task */
+#define ENV_DEFAULT_OPPONENT "predictor-hard"
+
+/* Define the 'PongEnv' struct */
+struct PongEnv{
+
+	PongEnvHeader *header;
+	unsigned char *base;
+	uint32_t count;
+	uint32_t slots;
+	uint32_t players;
+
+	Match *matches;
+	ControllerState *states;		/* Opponent memory, one agent per match only */
+	uint32_t *episodes;
+	const Controller *opponent;
+	uint32_t seed;
+	Pool *pool;
+
+	/* The step being run, read by the pool tasks */
+	const int8_t *actions;
+	uint32_t slot;
+
+};
+
+/* Static function declarations */
+static void PongEnv_stepChunk(void *arg, size_t index, int worker);
+static void PongEnv_resetMatch(PongEnv *env, uint32_t index);
+static void PongEnv_observe(const PongEnv *env, uint32_t index, float *observation);
+static uint32_t PongEnv_beginSlot(PongEnv *env);
+static void PongEnv_publish(PongEnv *env);
+static uint64_t alignOffset(uint64_t offset);
+
+/* Returns the ABI version of the library */
+uint32_t PongEnv_getAbiVersion(void){
+
+	return PONG_ENV_ABI_VERSION;
+
+}
+
+/* Returns the bytes of memory an environment of the given shape needs */
+uint64_t PongEnv_getMemorySize(uint32_t envCount, uint32_t slotCount, uint32_t players){
+
+	uint64_t size = alignOffset(sizeof(PongEnvHeader));
+	size = alignOffset(size + (uint64_t)slotCount * envCount * PONG_ENV_OBSERVATION_SIZE * sizeof(float));
+	size = alignOffset(size + (uint64_t)slotCount * envCount * players * sizeof(float));
+	size = alignOffset(size + (uint64_t)slotCount * envCount);
+	return alignOffset(size + (uint64_t)envCount * players);
+
+}
+
+/* Creates an environment writing into the caller's memory */
+PongEnv *PongEnv_create(void *memory, uint64_t size, uint32_t envCount, uint32_t slotCount,
+	uint32_t players, int32_t threads, const char *opponent, uint32_t seed){
+
+	if(!memory || (uintptr_t)memory % PONG_ENV_ALIGNMENT != 0 || envCount == 0 || slotCount == 0) return NULL;
+	if((players != 1 && players != 2) || size < PongEnv_getMemorySize(envCount, slotCount, players)) return NULL;
+
+	const Controller *controller = NULL;
+	if(players == 1){
+		controller = Controller_find(opponent ? opponent : ENV_DEFAULT_OPPONENT);
+		if(!controller) return NULL;
+	}
+
+	PongEnv *env = calloc(1, sizeof(PongEnv));
+	if(!env) return NULL;
+	env->matches = malloc(sizeof(Match) * envCount);
+	env->states = malloc(sizeof(ControllerState) * envCount);
+	env->episodes = calloc(envCount, sizeof(uint32_t));
+
+	/* A pool only pays off once there is more than one chunk to share */
+	if(threads <= 0) threads = Pool_getCpuCount();
+	if(threads > 1 && envCount > ENV_CHUNK) env->pool = Pool_create(threads);
+	if(!env->matches || !env->states || !env->episodes || (threads > 1 && envCount > ENV_CHUNK && !env->pool)){
+		PongEnv_destroy(env);
+		return NULL;
+	}
+
+	env->base = memory;
+	env->header = memory;
+	env->count = envCount;
+	env->slots = slotCount;
+	env->players = players;
+	env->opponent = controller;
+	env->seed = seed;
+
+	PongEnvHeader *header = env->header;
+	memset(header, 0, sizeof(*header));
+	header->version = PONG_ENV_ABI_VERSION;
+	header->envCount = envCount;
+	header->slotCount = slotCount;
+	header->observationSize = PONG_ENV_OBSERVATION_SIZE;
+	header->players = players;
+	header->observationOffset = alignOffset(sizeof(PongEnvHeader));
+	header->rewardOffset = alignOffset(header->observationOffset + (uint64_t)slotCount * envCount * PONG_ENV_OBSERVATION_SIZE * sizeof(float));
+	header->doneOffset = alignOffset(header->rewardOffset + (uint64_t)slotCount * envCount * players * sizeof(float));
+	header->actionOffset = alignOffset(header->doneOffset + (uint64_t)slotCount * envCount);
+	header->totalSize = PongEnv_getMemorySize(envCount, slotCount, players);
+	memset(env->base + header->actionOffset, 0, (size_t)envCount * players);
+
+	/* Readers check the magic last, so it is only set once the layout is complete */
+	atomic_thread_fence(memory_order_release);
+	header->magic = PONG_ENV_MAGIC;
+
+	PongEnv_reset(env, seed);
+	return env;
+
+}
+
+/* Starts every match over and writes the first observations */
+uint32_t PongEnv_reset(PongEnv *env, uint32_t seed){
+
+	uint32_t slot = PongEnv_beginSlot(env);
+	float *observations = (float*)(env->base + env->header->observationOffset) + (size_t)slot * env->count * PONG_ENV_OBSERVATION_SIZE;
+	float *rewards = (float*)(env->base + env->header->rewardOffset) + (size_t)slot * env->count * env->players;
+	uint8_t *dones = env->base + env->header->doneOffset + (size_t)slot * env->count;
+
+	env->seed = seed;
+	for(uint32_t i = 0; i < env->count; ++i){
+		env->episodes[i] = 0;
+		PongEnv_resetMatch(env, i);
+		PongEnv_observe(env, i, observations + (size_t)i * PONG_ENV_OBSERVATION_SIZE);
+	}
+	memset(rewards, 0, sizeof(float) * env->count * env->players);
+	memset(dones, 0, env->count);
+
+	PongEnv_publish(env);
+	return slot;
+
+}
+
+/* Advances every match by one tick and writes the results into the next slot */
+uint32_t PongEnv_step(PongEnv *env, const int8_t *actions){
+
+	env->actions = actions ? actions : (const int8_t*)(env->base + env->header->actionOffset);
+	env->slot = PongEnv_beginSlot(env);
+
+	size_t chunks = (env->count + ENV_CHUNK - 1) / ENV_CHUNK;
+	if(env->pool) Pool_run(env->pool, chunks, PongEnv_stepChunk, env);
+	else for(size_t i = 0; i < chunks; ++i) PongEnv_stepChunk(env, i, 0);
+
+	PongEnv_publish(env);
+	return env->slot;
+
+}
+
+/* Frees the environment */
+void PongEnv_destroy(PongEnv *env){
+
+	if(!env) return;
+	if(env->pool) Pool_destroy(env->pool);
+	free(env->matches);
+	free(env->states);
+	free(env->episodes);
+	free(env);
+
+}
+
+/* Pool task stepping one chunk of matches */
+static void PongEnv_stepChunk(void *arg, size_t index, int worker){
+
+	PongEnv *env = arg;
+	(void)worker;
+
+	uint32_t first = (uint32_t)index * ENV_CHUNK, last = MIN(first + ENV_CHUNK, env->count);
+	uint32_t players = env->players;
+	float *observations = (float*)(env->base + env->header->observationOffset) + (size_t)env->slot * env->count * PONG_ENV_OBSERVATION_SIZE;
+	float *rewards = (float*)(env->base + env->header->rewardOffset) + (size_t)env->slot * env->count * players;
+	uint8_t *dones = env->base + env->header->doneOffset + (size_t)env->slot * env->count;
+
+	for(uint32_t i = first; i < last; ++i){
+
+		Match *match = &env->matches[i];
+		int left = env->actions[(size_t)i * players];
+		int right = (players == 2) ? env->actions[(size_t)i * 2 + 1] : Controller_move(env->opponent, &env->states[i], match, 2);
+
+		Input input = INPUT_START;
+		if(left < 0) input |= INPUT_P1_UP;
+		else if(left > 0) input |= INPUT_P1_DOWN;
+		if(right < 0) input |= INPUT_P2_UP;
+		else if(right > 0) input |= INPUT_P2_DOWN;
+
+		int p1Score = match->p1.score, p2Score = match->p2.score;
+		Match_tick(match, input);
+		float reward = (float)((match->p1.score > p1Score) - (match->p2.score > p2Score));
+		rewards[(size_t)i * players] = reward;
+		if(players == 2) rewards[(size_t)i * 2 + 1] = -reward;
+
+		dones[i] = (match->events & MATCH_EVENT_GAME_OVER) != 0;
+		if(dones[i]){
+			++env->episodes[i];
+			PongEnv_resetMatch(env, i);
+		}
+
+		PongEnv_observe(env, i, observations + (size_t)i * PONG_ENV_OBSERVATION_SIZE);
+
+	}
+
+}
+
+/* Starts match 'index' with a seed from the environment seed, the match and its episode */
+static void PongEnv_resetMatch(PongEnv *env, uint32_t index){
+
+	uint32_t seed = (env->seed * 2654435761u) ^ (index * 40503u) ^ (env->episodes[index] * 0x9e3779b9u);
+	Match_init(&env->matches[index], seed);
+	if(env->opponent) Controller_reset(env->opponent, &env->states[index], ~seed);
+
+}
+
+/* Writes the observation of one match */
+static void PongEnv_observe(const PongEnv *env, uint32_t index, float *observation){
+
+	const Match *match = &env->matches[index];
+	observation[0] = Scalar_toFloat(match->ball.position.x);
+	observation[1] = Scalar_toFloat(match->ball.position.y);
+	observation[2] = Scalar_toFloat(match->ball.speed.x);
+	observation[3] = Scalar_toFloat(match->ball.speed.y);
+	observation[4] = Scalar_toFloat(match->p1.position.y);
+	observation[5] = Scalar_toFloat(match->p2.position.y);
+	observation[6] = (float)match->p1.score;
+	observation[7] = (float)match->p2.score;
+
+}
+
+/* Returns the ring slot the next reset or step writes */
+static uint32_t PongEnv_beginSlot(PongEnv *env){
+
+	return (uint32_t)(env->header->step % env->slots);
+
+}
+
+/* Makes the slot just written visible to readers of the shared memory */
+static void PongEnv_publish(PongEnv *env){
+
+	atomic_thread_fence(memory_order_release);
+	env->header->step = env->header->step + 1;
+
+}
+
+/* Rounds an offset up to 'PONG_ENV_ALIGNMENT' */
+static uint64_t alignOffset(uint64_t offset){
+
+	return (offset + PONG_ENV_ALIGNMENT - 1) / PONG_ENV_ALIGNMENT * PONG_ENV_ALIGNMENT;
+
+}
@@ -0,0 +1,109 @@
+/*
+   CPong
+   Vectorized reinforcement learning environment with a stable C ABI.
+
+   One environment runs 'envCount' matches side by side. 'PongEnv_reset'
+   starts all of them and 'PongEnv_step' advances all of them by one tick
+   with one action per agent: -1 moves the paddle up, 1 down and 0 keeps
+   it still. With one agent per match the agent plays the left paddle
+   and a built-in controller the right one; with two, both paddles are
+   agents. The start input is always pressed, so every match runs the
+   ordinary countdown, rounds and scoring.
+
+   Results are written straight into memory the caller provides, for
+   example a shared memory block that numpy maps, laid out as described
+   by 'PongEnvHeader' at its start:
+
+   observations  float32 [slotCount][envCount][PONG_ENV_OBSERVATION_SIZE]
+   rewards       float32 [slotCount][envCount][players]
+   dones         uint8   [slotCount][envCount]
+   actions       int8    [envCount][players]
+
+   Every reset or step fills the next slot of the ring and then bumps
+   'step' in the header, so a reader can work on earlier slots while new
+   ones are written. Observations are, in playfield units: ball x, ball
+   y, ball speed x, ball speed y (per tick), left paddle y, right paddle
+   y, left score and right score. A goal rewards the scorer with 1 and
+   the other agent with -1.
+
+   A match is done on the tick a player reaches 'WIN_SCORE', when it
+   leaves 'gameState' 2 for the start prompt. It is reset on the same
+   step with a fresh seed, so the observation written with a done flag
+   is the first one of the next match, as with gym's vector autoreset.
+
+   Nothing is allocated after 'PongEnv_create'. Matches are stepped in
+   chunks on the work-stealing pool when more than one thread is asked
+   for.
+*/
+
+#ifndef ENV_H
+#define ENV_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Symbols of the ABI are exported from a shared library build */
+#if defined(_WIN32)
+#define PONG_ENV_API __declspec(dllexport)
+#else
+#define PONG_ENV_API __attribute__((visibility("default")))
+#endif
+
+/* ABI definitions. The version changes whenever the header or the layout changes. */
+#define PONG_ENV_ABI_VERSION 1
+#define PONG_ENV_MAGIC 0x56455043u		/* "CPEV" */
+#define PONG_ENV_OBSERVATION_SIZE 8
+#define PONG_ENV_ALIGNMENT 64			/* Every array starts on a multiple of this offset */
+
+/* Define the 'PongEnvHeader' struct at the start of the caller's memory. Offsets are in bytes from the header. */
+typedef struct PongEnvHeader{
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t envCount;
+	uint32_t slotCount;
+	uint32_t observationSize;
+	uint32_t players;
+	uint64_t step;				/* Slots written; the latest is (step - 1) % slotCount */
+	uint64_t observationOffset;
+	uint64_t rewardOffset;
+	uint64_t doneOffset;
+	uint64_t actionOffset;
+	uint64_t totalSize;
+
+} PongEnvHeader;
+
+/* Opaque environment type */
+typedef struct PongEnv PongEnv;
+
+/* Returns 'PONG_ENV_ABI_VERSION' of the library */
+PONG_ENV_API uint32_t PongEnv_getAbiVersion(void);
+
+/* Returns the bytes of memory an environment of the given shape needs */
+PONG_ENV_API uint64_t PongEnv_getMemorySize(uint32_t envCount, uint32_t slotCount, uint32_t players);
+
+/* Creates an environment writing into 'memory', which must be 'PONG_ENV_ALIGNMENT' aligned and hold
+   'PongEnv_getMemorySize' bytes. 'players' is 1 or 2. 'opponent' names the controller of the right
+   paddle when 'players' is 1, NULL for the default. 'threads' of 0 or less uses every processor.
+   Returns NULL on failure. */
+PONG_ENV_API PongEnv *PongEnv_create(void *memory, uint64_t size, uint32_t envCount, uint32_t slotCount,
+	uint32_t players, int32_t threads, const char *opponent, uint32_t seed);
+
+/* Starts every match over from 'seed' and writes the first observations. Returns the slot written. */
+PONG_ENV_API uint32_t PongEnv_reset(PongEnv *env, uint32_t seed);
+
+/* Advances every match by one tick. 'actions' holds envCount * players actions; NULL takes them from
+   the actions array of the shared memory. Returns the slot written. */
+PONG_ENV_API uint32_t PongEnv_step(PongEnv *env, const int8_t *actions);
+
+/* Frees the environment. The caller's memory is left as it is. */
+PONG_ENV_API void PongEnv_destroy(PongEnv *env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
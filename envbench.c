@@ -0,0 +1,131 @@
+/*
+   CPong
+   Throughput benchmark of the reinforcement learning environment.
+   Steps a batch of matches with random actions on 1, 2, 4, ... threads
+   and prints environment steps per second, counting one step per match
+   per tick.
+
+   Usage: envbench [-envs <count>] [-steps <count>] [-threads <count>]
+                   [-players 1|2] [-opponent <controller>] [-seed <seed>]
+
+   Every thread count must leave the same bytes in the shared memory, so
+   the benchmark also checks that stepping in parallel changes nothing.
+*/
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "pong.h"
+#include "env.h"
+#include "pool.h"
+#include "timer.h"
+
+/* Benchmark property definitions */
+#define ACTION_PATTERNS 64			/* Steps of random actions cycled through */
+#define SLOT_COUNT 4
+
+/* Function declarations */
+int runSteps(int threads, uint32_t envCount, uint32_t steps, uint32_t players, const char *opponent,
+	uint32_t seed, const int8_t *actions, double *rate, unsigned long long *checksum);
+
+/* Program entrypoint */
+int main(int argc, char **argv){
+
+	uint32_t envCount = 4096, steps = 2000, players = 1, seed = 1;
+	int threads = Pool_getCpuCount();
+	const char *opponent = NULL;
+
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "-envs") == 0 && i + 1 < argc) envCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-steps") == 0 && i + 1 < argc) steps = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-players") == 0 && i + 1 < argc) players = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-opponent") == 0 && i + 1 < argc) opponent = argv[++i];
+		else if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc) seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else{
+			fprintf(stderr, "Usage: %s [-envs n] [-steps n] [-threads n] [-players 1|2] [-opponent name] [-seed n]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if(envCount < 1 || steps < 1 || threads < 1 || (players != 1 && players != 2)){
+		fprintf(stderr, "Needs at least one match, step and thread, and 1 or 2 players\n");
+		return EXIT_FAILURE;
+	}
+
+	int8_t *actions = malloc((size_t)ACTION_PATTERNS * envCount * players);
+	if(!actions){
+		fprintf(stderr, "Out of memory\n");
+		return EXIT_FAILURE;
+	}
+	unsigned int rng = seed * 2654435761u + 1;
+	for(size_t i = 0; i < (size_t)ACTION_PATTERNS * envCount * players; ++i){
+		rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+		actions[i] = (int8_t)(rng % 3) - 1;
+	}
+
+	fprintf(stdout, "%u matches, %u steps, %u agent%s per match, ABI %u, %llu bytes of shared memory\n\n",
+		envCount, steps, players, (players == 2) ? "s" : "", PongEnv_getAbiVersion(),
+		(unsigned long long)PongEnv_getMemorySize(envCount, SLOT_COUNT, players));
+	fprintf(stdout, "%8s %14s %8s %10s %10s\n", "threads", "steps/s", "speedup", "efficiency", "same");
+
+	double baseRate = 0.0;
+	unsigned long long baseChecksum = 0;
+	int ok = 1;
+	for(int run = 1;; run = MIN(run * 2, threads)){
+
+		double rate;
+		unsigned long long checksum;
+		if(!runSteps(run, envCount, steps, players, opponent, seed, actions, &rate, &checksum)){
+			fprintf(stderr, "Could not create an environment with %d threads\n", run);
+			free(actions);
+			return EXIT_FAILURE;
+		}
+		if(run == 1){
+			baseRate = rate;
+			baseChecksum = checksum;
+		}
+		ok &= (checksum == baseChecksum);
+		fprintf(stdout, "%8d %14.0f %8.2f %10.2f %10s\n", run, rate, rate / baseRate, rate / baseRate / run,
+			(checksum == baseChecksum) ? "yes" : "NO");
+
+		if(run == threads) break;
+
+	}
+
+	free(actions);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
+
+/* Times 'steps' steps on the given number of threads and hashes the final shared memory */
+int runSteps(int threads, uint32_t envCount, uint32_t steps, uint32_t players, const char *opponent,
+	uint32_t seed, const int8_t *actions, double *rate, unsigned long long *checksum){
+
+	uint64_t size = PongEnv_getMemorySize(envCount, SLOT_COUNT, players);
+	void *memory = aligned_alloc(PONG_ENV_ALIGNMENT, (size_t)size);
+	if(!memory) return 0;
+	PongEnv *env = PongEnv_create(memory, size, envCount, SLOT_COUNT, players, threads, opponent, seed);
+	if(!env){
+		free(memory);
+		return 0;
+	}
+
+	unsigned long long start = Timer_now();
+	for(uint32_t step = 0; step < steps; ++step)
+		PongEnv_step(env, actions + (size_t)(step % ACTION_PATTERNS) * envCount * players);
+	*rate = (double)steps * envCount / Timer_toSeconds(Timer_now() - start);
+
+	/* FNV-1a over everything the environment wrote */
+	unsigned long long hash = 14695981039346656037ull;
+	const unsigned char *bytes = memory;
+	for(uint64_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+	*checksum = hash;
+
+	PongEnv_destroy(env);
+	free(memory);
+	return 1;
+
+}
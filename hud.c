@@ -0,0 +1,221 @@
+/*
+   CPong
+   On-screen score, countdown and status text. See hud.h.
+*/
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "hud.h"
+
+/* Font definitions. Each glyph is 7 rows of 5 bits, the leftmost pixel in the highest bit. */
+#define GLYPH_WIDTH 5
+#define GLYPH_HEIGHT 7
+#define GLYPH_CELL_WIDTH (GLYPH_WIDTH + 1)	/* An empty column and row keep neighbours from bleeding in */
+#define GLYPH_CELL_HEIGHT (GLYPH_HEIGHT + 1)
+#define GLYPH_COUNT 40
+#define GLYPH_SPACE 36
+
+/* Layout definitions, in playfield units */
+#define SCORE_CHARS 8
+#define SCORE_PIXEL 5.0f
+#define SCORE_Y 16.0f
+#define STATUS_CHARS 28
+#define STATUS_PIXEL 3.0f
+#define STATUS_Y 140.0f
+#define HUD_QUADS (SCORE_CHARS + STATUS_CHARS)
+#define HUD_VERTICES (HUD_QUADS * 4)
+
+/* Status values of 'HudArena' besides countdown seconds */
+#define STATUS_NONE 0
+#define STATUS_PROMPT 100			/* Plus the winner of the last game, if any */
+
+/* Digits, then A to Z, then space, '-', '!' and ':' */
+static const unsigned char glyphs[GLYPH_COUNT][GLYPH_HEIGHT] = {
+	{0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},
+	{0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},
+	{0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},
+	{0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},
+	{0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C},
+	{0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11}, {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},
+	{0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C},
+	{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},
+	{0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},
+	{0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},
+	{0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},
+	{0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},
+	{0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},
+	{0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},
+	{0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+	{0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},
+	{0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},
+	{0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}, {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F},
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00},
+	{0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}
+};
+
+/* Static function declarations */
+static void Hud_layout(const Hud *hud, size_t arena, sfVertex *quads, size_t capacity, const char *text, float pixel, float y);
+static int getGlyph(char c);
+static int getStatus(const Match *match);
+
+/* Creates the atlas and a HUD for every arena of the renderer */
+int Hud_create(Hud *hud, const ArenaRenderer *renderer){
+
+	size_t count = renderer->arenaCount;
+	memset(hud, 0, sizeof(*hud));
+
+	/* Rasterize the font into white glyphs on a transparent atlas, tinted by the vertex color */
+	unsigned int width = GLYPH_COUNT * GLYPH_CELL_WIDTH, height = GLYPH_CELL_HEIGHT;
+	sfUint8 *pixels = calloc((size_t)width * height * 4, 1);
+	hud->atlas = sfTexture_create(width, height);
+	hud->vertices = sfVertexArray_create();
+	hud->arenas = malloc(sizeof(HudArena) * count);
+	if(pixels && hud->vertices) sfVertexArray_resize(hud->vertices, count * HUD_VERTICES);
+	if(!pixels || !hud->atlas || !hud->vertices || !hud->arenas || sfVertexArray_getVertexCount(hud->vertices) != count * HUD_VERTICES){
+		free(pixels);
+		Hud_destroy(hud);
+		return 0;
+	}
+
+	for(int glyph = 0; glyph < GLYPH_COUNT; ++glyph)
+		for(int row = 0; row < GLYPH_HEIGHT; ++row)
+			for(int column = 0; column < GLYPH_WIDTH; ++column)
+				if(glyphs[glyph][row] & (0x10 >> column))
+					memset(pixels + ((size_t)row * width + (size_t)glyph * GLYPH_CELL_WIDTH + column) * 4, 0xff, 4);
+	sfTexture_updateFromPixels(hud->atlas, pixels, width, height, 0, 0);
+	free(pixels);
+
+	hud->arenaCount = count;
+	hud->columns = renderer->columns;
+	hud->scale = renderer->scale;
+	hud->cellWidth = renderer->cellWidth;
+	hud->cellHeight = renderer->cellHeight;
+	sfVertexArray_setPrimitiveType(hud->vertices, sfQuads);
+
+	/* Every quad starts empty; the first update fills the lines in */
+	sfVertex *vertices = sfVertexArray_getVertex(hud->vertices, 0);
+	for(size_t i = 0; i < count * HUD_VERTICES; ++i){
+		vertices[i].position = (sfVector2f){0.0f, 0.0f};
+		vertices[i].texCoords = (sfVector2f){0.0f, 0.0f};
+		vertices[i].color = sfBlack;
+	}
+	for(size_t arena = 0; arena < count; ++arena) hud->arenas[arena] = (HudArena){-1, -1};
+
+	return 1;
+
+}
+
+/* Shows the score and status of every arena, tessellating only the lines that changed */
+void Hud_update(Hud *hud, const Match *matches){
+
+	sfVertex *vertices = sfVertexArray_getVertex(hud->vertices, 0);
+	for(size_t arena = 0; arena < hud->arenaCount; ++arena){
+
+		const Match *match = &matches[arena];
+		HudArena *shown = &hud->arenas[arena];
+		Hud_updateScore(hud, arena, match->p1.score, match->p2.score);
+
+		int status = getStatus(match);
+		if(status == shown->status) continue;
+		shown->status = status;
+
+		char text[2 * STATUS_CHARS] = "";
+		if(status == STATUS_PROMPT) snprintf(text, sizeof(text), "PRESS ENTER");
+		else if(status > STATUS_PROMPT) snprintf(text, sizeof(text), "PLAYER %d WINS - PRESS ENTER", status - STATUS_PROMPT);
+		else if(status != STATUS_NONE) snprintf(text, sizeof(text), "%d", status);
+		Hud_layout(hud, arena, vertices + arena * HUD_VERTICES + SCORE_CHARS * 4, STATUS_CHARS, text, STATUS_PIXEL, STATUS_Y);
+		++hud->rebuilds;
+
+	}
+
+}
+
+/* Shows a score, tessellating it only if it changed */
+void Hud_updateScore(Hud *hud, size_t arena, int p1Score, int p2Score){
+
+	int score = (MIN(MAX(p1Score, 0), 99) << 8) | MIN(MAX(p2Score, 0), 99);
+	if(score == hud->arenas[arena].score) return;
+	hud->arenas[arena].score = score;
+
+	char text[2 * SCORE_CHARS];
+	snprintf(text, sizeof(text), "%d - %d", score >> 8, score & 255);
+	Hud_layout(hud, arena, sfVertexArray_getVertex(hud->vertices, arena * HUD_VERTICES), SCORE_CHARS, text, SCORE_PIXEL, SCORE_Y);
+	++hud->rebuilds;
+
+}
+
+/* Draws the text of every arena with one draw call */
+void Hud_draw(const Hud *hud, sfRenderWindow *window){
+
+	sfRenderStates states = {sfBlendAlpha, sfTransform_Identity, hud->atlas, NULL};
+	sfRenderWindow_drawVertexArray(window, hud->vertices, &states);
+
+}
+
+/* Frees the atlas and the vertex array */
+void Hud_destroy(Hud *hud){
+
+	if(hud->vertices) sfVertexArray_destroy(hud->vertices);
+	if(hud->atlas) sfTexture_destroy(hud->atlas);
+	free(hud->arenas);
+
+}
+
+/* Writes a line of text centered in an arena at height 'y', leaving the remaining quads of the line empty */
+static void Hud_layout(const Hud *hud, size_t arena, sfVertex *quads, size_t capacity, const char *text, float pixel, float y){
+
+	size_t length = MIN(strlen(text), capacity);
+	float scale = hud->scale;
+	float width = ((float)length * GLYPH_CELL_WIDTH - 1.0f) * pixel;
+	float originX = (float)(arena % hud->columns) * hud->cellWidth + (WINDOW_WIDTH - width) * 0.5f * scale;
+	float originY = (float)(arena / hud->columns) * hud->cellHeight + y * scale;
+	float glyphWidth = GLYPH_WIDTH * pixel * scale, glyphHeight = GLYPH_HEIGHT * pixel * scale;
+
+	for(size_t i = 0; i < capacity; ++i){
+		sfVertex *quad = quads + i * 4;
+		int glyph = (i < length) ? getGlyph(text[i]) : GLYPH_SPACE;
+		if(glyph == GLYPH_SPACE){
+			for(int corner = 0; corner < 4; ++corner) quad[corner].position = (sfVector2f){0.0f, 0.0f};
+			continue;
+		}
+
+		float x = originX + (float)i * GLYPH_CELL_WIDTH * pixel * scale;
+		float u = (float)(glyph * GLYPH_CELL_WIDTH);
+		quad[0].position = (sfVector2f){x, originY};
+		quad[1].position = (sfVector2f){x + glyphWidth, originY};
+		quad[2].position = (sfVector2f){x + glyphWidth, originY + glyphHeight};
+		quad[3].position = (sfVector2f){x, originY + glyphHeight};
+		quad[0].texCoords = (sfVector2f){u, 0.0f};
+		quad[1].texCoords = (sfVector2f){u + GLYPH_WIDTH, 0.0f};
+		quad[2].texCoords = (sfVector2f){u + GLYPH_WIDTH, GLYPH_HEIGHT};
+		quad[3].texCoords = (sfVector2f){u, GLYPH_HEIGHT};
+	}
+
+}
+
+/* Returns the atlas cell of a character. Lower case is drawn as upper case and anything unknown as a space. */
+static int getGlyph(char c){
+
+	if(c >= '0' && c <= '9') return c - '0';
+	if(c >= 'A' && c <= 'Z') return 10 + c - 'A';
+	if(c >= 'a' && c <= 'z') return 10 + c - 'a';
+	if(c == '-') return 37;
+	if(c == '!') return 38;
+	if(c == ':') return 39;
+	return GLYPH_SPACE;
+
+}
+
+/* Returns what the status line of a match shows: the seconds left of the start countdown,
+   the start prompt with the winner of the last game, or nothing while a game is on */
+static int getStatus(const Match *match){
+
+	if(match->gameState != 0) return STATUS_NONE;
+	if(match->gameStarting) return (match->countdown + TICK_RATE - 1) / TICK_RATE;
+	return STATUS_PROMPT + Match_getWinner(match);
+
+}
@@ -0,0 +1,55 @@
+/*
+   CPong
+   On-screen score, countdown and status text.
+
+   Text is drawn from a glyph atlas: a built-in 5x7 pixel font is
+   rasterized once into a small texture, and every character is a quad
+   sampling its cell. Each arena owns a fixed run of quads in a single
+   vertex array, laid out over the same grid as 'ArenaRenderer'. A line
+   of text is only tessellated again when what it shows changes, a point
+   scored or a countdown second passing; every other frame the array is
+   drawn as it is, so the HUD of any number of arenas is one draw call
+   and a few integer comparisons per arena.
+*/
+
+#ifndef HUD_H
+#define HUD_H
+
+#include <stddef.h>
+
+#include <SFML/Graphics.h>
+
+#include "pong.h"
+#include "render.h"
+
+/* Define the 'HudArena' struct, what the text of one arena currently shows */
+typedef struct HudArena{
+
+	int score;				/* Both scores packed, or -1 before the first update */
+	int status;				/* Countdown second, prompt or winner, see hud.c */
+
+} HudArena;
+
+/* Define the 'Hud' struct */
+typedef struct Hud{
+
+	sfVertexArray *vertices;
+	sfTexture *atlas;
+	HudArena *arenas;
+	size_t arenaCount;
+	unsigned int columns;
+	float scale;
+	float cellWidth;
+	float cellHeight;
+	unsigned long long rebuilds;		/* Lines tessellated since the start */
+
+} Hud;
+
+/* HUD function declarations. Functions returning int return nonzero on success. */
+int Hud_create(Hud *hud, const ArenaRenderer *renderer);
+void Hud_update(Hud *hud, const Match *matches);
+void Hud_updateScore(Hud *hud, size_t arena, int p1Score, int p2Score);
+void Hud_draw(const Hud *hud, sfRenderWindow *window);
+void Hud_destroy(Hud *hud);
+
+#endif
@@ -0,0 +1,316 @@
+/*
+   CPong
+   Event driven keyboard and gamepad input. See input.h.
+*/
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "input.h"
+
+/* Define a 'NamedCode' struct pairing a name in a bindings file with a key code or axis */
+typedef struct NamedCode{
+
+	const char *name;
+	int code;
+
+} NamedCode;
+
+/* Static function declarations */
+static void InputSystem_setSource(InputSystem *input, int binding, int held, unsigned long long time);
+static void InputSystem_push(InputSystem *input, InputAction action, int pressed, unsigned long long time);
+static int parseBinding(char *line, Binding *binding);
+static int findName(const NamedCode *names, const char *name, int *code);
+static int compareNanos(const void *a, const void *b);
+
+/* Input bit of each action */
+static const Input actionBits[INPUT_ACTION_COUNT] = {INPUT_P1_UP, INPUT_P1_DOWN, INPUT_P2_UP, INPUT_P2_DOWN, INPUT_START};
+
+/* Names used in bindings files */
+static const NamedCode actionNames[] = {
+	{"p1_up", INPUT_ACTION_P1_UP}, {"p1_down", INPUT_ACTION_P1_DOWN},
+	{"p2_up", INPUT_ACTION_P2_UP}, {"p2_down", INPUT_ACTION_P2_DOWN},
+	{"start", INPUT_ACTION_START}, {NULL, 0}
+};
+static const NamedCode keyNames[] = {
+	{"Up", sfKeyUp}, {"Down", sfKeyDown}, {"Left", sfKeyLeft}, {"Right", sfKeyRight},
+	{"Return", sfKeyReturn}, {"Space", sfKeySpace}, {"Tab", sfKeyTab}, {"Backspace", sfKeyBackspace},
+	{"LShift", sfKeyLShift}, {"RShift", sfKeyRShift}, {"LControl", sfKeyLControl}, {"RControl", sfKeyRControl},
+	{"LAlt", sfKeyLAlt}, {"RAlt", sfKeyRAlt}, {"PageUp", sfKeyPageUp}, {"PageDown", sfKeyPageDown},
+	{"Home", sfKeyHome}, {"End", sfKeyEnd}, {"Insert", sfKeyInsert}, {"Delete", sfKeyDelete},
+	{"Comma", sfKeyComma}, {"Period", sfKeyPeriod}, {"Slash", sfKeySlash}, {"Semicolon", sfKeySemicolon},
+	{NULL, 0}
+};
+static const NamedCode axisNames[] = {
+	{"X", sfJoystickX}, {"Y", sfJoystickY}, {"Z", sfJoystickZ}, {"R", sfJoystickR},
+	{"U", sfJoystickU}, {"V", sfJoystickV}, {"PovX", sfJoystickPovX}, {"PovY", sfJoystickPovY},
+	{NULL, 0}
+};
+
+/* Default bindings: the keyboard controls of the original game, plus the left stick and start button
+   of the first two gamepads */
+static const Binding defaultBindings[] = {
+	{INPUT_ACTION_P1_UP, BINDING_KEY, sfKeyW, 0, 0},
+	{INPUT_ACTION_P1_DOWN, BINDING_KEY, sfKeyS, 0, 0},
+	{INPUT_ACTION_P2_UP, BINDING_KEY, sfKeyUp, 0, 0},
+	{INPUT_ACTION_P2_DOWN, BINDING_KEY, sfKeyDown, 0, 0},
+	{INPUT_ACTION_START, BINDING_KEY, sfKeyReturn, 0, 0},
+	{INPUT_ACTION_P1_UP, BINDING_AXIS, sfJoystickY, 0, -1},
+	{INPUT_ACTION_P1_DOWN, BINDING_AXIS, sfJoystickY, 0, 1},
+	{INPUT_ACTION_P2_UP, BINDING_AXIS, sfJoystickY, 1, -1},
+	{INPUT_ACTION_P2_DOWN, BINDING_AXIS, sfJoystickY, 1, 1},
+	{INPUT_ACTION_START, BINDING_BUTTON, 7, 0, 0},
+	{INPUT_ACTION_START, BINDING_BUTTON, 7, 1, 0},
+};
+
+/* Sets up the default bindings with nothing held */
+void InputSystem_init(InputSystem *input){
+
+	memset(input, 0, sizeof(*input));
+	for(size_t i = 0; i < sizeof(defaultBindings) / sizeof(defaultBindings[0]); ++i) InputSystem_bind(input, defaultBindings[i]);
+
+}
+
+/* Adds a binding. Returns 0 if the table is full. */
+int InputSystem_bind(InputSystem *input, Binding binding){
+
+	if(input->bindingCount == INPUT_MAX_BINDINGS || binding.action >= INPUT_ACTION_COUNT) return 0;
+	input->bindingHeld[input->bindingCount] = 0;
+	input->bindings[input->bindingCount++] = binding;
+	return 1;
+
+}
+
+/* Replaces every binding with the ones in a bindings file. Blank lines and lines starting with '#'
+   are skipped. Returns 0 if the file cannot be read or has an invalid line, keeping the old bindings. */
+int InputSystem_loadBindings(InputSystem *input, const char *path){
+
+	FILE *file = fopen(path, "r");
+	if(!file) return 0;
+
+	Binding bindings[INPUT_MAX_BINDINGS];
+	int count = 0, ok = 1, lineNumber = 0;
+	char line[256];
+	while(ok && fgets(line, sizeof(line), file)){
+		++lineNumber;
+		char *start = line + strspn(line, " \t\r\n");
+		if(*start == '\0' || *start == '#') continue;
+		if(count == INPUT_MAX_BINDINGS || !parseBinding(start, &bindings[count])){
+			fprintf(stderr, "%s:%d: invalid binding\n", path, lineNumber);
+			ok = 0;
+		}else ++count;
+	}
+	fclose(file);
+	if(!ok) return 0;
+
+	memset(input->bindingHeld, 0, sizeof(input->bindingHeld));
+	memset(input->sources, 0, sizeof(input->sources));
+	input->bindingCount = 0;
+	for(int i = 0; i < count; ++i) InputSystem_bind(input, bindings[i]);
+	return 1;
+
+}
+
+/* Updates the held bindings from a window event read at the given time */
+void InputSystem_handleEvent(InputSystem *input, const sfEvent *event, unsigned long long time){
+
+	for(int i = 0; i < input->bindingCount; ++i){
+
+		const Binding *binding = &input->bindings[i];
+		switch(event->type){
+			case sfEvtKeyPressed:
+			case sfEvtKeyReleased:
+				if(binding->type == BINDING_KEY && binding->code == (int)event->key.code)
+					InputSystem_setSource(input, i, event->type == sfEvtKeyPressed, time);
+				break;
+			case sfEvtJoystickButtonPressed:
+			case sfEvtJoystickButtonReleased:
+				if(binding->type == BINDING_BUTTON && binding->joystick == event->joystickButton.joystickId &&
+					binding->code == (int)event->joystickButton.button)
+					InputSystem_setSource(input, i, event->type == sfEvtJoystickButtonPressed, time);
+				break;
+			case sfEvtJoystickMoved:
+				if(binding->type == BINDING_AXIS && binding->joystick == event->joystickMove.joystickId &&
+					binding->code == (int)event->joystickMove.axis)
+					InputSystem_setSource(input, i, event->joystickMove.position * (float)binding->direction > INPUT_AXIS_THRESHOLD, time);
+				break;
+			case sfEvtJoystickDisconnected:
+				if(binding->type != BINDING_KEY && binding->joystick == event->joystickConnect.joystickId)
+					InputSystem_setSource(input, i, 0, time);
+				break;
+			case sfEvtLostFocus:
+				/* Key releases are not delivered to a window without focus */
+				if(binding->type == BINDING_KEY) InputSystem_setSource(input, i, 0, time);
+				break;
+			default:
+				break;
+		}
+
+	}
+
+}
+
+/* Returns the input of the tick that ends at 'tickEnd' and takes the changes read before then. An action
+   counts as held for the tick if it was held when the tick began or pressed at any time during it, so a
+   release takes effect from the next tick on and a press is never dropped. */
+Input InputSystem_getTickInput(InputSystem *input, unsigned long long tickEnd){
+
+	Input bits = 0;
+	for(int action = 0; action < INPUT_ACTION_COUNT; ++action) if(input->held[action]) bits |= actionBits[action];
+
+	while(input->queueCount > 0 && input->queue[input->queueHead].time < tickEnd){
+		const InputChange *change = &input->queue[input->queueHead];
+		if(change->pressed) bits |= actionBits[change->action];
+		input->held[change->action] = change->pressed;
+		if(input->pendingTime == 0) input->pendingTime = change->time;
+		input->queueHead = (input->queueHead + 1) % INPUT_QUEUE_SIZE;
+		--input->queueCount;
+	}
+
+	return bits;
+
+}
+
+/* Returns the read time of the earliest change taken by a tick since the last call, or 0, and forgets it. The front
+   end carries it to the frame that shows the tick. */
+unsigned long long InputSystem_takePending(InputSystem *input){
+
+	unsigned long long readTime = input->pendingTime;
+	input->pendingTime = 0;
+	return readTime;
+
+}
+
+/* Records one latency sample, from a change read at 'readTime' to the end of the display call at 'time' */
+void InputSystem_recordLatency(InputSystem *input, unsigned long long readTime, unsigned long long time){
+
+	input->latencies[input->latencyCount % INPUT_LATENCY_HISTORY] = time - readTime;
+	++input->latencyCount;
+
+}
+
+/* Computes input to display latency statistics over the recorded history. Returns 0 if nothing was recorded. */
+int InputSystem_getLatency(const InputSystem *input, InputLatency *latency){
+
+	unsigned long long samples[INPUT_LATENCY_HISTORY];
+	int count = MIN(input->latencyCount, INPUT_LATENCY_HISTORY);
+
+	memset(latency, 0, sizeof(*latency));
+	latency->count = count;
+	if(count == 0) return 0;
+
+	double total = 0.0;
+	for(int i = 0; i < count; ++i){
+		samples[i] = input->latencies[i];
+		total += (double)samples[i];
+	}
+	qsort(samples, (size_t)count, sizeof(unsigned long long), compareNanos);
+	latency->mean = total / count / 1e9;
+	latency->p50 = (double)samples[(count - 1) / 2] / 1e9;
+	latency->p99 = (double)samples[(count - 1) * 99 / 100] / 1e9;
+	latency->max = (double)samples[count - 1] / 1e9;
+	return 1;
+
+}
+
+/* Sets whether a binding is held and queues a change when its action starts or stops being held */
+static void InputSystem_setSource(InputSystem *input, int binding, int held, unsigned long long time){
+
+	if(input->bindingHeld[binding] == (held != 0)) return;
+	input->bindingHeld[binding] = (held != 0);
+
+	InputAction action = input->bindings[binding].action;
+	input->sources[action] += held ? 1 : -1;
+	if(held && input->sources[action] == 1) InputSystem_push(input, action, 1, time);
+	else if(!held && input->sources[action] == 0) InputSystem_push(input, action, 0, time);
+
+}
+
+/* Queues a change. When no tick has taken changes for a while (a replay or the spectator wall is
+   showing) the oldest change is applied to the held state and dropped. */
+static void InputSystem_push(InputSystem *input, InputAction action, int pressed, unsigned long long time){
+
+	if(input->queueCount == INPUT_QUEUE_SIZE){
+		const InputChange *oldest = &input->queue[input->queueHead];
+		input->held[oldest->action] = oldest->pressed;
+		input->queueHead = (input->queueHead + 1) % INPUT_QUEUE_SIZE;
+		--input->queueCount;
+	}
+
+	InputChange *change = &input->queue[(input->queueHead + input->queueCount) % INPUT_QUEUE_SIZE];
+	change->time = time;
+	change->action = (unsigned char)action;
+	change->pressed = (unsigned char)pressed;
+	++input->queueCount;
+
+}
+
+/* Parses "<action> key <name>", "<action> joystick <id> button <n>" or "<action> joystick <id> axis <name> <+|->" */
+static int parseBinding(char *line, Binding *binding){
+
+	char *words[6];
+	int count = 0;
+	for(char *word = strtok(line, " \t\r\n"); word && count < 6; word = strtok(NULL, " \t\r\n")) words[count++] = word;
+	if(count < 3) return 0;
+
+	int code;
+	memset(binding, 0, sizeof(*binding));
+	if(!findName(actionNames, words[0], &code)) return 0;
+	binding->action = (InputAction)code;
+
+	if(strcmp(words[1], "key") == 0 && count == 3){
+		size_t length = strlen(words[2]);
+		binding->type = BINDING_KEY;
+		if(length == 1 && words[2][0] >= 'A' && words[2][0] <= 'Z') binding->code = sfKeyA + (words[2][0] - 'A');
+		else if(length == 1 && words[2][0] >= '0' && words[2][0] <= '9') binding->code = sfKeyNum0 + (words[2][0] - '0');
+		else if(length == 7 && strncmp(words[2], "Numpad", 6) == 0 && words[2][6] >= '0' && words[2][6] <= '9')
+			binding->code = sfKeyNumpad0 + (words[2][6] - '0');
+		else if(!findName(keyNames, words[2], &binding->code)) return 0;
+		return 1;
+	}
+
+	if(strcmp(words[1], "joystick") != 0 || count < 5) return 0;
+	binding->joystick = (unsigned int)atoi(words[2]);
+	if(binding->joystick >= sfJoystickCount) return 0;
+
+	if(strcmp(words[3], "button") == 0 && count == 5){
+		binding->type = BINDING_BUTTON;
+		binding->code = atoi(words[4]);
+		return binding->code >= 0 && binding->code < sfJoystickButtonCount;
+	}
+
+	if(strcmp(words[3], "axis") == 0 && count == 6 && findName(axisNames, words[4], &binding->code)){
+		binding->type = BINDING_AXIS;
+		if(strcmp(words[5], "+") == 0) binding->direction = 1;
+		else if(strcmp(words[5], "-") == 0) binding->direction = -1;
+		else return 0;
+		return 1;
+	}
+
+	return 0;
+
+}
+
+/* Looks up a name in a table ending with a NULL name */
+static int findName(const NamedCode *names, const char *name, int *code){
+
+	for(; names->name; ++names){
+		if(strcmp(names->name, name) == 0){
+			*code = names->code;
+			return 1;
+		}
+	}
+	return 0;
+
+}
+
+/* Orders nanosecond values ascending */
+static int compareNanos(const void *a, const void *b){
+
+	unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+
+}
@@ -0,0 +1,115 @@
+/*
+   CPong
+   Event driven keyboard and gamepad input.
+
+   Key, joystick button and joystick axis events from the window's event
+   loop are turned into presses and releases of the five game actions
+   through a table of bindings, and queued with the time they were read.
+   Each simulation tick then takes the changes that fall inside the span
+   of time it stands for. A frame that runs several ticks applies every
+   press and release in the tick it happened in, and a tap shorter than
+   a frame is never lost, which polling the keyboard once per frame
+   cannot do.
+
+   Bindings can be replaced from a text file with one binding per line:
+
+   p1_up key W
+   p1_down joystick 0 axis Y +
+   start joystick 1 button 7
+
+   The latency from reading an input change to the end of the display
+   call of the first frame that shows its effect is recorded as well.
+
+   The system is not locked: a front end that reads events and ticks on
+   different threads serializes its calls itself.
+*/
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <SFML/Window.h>
+
+#include "pong.h"
+
+/* Input system property definitions */
+#define INPUT_MAX_BINDINGS 32
+#define INPUT_QUEUE_SIZE 256			/* Changes waiting for a tick */
+#define INPUT_LATENCY_HISTORY 1024		/* Latency samples kept for the statistics */
+#define INPUT_AXIS_THRESHOLD 50.0f		/* Axis position past which a direction counts as held */
+
+/* Game actions, one per bit of 'Input' */
+typedef enum {
+	INPUT_ACTION_P1_UP,
+	INPUT_ACTION_P1_DOWN,
+	INPUT_ACTION_P2_UP,
+	INPUT_ACTION_P2_DOWN,
+	INPUT_ACTION_START,
+	INPUT_ACTION_COUNT
+} InputAction;
+
+/* Kinds of input sources */
+typedef enum {BINDING_KEY, BINDING_BUTTON, BINDING_AXIS} BindingType;
+
+/* Define the 'Binding' struct tying one key, button or axis direction to an action */
+typedef struct Binding{
+
+	InputAction action;
+	BindingType type;
+	int code;			/* Key code, button number or axis */
+	unsigned int joystick;
+	int direction;			/* -1 or 1 for axes */
+
+} Binding;
+
+/* Define the 'InputChange' struct, a queued press or release of an action */
+typedef struct InputChange{
+
+	unsigned long long time;
+	unsigned char action;
+	unsigned char pressed;
+
+} InputChange;
+
+/* Define the 'InputLatency' struct with input to display statistics in seconds */
+typedef struct InputLatency{
+
+	int count;
+	double mean;
+	double p50;
+	double p99;
+	double max;
+
+} InputLatency;
+
+/* Define the 'InputSystem' struct */
+typedef struct InputSystem{
+
+	Binding bindings[INPUT_MAX_BINDINGS];
+	unsigned char bindingHeld[INPUT_MAX_BINDINGS];
+	int bindingCount;
+	int sources[INPUT_ACTION_COUNT];		/* Held bindings of each action */
+
+	/* Changes not yet taken by a tick, and the action state as of the last tick */
+	InputChange queue[INPUT_QUEUE_SIZE];
+	int queueHead;
+	int queueCount;
+	unsigned char held[INPUT_ACTION_COUNT];
+
+	/* Latency measurement */
+	unsigned long long pendingTime;		/* Earliest change taken by a tick but not yet shown, or 0 */
+	unsigned long long latencies[INPUT_LATENCY_HISTORY];
+	int latencyCount;
+
+} InputSystem;
+
+/* Input system function declarations. Functions returning int return nonzero on success. */
+void InputSystem_init(InputSystem *input);
+int InputSystem_bind(InputSystem *input, Binding binding);
+int InputSystem_loadBindings(InputSystem *input, const char *path);
+void InputSystem_handleEvent(InputSystem *input, const sfEvent *event, unsigned long long time);
+Input InputSystem_getTickInput(InputSystem *input, unsigned long long tickEnd);
+unsigned long long InputSystem_takePending(InputSystem *input);
+void InputSystem_recordLatency(InputSystem *input, unsigned long long readTime, unsigned long long time);
+int InputSystem_getLatency(const InputSystem *input, InputLatency *latency);
+
+#endif
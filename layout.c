@@ -0,0 +1,280 @@
+/*
+   CPong
+   Arena layouts: static rectangular obstacles inside the playfield. See layout.h.
+*/
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "layout.h"
+
+/* Most levels of a tree. Median splits keep it near the log of the obstacle count. */
+#define MAX_DEPTH 64
+
+/* Boxes are tested grown by this much, so a sweep that just grazes an obstacle is never lost to rounding at a box */
+#define NODE_MARGIN SCALAR(1.0f)
+
+/* Define the 'NodeEntry' struct, a box waiting to be visited and the time the ball reaches it */
+typedef struct NodeEntry{
+
+	int node;
+	Scalar time;
+
+} NodeEntry;
+
+/* Static function declarations */
+static void Layout_build(Layout *layout, size_t first, size_t count, int depth);
+static int Layout_enterNode(const LayoutNode *node, const Ball *ball, Scalar limit, Scalar *time);
+static int clipAxis(Scalar position, Scalar speed, Scalar low, Scalar high, Scalar *enter, Scalar *leave);
+static int parseObstacle(char *line, Obstacle *obstacle);
+static int compareX(const void *a, const void *b);
+static int compareY(const void *a, const void *b);
+static int compareRects(const Obstacle *a, const Obstacle *b);
+
+/* Copies the obstacles and builds the tree over them. A layout without obstacles is valid and never hit. */
+int Layout_create(Layout *layout, const Obstacle *obstacles, size_t count){
+
+	memset(layout, 0, sizeof(*layout));
+	if(count > LAYOUT_MAX_OBSTACLES) return 0;
+	if(count == 0) return 1;
+
+	/* A tree with leaves of at least one obstacle has fewer than twice as many nodes as obstacles */
+	layout->obstacles = malloc(sizeof(Obstacle) * count);
+	layout->nodes = malloc(sizeof(LayoutNode) * 2 * count);
+	if(!layout->obstacles || !layout->nodes){
+		Layout_destroy(layout);
+		return 0;
+	}
+	memcpy(layout->obstacles, obstacles, sizeof(Obstacle) * count);
+	layout->count = count;
+
+	Layout_build(layout, 0, count, 1);
+	return 1;
+
+}
+
+/* Reads a layout file. Returns 0 if it cannot be read or has an invalid line. */
+int Layout_load(Layout *layout, const char *path){
+
+	FILE *file = fopen(path, "r");
+	if(!file) return 0;
+
+	Obstacle *obstacles = NULL;
+	size_t count = 0, capacity = 0;
+	int ok = 1, lineNumber = 0;
+	char line[256];
+	while(ok && fgets(line, sizeof(line), file)){
+
+		++lineNumber;
+		char *start = line + strspn(line, " \t\r\n");
+		if(*start == '\0' || *start == '#') continue;
+
+		if(count == capacity){
+			capacity = capacity ? capacity * 2 : 64;
+			Obstacle *grown = (capacity <= LAYOUT_MAX_OBSTACLES) ? realloc(obstacles, sizeof(Obstacle) * capacity) : NULL;
+			if(!grown){
+				fprintf(stderr, "%s:%d: too many obstacles\n", path, lineNumber);
+				ok = 0;
+				break;
+			}
+			obstacles = grown;
+		}
+
+		if(!parseObstacle(start, &obstacles[count])){
+			fprintf(stderr, "%s:%d: invalid obstacle\n", path, lineNumber);
+			ok = 0;
+		}else ++count;
+
+	}
+	fclose(file);
+
+	ok = ok && Layout_create(layout, obstacles, count);
+	free(obstacles);
+	return ok;
+
+}
+
+/* Frees the obstacles and the tree */
+void Layout_destroy(Layout *layout){
+
+	free(layout->obstacles);
+	free(layout->nodes);
+	memset(layout, 0, sizeof(*layout));
+
+}
+
+/* Sweeps the ball along its speed for up to 'limit' ticks like 'Ball_sweepRect' and returns the index of the
+   first obstacle it hits, with the time of impact and the side hit, or -1 if it hits none. Of obstacles hit at
+   the same time the one with the lowest index is returned, so the result does not depend on the visit order. */
+int Layout_sweep(const Layout *layout, const Ball *ball, Scalar limit, Scalar *time, Side *side){
+
+	if(!layout || layout->nodeCount == 0) return -1;
+
+	NodeEntry stack[MAX_DEPTH + 1];
+	int top = 0, hit = -1;
+	Scalar best = limit;
+	if(Layout_enterNode(&layout->nodes[0], ball, best, &stack[0].time)){
+		stack[0].node = 0;
+		top = 1;
+	}
+
+	while(top > 0){
+
+		/* A box the ball reaches after the best hit so far cannot hold an earlier one */
+		NodeEntry entry = stack[--top];
+		if(entry.time > best) continue;
+		const LayoutNode *node = &layout->nodes[entry.node];
+
+		if(node->count > 0){
+			for(int i = node->first; i < node->first + node->count; ++i){
+				const Obstacle *obstacle = &layout->obstacles[i];
+				Scalar obstacleTime;
+				Side obstacleSide;
+				if(Ball_sweepRect(ball, obstacle->min, obstacle->max, best, &obstacleTime, &obstacleSide) &&
+					(hit < 0 || obstacleTime < best || i < hit)){
+					best = obstacleTime;
+					*side = obstacleSide;
+					hit = i;
+				}
+			}
+			continue;
+		}
+
+		/* The nearer child goes on top so it is visited first and narrows the search for the other */
+		NodeEntry children[2] = {{entry.node + 1, 0}, {node->first, 0}};
+		int reached[2];
+		for(int i = 0; i < 2; ++i) reached[i] = Layout_enterNode(&layout->nodes[children[i].node], ball, best, &children[i].time);
+		int nearer = (reached[1] && (!reached[0] || children[1].time < children[0].time)) ? 1 : 0;
+		if(reached[1 - nearer]) stack[top++] = children[1 - nearer];
+		if(reached[nearer]) stack[top++] = children[nearer];
+
+	}
+
+	if(hit >= 0) *time = best;
+	return hit;
+
+}
+
+/* Sorts 'count' obstacles from 'first' into a subtree rooted at the next free node */
+static void Layout_build(Layout *layout, size_t first, size_t count, int depth){
+
+	size_t index = layout->nodeCount++;
+	LayoutNode *node = &layout->nodes[index];
+	Obstacle *obstacles = layout->obstacles + first;
+
+	/* Bounds of the obstacles and of their centers */
+	node->min = obstacles[0].min;
+	node->max = obstacles[0].max;
+	Point low = {obstacles[0].min.x + obstacles[0].max.x, obstacles[0].min.y + obstacles[0].max.y}, high = low;
+	for(size_t i = 1; i < count; ++i){
+		node->min.x = MIN(node->min.x, obstacles[i].min.x); node->min.y = MIN(node->min.y, obstacles[i].min.y);
+		node->max.x = MAX(node->max.x, obstacles[i].max.x); node->max.y = MAX(node->max.y, obstacles[i].max.y);
+		Point center = {obstacles[i].min.x + obstacles[i].max.x, obstacles[i].min.y + obstacles[i].max.y};
+		low.x = MIN(low.x, center.x); low.y = MIN(low.y, center.y);
+		high.x = MAX(high.x, center.x); high.y = MAX(high.y, center.y);
+	}
+
+	layout->depth = MAX(layout->depth, depth);
+	if(count <= LAYOUT_LEAF_SIZE || depth == MAX_DEPTH){
+		node->first = (int)first;
+		node->count = (int)count;
+		return;
+	}
+
+	/* Split at the median along the axis the centers spread the most on. The sort orders every field, so
+	   every C library builds the same tree. */
+	qsort(obstacles, count, sizeof(Obstacle), (high.x - low.x >= high.y - low.y) ? compareX : compareY);
+	size_t half = count / 2;
+	node->count = 0;
+	Layout_build(layout, first, half, depth + 1);
+	layout->nodes[index].first = (int)layout->nodeCount;
+	Layout_build(layout, first + half, count - half, depth + 1);
+
+}
+
+/* Finds the time the ball reaches a box, grown by the ball's size so the ball can be treated as its top left corner.
+   Returns 0 if it does not within 'limit' ticks. A ball already inside the box reaches it at time 0. */
+static int Layout_enterNode(const LayoutNode *node, const Ball *ball, Scalar limit, Scalar *time){
+
+	Scalar enter = 0, leave = limit;
+	if(!clipAxis(ball->position.x, ball->speed.x, node->min.x - SCALAR(BALL_SIZE) - NODE_MARGIN, node->max.x + NODE_MARGIN, &enter, &leave) ||
+		!clipAxis(ball->position.y, ball->speed.y, node->min.y - SCALAR(BALL_SIZE) - NODE_MARGIN, node->max.y + NODE_MARGIN, &enter, &leave))
+		return 0;
+
+	*time = enter;
+	return 1;
+
+}
+
+/* Narrows the interval from 'enter' to 'leave' to the times a point moving along one axis is between 'low' and 'high' */
+static int clipAxis(Scalar position, Scalar speed, Scalar low, Scalar high, Scalar *enter, Scalar *leave){
+
+	if(speed == 0) return position >= low && position <= high;
+
+	Scalar a = Scalar_div(low - position, speed), b = Scalar_div(high - position, speed);
+	*enter = MAX(*enter, MIN(a, b));
+	*leave = MIN(*leave, MAX(a, b));
+	return *enter <= *leave;
+
+}
+
+/* Parses "wall|bumper <x> <y> <width> <height>" or "goal <1|2> <x> <y> <width> <height>" */
+static int parseObstacle(char *line, Obstacle *obstacle){
+
+	char kind[16];
+	float x, y, width, height;
+	int player = 0, read;
+
+	if(sscanf(line, "%15s%n", kind, &read) != 1) return 0;
+	line += read;
+
+	if(strcmp(kind, "wall") == 0) obstacle->kind = OBSTACLE_WALL;
+	else if(strcmp(kind, "bumper") == 0) obstacle->kind = OBSTACLE_BUMPER;
+	else if(strcmp(kind, "goal") == 0){
+		obstacle->kind = OBSTACLE_GOAL;
+		if(sscanf(line, "%d%n", &player, &read) != 1 || (player != 1 && player != 2)) return 0;
+		line += read;
+	}else return 0;
+
+	if(sscanf(line, "%f %f %f %f %n", &x, &y, &width, &height, &read) != 4 || line[read] != '\0') return 0;
+	if(!(width > 0.0f && height > 0.0f)) return 0;
+
+	obstacle->min = (Point){Scalar_fromFloat(x), Scalar_fromFloat(y)};
+	obstacle->max = (Point){Scalar_fromFloat(x + width), Scalar_fromFloat(y + height)};
+	obstacle->player = player;
+	return 1;
+
+}
+
+/* Orders obstacles by their center on the x axis */
+static int compareX(const void *a, const void *b){
+
+	const Obstacle *first = a, *second = b;
+	Scalar centerA = first->min.x + first->max.x, centerB = second->min.x + second->max.x;
+	if(centerA != centerB) return (centerA < centerB) ? -1 : 1;
+	return compareRects(first, second);
+
+}
+
+/* Orders obstacles by their center on the y axis */
+static int compareY(const void *a, const void *b){
+
+	const Obstacle *first = a, *second = b;
+	Scalar centerA = first->min.y + first->max.y, centerB = second->min.y + second->max.y;
+	if(centerA != centerB) return (centerA < centerB) ? -1 : 1;
+	return compareRects(first, second);
+
+}
+
+/* Breaks ties between equal centers on every other field */
+static int compareRects(const Obstacle *a, const Obstacle *b){
+
+	const Scalar fieldsA[4] = {a->min.x, a->min.y, a->max.x, a->max.y}, fieldsB[4] = {b->min.x, b->min.y, b->max.x, b->max.y};
+	for(int i = 0; i < 4; ++i) if(fieldsA[i] != fieldsB[i]) return (fieldsA[i] < fieldsB[i]) ? -1 : 1;
+	if(a->kind != b->kind) return (a->kind < b->kind) ? -1 : 1;
+	return (a->player > b->player) - (a->player < b->player);
+
+}
@@ -0,0 +1,82 @@
+/*
+   CPong
+   Arena layouts: static rectangular obstacles inside the playfield.
+
+   A layout adds any number of axis aligned rectangles to the field of a
+   match. Walls bounce the ball like the top and bottom walls, bumpers
+   bounce it back a quarter faster and goals score a point for their
+   player like the goal lines. The field's own walls, goal lines and
+   paddles stay as they are; paddles pass through obstacles, so layouts
+   keep the paddle lanes clear.
+
+   The ball is swept against the obstacles through a bounding volume
+   hierarchy built once when the layout is created. Obstacles are sorted
+   into a binary tree of boxes, split at the median of the longer axis
+   until a few are left in each leaf. A sweep visits nearer boxes first
+   and skips every box the ball cannot reach before the earliest hit
+   found so far, so its cost grows with the depth of the tree, the log
+   of the obstacle count, rather than with the count itself.
+
+   Layout files have one obstacle per line, in playfield units:
+
+   wall <x> <y> <width> <height>
+   bumper <x> <y> <width> <height>
+   goal <1|2> <x> <y> <width> <height>
+
+   Blank lines and lines starting with '#' are skipped.
+*/
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+
+#include "pong.h"
+
+/* Layout property definitions */
+#define LAYOUT_MAX_OBSTACLES 1000000
+#define LAYOUT_LEAF_SIZE 4			/* Most obstacles in a leaf of the tree */
+#define LAYOUT_BUMPER_BOOST 1.25f		/* Speed factor of a bounce off a bumper */
+
+/* Obstacle kinds */
+typedef enum {OBSTACLE_WALL, OBSTACLE_BUMPER, OBSTACLE_GOAL} ObstacleKind;
+
+/* Define the 'Obstacle' struct, a solid rectangle from 'min' to 'max' */
+typedef struct Obstacle{
+
+	Point min;
+	Point max;
+	ObstacleKind kind;
+	int player;				/* Player a goal scores for, 0 for other kinds */
+
+} Obstacle;
+
+/* Define the 'LayoutNode' struct, one box of the tree. An inner node has its first child right after it and its
+   second child at 'first'; a leaf holds 'count' obstacles from index 'first'. */
+typedef struct LayoutNode{
+
+	Point min;
+	Point max;
+	int first;
+	int count;				/* 0 for an inner node */
+
+} LayoutNode;
+
+/* Define the 'Layout' struct declared in pong.h. Obstacles are stored in tree order, not in the order given. */
+struct Layout{
+
+	Obstacle *obstacles;
+	size_t count;
+	LayoutNode *nodes;
+	size_t nodeCount;
+	int depth;				/* Levels of the tree */
+
+};
+
+/* Layout function declarations. Functions returning int return nonzero on success. */
+int Layout_create(Layout *layout, const Obstacle *obstacles, size_t count);
+int Layout_load(Layout *layout, const char *path);
+void Layout_destroy(Layout *layout);
+int Layout_sweep(const Layout *layout, const Ball *ball, Scalar limit, Scalar *time, Side *side);
+
+#endif
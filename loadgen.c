@@ -0,0 +1,420 @@
+/*
+   CPong
+   Load generator for the match server. Connects the given number of bot
+   clients to a running pongd, plays every match with a bot controller
+   and reports what the clients saw, so a machine can be sized for a
+   number of concurrent players.
+
+   Usage: loadgen [-host <host>] [-port <port>] [-clients <count>]
+                  [-threads <count>] [-seconds <count>] [-warmup <count>]
+                  [-bot <controller>]
+
+   Each client has its own UDP socket. The sockets are spread over the
+   client threads, which wait on them with epoll and answer every state
+   with the bot's input for the next tick. Measurements start after the
+   warmup, once the clients had time to join:
+
+   - input latency, from sending an input to receiving the first state
+     of a tick that applied it. It includes the wait for the next tick,
+     so it lies between the round trip time and one tick more.
+   - state lateness, how much later than the earliest seen phase of the
+     server's tick schedule each state arrived.
+   - states lost, from gaps in the tick numbers, and the server's tick
+     deadline misses, from the counter carried in every state.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Platform includes */
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Local includes */
+#include "pong.h"
+#include "bot.h"
+#include "netplay.h"
+#include "pool.h"
+#include "server.h"
+#include "timer.h"
+
+/* Load generator property definitions */
+#define LATENCY_BUCKET_NANOS 10000ull		/* 10 us */
+#define LATENCY_BUCKETS 20000			/* Up to 200 ms; slower samples land in the last bucket */
+#define JOIN_RETRY_NANOS 250000000ull
+#define SILENCE_NANOS 2000000000ull		/* A playing client that hears nothing for this long joins again */
+#define HOUSEKEEPING_NANOS 50000000ull
+#define POLL_EVENTS 256
+#define TICK_NANOS (1000000000ull / TICK_RATE)
+
+/* Define the 'Histogram' struct of nanosecond samples */
+typedef struct Histogram{
+
+	unsigned long long buckets[LATENCY_BUCKETS];
+	unsigned long long count;
+	unsigned long long max;
+
+} Histogram;
+
+/* Define the 'BotClient' struct, one connection to the server */
+typedef struct BotClient{
+
+	int socket;
+	int playing;
+	int player;
+	unsigned int sequence;
+	unsigned int lastTick;
+	unsigned long long lastJoin;
+	unsigned long long lastState;
+	unsigned long long lastEcho;
+	long long phase;			/* Earliest arrival time minus tick time seen */
+	ControllerState state;
+
+} BotClient;
+
+/* Define the 'LoadTest' struct shared by every client thread */
+typedef struct LoadTest{
+
+	const Controller *controller;
+	unsigned long long measureFrom;
+	unsigned long long end;
+
+} LoadTest;
+
+/* Define the 'ClientThread' struct. Each thread only writes its own results. */
+typedef struct ClientThread{
+
+	const LoadTest *test;
+	BotClient *clients;
+	int count;
+	int epoll;
+	pthread_t thread;
+
+	/* Results */
+	unsigned long long states;
+	unsigned long long lostStates;
+	unsigned long long joins;
+	unsigned long long leaves;
+	unsigned int missedFirst;
+	unsigned int missedLast;
+	int missedSeen;
+	Histogram latency;
+	Histogram lateness;
+
+} ClientThread;
+
+/* Function declarations */
+void *ClientThread_main(void *arg);
+void ClientThread_handle(ClientThread *thread, BotClient *client, const unsigned char *packet, size_t size, unsigned long long now);
+void Histogram_add(Histogram *histogram, unsigned long long nanos);
+void Histogram_merge(Histogram *into, const Histogram *from);
+double Histogram_getPercentile(const Histogram *histogram, double percentile);
+void printHistogram(const char *name, const Histogram *histogram);
+
+/* Program entrypoint */
+int main(int argc, char **argv){
+
+	const char *host = "127.0.0.1", *botName = "predictor-medium";
+	unsigned short port = SERVER_DEFAULT_PORT;
+	int clientCount = 1000, threadCount = Pool_getCpuCount();
+	double seconds = 10.0, warmup = 2.0;
+
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "-host") == 0 && i + 1 < argc) host = argv[++i];
+		else if(strcmp(argv[i], "-port") == 0 && i + 1 < argc) port = (unsigned short)atoi(argv[++i]);
+		else if(strcmp(argv[i], "-clients") == 0 && i + 1 < argc) clientCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) threadCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-seconds") == 0 && i + 1 < argc) seconds = atof(argv[++i]);
+		else if(strcmp(argv[i], "-warmup") == 0 && i + 1 < argc) warmup = atof(argv[++i]);
+		else if(strcmp(argv[i], "-bot") == 0 && i + 1 < argc) botName = argv[++i];
+		else{
+			fprintf(stderr, "Usage: %s [-host name] [-port n] [-clients n] [-threads n] [-seconds n] [-warmup n] [-bot name]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	LoadTest test;
+	test.controller = Controller_find(botName);
+	if(!test.controller){
+		fprintf(stderr, "Unknown controller %s\n", botName);
+		return EXIT_FAILURE;
+	}
+	if(clientCount < 1 || threadCount < 1 || seconds <= 0.0){
+		fprintf(stderr, "Needs at least one client, one thread and a positive duration\n");
+		return EXIT_FAILURE;
+	}
+	threadCount = MIN(threadCount, clientCount);
+
+	struct addrinfo hints, *result;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if(getaddrinfo(host, NULL, &hints, &result) != 0){
+		fprintf(stderr, "Unknown host %s\n", host);
+		return EXIT_FAILURE;
+	}
+	struct sockaddr_in server = *(struct sockaddr_in*)result->ai_addr;
+	server.sin_port = htons(port);
+	freeaddrinfo(result);
+
+	/* Every client needs a descriptor of its own */
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max){
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	BotClient *clients = calloc((size_t)clientCount, sizeof(BotClient));
+	ClientThread *threads = calloc((size_t)threadCount, sizeof(ClientThread));
+	if(!clients || !threads){
+		fprintf(stderr, "Out of memory\n");
+		free(clients);
+		free(threads);
+		return EXIT_FAILURE;
+	}
+
+	int ok = 1, opened = 0;
+	for(int t = 0; t < threadCount; ++t) threads[t].epoll = -1;
+	for(int t = 0; t < threadCount && ok; ++t){
+		ClientThread *thread = &threads[t];
+		int first = (int)((long long)clientCount * t / threadCount);
+		thread->test = &test;
+		thread->clients = clients + first;
+		thread->count = (int)((long long)clientCount * (t + 1) / threadCount) - first;
+		thread->epoll = epoll_create1(0);
+		if(thread->epoll < 0) ok = 0;
+
+		for(int i = 0; i < thread->count && ok; ++i){
+			BotClient *client = &thread->clients[i];
+			client->socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP);
+			if(client->socket < 0 || connect(client->socket, (struct sockaddr*)&server, sizeof(server)) != 0){
+				ok = 0;
+				break;
+			}
+			++opened;
+
+			struct epoll_event event;
+			event.events = EPOLLIN;
+			event.data.ptr = client;
+			epoll_ctl(thread->epoll, EPOLL_CTL_ADD, client->socket, &event);
+		}
+	}
+	if(!ok){
+		fprintf(stderr, "Could only open %d of %d client sockets\n", opened, clientCount);
+		clientCount = opened;
+	}
+
+	unsigned long long start = Timer_now();
+	test.measureFrom = start + (unsigned long long)(warmup * 1e9);
+	test.end = test.measureFrom + (unsigned long long)(seconds * 1e9);
+
+	int started = 0;
+	for(; started < threadCount && threads[started].epoll >= 0; ++started)
+		if(pthread_create(&threads[started].thread, NULL, ClientThread_main, &threads[started]) != 0) break;
+	for(int t = 0; t < started; ++t) pthread_join(threads[t].thread, NULL);
+
+	/* Combine the results of every thread */
+	static Histogram latency, lateness;
+	unsigned long long states = 0, lost = 0, joins = 0, leaves = 0;
+	unsigned int missedFirst = 0, missedLast = 0;
+	int playing = 0, missedSeen = 0;
+	for(int t = 0; t < threadCount; ++t){
+		ClientThread *thread = &threads[t];
+		states += thread->states;
+		lost += thread->lostStates;
+		joins += thread->joins;
+		leaves += thread->leaves;
+		Histogram_merge(&latency, &thread->latency);
+		Histogram_merge(&lateness, &thread->lateness);
+		if(thread->missedSeen){
+			missedFirst = missedSeen ? MIN(missedFirst, thread->missedFirst) : thread->missedFirst;
+			missedLast = MAX(missedLast, thread->missedLast);
+			missedSeen = 1;
+		}
+		for(int i = 0; i < thread->count; ++i){
+			playing += thread->clients[i].playing;
+			if(thread->clients[i].socket > 0) close(thread->clients[i].socket);
+		}
+		if(thread->epoll >= 0) close(thread->epoll);
+	}
+
+	fprintf(stdout, "%d clients on %d threads, %s bots, %.1f s measured after %.1f s warmup\n",
+		clientCount, started, test.controller->name, seconds, warmup);
+	fprintf(stdout, "%d playing at the end, %llu joins, %llu leaves\n", playing, joins, leaves);
+	fprintf(stdout, "%llu states received, %llu lost (%.3f%%)\n", states, lost,
+		states + lost ? 100.0 * (double)lost / (double)(states + lost) : 0.0);
+	fprintf(stdout, "server tick deadlines missed: %u\n\n", missedLast - missedFirst);
+	fprintf(stdout, "%-16s %9s %9s %9s %9s %9s %9s\n", "ms", "mean", "p50", "p90", "p99", "p99.9", "max");
+	printHistogram("input latency", &latency);
+	printHistogram("state lateness", &lateness);
+
+	free(clients);
+	free(threads);
+	return (states > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
+
+/* Client thread entrypoint. Plays the thread's clients until the test ends. */
+void *ClientThread_main(void *arg){
+
+	ClientThread *thread = arg;
+	const LoadTest *test = thread->test;
+	struct epoll_event events[POLL_EVENTS];
+	unsigned long long lastHousekeeping = 0;
+
+	for(;;){
+
+		unsigned long long now = Timer_now();
+		if(now >= test->end) break;
+
+		/* Join, and join again after a leave or a long silence */
+		if(now - lastHousekeeping >= HOUSEKEEPING_NANOS){
+			for(int i = 0; i < thread->count; ++i){
+				BotClient *client = &thread->clients[i];
+				if(client->playing && now - client->lastState > SILENCE_NANOS) client->playing = 0;
+				if(!client->playing && now - client->lastJoin >= JOIN_RETRY_NANOS){
+					unsigned char packet[SERVER_MAX_PACKET];
+					size_t size = ServerPacket_buildJoin(packet, (unsigned int)(client - thread->clients));
+					send(client->socket, packet, size, MSG_DONTWAIT);
+					client->lastJoin = now;
+				}
+			}
+			lastHousekeeping = now;
+		}
+
+		int count = epoll_wait(thread->epoll, events, POLL_EVENTS, 10);
+		for(int i = 0; i < count; ++i){
+			BotClient *client = events[i].data.ptr;
+			unsigned char packet[SERVER_MAX_PACKET];
+			ssize_t size;
+			while((size = recv(client->socket, packet, sizeof(packet), MSG_DONTWAIT)) > 0)
+				ClientThread_handle(thread, client, packet, (size_t)size, Timer_now());
+		}
+
+	}
+
+	return NULL;
+
+}
+
+/* Handles one packet from the server and answers states with the next input */
+void ClientThread_handle(ClientThread *thread, BotClient *client, const unsigned char *packet, size_t size, unsigned long long now){
+
+	const LoadTest *test = thread->test;
+	int type = ServerPacket_getType(packet, size);
+
+	if(type == SERVER_PACKET_WELCOME){
+		int player;
+		unsigned int matchId, seed;
+		if(client->playing || !ServerPacket_readWelcome(packet, size, &player, &matchId, &seed)) return;
+		client->playing = 1;
+		client->player = player;
+		client->sequence = 0;
+		client->lastTick = 0;
+		client->lastState = now;
+		client->lastEcho = 0;
+		client->phase = 0;
+		Controller_reset(test->controller, &client->state, seed ^ (unsigned int)player);
+		++thread->joins;
+		return;
+	}
+
+	if(type == SERVER_PACKET_LEAVE){
+		if(client->playing) ++thread->leaves;
+		client->playing = 0;
+		client->lastJoin = 0;
+		return;
+	}
+
+	ServerState state;
+	if(!client->playing || !ServerPacket_readState(packet, size, &state)) return;
+	if(state.tick <= client->lastTick) return;		/* Reordered or repeated */
+
+	/* The state with the earliest arrival relative to its tick sets the phase of the server's schedule */
+	long long phase = (long long)now - (long long)(state.tick * TICK_NANOS);
+	int firstState = (client->lastTick == 0);
+	if(firstState || phase < client->phase) client->phase = phase;
+
+	if(now >= test->measureFrom){
+		++thread->states;
+		if(!firstState) thread->lostStates += state.tick - client->lastTick - 1;
+		Histogram_add(&thread->lateness, (unsigned long long)(phase - client->phase));
+		if(state.echo != 0 && state.echo != client->lastEcho) Histogram_add(&thread->latency, now - state.echo);
+
+		if(!thread->missedSeen || state.missedTicks < thread->missedFirst) thread->missedFirst = state.missedTicks;
+		thread->missedLast = MAX(thread->missedLast, state.missedTicks);
+		thread->missedSeen = 1;
+	}
+	client->lastTick = state.tick;
+	client->lastState = now;
+	client->lastEcho = state.echo;
+
+	int move = Controller_move(test->controller, &client->state, &state.match, client->player);
+	NetInput input = NET_INPUT_START;
+	if(move < 0) input |= NET_INPUT_UP;
+	if(move > 0) input |= NET_INPUT_DOWN;
+
+	unsigned char reply[SERVER_MAX_PACKET];
+	size_t replySize = ServerPacket_buildInput(reply, input, ++client->sequence, Timer_now());
+	send(client->socket, reply, replySize, MSG_DONTWAIT);
+
+}
+
+/* Adds one sample */
+void Histogram_add(Histogram *histogram, unsigned long long nanos){
+
+	++histogram->buckets[MIN(nanos / LATENCY_BUCKET_NANOS, (unsigned long long)LATENCY_BUCKETS - 1)];
+	++histogram->count;
+	histogram->max = MAX(histogram->max, nanos);
+
+}
+
+/* Adds the samples of another histogram */
+void Histogram_merge(Histogram *into, const Histogram *from){
+
+	for(int i = 0; i < LATENCY_BUCKETS; ++i) into->buckets[i] += from->buckets[i];
+	into->count += from->count;
+	into->max = MAX(into->max, from->max);
+
+}
+
+/* Returns the upper edge of the bucket holding the given percentile, in seconds */
+double Histogram_getPercentile(const Histogram *histogram, double percentile){
+
+	unsigned long long rank = (unsigned long long)((double)(histogram->count - 1) * percentile / 100.0), seen = 0;
+	for(int i = 0; i < LATENCY_BUCKETS; ++i){
+		seen += histogram->buckets[i];
+		if(seen > rank) return Timer_toSeconds(MIN((i + 1) * LATENCY_BUCKET_NANOS, histogram->max));
+	}
+	return Timer_toSeconds(histogram->max);
+
+}
+
+/* Prints one row of the latency table in milliseconds */
+void printHistogram(const char *name, const Histogram *histogram){
+
+	if(histogram->count == 0){
+		fprintf(stdout, "%-16s %9s\n", name, "no samples");
+		return;
+	}
+
+	/* The mean is taken from the bucket centres */
+	double sum = 0.0;
+	for(int i = 0; i < LATENCY_BUCKETS; ++i) sum += (double)histogram->buckets[i] * ((double)i + 0.5) * LATENCY_BUCKET_NANOS;
+	fprintf(stdout, "%-16s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", name, sum / (double)histogram->count * 1e-6,
+		Histogram_getPercentile(histogram, 50.0) * 1e3, Histogram_getPercentile(histogram, 90.0) * 1e3,
+		Histogram_getPercentile(histogram, 99.0) * 1e3, Histogram_getPercentile(histogram, 99.9) * 1e3,
+		Timer_toSeconds(histogram->max) * 1e3);
+
+}
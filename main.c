@@ -3,682 +3,1023 @@
    A simple two-player pong styled game written in SFML with the
    C language. Features a nice collision detection solution.
 
+   The game runs on three threads. The main thread only reads window
+   events, as SFML requires, and queues them for the input system. The
+   simulation thread runs the fixed rate ticks on a schedule of its own,
+   reading input, stepping the match and playing sounds, and publishes
+   what the screen shows of the game after each tick through a triple
+   buffer. The render thread takes the newest published state without
+   waiting, draws it and presents it, so a slow display or vsync wait
+   never delays a tick or the input read that goes with it. '-loop
+   serial' runs everything in one loop on the main thread instead, to
+   compare the two.
+
    Benjamin Lanza
    9/20/2018
 */
 
 /* Standard C includes */
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <limits.h>
-#include <math.h>
+#include <string.h>
 #include <time.h>
 
 /* SFML includes */
 #include <SFML/Audio.h>
 #include <SFML/Graphics.h>
+#include <SFML/System.h>
+
+/* Local includes */
+#include "pong.h"
+#include "audio.h"
+#include "balls.h"
+#include "bot.h"
+#include "hud.h"
+#include "input.h"
+#include "layout.h"
+#include "mcts.h"
+#include "netplay.h"
+#include "overlay.h"
+#include "profile.h"
+#include "render.h"
+#include "replay.h"
+#include "timer.h"
+#include "triplebuffer.h"
 
 /* Window property definitions */
-#define WINDOW_WIDTH 800
-#define WINDOW_HEIGHT 600
 #define WINDOW_COLOR_DEPTH 32
 
-/* Game object starting position definitions */
-#define P1_START_X 75.0f
-#define P1_START_Y 250.0f
-#define P2_START_X 700.0f
-#define P2_START_Y 250.0f
-#define BALL_START_X 390.0f
-#define BALL_START_Y 290.0f
+/* Longest frame time fed to the simulation, so a long stall does not queue up an unbounded number of ticks */
+#define MAX_FRAME_TIME 0.25
+
+/* Distance the left and right keys jump during replay playback */
+#define REPLAY_SEEK_TICKS (5 * TICK_RATE)
+
+/* Time the main thread sleeps between looks at the window events while the other threads play */
+#define EVENT_POLL_MS 1
+
+/* Tick lateness and frame time histograms, in buckets of 0.1 ms. Longer times land in the last bucket. */
+#define HISTOGRAM_BUCKETS 2500
+#define HISTOGRAM_BUCKET_NS 100000ull
+
+/* Due time of tick 'n' of a schedule started at 'start', without the rounding of a fixed tick length adding up */
+#define TICK_DUE(start, n) ((start) + (n) * 1000000000ull / TICK_RATE)
+
+/* Define the 'Histogram' struct, a distribution of durations in nanoseconds */
+typedef struct Histogram{
+
+	unsigned long long count;
+	unsigned long long max;
+	unsigned long long buckets[HISTOGRAM_BUCKETS];
+
+} Histogram;
+
+/* Define the 'View' struct, a copy of what the screen shows of the game after a tick */
+typedef struct View{
+
+	unsigned long long time;		/* When the tick was due, for blending toward the next one */
+	unsigned long long inputTime;		/* Read time of the earliest input change not yet known to be shown, or 0 */
+	Match previous;
+	Match match;
+	Match *wallPrevious;
+	Match *wall;
+	BallField field;			/* Copy of the field with the view's own ball positions. Only the positions,
+						   paddles and scores are meant to be read. */
+
+} View;
+
+/* Define the 'Shared' struct, what the event, simulation and render threads hand each other */
+typedef struct Shared{
+
+	TripleBuffer views;
+	View slots[3];
+	InputSystem controls;
+	sfMutex *controlsLock;			/* Held around every use of 'controls' and 'title' */
+	atomic_int running;
+	atomic_int waiting;			/* The local match waits for the start input, so events can be waited on */
+	atomic_int seek;			/* Replay ticks to jump, requested by the event loop */
+	atomic_int overlayToggles;		/* F3 presses so far */
+	atomic_int overlayApplied;		/* F3 presses the renderer applied, once their title is published */
+	char title[OVERLAY_TITLE_LENGTH];	/* Newest window title written by the renderer */
+	atomic_uint titles;			/* Titles published so far, for the event loop to set on the window */
+	atomic_uint events;			/* Window events read so far, so the renderer knows to draw again */
+	atomic_ullong shownInput;		/* Input read time of the last frame shown */
+	atomic_ullong inputMark;		/* Time of the last input change not yet marked in the trace, or 0 */
+	atomic_ullong tickTime;			/* Mean time the simulation thread spends in a tick */
+
+} Shared;
+
+/* Define the 'Game' struct, the simulation's state. Only the thread running the ticks uses it. */
+typedef struct Game{
+
+	int spectating, partying, playing, networked, arranged, recording, pacing;
+	const Layout *arena;
+
+	/* Local match, and its state before the last tick */
+	Match match;
+	Match previous;
+	Input input;
+	Input lastInput;
+	unsigned long long pendingInput;	/* Read time of the earliest input change not yet shown, or 0 */
+	const Controller *cpu;
+	ControllerState cpuState;
+	Mcts *search;
+
+	/* Spectator wall */
+	int arenaCount;
+	Match *wall;
+	Match *wallPrevious;
+	ControllerState *wallStates;
+	Input *wallInputs;
+	const Controller *wallP1, *wallP2;
+
+	/* Many-ball mode, replays and network play */
+	BallField field;
+	Replay replay;
+	ReplayCursor cursor;
+	ReplayWriter writer;
+	NetSession session;
+	NetSocket netSocket;
+	NetInput netInput;
+
+	Audio *audio;
+	Histogram lateness;			/* How long after its due time each tick started */
+
+} Game;
+
+/* Define the 'Screen' struct, everything the renderer owns */
+typedef struct Screen{
 
-/* Game object size and speed definitions */
-#define BALL_SIZE 20.0f
-#define PADDLE_WIDTH 25.0f
-#define PADDLE_HEIGHT 100.0f
-#define BALL_SPEED 5.0f
-#define PADDLE_SPEED 8.0f
+	sfRenderWindow *window;
+	ArenaRenderer renderer;
+	FieldRenderer fieldRenderer;
+	LayoutRenderer layoutRenderer;
+	Hud hud;
+	Overlay overlay;
+	int spectating, partying, arranged, pacing;
+	int threaded;				/* Titles are handed to the event loop, which owns the window */
+	int overlayToggles;			/* F3 presses applied */
+	int stall;				/* Milliseconds added to every present, to try the loops with a slow display */
+	unsigned long long hudRebuilds, framesDrawn, framesSkipped;
+	unsigned long long lastPresent;		/* End of the last present if the frame before was drawn, or 0 */
+	Histogram frames;			/* Time between consecutive presents */
+
+} Screen;
+
+/* Define the 'App' struct handed to the threads */
+typedef struct App{
+
+	Game game;
+	Screen screen;
+	Shared shared;
+
+} App;
 
-/* Min and max macros */
-#define MIN(a, b) (((a)<(b))?(a):(b))
-#define MAX(a, b) (((a)>(b))?(a):(b))
+/* Function declarations */
+void runSerial(App *app);
+void runThreaded(App *app);
+void simulate(void *arg);
+void render(void *arg);
+void handleEvent(App *app, const sfEvent *event);
+int Game_readInput(Game *game, Shared *shared, unsigned long long tickEnd);
+Input Game_takeInput(Game *game, Shared *shared, unsigned long long tickEnd);
+void Game_advance(Game *game, Shared *shared);
+void Game_publish(const Game *game, View *view, unsigned long long time);
+int Game_isWaiting(const Game *game);
+int View_create(View *view, const Game *game);
+void View_destroy(View *view);
+int Screen_update(Screen *screen, Shared *shared, const View *view);
+void Screen_showTitle(Screen *screen, Shared *shared);
+int Screen_isIdle(const Screen *screen, const View *view);
+void Screen_draw(Screen *screen, const View *view, float alpha);
+void Screen_present(Screen *screen, Shared *shared, const View *view);
+void Histogram_add(Histogram *histogram, unsigned long long duration);
+double Histogram_getPercentile(const Histogram *histogram, double fraction);
+NetInput toNetInput(Input input);
+void playEvents(Audio *audio, const Match *match);
+void playFieldEvents(Audio *audio, const BallField *field, int lastPoints);
 
-/* Side enum definition used for collision detection */
-typedef enum {TOP, RIGHT, BOTTOM, LEFT} Side;
+/* Program entrypoint */
+int main(int argc, char **argv){
 
-/* Declare 'Point' as an alias to the SFML sfVector2f type */
-typedef sfVector2f Point;
+	/* With its histograms and views the game is too large for the stack */
+	static App app;
+	Game *game = &app.game;
+	Screen *screen = &app.screen;
+	Shared *shared = &app.shared;
+
+	/* Command line options */
+	const char *recordPath = NULL, *playPath = NULL, *peerAddress = NULL, *tracePath = NULL, *cpuName = NULL, *bindingsPath = NULL, *soundPath = NULL, *pacingMode = NULL, *layoutPath = NULL, *loopMode = NULL;
+	int netPlayer = 0, netPort = 0, arenaCount = 0, ballCount = 0, stall = 0;
+	for(int i = 1; i + 1 < argc; ++i){
+		if(strcmp(argv[i], "-record") == 0) recordPath = argv[++i];
+		else if(strcmp(argv[i], "-play") == 0) playPath = argv[++i];
+		else if(strcmp(argv[i], "-trace") == 0) tracePath = argv[++i];
+		else if(strcmp(argv[i], "-arenas") == 0) arenaCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-balls") == 0) ballCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-cpu") == 0) cpuName = argv[++i];
+		else if(strcmp(argv[i], "-bindings") == 0) bindingsPath = argv[++i];
+		else if(strcmp(argv[i], "-sounds") == 0) soundPath = argv[++i];
+		else if(strcmp(argv[i], "-pacing") == 0) pacingMode = argv[++i];
+		else if(strcmp(argv[i], "-layout") == 0) layoutPath = argv[++i];
+		else if(strcmp(argv[i], "-loop") == 0) loopMode = argv[++i];
+		else if(strcmp(argv[i], "-stall") == 0) stall = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-net") == 0 && i + 3 < argc){
+			netPlayer = atoi(argv[++i]);
+			netPort = atoi(argv[++i]);
+			peerAddress = argv[++i];
+		}
+	}
+	int serial = (loopMode && strcmp(loopMode, "serial") == 0);
+
+	/* Computer opponent for player two. "mcts" searches every tick, modelling the player as a tracker. */
+	if(cpuName && strcmp(cpuName, "mcts") == 0){
+		game->search = Mcts_create(0, MCTS_DEFAULT_NODES, Controller_find("tracker"));
+		if(!game->search){
+			fprintf(stderr, "Could not start the search threads\n");
+			return EXIT_FAILURE;
+		}
+	}else if(cpuName){
+		game->cpu = Controller_find(cpuName);
+		if(!game->cpu){
+			fprintf(stderr, "Unknown controller %s\n", cpuName);
+			return EXIT_FAILURE;
+		}
+	}
 
-/* Define a 'Line' struct as two points */
-typedef struct Line{
+	/* Keyboard and gamepad bindings */
+	InputSystem_init(&shared->controls);
+	if(bindingsPath && !InputSystem_loadBindings(&shared->controls, bindingsPath)){
+		fprintf(stderr, "Could not load bindings from %s\n", bindingsPath);
+		return EXIT_FAILURE;
+	}
+	shared->controlsLock = sfMutex_create();
+	if(!shared->controlsLock) return EXIT_FAILURE;
+
+	/* Arena layout for the local match. Replays and network play only carry inputs, so both play on the plain field. */
+	Layout layout;
+	if(layoutPath){
+		if(!Layout_load(&layout, layoutPath)){
+			fprintf(stderr, "Could not load layout from %s\n", layoutPath);
+			return EXIT_FAILURE;
+		}
+		game->arena = &layout;
+	}
 
-	Point a;
-	Point b;
+	/* Engine setup */
+	unsigned int seed = (unsigned int)time(NULL);
+	sfVideoMode mode = {WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_COLOR_DEPTH};
+	sfRenderWindow *window;
 
-} Line;
+	/* Create the window */
+	window = sfRenderWindow_create(mode, "CPong", sfClose, NULL);
+	if(!window) return EXIT_FAILURE;
+	sfRenderWindow_setVerticalSyncEnabled(window, sfTrue);
+	screen->window = window;
+
+	/* The match keeps track of paddle and ball position, points, speed and game state.
+	   The state before the last tick is kept to interpolate between the two when rendering. */
+	Match_init(&game->match, seed);
+	if(game->cpu) Controller_reset(game->cpu, &game->cpuState, seed);
+
+	/* Network play setup. The peer is given as host:port. */
+	if(peerAddress){
+		char host[256];
+		const char *colon = strrchr(peerAddress, ':');
+		size_t hostLength = colon ? (size_t)(colon - peerAddress) : 0;
+		if((netPlayer != 1 && netPlayer != 2) || !colon || hostLength >= sizeof(host)){
+			fprintf(stderr, "Usage: -net <1|2> <local port> <peer host:port>\n");
+			sfRenderWindow_destroy(window);
+			return EXIT_FAILURE;
+		}
+		memcpy(host, peerAddress, hostLength);
+		host[hostLength] = '\0';
+		if(!NetSocket_open(&game->netSocket, (unsigned short)netPort, host, (unsigned short)atoi(colon + 1))){
+			fprintf(stderr, "Could not open a connection to %s\n", peerAddress);
+			sfRenderWindow_destroy(window);
+			return EXIT_FAILURE;
+		}
+		NetSession_init(&game->session, netPlayer, seed);
+		game->match = game->session.match;
+		game->networked = 1;
+	}
 
-/* Define the 'Ball' struct */
-typedef struct Ball{
+	/* Replay recording and playback setup. Network play is not recorded, its inputs are not final when ticked. */
+	if(recordPath && game->arena) fprintf(stderr, "Matches played in a layout are not recorded\n");
+	else if(recordPath && !game->networked){
+		game->recording = ReplayWriter_open(&game->writer, recordPath, seed, REPLAY_KEYFRAME_INTERVAL);
+		if(!game->recording) fprintf(stderr, "Could not create replay file %s\n", recordPath);
+	}
 
-	Point position;
-	Point speed;
+	if(playPath && !game->networked){
+		if(!Replay_open(&game->replay, playPath) || !Replay_seek(&game->replay, &game->cursor, 0)){
+			fprintf(stderr, "Could not open replay file %s\n", playPath);
+			sfRenderWindow_destroy(window);
+			return EXIT_FAILURE;
+		}
+		game->match = game->cursor.match;
+		game->playing = 1;
+	}
+	game->previous = game->match;
+
+	/* Spectator wall setup: bot matches in a grid, each with its own seed */
+	game->wallP1 = Controller_find("tracker");
+	game->wallP2 = Controller_find("jitter");
+	game->spectating = (arenaCount > 0 && !game->networked && !game->playing);
+	if(game->spectating){
+		game->arenaCount = arenaCount;
+		game->wall = malloc(sizeof(Match) * (size_t)arenaCount);
+		game->wallPrevious = malloc(sizeof(Match) * (size_t)arenaCount);
+		game->wallStates = malloc(sizeof(ControllerState) * 2 * (size_t)arenaCount);
+		game->wallInputs = malloc(sizeof(Input) * (size_t)arenaCount);
+		if(!game->wall || !game->wallPrevious || !game->wallStates || !game->wallInputs){
+			fprintf(stderr, "Could not create %d arenas\n", arenaCount);
+			sfRenderWindow_destroy(window);
+			return EXIT_FAILURE;
+		}
+		for(int i = 0; i < arenaCount; ++i){
+			Match_init(&game->wall[i], seed + (unsigned int)i);
+			Controller_reset(game->wallP1, &game->wallStates[2 * i], seed + (unsigned int)i);
+			Controller_reset(game->wallP2, &game->wallStates[2 * i + 1], ~(seed + (unsigned int)i));
+			game->wallPrevious[i] = game->wall[i];
+		}
+	}
 
-} Ball;
+	/* Many-ball party mode, both players on the keyboard */
+	game->partying = (ballCount > 0 && !game->spectating && !game->networked && !game->playing);
+	if(game->partying){
+		if(!BallField_create(&game->field, (size_t)ballCount, BallField_getDefaultSize((size_t)ballCount), seed) ||
+			!FieldRenderer_create(&screen->fieldRenderer, (size_t)ballCount)){
+			fprintf(stderr, "Could not create %d balls\n", ballCount);
+			sfRenderWindow_destroy(window);
+			return EXIT_FAILURE;
+		}
+	}
 
-/* Define the 'Paddle' struct */
-typedef struct Paddle{
+	/* Every arena on screen is drawn from one vertex array */
+	if(!ArenaRenderer_create(&screen->renderer, game->spectating ? (size_t)arenaCount : 1, WINDOW_WIDTH, WINDOW_HEIGHT)){
+		sfRenderWindow_destroy(window);
+		return EXIT_FAILURE;
+	}
 
-	Point position;
-	int score;
+	/* Obstacles never move, so they are drawn from a vertex array written once */
+	game->arranged = (game->arena && !game->spectating && !game->partying && !game->networked && !game->playing);
+	if(game->arranged && !LayoutRenderer_create(&screen->layoutRenderer, game->arena)){
+		ArenaRenderer_destroy(&screen->renderer);
+		sfRenderWindow_destroy(window);
+		return EXIT_FAILURE;
+	}
 
-} Paddle;
+	/* Score and status text over every arena */
+	if(!Hud_create(&screen->hud, &screen->renderer)){
+		ArenaRenderer_destroy(&screen->renderer);
+		sfRenderWindow_destroy(window);
+		return EXIT_FAILURE;
+	}
 
-/* Define the 'Collision' struct used to store collision detection return information */
-typedef struct Collision{
+	/* Frame timing overlay, toggled with F3, and trace output. With split threads the frames timed are the render
+	   thread's, which only draw and present. */
+	if(!Overlay_create(&screen->overlay)){
+		sfRenderWindow_destroy(window);
+		return EXIT_FAILURE;
+	}
+	if(tracePath && !Profile_openTrace(tracePath)) fprintf(stderr, "Could not create trace file %s\n", tracePath);
 
-	int collides;
-	Point position;
-	Side side;
+	/* Sound effects, synthesized unless a directory is given. The wall of bot matches stays silent. */
+	int muted = (soundPath && strcmp(soundPath, "off") == 0);
+	if(!muted && !game->spectating){
+		game->audio = Audio_create(soundPath);
+		if(!game->audio) fprintf(stderr, "Could not start audio, playing without sound\n");
+	}
 
-} Collision;
+	/* Idle pacing. While the local match waits for the start input or counts down, nothing on screen moves:
+	   events are waited on at the start prompt, and only frames whose contents changed are presented. */
+	game->pacing = !(pacingMode && strcmp(pacingMode, "off") == 0) && !game->spectating && !game->partying && !game->networked && !game->playing;
+	screen->spectating = game->spectating;
+	screen->partying = game->partying;
+	screen->arranged = game->arranged;
+	screen->pacing = game->pacing;
+	screen->threaded = !serial;
+	screen->stall = MAX(stall, 0);
+
+	/* Every view starts as the first state, as the renderer may draw one before the first tick */
+	unsigned long long startTime = Timer_now(), startCpuTime = Timer_getCpuTime();
+	TripleBuffer_init(&shared->views);
+	for(int i = 0; i < 3; ++i){
+		if(!View_create(&shared->slots[i], game)){
+			fprintf(stderr, "Out of memory\n");
+			sfRenderWindow_destroy(window);
+			return EXIT_FAILURE;
+		}
+		Game_publish(game, &shared->slots[i], startTime);
+	}
+	atomic_init(&shared->running, 1);
+	atomic_init(&shared->waiting, 0);
+	atomic_init(&shared->seek, 0);
+	atomic_init(&shared->overlayToggles, 0);
+	atomic_init(&shared->overlayApplied, 0);
+	atomic_init(&shared->titles, 0u);
+	atomic_init(&shared->events, 0u);
+	atomic_init(&shared->shownInput, 0ull);
+	atomic_init(&shared->inputMark, 0ull);
+	atomic_init(&shared->tickTime, 0ull);
 
-/* Function declarations */
-float Point_getDistance(Point a, Point b);
-Point Ball_getVertex(const Ball *ball, int vertex);
-Line Ball_getSide(const Ball *ball, Side side);
-float Ball_getBound(const Ball *ball, Side side);
-Point Paddle_getVertex(const Paddle *paddle, int vertex);
-Line Paddle_getSide(const Paddle *paddle, Side side);
-float Paddle_getBound(const Paddle *paddle, Side side);
-Collision getPaddleCollision(const Ball *ball, const Paddle *paddle, Point *newPosition);
-Collision getWallCollision(const Ball *ball, Point *newPosition);
+	/* Print prompt to console */
+	if(game->spectating) fprintf(stdout, "Watching %d bot matches.\n", arenaCount);
+	else if(game->partying) fprintf(stdout, "Playing with %d balls!\n", ballCount);
+	else if(game->playing) fprintf(stdout, "Playing %u ticks, use left and right to seek.\n", game->replay.tickCount);
+	else if(game->networked) fprintf(stdout, "Playing as player %d, press enter to start the game!\n", netPlayer);
+	else fprintf(stdout, "Press enter to start the game!\n");
+
+	/* Play until the window is closed */
+	if(serial) runSerial(&app);
+	else runThreaded(&app);
+	sfRenderWindow_close(window);
+
+	/* Finish the replay files */
+	if(game->recording && !ReplayWriter_close(&game->writer)) fprintf(stderr, "Could not finish replay file %s\n", recordPath);
+	if(game->playing) Replay_close(&game->replay);
+	if(game->networked) NetSocket_close(&game->netSocket);
+	Profile_closeTrace();
+
+	InputLatency latency;
+	if(InputSystem_getLatency(&shared->controls, &latency))
+		fprintf(stdout, "Input to display latency over %d changes: mean %.1f ms, p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+			latency.count, latency.mean * 1000.0, latency.p50 * 1000.0, latency.p99 * 1000.0, latency.max * 1000.0);
+
+	double seconds = Timer_toSeconds(Timer_now() - startTime);
+	fprintf(stdout, "CPU time: %.1f%% of one core over %.0f s, %llu frames drawn, %llu idle frames skipped\n",
+		100.0 * Timer_toSeconds(Timer_getCpuTime() - startCpuTime) / seconds, seconds, screen->framesDrawn, screen->framesSkipped);
+
+	/* A tick's lateness is how long after its due time it started, which includes any wait for the frame before it */
+	const Histogram *lateness = &game->lateness, *frames = &screen->frames;
+	if(lateness->count > 0)
+		fprintf(stdout, "Tick lateness over %llu ticks (%s loop): p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", lateness->count,
+			serial ? "serial" : "threaded", Histogram_getPercentile(lateness, 0.5) * 1000.0,
+			Histogram_getPercentile(lateness, 0.99) * 1000.0, lateness->max / 1e6);
+	if(frames->count > 0)
+		fprintf(stdout, "Frame time over %llu frames: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", frames->count,
+			Histogram_getPercentile(frames, 0.5) * 1000.0, Histogram_getPercentile(frames, 0.99) * 1000.0, frames->max / 1e6);
+
+	AudioStats sounds;
+	if(game->audio){
+		Audio_getStats(game->audio, &sounds);
+		fprintf(stdout, "Sounds played: %llu, dropped: %llu, voices stolen: %llu\n", sounds.played, sounds.dropped, sounds.stolen);
+	}
 
-/* Program entrypoint */
-int main(int argc, char **argv){
+	/* SFML object cleanup */
+	Audio_destroy(game->audio);
+	ArenaRenderer_destroy(&screen->renderer);
+	if(game->arranged) LayoutRenderer_destroy(&screen->layoutRenderer);
+	if(game->arena) Layout_destroy(&layout);
+	Hud_destroy(&screen->hud);
+	if(game->partying){
+		fprintf(stdout, "Final score: %d to %d\n", game->field.p1.score, game->field.p2.score);
+		FieldRenderer_destroy(&screen->fieldRenderer);
+		BallField_destroy(&game->field);
+	}
+	Overlay_destroy(&screen->overlay);
+	Mcts_destroy(game->search);
+	sfRenderWindow_destroy(window);
+	sfMutex_destroy(shared->controlsLock);
+	for(int i = 0; i < 3; ++i) View_destroy(&shared->slots[i]);
+	free(game->wall);
+	free(game->wallPrevious);
+	free(game->wallStates);
+	free(game->wallInputs);
 
-	/* Engine setup */
-	srand(time(NULL));
-	size_t count;
-	sfVideoMode mode = {WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_COLOR_DEPTH};
-	sfRenderWindow *window;
-	sfEvent event;
+	/* Exit successfully */
+	return EXIT_SUCCESS;
 
-	/* Create the window */
-	window = sfRenderWindow_create(mode, "CPong", sfClose, NULL);
-	if(!window) return EXIT_FAILURE;
-	sfRenderWindow_setVerticalSyncEnabled(window, sfTrue);
-	sfRenderWindow_setFramerateLimit(window, 60);
-
-	/* Game variable setup */
-	int gameState = 0;
-	int gameStarting = 0;
-	time_t sinceStart = time(NULL);
-
-	/* Define paddle and ball structs to keep track of position, points, and speed */
-	Paddle p1 = {{P1_START_X, P1_START_Y}, 0};
-	Paddle p2 = {{P2_START_X, P2_START_Y}, 0};
-	Ball ball = {{BALL_START_X, BALL_START_Y}, {BALL_SPEED, BALL_SPEED}};
-
-	/* Create SFML rectangles to display the objects */
-	sfRectangleShape *p1Rect = sfRectangleShape_create();
-	sfRectangleShape *p2Rect = sfRectangleShape_create();
-	sfRectangleShape *ballRect = sfRectangleShape_create();
-
-	/* Set the default positions */
-	sfRectangleShape_setPosition(p1Rect, p1.position);
-	sfRectangleShape_setPosition(p2Rect, p2.position);
-	sfRectangleShape_setPosition(ballRect, ball.position);
-
-	/* Set the sizes */
-	sfRectangleShape_setSize(p1Rect, (sfVector2f){PADDLE_WIDTH, PADDLE_HEIGHT});
-	sfRectangleShape_setSize(p2Rect, (sfVector2f){PADDLE_WIDTH, PADDLE_HEIGHT});
-	sfRectangleShape_setSize(ballRect, (sfVector2f){BALL_SIZE, BALL_SIZE});
-
-	/* Set the colors */
-	sfRectangleShape_setFillColor(p1Rect, sfRed);
-	sfRectangleShape_setFillColor(p2Rect, sfBlue);
-	sfRectangleShape_setFillColor(ballRect, sfGreen);
+}
 
-	/* Print prompt to console */
-	fprintf(stdout, "Press enter to start the game!\n");
+/* Reads events, ticks, draws and presents in one loop on the main thread, so every part waits for the others */
+void runSerial(App *app){
 
-	/* Loop while the window is open */
-	while(sfRenderWindow_isOpen(window)){
+	Game *game = &app->game;
+	Screen *screen = &app->screen;
+	Shared *shared = &app->shared;
+	View *view = &shared->slots[0];
+	sfEvent event;
 
-		while(sfRenderWindow_pollEvent(window, &event)){
-			if(event.type == sfEvtClosed) sfRenderWindow_close(window);
+	/* Fixed timestep variables */
+	unsigned long long lastTime = Timer_now();
+	double accumulator = 0.0;
+	int idle = 0, dirty = 1;
+
+	while(atomic_load(&shared->running)){
+
+		PROFILE_FRAME_BEGIN();
+		PROFILE_BEGIN(PHASE_EVENTS);
+		int waiting = idle && Game_isWaiting(game);
+		while(waiting ? sfRenderWindow_waitEvent(screen->window, &event) : sfRenderWindow_pollEvent(screen->window, &event)){
+			if(waiting){
+				/* Only the woken frame's tick runs, the time spent blocked is not caught up */
+				lastTime = Timer_now();
+				accumulator = TICK_TIME;
+				waiting = 0;
+			}
+			dirty = 1;
+			handleEvent(app, &event);
+		}
+		PROFILE_END(PHASE_EVENTS);
+
+		/* Measure the time since the last frame */
+		unsigned long long now = Timer_now();
+		double frameTime = Timer_toSeconds(now - lastTime);
+		lastTime = now;
+		accumulator += (frameTime < MAX_FRAME_TIME) ? frameTime : MAX_FRAME_TIME;
+
+		/* Game logic, run in fixed ticks until the simulation has caught up with the clock. A tick was due when the
+		   clock passed its end, as long ago as the accumulator holds past one tick. */
+		while(accumulator >= TICK_TIME){
+			unsigned long long late = (unsigned long long)((accumulator - TICK_TIME) * 1e9);
+			Histogram_add(&game->lateness, late);
+			PROFILE_BEGIN(PHASE_INPUT);
+			int changed = Game_readInput(game, shared, now - late);
+			PROFILE_END(PHASE_INPUT);
+			if(changed) PROFILE_MARK("input");
+			PROFILE_BEGIN(PHASE_SIMULATION);
+			Game_advance(game, shared);
+			PROFILE_END(PHASE_SIMULATION);
+			accumulator -= TICK_TIME;
 		}
+		Game_publish(game, view, now);
+
+		/* Text only changes when the HUD lays a line out again, so an idle frame without that or an event is skipped */
+		dirty |= Screen_update(screen, shared, view);
+		idle = Screen_isIdle(screen, view);
+		if(idle && !dirty){
+			++screen->framesSkipped;
+			screen->lastPresent = 0;
+			PROFILE_FRAME_END();
+			sfSleep(sfSeconds((float)MAX(TICK_TIME - accumulator, 0.001)));
+			continue;
+		}
+		dirty = 0;
 
-		/* Game logic */
-		if(gameState == 0){			/* Startup state */
-			
-			if(gameStarting){
-
-				if(time(NULL) - sinceStart >= 3){
-			
-					/* Set object positions and generate random ball speed and direction */
-					ball.position = (sfVector2f){BALL_START_X, BALL_START_Y};
-					ball.speed = (sfVector2f){BALL_SPEED, 3.0f};
-					if(rand() % 2) ball.speed.x *= -1.0f;
-					ball.speed.y *= ((float)rand() / (float)RAND_MAX) * ((rand() % 2) ? -1.0f : 1.0f) + 0.1f;
-					p1.position = (sfVector2f){P1_START_X, P1_START_Y};
-					p2.position = (sfVector2f){P2_START_X, P2_START_Y};
-					sfRectangleShape_setPosition(p1Rect, p1.position);
-					sfRectangleShape_setPosition(p2Rect, p2.position);
-					p1.score = 0; p2.score = 0;
-					gameStarting = 0;
-					++gameState;
-
-				}
-
-			/* Wait for the user to press the return key to start the match */
-			}else if(sfKeyboard_isKeyPressed(sfKeyReturn)){
-
-				gameStarting = 1;
-				sinceStart = time(NULL);
-				fprintf(stdout, "Starting the game in 3 seconds...\n");
+		/* Blend the objects between the last two ticks */
+		PROFILE_BEGIN(PHASE_DRAW);
+		Screen_draw(screen, view, (float)(accumulator / TICK_TIME));
+		PROFILE_END(PHASE_DRAW);
+		PROFILE_BEGIN(PHASE_DISPLAY);
+		Screen_present(screen, shared, view);
+		PROFILE_END(PHASE_DISPLAY);
+		PROFILE_FRAME_END();
 
-			}
-		
-		}else if(gameState == 1){		/* Round loop state */
-
-			/* Stores direction of player paddles and ball for later collision detection */
-			int p1Dir = 0, p2Dir = 0;
-			int ballXDir = (ball.speed.x >= 0) ? 1 : 0;
-			int ballYDir = (ball.speed.y >= 0) ? 1 : 0;
-
-			/* Check movement controls and update paddle positions */
-			if(sfKeyboard_isKeyPressed(sfKeyW)){		/* W key pressed */
-				float newY = p1.position.y - PADDLE_SPEED;
-				newY = (newY > 0) ? newY : 0;
-				p1.position.y = newY;
-				sfRectangleShape_setPosition(p1Rect, p1.position);
-				p1Dir -= 1;
-			}
+	}
 
-			if(sfKeyboard_isKeyPressed(sfKeyS)){		/* S key pressed */
-				float newY = p1.position.y + PADDLE_SPEED;
-				newY = (newY < WINDOW_HEIGHT - PADDLE_HEIGHT) ? newY : WINDOW_HEIGHT - PADDLE_HEIGHT;
-				p1.position.y = newY;
-				sfRectangleShape_setPosition(p1Rect, p1.position);	
-				p1Dir += 1;	
-			}
-		
-			if(sfKeyboard_isKeyPressed(sfKeyUp)){		/* Up key pressed */
-				float newY = p2.position.y - PADDLE_SPEED;
-				newY = (newY > 0) ? newY : 0;
-				p2.position.y = newY;
-				sfRectangleShape_setPosition(p2Rect, p2.position);
-				p2Dir -= 1;	
-			}
+}
 
-			if(sfKeyboard_isKeyPressed(sfKeyDown)){		/* Down key pressed */
-				float newY = p2.position.y + PADDLE_SPEED;
-				newY = (newY < WINDOW_HEIGHT - PADDLE_HEIGHT) ? newY : WINDOW_HEIGHT - PADDLE_HEIGHT;
-				p2.position.y = newY;
-				sfRectangleShape_setPosition(p2Rect, p2.position);
-				p2Dir += 1;	
-			}
+/* Starts the simulation and render threads and reads window events on this one until the window is closed */
+void runThreaded(App *app){
 
-			/* Get sfFloatRect objects for checking ball-paddle intersections */
-			sfFloatRect p1FRect = sfRectangleShape_getGlobalBounds(p1Rect);
-			sfFloatRect p2FRect = sfRectangleShape_getGlobalBounds(p2Rect);
-			sfFloatRect ballFRect = sfRectangleShape_getGlobalBounds(ballRect);
+	Shared *shared = &app->shared;
+	sfRenderWindow *window = app->screen.window;
+	sfEvent event;
 
-			sfRectangleShape *pRect;
-			sfFloatRect *pFRect;
-			int *pDir;
+	/* The render thread takes over the window's drawing context */
+	sfRenderWindow_setActive(window, sfFalse);
+	sfThread *simulation = sfThread_create(simulate, app), *renderer = sfThread_create(render, app);
+	if(!simulation || !renderer){
+		fprintf(stderr, "Could not start the game threads\n");
+		if(simulation) sfThread_destroy(simulation);
+		if(renderer) sfThread_destroy(renderer);
+		sfRenderWindow_setActive(window, sfTrue);
+		return;
+	}
+	sfThread_launch(simulation);
+	sfThread_launch(renderer);
+
+	/* Events are polled often so their read times stay close to when they happened. At the start prompt the
+	   thread blocks until one arrives instead, unless the renderer still has an overlay toggle or a title for it.
+	   SFML only allows window calls from the thread that created the window, so the renderer's titles are set here. */
+	unsigned int shownTitles = 0;
+	while(atomic_load(&shared->running)){
+		unsigned int titles = atomic_load(&shared->titles);
+		if(titles != shownTitles){
+			sfMutex_lock(shared->controlsLock);
+			sfRenderWindow_setTitle(window, shared->title);
+			sfMutex_unlock(shared->controlsLock);
+			shownTitles = titles;
+		}
 
-			/* Check if the ball intersects a paddle after paddle movement */ 
-			if(ballXDir == 1){ pRect = p2Rect; pFRect = &p2FRect; pDir = &p2Dir; }
-			else{ pRect = p1Rect; pFRect = &p1FRect; pDir = &p1Dir; }
+		int toggles = atomic_load(&shared->overlayToggles);
+		if(atomic_load(&shared->waiting) && toggles % 2 == 0 && atomic_load(&shared->overlayApplied) == toggles &&
+			atomic_load(&shared->titles) == shownTitles){
+			if(sfRenderWindow_waitEvent(window, &event)) handleEvent(app, &event);
+		}else{
+			while(sfRenderWindow_pollEvent(window, &event)) handleEvent(app, &event);
+			sfSleep(sfMilliseconds(EVENT_POLL_MS));
+		}
+	}
 
-			if(sfFloatRect_intersects(pFRect, &ballFRect, NULL)){
+	sfThread_wait(renderer);
+	sfThread_wait(simulation);
+	sfThread_destroy(renderer);
+	sfThread_destroy(simulation);
+	sfRenderWindow_setActive(window, sfTrue);
 
-				if(*pDir != 0){
-					ball.speed.y = abs(ball.speed.y) * (float)*pDir;
-					ball.speed.y += (*pDir == 1) ? PADDLE_SPEED : 0.0f - PADDLE_SPEED;
-				}
+}
 
-			}
-		
-			/* Set up variables for line segment ball-paddle collision detection */
-			Point ballNextA = {0.0f, 0.0f};
-			Collision paddleCol;
-			if(ball.speed.x >= 0) paddleCol = getPaddleCollision(&ball, &p2, &ballNextA);
-			else paddleCol = getPaddleCollision(&ball, &p1, &ballNextA);
-
-			/* Set up variables for line segment ball-wall collision detection */
-			Point ballNextB = {0.0f, 0.0f};
-			Collision wallCol = getWallCollision(&ball, &ballNextB);
-
-			/* Check outcomes of ball-paddle collision tests and set ball speed and position accordingly */
-			if(paddleCol.collides){
-				ball.position = ballNextA;
-				if(paddleCol.side == LEFT){
-					ball.speed.x = ball.speed.x * -1.0f - 0.5f;
-					ball.speed.y += (ballNextA.y + (0.5f * BALL_SIZE) - (p2.position.y + (0.5f * PADDLE_HEIGHT))) / 5.0f;
-				}else if(paddleCol.side == RIGHT){
-					ball.speed.x = ball.speed.x * -1.0f + 0.5f;
-					ball.speed.y += (ballNextA.y + (0.5f * BALL_SIZE) - (p1.position.y + (0.5f * PADDLE_HEIGHT))) / 5.0f; 
-				}
-				else ball.speed.y *= -1.0f;
-				if(ball.speed.y >= MAX(ball.speed.x * 3.0f, ball.speed.x * -3.0f))
-					ball.speed.y = MAX(ball.speed.x * 3.0f, ball.speed.x * -3.0f);
-				else if(ball.speed.y <= MIN(ball.speed.x * 3.0f, ball.speed.x * -3.0f))
-					ball.speed.y = MIN(ball.speed.x * 3.0f, ball.speed.x * -3.0f);
-
-			/* Check outcomes of ball-wall collision tests and set ball speed and position accordingly */
-			}else if(wallCol.collides){
-				if(wallCol.side == TOP || wallCol.side == BOTTOM){
-					ball.speed.y *= -1.0f;
-				}else if(wallCol.side == LEFT){
-					++p2.score; ++gameState;
-					fprintf(stdout, "Score is: %d to %d\n", p1.score, p2.score);
-				}else if(wallCol.side == RIGHT){
-					++p1.score; ++gameState;
-					fprintf(stdout, "Score is: %d to %d\n", p1.score, p2.score);
-				}
-		
-			/* If no collisions occured, update the balls position according to its unobstructed trajectory */
-			}else{
-				ball.position.x += ball.speed.x; ball.position.y += ball.speed.y;
-			}
+/* Simulation thread: runs each tick at its due time and publishes the result. Ticks that fall behind run back to back
+   to catch up, up to the same limit as the serial loop, past which the schedule starts again from now. */
+void simulate(void *arg){
 
-			/* Double check if the ball is out of bounds to handle an edge case */
-			if(ball.position.y <= 0.0f) ball.position.y = 0.1f;
-			else if(ball.position.y >= WINDOW_HEIGHT) ball.position.y = WINDOW_HEIGHT - BALL_SIZE - 0.1f;
-			sfRectangleShape_setPosition(ballRect, ball.position);
-			
-		}else if(gameState == 2){			/* New round state */ 
-			
-			if(gameStarting){
-
-				if(time(NULL) - sinceStart >= 1){
-					
-					/* Set object positions and generate random ball speed and direction */
-					ball.position = (sfVector2f){BALL_START_X, BALL_START_Y};
-					ball.speed = (sfVector2f){BALL_SPEED, 3.0f};
-					if(rand() % 2) ball.speed.x *= -1.0f;
-					ball.speed.y *= ((float)rand() / (float)RAND_MAX) * ((rand() % 2) ? -1.0f : 1.0f) + 0.1f;
-					p1.position = (sfVector2f){P1_START_X, P1_START_Y};
-					p2.position = (sfVector2f){P2_START_X, P2_START_Y};
-					sfRectangleShape_setPosition(p1Rect, p1.position);
-					sfRectangleShape_setPosition(p2Rect, p2.position);
-					gameStarting = 0;
-					--gameState;
-
-				}
-
-			}else if(p1.score >= 9 || p2.score >= 9){
-				fprintf(stdout, "Player %d wins!\n", (MAX(p1.score, p2.score) == p1.score) ? 1 : 2);
-				gameState = 0;
-			}else{
-				sinceStart = time(NULL);
-				gameStarting = 1;
-			}
+	App *app = arg;
+	Game *game = &app->game;
+	Shared *shared = &app->shared;
+	unsigned long long start = Timer_now(), ticks = 0;
+	double tickTime = 0.0;
 
+	while(atomic_load(&shared->running)){
+
+		unsigned long long due = TICK_DUE(start, ticks + 1), now = Timer_now();
+		if(now < due){
+			sfSleep(sfMicroseconds((sfInt64)((due - now) / 1000)));
+			continue;
+		}
+		if(Timer_toSeconds(now - due) > MAX_FRAME_TIME){
+			start = now - TICK_DUE(0ull, 1);
+			ticks = 0;
+			due = now;
 		}
 
+		/* The profiler belongs to the render thread, so input changes and the tick time are handed to it */
+		Histogram_add(&game->lateness, now - due);
+		if(Game_readInput(game, shared, due)) atomic_store(&shared->inputMark, now);
+		Game_advance(game, shared);
+		++ticks;
+		tickTime += ((double)(Timer_now() - now) - tickTime) / TICK_RATE;
+		atomic_store(&shared->tickTime, (unsigned long long)tickTime);
 
-		/* Clear the screen */
-		sfRenderWindow_clear(window, sfWhite);
+		Game_publish(game, &shared->slots[shared->views.write], due);
+		TripleBuffer_publish(&shared->views);
+		atomic_store(&shared->waiting, game->pacing && Game_isWaiting(game));
 
-		/* Draw objects to the buffer */	
-		sfRenderWindow_drawRectangleShape(window, p1Rect, NULL);
-		sfRenderWindow_drawRectangleShape(window, p2Rect, NULL);
-		sfRenderWindow_drawRectangleShape(window, ballRect, NULL);
+	}
 
-		/* Display the buffer */
-		sfRenderWindow_display(window);
+}
 
-	}
+/* Render thread: draws the newest published view, blended toward the next tick by the time since its own was due.
+   An idle frame that shows nothing new is not presented, and the thread sleeps until the next tick instead. */
+void render(void *arg){
+
+	App *app = arg;
+	Screen *screen = &app->screen;
+	Shared *shared = &app->shared;
+	unsigned int seenEvents = 0;
+	int dirty = 1;
+
+	sfRenderWindow_setActive(screen->window, sfTrue);
+	while(atomic_load(&shared->running)){
+
+		PROFILE_FRAME_BEGIN();
+		/* Input changes within one frame are marked once, at the newest */
+		unsigned long long inputMark = atomic_exchange(&shared->inputMark, 0ull);
+		if(inputMark) PROFILE_MARK_AT("input", inputMark);
+		TripleBuffer_acquire(&shared->views);
+		const View *view = &shared->slots[shared->views.read];
+
+		unsigned int events = atomic_load(&shared->events);
+		if(events != seenEvents){
+			seenEvents = events;
+			dirty = 1;
+		}
+		dirty |= Screen_update(screen, shared, view);
+
+		unsigned long long now = Timer_now();
+		double sinceTick = (now > view->time) ? Timer_toSeconds(now - view->time) : 0.0;
+		if(Screen_isIdle(screen, view) && !dirty){
+			++screen->framesSkipped;
+			screen->lastPresent = 0;
+			PROFILE_FRAME_END();
+			sfSleep(sfSeconds((float)MAX(TICK_TIME - sinceTick, 0.001)));
+			continue;
+		}
+		dirty = 0;
 
-	/* SFML object cleanup */
-	sfRectangleShape_destroy(p1Rect);
-	sfRectangleShape_destroy(p2Rect);
-	sfRectangleShape_destroy(ballRect);
-	sfRenderWindow_destroy(window);
-	
-	/* Exit successfully */
-	return EXIT_SUCCESS;
+		PROFILE_BEGIN(PHASE_DRAW);
+		Screen_draw(screen, view, (float)MIN(sinceTick / TICK_TIME, 1.0));
+		PROFILE_END(PHASE_DRAW);
+		PROFILE_BEGIN(PHASE_DISPLAY);
+		Screen_present(screen, shared, view);
+		PROFILE_END(PHASE_DISPLAY);
+		PROFILE_FRAME_END();
+
+	}
+	sfRenderWindow_setActive(screen->window, sfFalse);
 
 }
 
-/* Returns the distance between the two passed points */
-float Point_getDistance(Point a, Point b){
+/* Handles one window event on the main thread. Everything but input is handed to the thread it concerns. */
+void handleEvent(App *app, const sfEvent *event){
 
-	return sqrt(pow(b.x - a.x, 2) + (b.y - a.y, 2));
+	Shared *shared = &app->shared;
+	atomic_fetch_add(&shared->events, 1u);
 
-}
+	sfMutex_lock(shared->controlsLock);
+	InputSystem_handleEvent(&shared->controls, event, Timer_now());
+	sfMutex_unlock(shared->controlsLock);
 
-/* Gets the position of the vertex on the ball corresponding to the passed int identifier.
-   The points are numbered as follows, from the origin (0) at the visual top-left position:
-
-   0--1
-   |  |
-   3--2
-   
-   This clockwise point layout is used in the same way for all similar functions. */
-Point Ball_getVertex(const Ball *ball, int vertex){
-
-	switch(vertex){
-		case 0:
-			return ball->position;
-		case 1:
-			return (Point){ball->position.x + BALL_SIZE, ball->position.y};
-		case 2:
-			return (Point){ball->position.x + BALL_SIZE, ball->position.y + BALL_SIZE};
-		case 3:
-			return (Point){ball->position.x, ball->position.y + BALL_SIZE};
-		default:
-			return (Point){0.0f, 0.0f};
-	}
+	if(event->type == sfEvtClosed) atomic_store(&shared->running, 0);
+	if(event->type == sfEvtKeyPressed && event->key.code == sfKeyF3) atomic_fetch_add(&shared->overlayToggles, 1);
+
+	/* Jump backward or forward through a replay */
+	if(app->game.playing && event->type == sfEvtKeyPressed && (event->key.code == sfKeyLeft || event->key.code == sfKeyRight))
+		atomic_fetch_add(&shared->seek, (event->key.code == sfKeyRight) ? REPLAY_SEEK_TICKS : -REPLAY_SEEK_TICKS);
 
 }
 
-/* Returns the line represented by the given side of the ball */
-Line Ball_getSide(const Ball *ball, Side side){
+/* Reads the input of the tick ending at 'tickEnd'. Returns nonzero if the local input changed since the last tick. */
+int Game_readInput(Game *game, Shared *shared, unsigned long long tickEnd){
 
-	switch(side){
-		case TOP:
-			return (Line){Ball_getVertex(ball, 0), Ball_getVertex(ball, 1)};
-		case RIGHT:
-			return (Line){Ball_getVertex(ball, 1), Ball_getVertex(ball, 2)};
-		case BOTTOM:
-			return (Line){Ball_getVertex(ball, 2), Ball_getVertex(ball, 3)};
-		case LEFT:
-			return (Line){Ball_getVertex(ball, 3), Ball_getVertex(ball, 0)};
-		default:
-			return (Line){{0.0f, 0.0f}, {0.0f, 0.0f}};
+	if(game->spectating){
+		for(int i = 0; i < game->arenaCount; ++i){
+			game->wallPrevious[i] = game->wall[i];
+			game->wallInputs[i] = Controller_getInput(game->wallP1, &game->wallStates[2 * i], game->wallP2, &game->wallStates[2 * i + 1], &game->wall[i]);
+		}
+		return 0;
+	}
+	if(game->partying){
+		game->input = Game_takeInput(game, shared, tickEnd);
+		return 0;
 	}
+	if(game->playing) return 0;
+
+	Input input;
+	if(game->networked){
+		/* Take every packet that arrived before ticking with the local input */
+		unsigned char packet[NETPLAY_MAX_PACKET];
+		size_t size;
+		while((size = NetSocket_receive(&game->netSocket, packet, sizeof(packet))) > 0)
+			NetSession_receive(&game->session, packet, size);
+		input = game->netInput = toNetInput(Game_takeInput(game, shared, tickEnd));
+	}else{
+		game->input = Game_takeInput(game, shared, tickEnd);
+		/* Paddles only move during a round, so the search is not run while idle */
+		if(game->cpu || (game->search && game->match.gameState == 1)){
+			int move = game->search ? Mcts_search(game->search, &game->match, 2, MCTS_DEFAULT_BUDGET, NULL) :
+				Controller_move(game->cpu, &game->cpuState, &game->match, 2);
+			game->input &= (Input)~(INPUT_P2_UP | INPUT_P2_DOWN);
+			if(move < 0) game->input |= INPUT_P2_UP;
+			else if(move > 0) game->input |= INPUT_P2_DOWN;
+		}
+		input = game->input;
+	}
+
+	int changed = (input != game->lastInput);
+	game->lastInput = input;
+	return changed;
 
 }
 
-/* Returns the furthest extent of the given side of the ball.
-   Naturally, TOP and BOTTOM will return a Y coordinate while LEFT and RIGHT will
-   return an X coordinate. */
-float Ball_getBound(const Ball *ball, Side side){
+/* Takes the keyboard and gamepad input of a tick. The read time of the first change it applies is carried in every
+   view until the renderer reports showing it, so the latency is measured to the first frame that includes the tick. */
+Input Game_takeInput(Game *game, Shared *shared, unsigned long long tickEnd){
 
-	switch(side){
-		case TOP:
-			return ball->position.y;
-		case RIGHT:
-			return ball->position.x + BALL_SIZE;
-		case BOTTOM:
-			return ball->position.y + BALL_SIZE;
-		case LEFT:
-			return ball->position.x;
-		default:
-			return 0.0f;
-	}
+	sfMutex_lock(shared->controlsLock);
+	Input input = InputSystem_getTickInput(&shared->controls, tickEnd);
+	unsigned long long readTime = InputSystem_takePending(&shared->controls);
+	sfMutex_unlock(shared->controlsLock);
+
+	if(game->pendingInput && game->pendingInput == atomic_load(&shared->shownInput)) game->pendingInput = 0;
+	if(!game->pendingInput) game->pendingInput = readTime;
+	return input;
 
 }
 
-/* Returns the position of the given vertex of the given paddle.
-   See function 'Ball_getVertex' for more details. */
-Point Paddle_getVertex(const Paddle *paddle, int vertex){
+/* Runs one tick with the input read for it and queues its sounds */
+void Game_advance(Game *game, Shared *shared){
 
-	switch(vertex){
-		case 0:
-			return paddle->position;
-		case 1:
-			return (Point){paddle->position.x + PADDLE_WIDTH, paddle->position.y};
-		case 2:
-			return (Point){paddle->position.x + PADDLE_WIDTH, paddle->position.y + PADDLE_HEIGHT};
-		case 3:
-			return (Point){paddle->position.x, paddle->position.y + PADDLE_HEIGHT};
-		default:
-			return (Point){0.0f, 0.0f};
+	/* Jump through a replay as the event loop asked */
+	int seek = game->playing ? atomic_exchange(&shared->seek, 0) : 0;
+	if(seek){
+		long long target = (long long)game->cursor.tick + seek;
+		target = MAX(0, MIN(target, (long long)game->replay.tickCount));
+		Replay_seek(&game->replay, &game->cursor, (unsigned int)target);
+		game->match = game->cursor.match;
 	}
 
+	game->previous = game->match;
+	int ticked = 1;
+	if(game->spectating){
+		Match_step(game->wall, game->wallInputs, (size_t)game->arenaCount);
+		ticked = 0;
+	}else if(game->partying){
+		int points = game->field.p1.score + game->field.p2.score;
+		BallField_tick(&game->field, game->input);
+		playFieldEvents(game->audio, &game->field, points);
+		ticked = 0;
+	}else if(game->playing){
+		Input input;
+		ticked = ReplayCursor_next(&game->cursor, &input);
+		if(ticked) game->match = game->cursor.match;
+	}else if(game->networked){
+		/* Tick with the local input and send it on */
+		unsigned char packet[NETPLAY_MAX_PACKET];
+		ticked = NetSession_advance(&game->session, game->netInput);
+		game->match = game->session.match;
+		size_t size = NetSession_buildPacket(&game->session, packet);
+		if(size) NetSocket_send(&game->netSocket, packet, size);
+	}else{
+		if(game->recording) ReplayWriter_record(&game->writer, &game->match, game->input);
+		Match_tickLayout(&game->match, game->arranged ? game->arena : NULL, game->input, NULL);
+	}
+	if(ticked) playEvents(game->audio, &game->match);
+
 }
 
-/* Returns the line representing the given side of the given paddle.
-   See function 'Ball_getSide for more details. */
-Line Paddle_getSide(const Paddle *paddle, Side side){
+/* Copies what the screen shows of the game into a view */
+void Game_publish(const Game *game, View *view, unsigned long long time){
 
-	switch(side){
-		case TOP:
-			return (Line){Paddle_getVertex(paddle, 0), Paddle_getVertex(paddle, 1)};
-		case RIGHT:
-			return (Line){Paddle_getVertex(paddle, 1), Paddle_getVertex(paddle, 2)};
-		case BOTTOM:
-			return (Line){Paddle_getVertex(paddle, 2), Paddle_getVertex(paddle, 3)};
-		case LEFT:
-			return (Line){Paddle_getVertex(paddle, 3), Paddle_getVertex(paddle, 0)};
-		default:
-			return (Line){{0.0f, 0.0f}, {0.0f, 0.0f}};
+	view->time = time;
+	view->inputTime = game->pendingInput;
+	view->previous = game->previous;
+	view->match = game->match;
+	if(game->spectating){
+		memcpy(view->wallPrevious, game->wallPrevious, sizeof(Match) * (size_t)game->arenaCount);
+		memcpy(view->wall, game->wall, sizeof(Match) * (size_t)game->arenaCount);
+	}
+	if(game->partying){
+		float *x = view->field.x, *y = view->field.y;
+		view->field = game->field;
+		view->field.x = x;
+		view->field.y = y;
+		memcpy(x, game->field.x, sizeof(float) * game->field.count);
+		memcpy(y, game->field.y, sizeof(float) * game->field.count);
 	}
 
 }
 
-/* Returns the extent of the paddle's bounds at the given side.
-   See function 'Ball_getBound' for more details. */
-float Paddle_getBound(const Paddle *paddle, Side side){
+/* Returns nonzero while the match waits for the start input */
+int Game_isWaiting(const Game *game){
 
-	switch(side){
-		case TOP:
-			return paddle->position.y;
-		case RIGHT:
-			return paddle->position.x + PADDLE_WIDTH;
-		case BOTTOM:
-			return paddle->position.y + PADDLE_HEIGHT;
-		case LEFT:
-			return paddle->position.x;
-		default:
-			return 0.0f;
-	}
+	return game->match.gameState == 0 && !game->match.gameStarting;
 
 }
 
-/* Tests collision between the ball and the passed paddle */
-Collision getPaddleCollision(const Ball *ball, const Paddle *paddle, Point *newPosition){
+/* Allocates the arrays of a view for the game's mode */
+int View_create(View *view, const Game *game){
 
-	/* Declare the return value */
-	Collision returnVal = (Collision){0, {0.0f, 0.0f}, TOP};
+	memset(view, 0, sizeof(*view));
+	if(game->spectating){
+		view->wallPrevious = malloc(sizeof(Match) * (size_t)game->arenaCount);
+		view->wall = malloc(sizeof(Match) * (size_t)game->arenaCount);
+		if(!view->wallPrevious || !view->wall) return 0;
+	}
+	if(game->partying){
+		view->field.x = malloc(sizeof(float) * game->field.count);
+		view->field.y = malloc(sizeof(float) * game->field.count);
+		if(!view->field.x || !view->field.y) return 0;
+	}
+	return 1;
 
-	/* Find the slope of the ball's path */
-	float slopeN = ball->speed.y;
-	float slopeD = ball->speed.x;
+}
 
-	/* Return failure if the slope is vertical */
-	if(slopeD == 0.0f) return returnVal;
-	float slope = slopeN / slopeD;
+/* Frees the arrays of a view */
+void View_destroy(View *view){
 
-	/* Declare arrays to store collision test information */	
-	int horizontalVertices[2];		/* Stores the vertices on the ball that collision will be tested against for horizontal collisions */
-	int verticalVertices[2];		/* Stores the vertices on the ball that collision will be tested against for vertical collisions */
-	int collisionVertices[2];		/* Stores the vertices on the ball where collisions actually occur */
-	Side paddleSides[2];			/* Stores the names of paddle's sides where collisions will be tested against */
-	Line paddleEdges[2];			/* Stores the points that define the paddle's sides where collision will be tested against */
+	free(view->wallPrevious);
+	free(view->wall);
+	free(view->field.x);
+	free(view->field.y);
 
-	/* Determine the edges of the paddle that collision will be tested against */
-	if(ball->speed.x >= 0.0f){
-		
-		if(Ball_getBound(ball, LEFT) > Paddle_getBound(paddle, RIGHT)) return returnVal;
-		horizontalVertices[0] = 1; horizontalVertices[1] = 2;
-		paddleSides[0] = LEFT;
-		paddleEdges[0] = Paddle_getSide(paddle, LEFT);
+}
 
-	}else{
+/* Applies overlay toggles and brings the HUD up to date with a view. Returns nonzero if the text changed. */
+int Screen_update(Screen *screen, Shared *shared, const View *view){
 
-		if(Ball_getBound(ball, RIGHT) < Paddle_getBound(paddle, LEFT)) return returnVal;
-		horizontalVertices[0] = 0; horizontalVertices[1] = 3;
-		paddleSides[0] = RIGHT;
-		paddleEdges[0] = Paddle_getSide(paddle, RIGHT);
+	/* The toggle is only reported applied once the title it changed is handed on */
+	int toggles = atomic_load(&shared->overlayToggles);
+	if((toggles - screen->overlayToggles) % 2) Overlay_setVisible(&screen->overlay, !screen->overlay.visible);
+	screen->overlayToggles = toggles;
+	Screen_showTitle(screen, shared);
+	atomic_store(&shared->overlayApplied, toggles);
+	screen->overlay.tickTime = atomic_load(&shared->tickTime);
 
-	}
+	if(screen->spectating) Hud_update(&screen->hud, view->wall);
+	else if(screen->partying) Hud_updateScore(&screen->hud, 0, view->field.p1.score, view->field.p2.score);
+	else Hud_update(&screen->hud, &view->match);
 
-	if(ball->speed.y >= 0.0f){
+	int changed = (screen->hud.rebuilds != screen->hudRebuilds);
+	screen->hudRebuilds = screen->hud.rebuilds;
+	return changed;
 
-		if(Ball_getBound(ball, TOP) > Paddle_getBound(paddle, BOTTOM)) return returnVal;	
-		verticalVertices[0] = 2; verticalVertices[1] = 3;
-		paddleSides[1] = TOP;
-		paddleEdges[1] = Paddle_getSide(paddle, TOP);
-	
-	}else{
+}
 
-		if(Ball_getBound(ball, BOTTOM) < Paddle_getBound(paddle, TOP)) return returnVal;
-		verticalVertices[0] = 0; verticalVertices[1] = 1;	
-		paddleSides[1] = BOTTOM;
-		paddleEdges[1] = Paddle_getSide(paddle, BOTTOM);
-
-	}
-
-	Collision horizontalCol = {0, {0.0f, 0.0f}, TOP};
-	Collision verticalCol = {0, {0.0f, 0.0f}, TOP};
-
-	/* Horizontal tests */
-	for(int i = 0; i < 2; ++i){
-
-		collisionVertices[0] = horizontalVertices[i];
-			
-		Point vertexPos = Ball_getVertex(ball, collisionVertices[0]);
-		Point nextPos = {vertexPos.x + ball->speed.x, vertexPos.y + ball->speed.y};
-			
-		float ballMinX = MIN(vertexPos.x, nextPos.x), ballMaxX = MAX(vertexPos.x, nextPos.x);
-		float paddleX = Paddle_getBound(paddle, paddleSides[0]);
-
-		if(!(paddleX >= ballMinX && paddleX <= ballMaxX)) break;
-	
-		float yIncp = vertexPos.y - (vertexPos.x * slope);
-		float paddleMinY = Paddle_getBound(paddle, TOP), paddleMaxY = Paddle_getBound(paddle, BOTTOM);
-		float ballColY = (paddleX * slope) + yIncp;
-			
-		if(!(ballColY >= paddleMinY && ballColY <= paddleMaxY)) continue;
-		else{
-			horizontalCol.collides = 1;
-			horizontalCol.position = (Point){paddleX, ballColY};
-			horizontalCol.side = paddleSides[0];
-			break;
-		}
+/* Sets the overlay's new title on the window, or hands it to the event loop when another thread owns the window */
+void Screen_showTitle(Screen *screen, Shared *shared){
 
+	if(!screen->overlay.titleChanged) return;
+	screen->overlay.titleChanged = 0;
+	if(!screen->threaded){
+		sfRenderWindow_setTitle(screen->window, screen->overlay.title);
+		return;
 	}
 
-	/* Vertical tests */
-	for(int i = 0; i < 2; ++i){
+	sfMutex_lock(shared->controlsLock);
+	memcpy(shared->title, screen->overlay.title, sizeof(shared->title));
+	sfMutex_unlock(shared->controlsLock);
+	atomic_fetch_add(&shared->titles, 1u);
 
-		if(slope == 0.0f) break;
+}
 
-		collisionVertices[1] = verticalVertices[i];
+/* Returns nonzero if nothing on screen moves, so frames only need presenting when something else changed */
+int Screen_isIdle(const Screen *screen, const View *view){
 
-		Point vertexPos = Ball_getVertex(ball, collisionVertices[1]);
-		Point nextPos = {vertexPos.x + ball->speed.x, vertexPos.y + ball->speed.y};
+	return screen->pacing && !screen->overlay.visible && view->match.gameState != 1 && view->previous.gameState != 1;
 
-		float ballMinY = MIN(vertexPos.y, nextPos.y), ballMaxY = MAX(vertexPos.y, nextPos.y);
-		float paddleY = Paddle_getBound(paddle, paddleSides[1]);
+}
 
-		if(!(paddleY >= ballMinY && paddleY <= ballMaxY)) break;
+/* Blends the objects between the two ticks of a view and draws every arena in one call */
+void Screen_draw(Screen *screen, const View *view, float alpha){
 
-		float yIncp = vertexPos.y - (vertexPos.x * slope);
-		float paddleMinX = Paddle_getBound(paddle, LEFT), paddleMaxX = Paddle_getBound(paddle, RIGHT);
-			float ballColX = (paddleY - yIncp) / slope;
+	if(screen->spectating) ArenaRenderer_update(&screen->renderer, view->wallPrevious, view->wall, alpha);
+	else if(screen->partying) FieldRenderer_update(&screen->fieldRenderer, &view->field);
+	else ArenaRenderer_update(&screen->renderer, &view->previous, &view->match, alpha);
 
-		if(!(ballColX >= paddleMinX && ballColX <= paddleMaxX)) continue;
-		else{
-			verticalCol.collides = 1;
-			verticalCol.position = (Point){ballColX, paddleY};
-			verticalCol.side = paddleSides[1];
-			break;
-		}
+	sfRenderWindow_clear(screen->window, sfBlack);
+	if(screen->partying) FieldRenderer_draw(&screen->fieldRenderer, screen->window);
+	else ArenaRenderer_draw(&screen->renderer, screen->window);
+	if(screen->arranged) LayoutRenderer_draw(&screen->layoutRenderer, screen->window);
+	Hud_draw(&screen->hud, screen->window);
+	Overlay_draw(&screen->overlay, screen->window);
 
-	}
+}
 
-	/* Assigns the closest collision occurence to returnVal */
-	int collisionVertex = 0;
-	if(horizontalCol.collides && verticalCol.collides){
-		int returnIndex = (Point_getDistance(Ball_getVertex(ball, collisionVertices[0]), horizontalCol.position) <
-					Point_getDistance(Ball_getVertex(ball, collisionVertices[1]), verticalCol.position) ?
-						0 : 1);
-		collisionVertex = collisionVertices[returnIndex];
-		returnVal = (returnIndex) ? verticalCol : horizontalCol;
-	}
-	else if(horizontalCol.collides){ returnVal = horizontalCol; collisionVertex = collisionVertices[0]; }
-	else if(verticalCol.collides){ returnVal = verticalCol; collisionVertex = collisionVertices[1]; }
-		
-	if(returnVal.collides){
+/* Displays the frame, then records the input latency it shows and the time since the last present */
+void Screen_present(Screen *screen, Shared *shared, const View *view){
+
+	Screen_showTitle(screen, shared);
+	if(screen->stall > 0) sfSleep(sfMilliseconds(screen->stall));
+	sfRenderWindow_display(screen->window);
+	unsigned long long now = Timer_now();
+	++screen->framesDrawn;
 
-		Ball originReference = {returnVal.position, {0.0f, 0.0f}};
-		Point backToOrigin = Ball_getVertex(&originReference, collisionVertex);
-		newPosition->x = returnVal.position.x - (backToOrigin.x - returnVal.position.x);
-		newPosition->y = returnVal.position.y - (backToOrigin.y - returnVal.position.y);
+	if(view->inputTime && view->inputTime != atomic_load(&shared->shownInput)){
+		sfMutex_lock(shared->controlsLock);
+		InputSystem_recordLatency(&shared->controls, view->inputTime, now);
+		sfMutex_unlock(shared->controlsLock);
+		atomic_store(&shared->shownInput, view->inputTime);
 	}
-	
-	return returnVal;
+
+	if(screen->lastPresent) Histogram_add(&screen->frames, now - screen->lastPresent);
+	screen->lastPresent = now;
 
 }
 
-/* Tests collision between the ball and the stage boundaries */
-Collision getWallCollision(const Ball *ball, Point *newPosition){
-	
-	Collision returnVal = {0, {0.f, 0.f}, TOP};
-
-	int testedVertex = -1;
-	Side horizontalSide = -1, verticalSide = -1;
-	float horizontalBound = -1.0f, verticalBound = -1.0f;
-	
-	if(ball->speed.x >= 0){
-		horizontalSide = RIGHT;
-		horizontalBound = WINDOW_WIDTH;
-	}else{
-		horizontalSide = LEFT; 
-		horizontalBound = 0.0f;
-	}
+/* Adds one duration */
+void Histogram_add(Histogram *histogram, unsigned long long duration){
 
-	if(ball->speed.y >= 0){
-		verticalSide = BOTTOM;
-		verticalBound = WINDOW_HEIGHT;
-	}
-	else{
-		verticalSide = TOP;
-		verticalBound = 0.0f;	
-	}
+	++histogram->buckets[MIN(duration / HISTOGRAM_BUCKET_NS, HISTOGRAM_BUCKETS - 1)];
+	++histogram->count;
+	histogram->max = MAX(histogram->max, duration);
 
-	if(horizontalSide == RIGHT && verticalSide == BOTTOM) testedVertex = 2;
-	else if(horizontalSide == LEFT && verticalSide == BOTTOM) testedVertex = 3;
-	else if(horizontalSide == RIGHT && verticalSide == TOP) testedVertex = 1;
-	else testedVertex = 0;
+}
 
-	float slopeN = ball->speed.y;
-	float slopeD = ball->speed.x;
+/* Returns the duration the given fraction of the samples are below, in seconds, rounded up to a bucket */
+double Histogram_getPercentile(const Histogram *histogram, double fraction){
 
-	if(slopeD == 0.0f) return returnVal;
-	float slope = slopeN / slopeD;
+	unsigned long long target = (unsigned long long)(fraction * (double)histogram->count), seen = 0;
+	for(int i = 0; i < HISTOGRAM_BUCKETS; ++i){
+		seen += histogram->buckets[i];
+		if(seen > target) return (double)((i + 1) * HISTOGRAM_BUCKET_NS) / 1e9;
+	}
+	return (double)histogram->max / 1e9;
 
-	Point vertexPos = Ball_getVertex(ball, testedVertex);
-	Point nextPos = {vertexPos.x + ball->speed.x, vertexPos.y + ball->speed.y};
+}
 
-	float yIncp = vertexPos.y - (vertexPos.x * slope);
+/* Converts tick input to the local player's input in network play. Either player's controls move the paddle. */
+NetInput toNetInput(Input input){
 
-	Collision horizontalCol = {0, {0.0f, 0.0f}, TOP};
-	Collision verticalCol = {0, {0.0f, 0.0f}, TOP};
+	NetInput netInput = 0;
+	if(input & (INPUT_P1_UP | INPUT_P2_UP)) netInput |= NET_INPUT_UP;
+	if(input & (INPUT_P1_DOWN | INPUT_P2_DOWN)) netInput |= NET_INPUT_DOWN;
+	if(input & INPUT_START) netInput |= NET_INPUT_START;
+	return netInput;
 
-	if(MIN(vertexPos.x, nextPos.x) <= horizontalBound &&
-		MAX(vertexPos.x, nextPos.x) >= horizontalBound){
-		horizontalCol = (Collision){1, {horizontalBound, (slope * horizontalBound) + yIncp}, horizontalSide};
-	}
+}
 
-	if(MIN(vertexPos.y, nextPos.y) <= verticalBound &&
-		MAX(vertexPos.y, nextPos.y) >= verticalBound){
-		verticalCol = (Collision){1, {(verticalBound - yIncp) / slope, verticalBound}, verticalSide};
-	}
+/* Queues the sounds of the last tick, panned to where the ball is */
+void playEvents(Audio *audio, const Match *match){
 
+	float pan = Scalar_toFloat(match->ball.position.x) / WINDOW_WIDTH * 2.0f - 1.0f;
+	if(match->events & MATCH_EVENT_PADDLE_HIT) Audio_play(audio, SOUND_PADDLE, pan, 1.0f);
+	if(match->events & (MATCH_EVENT_WALL_BOUNCE | MATCH_EVENT_OBSTACLE_HIT)) Audio_play(audio, SOUND_WALL, pan, 0.8f);
+	if(match->events & MATCH_EVENT_SCORE) Audio_play(audio, SOUND_SCORE, 0.0f, 1.0f);
 
-	if(horizontalCol.collides && verticalCol.collides){
-		returnVal = (Point_getDistance(vertexPos, horizontalCol.position) <
-				Point_getDistance(vertexPos, verticalCol.position) ?
-					horizontalCol : verticalCol);
-	}
-	else if(horizontalCol.collides) returnVal = horizontalCol;
-	else if(verticalCol.collides) returnVal = verticalCol;
+}
 
-	if(returnVal.collides){
+/* Queues the sounds of the last many-ball tick. A tick can have thousands of bounces; no more than
+   the mixer has voices are queued per kind, the rest would only steal each other's voices. */
+void playFieldEvents(Audio *audio, const BallField *field, int lastPoints){
+
+	unsigned long long paddleHits = MIN(field->stats.paddleHits, AUDIO_VOICES);
+	unsigned long long wallBounces = MIN(field->stats.wallBounces, AUDIO_VOICES);
+	for(unsigned long long i = 0; i < paddleHits; ++i) Audio_play(audio, SOUND_PADDLE, 0.0f, 0.5f);
+	for(unsigned long long i = 0; i < wallBounces; ++i) Audio_play(audio, SOUND_WALL, 0.0f, 0.4f);
+	if(field->p1.score + field->p2.score != lastPoints) Audio_play(audio, SOUND_SCORE, 0.0f, 1.0f);
 
-		Ball originReference = {returnVal.position, {0.0f, 0.0f}};
-		Point backToOrigin = Ball_getVertex(&originReference, testedVertex);
-		newPosition->x = returnVal.position.x - (backToOrigin.x - returnVal.position.x);
-		newPosition->y = returnVal.position.y - (backToOrigin.y - returnVal.position.y);
-	}
-	
-	return returnVal;
 }
@@ -0,0 +1,323 @@
+/*
+   CPong
+   Monte-Carlo tree search for one paddle. See mcts.h.
+*/
+
+/* Standard C includes */
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/* Local includes */
+#include "mcts.h"
+#include "pool.h"
+#include "timer.h"
+
+/* Search tuning definitions */
+#define MCTS_MAX_DEPTH 32
+#define MCTS_EXPLORATION 0.7f
+#define MCTS_VALUE_SCALE 1024		/* Results are summed as fixed point integers */
+#define MCTS_VIRTUAL_LOSS MCTS_VALUE_SCALE	/* Counted against a node while a thread is below it */
+#define MCTS_RANDOM_MOVES 4		/* One in this many rollout moves is random */
+#define CACHE_LINE 64
+
+/* Node expansion states */
+enum {NODE_LEAF, NODE_EXPANDING, NODE_EXPANDED, NODE_FULL};
+
+/* Define the 'Node' struct. 'firstChild' is written before 'state' is set to NODE_EXPANDED. */
+typedef struct Node{
+
+	atomic_int visits;
+	atomic_llong value;
+	atomic_int state;
+	int firstChild;
+
+} Node;
+
+/* Define the 'SearchWorker' struct. Each worker writes only its own entry. */
+typedef struct SearchWorker{
+
+	unsigned long long rollouts;
+	unsigned long long ticks;
+	unsigned int rng;
+	char padding[CACHE_LINE];
+
+} SearchWorker;
+
+/* Define the 'Mcts' struct */
+struct Mcts{
+
+	Pool *pool;
+	int threadCount;
+	const Controller *opponent;
+	Node *nodes;
+	int capacity;
+	atomic_int nodeCount;
+	SearchWorker *workers;
+	unsigned int searchCount;
+
+	/* Current search */
+	Match root;
+	int player;
+	unsigned long long deadline;
+
+};
+
+/* Static function declarations */
+static void Mcts_searchTask(void *arg, size_t index, int worker);
+static void Mcts_iterate(Mcts *mcts, SearchWorker *worker);
+static int Mcts_select(const Mcts *mcts, const Node *node);
+static void Mcts_expand(Mcts *mcts, Node *node);
+static int Mcts_advance(const Mcts *mcts, Match *match, int move, ControllerState *opponentState, int ticks, SearchWorker *worker);
+static int Mcts_rollout(const Mcts *mcts, Match *match, ControllerState *opponentState, SearchWorker *worker);
+static unsigned int Mcts_random(SearchWorker *worker);
+
+/* Creates a searcher with its own thread pool and node storage */
+Mcts *Mcts_create(int threads, int nodeCapacity, const Controller *opponent){
+
+	Mcts *mcts = calloc(1, sizeof(Mcts));
+	if(!mcts) return NULL;
+
+	mcts->threadCount = (threads > 0) ? threads : Pool_getCpuCount();
+	mcts->capacity = MAX(nodeCapacity, 1 + MCTS_ACTIONS);
+	mcts->opponent = opponent;
+	mcts->pool = Pool_create(mcts->threadCount);
+	mcts->nodes = malloc(sizeof(Node) * (size_t)mcts->capacity);
+	mcts->workers = calloc((size_t)mcts->threadCount, sizeof(SearchWorker));
+	if(!mcts->pool || !mcts->nodes || !mcts->workers){
+		Mcts_destroy(mcts);
+		return NULL;
+	}
+
+	return mcts;
+
+}
+
+/* Stops the searcher's threads and frees it */
+void Mcts_destroy(Mcts *mcts){
+
+	if(!mcts) return;
+	if(mcts->pool) Pool_destroy(mcts->pool);
+	free(mcts->nodes);
+	free(mcts->workers);
+	free(mcts);
+
+}
+
+/* Returns the number of threads searching */
+int Mcts_getThreadCount(const Mcts *mcts){
+
+	return mcts->threadCount;
+
+}
+
+/* Searches from the given match on every thread until the budget runs out and returns the most visited root action */
+int Mcts_search(Mcts *mcts, const Match *match, int player, double budget, MctsStats *stats){
+
+	unsigned long long start = Timer_now();
+
+	mcts->root = *match;
+	mcts->player = player;
+	mcts->deadline = start + (unsigned long long)(budget * 1e9);
+	++mcts->searchCount;
+
+	/* A fresh tree with the root already expanded, so every thread starts on a different action */
+	Node *root = &mcts->nodes[0];
+	atomic_store_explicit(&root->visits, 0, memory_order_relaxed);
+	atomic_store_explicit(&root->value, 0, memory_order_relaxed);
+	atomic_store_explicit(&root->state, NODE_LEAF, memory_order_relaxed);
+	atomic_store_explicit(&mcts->nodeCount, 1, memory_order_relaxed);
+	Mcts_expand(mcts, root);
+
+	for(int i = 0; i < mcts->threadCount; ++i){
+		mcts->workers[i].rollouts = 0;
+		mcts->workers[i].ticks = 0;
+		mcts->workers[i].rng = ((mcts->searchCount * 2654435761u) ^ ((unsigned int)i * 40503u) ^ match->rng) | 1u;
+	}
+
+	Pool_run(mcts->pool, (size_t)mcts->threadCount, Mcts_searchTask, mcts);
+
+	/* The most visited action is the most reliable choice */
+	int best = 1, bestVisits = -1;
+	for(int i = 0; i < MCTS_ACTIONS; ++i){
+		int visits = atomic_load_explicit(&mcts->nodes[root->firstChild + i].visits, memory_order_relaxed);
+		if(visits > bestVisits){ best = i; bestVisits = visits; }
+	}
+
+	if(stats){
+		stats->rollouts = 0;
+		stats->ticks = 0;
+		for(int i = 0; i < mcts->threadCount; ++i){
+			stats->rollouts += mcts->workers[i].rollouts;
+			stats->ticks += mcts->workers[i].ticks;
+		}
+		stats->nodes = MIN(atomic_load(&mcts->nodeCount), mcts->capacity);
+		stats->threads = mcts->threadCount;
+		stats->seconds = Timer_toSeconds(Timer_now() - start);
+		for(int i = 0; i < MCTS_ACTIONS; ++i){
+			const Node *child = &mcts->nodes[root->firstChild + i];
+			int visits = atomic_load(&child->visits);
+			stats->visits[i] = visits;
+			stats->values[i] = visits ? (float)atomic_load(&child->value) / MCTS_VALUE_SCALE / (float)visits : 0.0f;
+		}
+	}
+
+	return best - 1;
+
+}
+
+/* Runs search iterations on one worker until the deadline */
+static void Mcts_searchTask(void *arg, size_t index, int worker){
+
+	(void)index;
+	Mcts *mcts = arg;
+	while(Timer_now() < mcts->deadline) Mcts_iterate(mcts, &mcts->workers[worker]);
+
+}
+
+/* Runs one iteration: descends the tree on a forked match, expands the leaf, plays a rollout and
+   adds the result to every node on the path */
+static void Mcts_iterate(Mcts *mcts, SearchWorker *worker){
+
+	Match match = mcts->root;
+	ControllerState opponentState;
+	Controller_reset(mcts->opponent, &opponentState, Mcts_random(worker));
+
+	int path[MCTS_MAX_DEPTH + 1];
+	int depth = 0, result = 0, scored = 0;
+	Node *node = &mcts->nodes[0];
+	path[0] = 0;
+	atomic_fetch_add_explicit(&node->visits, 1, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&node->value, MCTS_VIRTUAL_LOSS, memory_order_relaxed);
+
+	/* Selection, playing each chosen action on the forked match */
+	while(depth < MCTS_MAX_DEPTH && atomic_load_explicit(&node->state, memory_order_acquire) == NODE_EXPANDED){
+
+		int child = Mcts_select(mcts, node);
+		node = &mcts->nodes[child];
+		path[++depth] = child;
+		atomic_fetch_add_explicit(&node->visits, 1, memory_order_relaxed);
+		atomic_fetch_sub_explicit(&node->value, MCTS_VIRTUAL_LOSS, memory_order_relaxed);
+
+		int move = child - mcts->nodes[path[depth - 1]].firstChild - 1;
+		result = Mcts_advance(mcts, &match, move, &opponentState, MCTS_ACTION_TICKS, worker);
+		if(result != 0){ scored = 1; break; }
+
+	}
+
+	/* Expansion once a leaf has been reached before, then a rollout from it */
+	if(!scored){
+		if(atomic_load_explicit(&node->visits, memory_order_relaxed) > 1) Mcts_expand(mcts, node);
+		result = Mcts_rollout(mcts, &match, &opponentState, worker);
+	}
+	++worker->rollouts;
+
+	/* Backpropagation, taking back the virtual loss */
+	long long value = MCTS_VIRTUAL_LOSS + (long long)result * MCTS_VALUE_SCALE;
+	for(int i = 0; i <= depth; ++i) atomic_fetch_add_explicit(&mcts->nodes[path[i]].value, value, memory_order_relaxed);
+
+}
+
+/* Returns the child of an expanded node with the highest upper confidence bound */
+static int Mcts_select(const Mcts *mcts, const Node *node){
+
+	int first = node->firstChild, best = first;
+	float bestScore = -INFINITY;
+	float logVisits = logf((float)MAX(atomic_load_explicit(&node->visits, memory_order_relaxed), 1));
+
+	for(int i = 0; i < MCTS_ACTIONS; ++i){
+		const Node *child = &mcts->nodes[first + i];
+		int visits = atomic_load_explicit(&child->visits, memory_order_relaxed);
+		if(visits == 0) return first + i;
+		float mean = (float)atomic_load_explicit(&child->value, memory_order_relaxed) / MCTS_VALUE_SCALE / (float)visits;
+		float score = mean + MCTS_EXPLORATION * sqrtf(logVisits / (float)visits);
+		if(score > bestScore){ best = first + i; bestScore = score; }
+	}
+
+	return best;
+
+}
+
+/* Gives a leaf its three children. Only the thread that wins the state change expands it; the others
+   treat it as a leaf for now. A tree that has run out of nodes stops growing. */
+static void Mcts_expand(Mcts *mcts, Node *node){
+
+	int expected = NODE_LEAF;
+	if(!atomic_compare_exchange_strong(&node->state, &expected, NODE_EXPANDING)) return;
+
+	int first = atomic_fetch_add(&mcts->nodeCount, MCTS_ACTIONS);
+	if(first + MCTS_ACTIONS > mcts->capacity){
+		atomic_store(&node->state, NODE_FULL);
+		return;
+	}
+
+	for(int i = 0; i < MCTS_ACTIONS; ++i){
+		Node *child = &mcts->nodes[first + i];
+		atomic_store_explicit(&child->visits, 0, memory_order_relaxed);
+		atomic_store_explicit(&child->value, 0, memory_order_relaxed);
+		atomic_store_explicit(&child->state, NODE_LEAF, memory_order_relaxed);
+	}
+	node->firstChild = first;
+	atomic_store_explicit(&node->state, NODE_EXPANDED, memory_order_release);
+
+}
+
+/* Plays the searching player's move for a number of ticks against the opponent controller.
+   Returns 1 if the searching player scored, -1 if the opponent did and 0 otherwise. */
+static int Mcts_advance(const Mcts *mcts, Match *match, int move, ControllerState *opponentState, int ticks, SearchWorker *worker){
+
+	int player = mcts->player, other = 3 - player;
+	Input up = (player == 1) ? INPUT_P1_UP : INPUT_P2_UP, down = (player == 1) ? INPUT_P1_DOWN : INPUT_P2_DOWN;
+	Input otherUp = (player == 1) ? INPUT_P2_UP : INPUT_P1_UP, otherDown = (player == 1) ? INPUT_P2_DOWN : INPUT_P1_DOWN;
+
+	for(int i = 0; i < ticks; ++i){
+
+		Input input = INPUT_START;
+		if(move < 0) input |= up;
+		else if(move > 0) input |= down;
+		int otherMove = Controller_move(mcts->opponent, opponentState, match, other);
+		if(otherMove < 0) input |= otherUp;
+		else if(otherMove > 0) input |= otherDown;
+
+		int score = Match_getPaddle(match, player)->score;
+		Match_tick(match, input);
+		++worker->ticks;
+		if(match->events & MATCH_EVENT_SCORE) return (Match_getPaddle(match, player)->score > score) ? 1 : -1;
+
+	}
+
+	return 0;
+
+}
+
+/* Plays on to the next point or the rollout horizon. The searching player follows the ball,
+   with an occasional random move to keep the rollouts varied. */
+static int Mcts_rollout(const Mcts *mcts, Match *match, ControllerState *opponentState, SearchWorker *worker){
+
+	for(int ticks = 0; ticks < MCTS_ROLLOUT_TICKS; ticks += MCTS_ACTION_TICKS){
+
+		unsigned int random = Mcts_random(worker);
+		int move;
+		if(random % MCTS_RANDOM_MOVES == 0) move = (int)((random >> 8) % 3) - 1;
+		else{
+			float ballY = Scalar_toFloat(match->ball.position.y) + BALL_SIZE * 0.5f;
+			float paddleY = Scalar_toFloat(Match_getPaddle(match, mcts->player)->position.y) + PADDLE_HEIGHT * 0.5f;
+			move = (ballY < paddleY - 10.0f) ? -1 : (ballY > paddleY + 10.0f) ? 1 : 0;
+		}
+
+		int result = Mcts_advance(mcts, match, move, opponentState, MCTS_ACTION_TICKS, worker);
+		if(result != 0) return result;
+
+	}
+
+	return 0;
+
+}
+
+/* Returns the next number from a worker's xorshift generator */
+static unsigned int Mcts_random(SearchWorker *worker){
+
+	worker->rng ^= worker->rng << 13; worker->rng ^= worker->rng >> 17; worker->rng ^= worker->rng << 5;
+	return worker->rng;
+
+}
@@ -0,0 +1,58 @@
+/*
+   CPong
+   Monte-Carlo tree search for one paddle.
+
+   Each tree node stands for one of the three paddle actions (up, none,
+   down) held for 'MCTS_ACTION_TICKS' ticks. Every iteration copies the
+   root match, walks down the tree with UCT, expands the leaf and plays a
+   rollout to the next point or the rollout horizon. The opponent is
+   played by an ordinary controller. A 'Match' holds no pointers, so
+   forking the state for a rollout is a plain struct copy on the stack
+   and a search allocates nothing once the searcher is created.
+
+   The search runs on every thread of a work-stealing pool until the
+   time budget runs out. Node statistics are atomic counters updated
+   without locks, and a visit is counted on the way down so that threads
+   descending at the same time spread over different branches.
+*/
+
+#ifndef MCTS_H
+#define MCTS_H
+
+#include "pong.h"
+#include "bot.h"
+
+/* Search property definitions */
+#define MCTS_ACTIONS 3				/* Up, none, down */
+#define MCTS_ACTION_TICKS 6			/* Ticks each tree action is held for */
+#define MCTS_ROLLOUT_TICKS (4 * TICK_RATE)	/* Rollouts without a point are scored as a draw */
+#define MCTS_DEFAULT_NODES (1 << 16)
+#define MCTS_DEFAULT_BUDGET 0.002		/* Seconds of search per move */
+
+/* Define the 'MctsStats' struct describing the last search */
+typedef struct MctsStats{
+
+	unsigned long long rollouts;
+	unsigned long long ticks;		/* Ticks simulated in the tree and in rollouts */
+	int nodes;
+	int threads;
+	double seconds;
+	int visits[MCTS_ACTIONS];		/* Root visits of up, none and down */
+	float values[MCTS_ACTIONS];		/* Mean result of each root action, from -1 to 1 */
+
+} MctsStats;
+
+/* Opaque searcher type */
+typedef struct Mcts Mcts;
+
+/* Search function declarations. 'threads' of 0 or less uses every processor.
+   'opponent' plays the other paddle during the search. Returns NULL on failure. */
+Mcts *Mcts_create(int threads, int nodeCapacity, const Controller *opponent);
+void Mcts_destroy(Mcts *mcts);
+int Mcts_getThreadCount(const Mcts *mcts);
+
+/* Searches for 'budget' seconds and returns the best move for the given player's paddle:
+   -1 for up, 1 for down and 0 to stay. 'stats' may be NULL. */
+int Mcts_search(Mcts *mcts, const Match *match, int player, double budget, MctsStats *stats);
+
+#endif
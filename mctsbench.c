@@ -0,0 +1,181 @@
+/*
+   CPong
+   Search benchmark. Measures how many rollouts per second the tree search
+   reaches on 1, 2, 4, ... threads, and optionally plays the search against
+   a built-in controller to check its strength.
+
+   Usage: mctsbench [-budget <ms>] [-threads <count>] [-positions <count>]
+                    [-opponent <controller>] [-games <count>] [-seed <seed>]
+
+   The positions are taken from a tracker match at regular intervals and
+   searched with the same budget on every thread count. In games the
+   search plays the right paddle and searches again every
+   'MCTS_ACTION_TICKS' ticks, holding its move in between.
+*/
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "pong.h"
+#include "bot.h"
+#include "mcts.h"
+#include "pool.h"
+#include "timer.h"
+
+/* Benchmark property definitions */
+#define MAX_POSITIONS 1024
+#define POSITION_SPACING 37			/* Ticks between sampled positions */
+#define MAX_GAME_TICKS (10 * 60 * TICK_RATE)	/* A game still running after ten minutes is a draw */
+
+/* Function declarations */
+int samplePositions(Match *positions, int count, unsigned int seed);
+int runScaling(const Match *positions, int count, int threads, double budget, const Controller *opponent);
+int playGames(int games, int threads, double budget, const Controller *opponent, unsigned int seed);
+
+/* Program entrypoint */
+int main(int argc, char **argv){
+
+	double budget = MCTS_DEFAULT_BUDGET;
+	int threads = Pool_getCpuCount(), positionCount = 100, games = 0;
+	unsigned int seed = 1;
+	const char *opponentName = "predictor-hard";
+
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "-budget") == 0 && i + 1 < argc) budget = atof(argv[++i]) / 1000.0;
+		else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-positions") == 0 && i + 1 < argc) positionCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-opponent") == 0 && i + 1 < argc) opponentName = argv[++i];
+		else if(strcmp(argv[i], "-games") == 0 && i + 1 < argc) games = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc) seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else{
+			fprintf(stderr, "Usage: %s [-budget ms] [-threads n] [-positions n] [-opponent name] [-games n] [-seed n]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	const Controller *opponent = Controller_find(opponentName);
+	if(!opponent){
+		fprintf(stderr, "Unknown controller %s\n", opponentName);
+		return EXIT_FAILURE;
+	}
+	if(threads < 1 || budget <= 0.0 || positionCount < 1 || positionCount > MAX_POSITIONS){
+		fprintf(stderr, "Needs at least one thread, a positive budget and 1 to %d positions\n", MAX_POSITIONS);
+		return EXIT_FAILURE;
+	}
+
+	static Match positions[MAX_POSITIONS];
+	positionCount = samplePositions(positions, positionCount, seed);
+	if(!runScaling(positions, positionCount, threads, budget, opponent)) return EXIT_FAILURE;
+	if(games > 0 && !playGames(games, threads, budget, opponent, seed)) return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+
+}
+
+/* Fills 'positions' with rally states of a tracker match and returns how many were taken */
+int samplePositions(Match *positions, int count, unsigned int seed){
+
+	const Controller *tracker = Controller_find("tracker");
+	ControllerState p1State, p2State;
+	Match match;
+	Match_init(&match, seed);
+	Controller_reset(tracker, &p1State, seed);
+	Controller_reset(tracker, &p2State, ~seed);
+
+	int taken = 0;
+	for(unsigned int tick = 0; taken < count && tick < (unsigned int)count * POSITION_SPACING * 16; ++tick){
+		Match_tick(&match, Controller_getInput(tracker, &p1State, tracker, &p2State, &match));
+		if(match.gameState == 1 && tick % POSITION_SPACING == 0) positions[taken++] = match;
+	}
+
+	return taken;
+
+}
+
+/* Searches every position on 1, 2, 4, ... threads up to 'threads' and prints rollouts per second */
+int runScaling(const Match *positions, int count, int threads, double budget, const Controller *opponent){
+
+	fprintf(stdout, "%d positions, %.2f ms per search against %s\n\n", count, budget * 1000.0, opponent->name);
+	fprintf(stdout, "%8s %14s %12s %10s %8s %10s\n", "threads", "rollouts/s", "ticks/s", "nodes", "speedup", "efficiency");
+
+	double baseRate = 0.0;
+	for(int run = 1;; run = MIN(run * 2, threads)){
+
+		Mcts *mcts = Mcts_create(run, MCTS_DEFAULT_NODES, opponent);
+		if(!mcts){
+			fprintf(stderr, "Could not start %d threads\n", run);
+			return 0;
+		}
+
+		unsigned long long rollouts = 0, ticks = 0, nodes = 0;
+		double seconds = 0.0;
+		for(int i = 0; i < count; ++i){
+			MctsStats stats;
+			Mcts_search(mcts, &positions[i], 2, budget, &stats);
+			rollouts += stats.rollouts;
+			ticks += stats.ticks;
+			nodes += (unsigned long long)stats.nodes;
+			seconds += stats.seconds;
+		}
+		Mcts_destroy(mcts);
+
+		double rate = (double)rollouts / seconds;
+		if(run == 1) baseRate = rate;
+		fprintf(stdout, "%8d %14.0f %12.0f %10.0f %8.2f %10.2f\n", run, rate, (double)ticks / seconds,
+			(double)nodes / count, rate / baseRate, rate / baseRate / run);
+
+		if(run == threads) break;
+
+	}
+
+	return 1;
+
+}
+
+/* Plays games between the search on the right and the opponent controller on the left */
+int playGames(int games, int threads, double budget, const Controller *opponent, unsigned int seed){
+
+	Mcts *mcts = Mcts_create(threads, MCTS_DEFAULT_NODES, opponent);
+	if(!mcts){
+		fprintf(stderr, "Could not start %d threads\n", threads);
+		return 0;
+	}
+
+	int wins = 0, losses = 0, pointsFor = 0, pointsAgainst = 0;
+	for(int game = 0; game < games; ++game){
+
+		Match match;
+		ControllerState state;
+		Match_init(&match, seed + (unsigned int)game);
+		Controller_reset(opponent, &state, seed + (unsigned int)game);
+
+		int move = 0;
+		for(int tick = 0; tick < MAX_GAME_TICKS; ++tick){
+			if(tick % MCTS_ACTION_TICKS == 0) move = Mcts_search(mcts, &match, 2, budget, NULL);
+			Input input = INPUT_START;
+			int opponentMove = Controller_move(opponent, &state, &match, 1);
+			if(opponentMove < 0) input |= INPUT_P1_UP;
+			else if(opponentMove > 0) input |= INPUT_P1_DOWN;
+			if(move < 0) input |= INPUT_P2_UP;
+			else if(move > 0) input |= INPUT_P2_DOWN;
+			Match_tick(&match, input);
+			if(match.events & MATCH_EVENT_GAME_OVER) break;
+		}
+
+		int winner = Match_getWinner(&match);
+		if(winner == 2) ++wins;
+		else if(winner == 1) ++losses;
+		pointsFor += match.p2.score;
+		pointsAgainst += match.p1.score;
+
+	}
+
+	Mcts_destroy(mcts);
+	fprintf(stdout, "\nsearch against %s: %d wins, %d losses, %d draws, points %d to %d\n",
+		opponent->name, wins, losses, games - wins - losses, pointsFor, pointsAgainst);
+	return 1;
+
+}
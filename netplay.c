@@ -0,0 +1,294 @@
+/*
+   CPong
+   Rollback netcode for two-player matches. See netplay.h.
+*/
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+/* Standard C includes */
+#include <string.h>
+
+/* Platform includes */
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+/* Local includes */
+#include "netplay.h"
+#include "timer.h"
+
+/* Packet definitions */
+#define NETPLAY_MAGIC_0 'C'
+#define NETPLAY_MAGIC_1 'N'
+#define NETPLAY_MASK (NETPLAY_WINDOW - 1)
+
+/* Static function declarations */
+static NetInput NetSession_getRemoteInput(const NetSession *session, unsigned int tick);
+static void putU32(unsigned char *bytes, unsigned int value);
+static unsigned int getU32(const unsigned char *bytes);
+
+/* Starts a session for the given local player. Player one starts at once, player two once player one's seed arrives. */
+void NetSession_init(NetSession *session, int localPlayer, unsigned int seed){
+
+	memset(session, 0, sizeof(*session));
+	session->localPlayer = localPlayer;
+	session->seed = seed;
+	session->synchronized = (localPlayer == 1);
+	Match_init(&session->match, seed);
+
+}
+
+/* Reads a packet from the other peer. Returns 0 if it is malformed or belongs to another match. */
+int NetSession_receive(NetSession *session, const unsigned char *packet, size_t size){
+
+	if(size < NETPLAY_HEADER_SIZE || packet[0] != NETPLAY_MAGIC_0 || packet[1] != NETPLAY_MAGIC_1) return 0;
+	if(packet[2] != 3 - session->localPlayer || size < NETPLAY_HEADER_SIZE + (size_t)packet[3]) return 0;
+
+	unsigned int seed = getU32(packet + 4);
+	if(!session->synchronized){
+		session->seed = seed;
+		session->synchronized = 1;
+		Match_init(&session->match, seed);
+	}else if(seed != session->seed){
+		return 0;
+	}
+
+	/* The remote may acknowledge more of our input, never less */
+	unsigned int ack = getU32(packet + 12);
+	if(ack > session->ackedCount && ack <= session->tick) session->ackedCount = ack;
+
+	/* Take the inputs that extend the contiguous run received so far, skipping repeats */
+	unsigned int first = getU32(packet + 8);
+	for(unsigned int i = 0; i < packet[3]; ++i){
+		unsigned int tick = first + i;
+		if(tick < session->remoteCount) continue;
+		if(tick > session->remoteCount || tick >= session->tick + NETPLAY_WINDOW / 2) break;
+
+		NetInput input = packet[NETPLAY_HEADER_SIZE + i];
+		session->remoteInputs[tick & NETPLAY_MASK] = input;
+		++session->remoteCount;
+
+		/* A tick already simulated with a different guess has to be replayed */
+		if(tick < session->tick && session->usedInputs[tick & NETPLAY_MASK] != input)
+			session->rollbackTick = MIN(session->rollbackTick, tick);
+	}
+
+	return 1;
+
+}
+
+/* Writes the packet to send this tick and returns its size. Returns 0 while there is nothing to say yet. */
+size_t NetSession_buildPacket(const NetSession *session, unsigned char *packet){
+
+	if(!session->synchronized) return 0;
+
+	unsigned int count = session->tick - session->ackedCount;
+	packet[0] = NETPLAY_MAGIC_0;
+	packet[1] = NETPLAY_MAGIC_1;
+	packet[2] = (unsigned char)session->localPlayer;
+	packet[3] = (unsigned char)count;
+	putU32(packet + 4, session->seed);
+	putU32(packet + 8, session->ackedCount);
+	putU32(packet + 12, session->remoteCount);
+	for(unsigned int i = 0; i < count; ++i)
+		packet[NETPLAY_HEADER_SIZE + i] = session->localInputs[(session->ackedCount + i) & NETPLAY_MASK];
+
+	return NETPLAY_HEADER_SIZE + count;
+
+}
+
+/* Simulates one tick with the local input and the predicted remote input.
+   Returns 0 without simulating while the session is too far ahead of the other peer. */
+int NetSession_advance(NetSession *session, NetInput input){
+
+	if(!session->synchronized) return 0;
+
+	NetSession_rollback(session);
+
+	/* Stall rather than predict further than the snapshots reach, or send more input than fits a packet */
+	if(session->tick >= session->remoteCount + NETPLAY_MAX_PREDICTION ||
+		session->tick - session->ackedCount >= NETPLAY_WINDOW / 2){
+		++session->stats.stalls;
+		return 0;
+	}
+
+	unsigned int slot = session->tick & NETPLAY_MASK;
+	NetInput remote = NetSession_getRemoteInput(session, session->tick);
+	session->localInputs[slot] = input;
+	session->usedInputs[slot] = remote;
+	session->snapshots[slot] = session->match;
+	Match_tick(&session->match, NetSession_combine(session->localPlayer, input, remote));
+
+	++session->tick;
+	session->rollbackTick = session->tick;
+	++session->stats.ticks;
+	return 1;
+
+}
+
+/* Re-simulates from the first mispredicted tick, if any, with the inputs known now */
+void NetSession_rollback(NetSession *session){
+
+	session->stats.lastDepth = 0;
+	session->stats.lastResimulationNanos = 0;
+	if(session->rollbackTick >= session->tick){
+		session->rollbackTick = session->tick;
+		return;
+	}
+
+	unsigned long long start = Timer_now();
+	unsigned int depth = session->tick - session->rollbackTick;
+
+	session->match = session->snapshots[session->rollbackTick & NETPLAY_MASK];
+	for(unsigned int tick = session->rollbackTick; tick < session->tick; ++tick){
+		unsigned int slot = tick & NETPLAY_MASK;
+		NetInput remote = NetSession_getRemoteInput(session, tick);
+		session->usedInputs[slot] = remote;
+		session->snapshots[slot] = session->match;
+		Match_tick(&session->match, NetSession_combine(session->localPlayer, session->localInputs[slot], remote));
+	}
+	session->rollbackTick = session->tick;
+
+	unsigned long long nanos = Timer_now() - start;
+	NetStats *stats = &session->stats;
+	++stats->rollbacks;
+	stats->resimulatedTicks += depth;
+	stats->resimulationNanos += nanos;
+	++stats->depthHistogram[MIN(depth, NETPLAY_MAX_PREDICTION)];
+	stats->maxDepth = MAX(stats->maxDepth, depth);
+	stats->lastDepth = depth;
+	stats->lastResimulationNanos = nanos;
+
+}
+
+/* Merges the inputs of both players into the input of one tick */
+Input NetSession_combine(int localPlayer, NetInput local, NetInput remote){
+
+	NetInput p1 = (localPlayer == 1) ? local : remote;
+	NetInput p2 = (localPlayer == 1) ? remote : local;
+	Input input = 0;
+	if(p1 & NET_INPUT_UP) input |= INPUT_P1_UP;
+	if(p1 & NET_INPUT_DOWN) input |= INPUT_P1_DOWN;
+	if(p2 & NET_INPUT_UP) input |= INPUT_P2_UP;
+	if(p2 & NET_INPUT_DOWN) input |= INPUT_P2_DOWN;
+	if((p1 | p2) & NET_INPUT_START) input |= INPUT_START;
+	return input;
+
+}
+
+/* Returns the remote input of a tick, or the last one received as the prediction if it has not arrived */
+static NetInput NetSession_getRemoteInput(const NetSession *session, unsigned int tick){
+
+	if(tick < session->remoteCount) return session->remoteInputs[tick & NETPLAY_MASK];
+	if(session->remoteCount == 0) return 0;
+	return session->remoteInputs[(session->remoteCount - 1) & NETPLAY_MASK];
+
+}
+
+/* Opens a non-blocking UDP socket on the local port, talking to the given peer */
+int NetSocket_open(NetSocket *sock, unsigned short port, const char *peerHost, unsigned short peerPort){
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if(WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return 0;
+#endif
+
+	struct addrinfo hints, *result;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if(getaddrinfo(peerHost, NULL, &hints, &result) != 0) return 0;
+	sock->peerAddress = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+	sock->peerPort = htons(peerPort);
+	freeaddrinfo(result);
+
+#ifdef _WIN32
+	SOCKET handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(handle == INVALID_SOCKET) return 0;
+	u_long nonBlocking = 1;
+	ioctlsocket(handle, FIONBIO, &nonBlocking);
+#else
+	int handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(handle < 0) return 0;
+	fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+	sock->handle = (long long)handle;
+
+	struct sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(port);
+	if(bind(handle, (struct sockaddr*)&local, sizeof(local)) != 0){
+		NetSocket_close(sock);
+		return 0;
+	}
+
+	return 1;
+
+}
+
+/* Sends one datagram to the peer */
+int NetSocket_send(const NetSocket *sock, const unsigned char *data, size_t size){
+
+	struct sockaddr_in peer;
+	memset(&peer, 0, sizeof(peer));
+	peer.sin_family = AF_INET;
+	peer.sin_addr.s_addr = sock->peerAddress;
+	peer.sin_port = sock->peerPort;
+	return sendto(sock->handle, (const char*)data, (int)size, 0, (struct sockaddr*)&peer, sizeof(peer)) == (int)size;
+
+}
+
+/* Receives one datagram from the peer. Returns 0 when none is waiting. */
+size_t NetSocket_receive(const NetSocket *sock, unsigned char *buffer, size_t capacity){
+
+	for(;;){
+		struct sockaddr_in from;
+		socklen_t fromSize = sizeof(from);
+		int size = (int)recvfrom(sock->handle, (char*)buffer, (int)capacity, 0, (struct sockaddr*)&from, &fromSize);
+		if(size <= 0) return 0;
+
+		/* Datagrams from anyone but the peer are dropped */
+		if(from.sin_addr.s_addr == sock->peerAddress && from.sin_port == sock->peerPort) return (size_t)size;
+	}
+
+}
+
+/* Closes the socket */
+void NetSocket_close(NetSocket *sock){
+
+#ifdef _WIN32
+	closesocket((SOCKET)sock->handle);
+	WSACleanup();
+#else
+	close((int)sock->handle);
+#endif
+
+}
+
+/* Stores a little-endian 32 bit integer */
+static void putU32(unsigned char *bytes, unsigned int value){
+
+	bytes[0] = value & 0xff; bytes[1] = (value >> 8) & 0xff;
+	bytes[2] = (value >> 16) & 0xff; bytes[3] = (value >> 24) & 0xff;
+
+}
+
+/* Loads a little-endian 32 bit integer */
+static unsigned int getU32(const unsigned char *bytes){
+
+	return (unsigned int)bytes[0] | ((unsigned int)bytes[1] << 8) |
+		((unsigned int)bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+
+}
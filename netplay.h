@@ -0,0 +1,108 @@
+/*
+   CPong
+   Rollback netcode for two-player matches.
+
+   Each peer runs the full simulation. A peer's own input is applied on
+   the tick it is read, so there is no added input delay. The other
+   player's input for ticks that have not arrived yet is predicted by
+   repeating the last input received. When the real input arrives and
+   differs from the prediction, the session restores the match snapshot
+   taken before the first wrong tick and re-simulates up to the present.
+
+   The session itself does not touch the network: packets built by
+   'NetSession_buildPacket' are sent however the caller likes and
+   received packets are handed to 'NetSession_receive'. Every packet
+   repeats all inputs the other side has not acknowledged yet, so lost
+   packets are covered by the next one. 'NetSocket' is a minimal
+   non-blocking UDP transport for real play.
+
+   Packet layout, all integers little-endian:
+
+   "CN", u8 sender player, u8 input count, u32 seed, u32 first tick,
+   u32 ack (ticks of the receiver's input known to the sender),
+   count * u8 input
+*/
+
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <stddef.h>
+
+#include "pong.h"
+
+/* Input bits of one player, in the same terms as the keyboard */
+typedef unsigned char NetInput;
+
+#define NET_INPUT_UP 0x01
+#define NET_INPUT_DOWN 0x02
+#define NET_INPUT_START 0x04
+
+/* Number of ticks of input and snapshots kept. Must be a power of two. */
+#define NETPLAY_WINDOW 128
+
+/* Furthest the simulation may run ahead of the other player's inputs, in ticks.
+   Eight ticks cover about 130 ms of one-way delay; past that the session stalls. */
+#define NETPLAY_MAX_PREDICTION 8
+
+/* Largest packet 'NetSession_buildPacket' produces */
+#define NETPLAY_HEADER_SIZE 16
+#define NETPLAY_MAX_PACKET (NETPLAY_HEADER_SIZE + NETPLAY_WINDOW / 2)
+
+/* Define the 'NetStats' struct with rollback measurements. The 'last' fields describe the latest advance. */
+typedef struct NetStats{
+
+	unsigned long long ticks;		/* Ticks simulated for the first time */
+	unsigned long long stalls;		/* Advances refused for running too far ahead */
+	unsigned long long rollbacks;
+	unsigned long long resimulatedTicks;
+	unsigned long long resimulationNanos;
+	unsigned int depthHistogram[NETPLAY_MAX_PREDICTION + 1];
+	unsigned int maxDepth;
+	unsigned int lastDepth;
+	unsigned long long lastResimulationNanos;
+
+} NetStats;
+
+/* Define the 'NetSession' struct holding one peer's view of a networked match */
+typedef struct NetSession{
+
+	Match match;				/* State after the last simulated tick */
+	int localPlayer;			/* 1 or 2 */
+	int synchronized;			/* Player two waits for the seed from player one */
+	unsigned int seed;
+	unsigned int tick;			/* Ticks simulated so far */
+	unsigned int remoteCount;		/* Ticks of remote input received */
+	unsigned int ackedCount;		/* Ticks of local input the remote has received */
+	unsigned int rollbackTick;		/* Earliest mispredicted tick, or 'tick' if none */
+	NetInput localInputs[NETPLAY_WINDOW];
+	NetInput remoteInputs[NETPLAY_WINDOW];
+	NetInput usedInputs[NETPLAY_WINDOW];	/* Remote input each simulated tick was run with */
+	Match snapshots[NETPLAY_WINDOW];	/* State before each tick */
+	NetStats stats;
+
+} NetSession;
+
+/* Session function declarations. Player one picks the seed; player two's is ignored. */
+void NetSession_init(NetSession *session, int localPlayer, unsigned int seed);
+int NetSession_receive(NetSession *session, const unsigned char *packet, size_t size);
+size_t NetSession_buildPacket(const NetSession *session, unsigned char *packet);
+int NetSession_advance(NetSession *session, NetInput input);
+void NetSession_rollback(NetSession *session);
+Input NetSession_combine(int localPlayer, NetInput local, NetInput remote);
+
+/* Define the 'NetSocket' struct, a non-blocking UDP socket talking to one peer */
+typedef struct NetSocket{
+
+	long long handle;
+	unsigned int peerAddress;		/* IPv4 address in network byte order */
+	unsigned short peerPort;		/* Network byte order */
+
+} NetSocket;
+
+/* Socket function declarations. Functions returning int return nonzero on success. */
+int NetSocket_open(NetSocket *sock, unsigned short port, const char *peerHost, unsigned short peerPort);
+int NetSocket_send(const NetSocket *sock, const unsigned char *data, size_t size);
+size_t NetSocket_receive(const NetSocket *sock, unsigned char *buffer, size_t capacity);
+void NetSocket_close(NetSocket *sock);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+   CPong
+   Loopback test harness for the rollback netcode. Two sessions play a
+   match in one process, driven by bot controllers, over a simulated link
+   that adds latency, jitter and packet loss. Time is simulated too, so
+   runs are repeatable and finish as fast as the machine allows.
+
+   After the match both peers must hold exactly the state that a plain
+   simulation of the inputs they sent produces. The harness reports how
+   often and how deep the sessions rolled back and what the
+   re-simulation cost per frame.
+
+   Usage: nettest [-rtt <ms>] [-jitter <ms>] [-loss <percent>]
+                  [-ticks <count>] [-seed <seed>] [-p1 <bot>] [-p2 <bot>]
+                  [-sweep]
+
+   -sweep repeats the run for round trip times from 0 to 250 ms.
+*/
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "pong.h"
+#include "bot.h"
+#include "netplay.h"
+
+/* Harness property definitions */
+#define TICK_MS (1000.0 / TICK_RATE)
+#define LINK_CAPACITY 1024			/* Packets in flight per direction */
+#define DRAIN_LIMIT (10 * TICK_RATE)		/* Frames allowed for the last inputs to arrive */
+
+/* Define the 'Packet' struct for a datagram in flight */
+typedef struct Packet{
+
+	double deliverAt;
+	size_t size;
+	unsigned char data[NETPLAY_MAX_PACKET];
+
+} Packet;
+
+/* Define the 'Link' struct, one direction of the simulated network */
+typedef struct Link{
+
+	Packet packets[LINK_CAPACITY];
+	int count;
+
+} Link;
+
+/* Define the 'Conditions' struct describing the simulated network */
+typedef struct Conditions{
+
+	double rtt;
+	double jitter;
+	double loss;
+
+} Conditions;
+
+/* Define the 'Peer' struct, one side of the match with its bot */
+typedef struct Peer{
+
+	NetSession session;
+	const Controller *controller;
+	ControllerState state;
+	NetInput *inputs;			/* Input sent for every simulated tick */
+	Link *outgoing;
+
+} Peer;
+
+/* Function declarations */
+double randomUnit(unsigned int *rng);
+void Link_send(Link *link, const unsigned char *data, size_t size, double now, const Conditions *conditions, unsigned int *rng);
+void Link_deliver(Link *link, NetSession *session, double now);
+int runScenario(const Conditions *conditions, unsigned int ticks, unsigned int seed, const Controller *p1, const Controller *p2);
+int compareNanos(const void *a, const void *b);
+
+/* Program entrypoint */
+int main(int argc, char **argv){
+
+	Conditions conditions = {100.0, 10.0, 2.0};
+	unsigned int ticks = 60 * TICK_RATE, seed = 1;
+	const char *p1Name = "tracker", *p2Name = "jitter";
+	int sweep = 0;
+
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "-rtt") == 0 && i + 1 < argc) conditions.rtt = atof(argv[++i]);
+		else if(strcmp(argv[i], "-jitter") == 0 && i + 1 < argc) conditions.jitter = atof(argv[++i]);
+		else if(strcmp(argv[i], "-loss") == 0 && i + 1 < argc) conditions.loss = atof(argv[++i]);
+		else if(strcmp(argv[i], "-ticks") == 0 && i + 1 < argc) ticks = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc) seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-p1") == 0 && i + 1 < argc) p1Name = argv[++i];
+		else if(strcmp(argv[i], "-p2") == 0 && i + 1 < argc) p2Name = argv[++i];
+		else if(strcmp(argv[i], "-sweep") == 0) sweep = 1;
+		else{
+			fprintf(stderr, "Usage: %s [-rtt ms] [-jitter ms] [-loss percent] [-ticks n] [-seed n] "
+				"[-p1 bot] [-p2 bot] [-sweep]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	const Controller *p1 = Controller_find(p1Name), *p2 = Controller_find(p2Name);
+	if(!p1 || !p2){
+		fprintf(stderr, "Unknown controller %s\n", p1 ? p2Name : p1Name);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stdout, "%6s %6s %6s %7s %10s %6s %6s %10s %9s %9s %9s %6s\n", "rtt", "jitter", "loss",
+		"stall%", "rollback/s", "depth", "max", "resim/tick", "us mean", "us p99", "us max", "sync");
+
+	int ok = 1;
+	if(sweep){
+		for(int rtt = 0; rtt <= 250; rtt += 25){
+			conditions.rtt = rtt;
+			ok &= runScenario(&conditions, ticks, seed, p1, p2);
+		}
+	}else{
+		ok = runScenario(&conditions, ticks, seed, p1, p2);
+	}
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
+
+/* Returns a uniform random number in [0, 1) */
+double randomUnit(unsigned int *rng){
+
+	*rng ^= *rng << 13; *rng ^= *rng >> 17; *rng ^= *rng << 5;
+	return (*rng >> 8) / 16777216.0;
+
+}
+
+/* Puts a packet on the link, or drops it */
+void Link_send(Link *link, const unsigned char *data, size_t size, double now, const Conditions *conditions, unsigned int *rng){
+
+	if(size == 0 || link->count == LINK_CAPACITY) return;
+	if(randomUnit(rng) * 100.0 < conditions->loss) return;
+
+	double delay = conditions->rtt / 2.0 + (randomUnit(rng) * 2.0 - 1.0) * conditions->jitter;
+	Packet *packet = &link->packets[link->count++];
+	packet->deliverAt = now + MAX(delay, 0.0);
+	packet->size = size;
+	memcpy(packet->data, data, size);
+
+}
+
+/* Hands every packet that has arrived by now to the receiving session. Jitter may reorder them. */
+void Link_deliver(Link *link, NetSession *session, double now){
+
+	int kept = 0;
+	for(int i = 0; i < link->count; ++i){
+		if(link->packets[i].deliverAt <= now) NetSession_receive(session, link->packets[i].data, link->packets[i].size);
+		else link->packets[kept++] = link->packets[i];
+	}
+	link->count = kept;
+
+}
+
+/* Plays one match under the given conditions and prints its row. Returns 0 if the peers desynchronized. */
+int runScenario(const Conditions *conditions, unsigned int ticks, unsigned int seed, const Controller *p1, const Controller *p2){
+
+	static Link links[2];
+	Peer peers[2];
+	unsigned int rng = seed * 2654435761u + 1;
+	unsigned long long *samples = malloc(sizeof(unsigned long long) * ((size_t)ticks * 4 + DRAIN_LIMIT) * 2);
+	NetInput *inputs = calloc((size_t)ticks * 2, sizeof(NetInput));
+	if(!samples || !inputs){
+		fprintf(stderr, "Out of memory\n");
+		free(samples);
+		free(inputs);
+		return 0;
+	}
+	size_t sampleCount = 0;
+
+	for(int i = 0; i < 2; ++i){
+		Peer *peer = &peers[i];
+		NetSession_init(&peer->session, i + 1, seed);
+		peer->controller = (i == 0) ? p1 : p2;
+		Controller_reset(peer->controller, &peer->state, seed + (unsigned int)i);
+		peer->inputs = inputs + (size_t)i * ticks;
+		peer->outgoing = &links[i];
+		links[i].count = 0;
+	}
+
+	/* Play until both peers simulated every tick, then let the last inputs arrive */
+	unsigned int frame = 0, frameLimit = ticks * 4 + DRAIN_LIMIT, drainFrames = 0;
+	for(; frame < frameLimit; ++frame){
+
+		double now = frame * TICK_MS;
+		Link_deliver(&links[0], &peers[1].session, now);
+		Link_deliver(&links[1], &peers[0].session, now);
+
+		int playing = 0;
+		for(int i = 0; i < 2; ++i){
+			Peer *peer = &peers[i];
+			NetSession *session = &peer->session;
+
+			if(session->tick < ticks){
+				playing = 1;
+				int move = Controller_move(peer->controller, &peer->state, &session->match, i + 1);
+				NetInput input = NET_INPUT_START;
+				if(move < 0) input |= NET_INPUT_UP;
+				if(move > 0) input |= NET_INPUT_DOWN;
+
+				unsigned int tick = session->tick;
+				if(NetSession_advance(session, input)) peer->inputs[tick] = input;
+			}else{
+				NetSession_rollback(session);
+			}
+			if(session->stats.lastDepth > 0) samples[sampleCount++] = session->stats.lastResimulationNanos;
+
+			unsigned char packet[NETPLAY_MAX_PACKET];
+			Link_send(peer->outgoing, packet, NetSession_buildPacket(session, packet), now, conditions, &rng);
+		}
+
+		if(!playing){
+			if(peers[0].session.remoteCount == ticks && peers[1].session.remoteCount == ticks) break;
+			if(++drainFrames == DRAIN_LIMIT) break;
+		}
+
+	}
+
+	/* Both peers must match each other and a plain simulation of the inputs they sent */
+	Match reference;
+	Match_init(&reference, seed);
+	for(unsigned int tick = 0; tick < ticks; ++tick)
+		Match_tick(&reference, NetSession_combine(1, peers[0].inputs[tick], peers[1].inputs[tick]));
+
+	int synced = 1;
+	for(int i = 0; i < 2; ++i){
+		NetSession_rollback(&peers[i].session);
+		if(peers[i].session.tick != ticks || peers[i].session.remoteCount != ticks ||
+			memcmp(&peers[i].session.match, &reference, sizeof(Match)) != 0) synced = 0;
+	}
+
+	/* Combine the statistics of both peers */
+	unsigned long long stalls = 0, rollbacks = 0, resimulated = 0, nanos = 0;
+	unsigned int maxDepth = 0;
+	for(int i = 0; i < 2; ++i){
+		const NetStats *stats = &peers[i].session.stats;
+		stalls += stats->stalls;
+		rollbacks += stats->rollbacks;
+		resimulated += stats->resimulatedTicks;
+		nanos += stats->resimulationNanos;
+		maxDepth = MAX(maxDepth, stats->maxDepth);
+	}
+
+	qsort(samples, sampleCount, sizeof(unsigned long long), compareNanos);
+	double p99 = sampleCount ? samples[(sampleCount - 1) * 99 / 100] / 1000.0 : 0.0;
+	double worst = sampleCount ? samples[sampleCount - 1] / 1000.0 : 0.0;
+	double seconds = (double)ticks / TICK_RATE;
+
+	fprintf(stdout, "%6.0f %6.0f %6.1f %7.2f %10.2f %6.2f %6u %10.3f %9.2f %9.2f %9.2f %6s\n",
+		conditions->rtt, conditions->jitter, conditions->loss,
+		100.0 * (double)stalls / (double)(stalls + 2ull * ticks),
+		(double)rollbacks / 2.0 / seconds,
+		rollbacks ? (double)resimulated / (double)rollbacks : 0.0, maxDepth,
+		(double)resimulated / (2.0 * ticks),
+		rollbacks ? (double)nanos / (double)rollbacks / 1000.0 : 0.0, p99, worst,
+		synced ? "yes" : "NO");
+
+	free(samples);
+	free(inputs);
+	return synced;
+
+}
+
+/* Orders nanosecond samples ascending */
+int compareNanos(const void *a, const void *b){
+
+	unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+
+}
@@ -0,0 +1,153 @@
+/*
+   CPong
+   On-screen frame timing overlay. See overlay.h.
+*/
+
+/* Standard C includes */
+#include <stdio.h>
+
+/* Local includes */
+#include "pong.h"
+#include "overlay.h"
+#include "timer.h"
+
+/* Layout definitions, in pixels */
+#define OVERLAY_X 10.0f
+#define OVERLAY_Y 10.0f
+#define OVERLAY_BAR_WIDTH 1.5f
+#define OVERLAY_HEIGHT 120.0f
+#define OVERLAY_GAP 10.0f
+#define OVERLAY_HISTOGRAM_WIDTH 120.0f
+
+/* Frame time at the top of the graph and per histogram bucket, in nanoseconds */
+#define OVERLAY_RANGE 33333333ull
+#define OVERLAY_BUCKETS 40
+#define OVERLAY_BUCKET_SIZE (OVERLAY_RANGE / OVERLAY_BUCKETS)
+
+/* Nanoseconds between window title updates */
+#define OVERLAY_TITLE_INTERVAL 500000000ull
+
+/* Static function declarations */
+static void addQuad(sfVertexArray *vertices, float x, float y, float width, float height, sfColor color);
+static float toHeight(unsigned long long nanos);
+
+/* Creates the overlay, hidden */
+int Overlay_create(Overlay *overlay){
+
+	overlay->vertices = sfVertexArray_create();
+	if(!overlay->vertices) return 0;
+	sfVertexArray_setPrimitiveType(overlay->vertices, sfQuads);
+	overlay->visible = 0;
+	overlay->titleTime = 0;
+	overlay->title[0] = '\0';
+	overlay->titleChanged = 0;
+	overlay->tickTime = 0;
+	return 1;
+
+}
+
+/* Frees the overlay */
+void Overlay_destroy(Overlay *overlay){
+
+	sfVertexArray_destroy(overlay->vertices);
+
+}
+
+/* Shows or hides the overlay. The profiler only runs while the overlay is shown or a trace is written. */
+void Overlay_setVisible(Overlay *overlay, int visible){
+
+	overlay->visible = visible;
+	profiler.enabled = visible || profiler.trace;
+	overlay->titleTime = 0;
+	if(!visible){
+		snprintf(overlay->title, sizeof(overlay->title), "CPong");
+		overlay->titleChanged = 1;
+	}
+
+}
+
+/* Draws the overlay if it is shown */
+void Overlay_draw(Overlay *overlay, sfRenderWindow *window){
+
+	if(!overlay->visible) return;
+
+	static const sfColor phaseColors[PHASE_COUNT] = {
+		{150, 150, 150, 255}, {200, 120, 255, 255}, {80, 200, 80, 255}, {80, 140, 255, 255}, {255, 160, 40, 255}
+	};
+
+	ProfileStats stats;
+	Profile_getStats(&stats);
+	sfVertexArray *vertices = overlay->vertices;
+	sfVertexArray_clear(vertices);
+
+	float graphWidth = PROFILE_HISTORY * OVERLAY_BAR_WIDTH;
+	float bottom = OVERLAY_Y + OVERLAY_HEIGHT;
+	addQuad(vertices, OVERLAY_X - 4.0f, OVERLAY_Y - 4.0f, graphWidth + OVERLAY_GAP + OVERLAY_HISTOGRAM_WIDTH + 8.0f,
+		OVERLAY_HEIGHT + 8.0f, sfColor_fromRGBA(0, 0, 0, 180));
+
+	/* Frame bars, oldest on the left, stacked by phase from the bottom */
+	unsigned int first = profiler.frameCount - stats.frames;
+	unsigned int histogram[OVERLAY_BUCKETS] = {0}, tallest = 1;
+	for(unsigned int i = 0; i < stats.frames; ++i){
+		const ProfileFrame *frame = &profiler.history[(first + i) % PROFILE_HISTORY];
+		float x = OVERLAY_X + (PROFILE_HISTORY - stats.frames + i) * OVERLAY_BAR_WIDTH, y = bottom;
+		for(int phase = 0; phase < PHASE_COUNT && y > OVERLAY_Y; ++phase){
+			float height = MIN(toHeight(frame->phases[phase]), y - OVERLAY_Y);
+			addQuad(vertices, x, y - height, OVERLAY_BAR_WIDTH, height, phaseColors[phase]);
+			y -= height;
+		}
+
+		unsigned int bucket = (unsigned int)MIN(frame->total / OVERLAY_BUCKET_SIZE, OVERLAY_BUCKETS - 1);
+		if(++histogram[bucket] > tallest) tallest = histogram[bucket];
+	}
+
+	/* Reference lines: one 60 Hz frame, then the percentiles */
+	addQuad(vertices, OVERLAY_X, bottom - toHeight(1000000000ull / 60), graphWidth, 1.0f, sfWhite);
+	addQuad(vertices, OVERLAY_X, bottom - toHeight(stats.p50), graphWidth, 1.0f, sfGreen);
+	addQuad(vertices, OVERLAY_X, bottom - toHeight(stats.p99), graphWidth, 1.0f, sfYellow);
+	addQuad(vertices, OVERLAY_X, bottom - toHeight(stats.max), graphWidth, 1.0f, sfRed);
+
+	/* Histogram of frame times, on the same vertical scale as the graph */
+	float histogramX = OVERLAY_X + graphWidth + OVERLAY_GAP;
+	float bucketHeight = OVERLAY_HEIGHT / OVERLAY_BUCKETS;
+	for(int bucket = 0; bucket < OVERLAY_BUCKETS; ++bucket){
+		if(histogram[bucket] == 0) continue;
+		float width = OVERLAY_HISTOGRAM_WIDTH * histogram[bucket] / tallest;
+		addQuad(vertices, histogramX, bottom - (bucket + 1) * bucketHeight, width, bucketHeight - 1.0f, sfCyan);
+	}
+
+	sfRenderWindow_drawVertexArray(window, vertices, NULL);
+
+	/* Numbers go to the title, a couple of times per second */
+	unsigned long long now = Timer_now();
+	if(now - overlay->titleTime >= OVERLAY_TITLE_INTERVAL){
+		snprintf(overlay->title, sizeof(overlay->title), "CPong - frame p50 %.2f ms, p99 %.2f ms, max %.2f ms | sim %.2f ms, draw %.2f ms, display %.2f ms",
+			stats.p50 / 1e6, stats.p99 / 1e6, stats.max / 1e6,
+			(overlay->tickTime ? overlay->tickTime : stats.phaseMeans[PHASE_SIMULATION]) / 1e6,
+			stats.phaseMeans[PHASE_DRAW] / 1e6, stats.phaseMeans[PHASE_DISPLAY] / 1e6);
+		overlay->titleChanged = 1;
+		overlay->titleTime = now;
+	}
+
+}
+
+/* Appends an axis aligned rectangle */
+static void addQuad(sfVertexArray *vertices, float x, float y, float width, float height, sfColor color){
+
+	sfVertex vertex = {{x, y}, color, {0.0f, 0.0f}};
+	sfVertexArray_append(vertices, vertex);
+	vertex.position.x = x + width;
+	sfVertexArray_append(vertices, vertex);
+	vertex.position.y = y + height;
+	sfVertexArray_append(vertices, vertex);
+	vertex.position.x = x;
+	sfVertexArray_append(vertices, vertex);
+
+}
+
+/* Converts a duration to a height in the graph, clamped to the top */
+static float toHeight(unsigned long long nanos){
+
+	return OVERLAY_HEIGHT * (float)MIN(nanos, OVERLAY_RANGE) / (float)OVERLAY_RANGE;
+
+}
@@ -0,0 +1,44 @@
+/*
+   CPong
+   On-screen frame timing overlay.
+
+   Shows the last PROFILE_HISTORY frames as bars stacked by phase, with
+   lines at the p50, p99 and max frame time and at one 60 Hz frame, and a
+   histogram of frame times next to it. The numbers themselves go to the
+   window title. Everything is drawn from one vertex array.
+
+   The overlay only writes the title text; the front end sets it on the
+   window once 'titleChanged' is set, from the thread that owns the
+   window.
+*/
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <SFML/Graphics.h>
+
+#include "profile.h"
+
+/* Longest window title the overlay writes, with the terminator */
+#define OVERLAY_TITLE_LENGTH 160
+
+/* Define the 'Overlay' struct */
+typedef struct Overlay{
+
+	sfVertexArray *vertices;
+	int visible;
+	unsigned long long titleTime;		/* When the title was last updated */
+	char title[OVERLAY_TITLE_LENGTH];
+	int titleChanged;			/* Set when 'title' changed, cleared by the front end once it is shown */
+	unsigned long long tickTime;		/* Mean tick time of a simulation running on another thread, or 0 to show
+						   the simulation phase of the frames */
+
+} Overlay;
+
+/* Overlay function declarations. Functions returning int return nonzero on success. */
+int Overlay_create(Overlay *overlay);
+void Overlay_destroy(Overlay *overlay);
+void Overlay_setVisible(Overlay *overlay, int visible);
+void Overlay_draw(Overlay *overlay, sfRenderWindow *window);
+
+#endif
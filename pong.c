@@ -0,0 +1,761 @@
+/*
+   CPong
+   Headless simulation core. See pong.h for an overview.
+*/
+
+/* Standard C includes */
+#include <stdlib.h>
+#include <math.h>
+
+/* Local includes */
+#include "pong.h"
+#include "layout.h"
+
+/* Largest scalar, standing in for an infinite time */
+#ifdef PONG_FIXED
+#define SCALAR_INFINITY SCALAR_MAX
+#else
+#define SCALAR_INFINITY INFINITY
+#endif
+
+/* Branch counters, compiled in only when PONG_BRANCH_STATS is defined */
+#ifdef PONG_BRANCH_STATS
+unsigned long long branchHits[BRANCH_COUNT];
+#define COUNT_BRANCH(branch) (++branchHits[branch])
+#else
+#define COUNT_BRANCH(branch) ((void)0)
+#endif
+
+/* Static function declarations */
+static void Match_serve(Match *match);
+static void Match_movePaddle(Paddle *paddle, Scalar distance, int *dir, int step);
+static void Match_updateRound(Match *match, const Layout *layout, Input input, MatchContacts *trace);
+static void Match_moveBall(Match *match, const Layout *layout, MatchContacts *trace);
+static void Match_returnBall(Ball *ball, const Paddle *paddle, Side side);
+static void Match_hitObstacle(Match *match, const Obstacle *obstacle, Side side);
+#ifdef PONG_FIXED
+static uint64_t squareRoot(uint64_t value);
+#endif
+
+/* Returns the distance between the two passed points */
+Scalar Point_getDistance(Point a, Point b){
+
+#ifdef PONG_FIXED
+	/* The same expression as the float version below, with the square taken in Q32.32 */
+	int64_t dx = (int64_t)b.x - a.x;
+	if(dx <= -SCALAR_MAX || dx >= SCALAR_MAX) return SCALAR_MAX;
+	return (Scalar)squareRoot((uint64_t)(dx * dx) + ((uint64_t)2 << (2 * SCALAR_FRACTION_BITS)));
+#else
+	return sqrt(pow(b.x - a.x, 2) + (b.y - a.y, 2));
+#endif
+
+}
+
+/* Gets the position of the vertex on the ball corresponding to the passed int identifier.
+   The points are numbered as follows, from the origin (0) at the visual top-left position:
+
+   0--1
+   |  |
+   3--2
+   
+   This clockwise point layout is used in the same way for all similar functions. */
+Point Ball_getVertex(const Ball *ball, int vertex){
+
+	switch(vertex){
+		case 0:
+			return ball->position;
+		case 1:
+			return (Point){ball->position.x + SCALAR(BALL_SIZE), ball->position.y};
+		case 2:
+			return (Point){ball->position.x + SCALAR(BALL_SIZE), ball->position.y + SCALAR(BALL_SIZE)};
+		case 3:
+			return (Point){ball->position.x, ball->position.y + SCALAR(BALL_SIZE)};
+		default:
+			return (Point){0, 0};
+	}
+
+}
+
+/* Returns the line represented by the given side of the ball */
+Line Ball_getSide(const Ball *ball, Side side){
+
+	switch(side){
+		case TOP:
+			return (Line){Ball_getVertex(ball, 0), Ball_getVertex(ball, 1)};
+		case RIGHT:
+			return (Line){Ball_getVertex(ball, 1), Ball_getVertex(ball, 2)};
+		case BOTTOM:
+			return (Line){Ball_getVertex(ball, 2), Ball_getVertex(ball, 3)};
+		case LEFT:
+			return (Line){Ball_getVertex(ball, 3), Ball_getVertex(ball, 0)};
+		default:
+			return (Line){{0, 0}, {0, 0}};
+	}
+
+}
+
+/* Returns the furthest extent of the given side of the ball.
+   Naturally, TOP and BOTTOM will return a Y coordinate while LEFT and RIGHT will
+   return an X coordinate. */
+Scalar Ball_getBound(const Ball *ball, Side side){
+
+	switch(side){
+		case TOP:
+			return ball->position.y;
+		case RIGHT:
+			return ball->position.x + SCALAR(BALL_SIZE);
+		case BOTTOM:
+			return ball->position.y + SCALAR(BALL_SIZE);
+		case LEFT:
+			return ball->position.x;
+		default:
+			return 0;
+	}
+
+}
+
+/* Returns the position of the given vertex of the given paddle.
+   See function 'Ball_getVertex' for more details. */
+Point Paddle_getVertex(const Paddle *paddle, int vertex){
+
+	switch(vertex){
+		case 0:
+			return paddle->position;
+		case 1:
+			return (Point){paddle->position.x + SCALAR(PADDLE_WIDTH), paddle->position.y};
+		case 2:
+			return (Point){paddle->position.x + SCALAR(PADDLE_WIDTH), paddle->position.y + SCALAR(PADDLE_HEIGHT)};
+		case 3:
+			return (Point){paddle->position.x, paddle->position.y + SCALAR(PADDLE_HEIGHT)};
+		default:
+			return (Point){0, 0};
+	}
+
+}
+
+/* Returns the line representing the given side of the given paddle.
+   See function 'Ball_getSide for more details. */
+Line Paddle_getSide(const Paddle *paddle, Side side){
+
+	switch(side){
+		case TOP:
+			return (Line){Paddle_getVertex(paddle, 0), Paddle_getVertex(paddle, 1)};
+		case RIGHT:
+			return (Line){Paddle_getVertex(paddle, 1), Paddle_getVertex(paddle, 2)};
+		case BOTTOM:
+			return (Line){Paddle_getVertex(paddle, 2), Paddle_getVertex(paddle, 3)};
+		case LEFT:
+			return (Line){Paddle_getVertex(paddle, 3), Paddle_getVertex(paddle, 0)};
+		default:
+			return (Line){{0, 0}, {0, 0}};
+	}
+
+}
+
+/* Returns the extent of the paddle's bounds at the given side.
+   See function 'Ball_getBound' for more details. */
+Scalar Paddle_getBound(const Paddle *paddle, Side side){
+
+	switch(side){
+		case TOP:
+			return paddle->position.y;
+		case RIGHT:
+			return paddle->position.x + SCALAR(PADDLE_WIDTH);
+		case BOTTOM:
+			return paddle->position.y + SCALAR(PADDLE_HEIGHT);
+		case LEFT:
+			return paddle->position.x;
+		default:
+			return 0;
+	}
+
+}
+
+/* Returns nonzero if the paddle and ball rectangles overlap.
+   Edges that only touch do not count as an intersection. */
+int Paddle_intersectsBall(const Paddle *paddle, const Ball *ball){
+
+	Scalar left = MAX(Paddle_getBound(paddle, LEFT), Ball_getBound(ball, LEFT));
+	Scalar top = MAX(Paddle_getBound(paddle, TOP), Ball_getBound(ball, TOP));
+	Scalar right = MIN(Paddle_getBound(paddle, RIGHT), Ball_getBound(ball, RIGHT));
+	Scalar bottom = MIN(Paddle_getBound(paddle, BOTTOM), Ball_getBound(ball, BOTTOM));
+
+	return (left < right && top < bottom);
+
+}
+
+/* Tests collision between the ball and the passed paddle. Only bench calls this; the tick uses 'Ball_sweepRect'. */
+Collision getPaddleCollision(const Ball *ball, const Paddle *paddle, Point *newPosition){
+
+	/* Declare the return value */
+	Collision returnVal = (Collision){0, {0, 0}, TOP};
+
+	/* Find the slope of the ball's path */
+	Scalar slopeN = ball->speed.y;
+	Scalar slopeD = ball->speed.x;
+
+	/* Return failure if the slope is vertical */
+	if(slopeD == 0){ COUNT_BRANCH(BRANCH_PADDLE_NO_SLOPE); return returnVal; }
+	Scalar slope = Scalar_div(slopeN, slopeD);
+
+	/* Declare arrays to store collision test information */	
+	int horizontalVertices[2];		/* Stores the vertices on the ball that collision will be tested against for horizontal collisions */
+	int verticalVertices[2];		/* Stores the vertices on the ball that collision will be tested against for vertical collisions */
+	int collisionVertices[2];		/* Stores the vertices on the ball where collisions actually occur */
+	Side paddleSides[2];			/* Stores the names of paddle's sides where collisions will be tested against */
+	Line paddleEdges[2];			/* Stores the points that define the paddle's sides where collision will be tested against */
+
+	/* Determine the edges of the paddle that collision will be tested against */
+	if(ball->speed.x >= 0){
+		
+		if(Ball_getBound(ball, LEFT) > Paddle_getBound(paddle, RIGHT)){ COUNT_BRANCH(BRANCH_PADDLE_PAST); return returnVal; }
+		horizontalVertices[0] = 1; horizontalVertices[1] = 2;
+		paddleSides[0] = LEFT;
+		paddleEdges[0] = Paddle_getSide(paddle, LEFT);
+
+	}else{
+
+		if(Ball_getBound(ball, RIGHT) < Paddle_getBound(paddle, LEFT)){ COUNT_BRANCH(BRANCH_PADDLE_PAST); return returnVal; }
+		horizontalVertices[0] = 0; horizontalVertices[1] = 3;
+		paddleSides[0] = RIGHT;
+		paddleEdges[0] = Paddle_getSide(paddle, RIGHT);
+
+	}
+
+	if(ball->speed.y >= 0){
+
+		if(Ball_getBound(ball, TOP) > Paddle_getBound(paddle, BOTTOM)){ COUNT_BRANCH(BRANCH_PADDLE_PAST); return returnVal; }	
+		verticalVertices[0] = 2; verticalVertices[1] = 3;
+		paddleSides[1] = TOP;
+		paddleEdges[1] = Paddle_getSide(paddle, TOP);
+	
+	}else{
+
+		if(Ball_getBound(ball, BOTTOM) < Paddle_getBound(paddle, TOP)){ COUNT_BRANCH(BRANCH_PADDLE_PAST); return returnVal; }
+		verticalVertices[0] = 0; verticalVertices[1] = 1;	
+		paddleSides[1] = BOTTOM;
+		paddleEdges[1] = Paddle_getSide(paddle, BOTTOM);
+
+	}
+
+	Collision horizontalCol = {0, {0, 0}, TOP};
+	Collision verticalCol = {0, {0, 0}, TOP};
+
+	/* Horizontal tests */
+	for(int i = 0; i < 2; ++i){
+
+		collisionVertices[0] = horizontalVertices[i];
+			
+		Point vertexPos = Ball_getVertex(ball, collisionVertices[0]);
+		Point nextPos = {vertexPos.x + ball->speed.x, vertexPos.y + ball->speed.y};
+			
+		Scalar ballMinX = MIN(vertexPos.x, nextPos.x), ballMaxX = MAX(vertexPos.x, nextPos.x);
+		Scalar paddleX = Paddle_getBound(paddle, paddleSides[0]);
+
+		if(!(paddleX >= ballMinX && paddleX <= ballMaxX)) break;
+	
+		Scalar yIncp = vertexPos.y - Scalar_mul(vertexPos.x, slope);
+		Scalar paddleMinY = Paddle_getBound(paddle, TOP), paddleMaxY = Paddle_getBound(paddle, BOTTOM);
+		Scalar ballColY = Scalar_mul(paddleX, slope) + yIncp;
+			
+		if(!(ballColY >= paddleMinY && ballColY <= paddleMaxY)) continue;
+		else{
+			horizontalCol.collides = 1;
+			horizontalCol.position = (Point){paddleX, ballColY};
+			horizontalCol.side = paddleSides[0];
+			break;
+		}
+
+	}
+
+	/* Vertical tests */
+	for(int i = 0; i < 2; ++i){
+
+		if(slope == 0) break;
+
+		collisionVertices[1] = verticalVertices[i];
+
+		Point vertexPos = Ball_getVertex(ball, collisionVertices[1]);
+		Point nextPos = {vertexPos.x + ball->speed.x, vertexPos.y + ball->speed.y};
+
+		Scalar ballMinY = MIN(vertexPos.y, nextPos.y), ballMaxY = MAX(vertexPos.y, nextPos.y);
+		Scalar paddleY = Paddle_getBound(paddle, paddleSides[1]);
+
+		if(!(paddleY >= ballMinY && paddleY <= ballMaxY)) break;
+
+		Scalar yIncp = vertexPos.y - Scalar_mul(vertexPos.x, slope);
+		Scalar paddleMinX = Paddle_getBound(paddle, LEFT), paddleMaxX = Paddle_getBound(paddle, RIGHT);
+			Scalar ballColX = Scalar_div(paddleY - yIncp, slope);
+
+		if(!(ballColX >= paddleMinX && ballColX <= paddleMaxX)) continue;
+		else{
+			verticalCol.collides = 1;
+			verticalCol.position = (Point){ballColX, paddleY};
+			verticalCol.side = paddleSides[1];
+			break;
+		}
+
+	}
+
+	/* Assigns the closest collision occurence to returnVal */
+	int collisionVertex = 0;
+	if(horizontalCol.collides && verticalCol.collides){
+		COUNT_BRANCH(BRANCH_PADDLE_BOTH);
+		int returnIndex = (Point_getDistance(Ball_getVertex(ball, collisionVertices[0]), horizontalCol.position) <
+					Point_getDistance(Ball_getVertex(ball, collisionVertices[1]), verticalCol.position) ?
+						0 : 1);
+		collisionVertex = collisionVertices[returnIndex];
+		returnVal = (returnIndex) ? verticalCol : horizontalCol;
+	}
+	else if(horizontalCol.collides){ returnVal = horizontalCol; COUNT_BRANCH(BRANCH_PADDLE_HORIZONTAL); collisionVertex = collisionVertices[0]; }
+	else if(verticalCol.collides){ returnVal = verticalCol; COUNT_BRANCH(BRANCH_PADDLE_VERTICAL); collisionVertex = collisionVertices[1]; }
+	else COUNT_BRANCH(BRANCH_PADDLE_MISS);
+		
+	if(returnVal.collides){
+
+		Ball originReference = {returnVal.position, {0, 0}};
+		Point backToOrigin = Ball_getVertex(&originReference, collisionVertex);
+		newPosition->x = returnVal.position.x - (backToOrigin.x - returnVal.position.x);
+		newPosition->y = returnVal.position.y - (backToOrigin.y - returnVal.position.y);
+	}
+	
+	return returnVal;
+
+}
+
+/* Tests collision between the ball and the stage boundaries. Only bench calls this; the tick sweeps the ball against
+   the walls in 'Match_moveBall'. */
+Collision getWallCollision(const Ball *ball, Point *newPosition){
+	
+	Collision returnVal = {0, {0, 0}, TOP};
+
+	int testedVertex = -1;
+	Side horizontalSide = -1, verticalSide = -1;
+	Scalar horizontalBound = SCALAR(-1.0f), verticalBound = SCALAR(-1.0f);
+	
+	if(ball->speed.x >= 0){
+		horizontalSide = RIGHT;
+		horizontalBound = SCALAR(WINDOW_WIDTH);
+	}else{
+		horizontalSide = LEFT; 
+		horizontalBound = 0;
+	}
+
+	if(ball->speed.y >= 0){
+		verticalSide = BOTTOM;
+		verticalBound = SCALAR(WINDOW_HEIGHT);
+	}
+	else{
+		verticalSide = TOP;
+		verticalBound = 0;
+	}
+
+	if(horizontalSide == RIGHT && verticalSide == BOTTOM) testedVertex = 2;
+	else if(horizontalSide == LEFT && verticalSide == BOTTOM) testedVertex = 3;
+	else if(horizontalSide == RIGHT && verticalSide == TOP) testedVertex = 1;
+	else testedVertex = 0;
+
+	Scalar slopeN = ball->speed.y;
+	Scalar slopeD = ball->speed.x;
+
+	if(slopeD == 0){ COUNT_BRANCH(BRANCH_WALL_NO_SLOPE); return returnVal; }
+	Scalar slope = Scalar_div(slopeN, slopeD);
+
+	Point vertexPos = Ball_getVertex(ball, testedVertex);
+	Point nextPos = {vertexPos.x + ball->speed.x, vertexPos.y + ball->speed.y};
+
+	Scalar yIncp = vertexPos.y - Scalar_mul(vertexPos.x, slope);
+
+	Collision horizontalCol = {0, {0, 0}, TOP};
+	Collision verticalCol = {0, {0, 0}, TOP};
+
+	if(MIN(vertexPos.x, nextPos.x) <= horizontalBound &&
+		MAX(vertexPos.x, nextPos.x) >= horizontalBound){
+		horizontalCol = (Collision){1, {horizontalBound, Scalar_mul(slope, horizontalBound) + yIncp}, horizontalSide};
+	}
+
+	if(MIN(vertexPos.y, nextPos.y) <= verticalBound &&
+		MAX(vertexPos.y, nextPos.y) >= verticalBound){
+		verticalCol = (Collision){1, {Scalar_div(verticalBound - yIncp, slope), verticalBound}, verticalSide};
+	}
+
+
+	if(horizontalCol.collides && verticalCol.collides){
+		COUNT_BRANCH(BRANCH_WALL_BOTH);
+		returnVal = (Point_getDistance(vertexPos, horizontalCol.position) <
+				Point_getDistance(vertexPos, verticalCol.position) ?
+					horizontalCol : verticalCol);
+	}
+	else if(horizontalCol.collides){ returnVal = horizontalCol; COUNT_BRANCH(BRANCH_WALL_HORIZONTAL); }
+	else if(verticalCol.collides){ returnVal = verticalCol; COUNT_BRANCH(BRANCH_WALL_VERTICAL); }
+	else COUNT_BRANCH(BRANCH_WALL_MISS);
+
+	if(returnVal.collides){
+
+		Ball originReference = {returnVal.position, {0, 0}};
+		Point backToOrigin = Ball_getVertex(&originReference, testedVertex);
+		newPosition->x = returnVal.position.x - (backToOrigin.x - returnVal.position.x);
+		newPosition->y = returnVal.position.y - (backToOrigin.y - returnVal.position.y);
+	}
+	
+	return returnVal;
+}
+
+/* Sweeps the ball along its speed for up to 'limit' ticks against a solid rectangle from 'min' to 'max'.
+   Returns nonzero if the ball hits it, with the time of impact in ticks in 'time' and the side of the
+   rectangle that was hit in 'side'. A ball that already overlaps the rectangle is free to move out of it. */
+int Ball_sweepRect(const Ball *ball, Point min, Point max, Scalar limit, Scalar *time, Side *side){
+
+	Scalar entryX = -SCALAR_INFINITY, exitX = SCALAR_INFINITY, entryY = -SCALAR_INFINITY, exitY = SCALAR_INFINITY;
+
+	/* Times the ball's extent enters and leaves the rectangle's extent on each axis */
+	if(ball->speed.x > 0){
+		entryX = Scalar_div(min.x - Ball_getBound(ball, RIGHT), ball->speed.x);
+		exitX = Scalar_div(max.x - Ball_getBound(ball, LEFT), ball->speed.x);
+	}else if(ball->speed.x < 0){
+		entryX = Scalar_div(max.x - Ball_getBound(ball, LEFT), ball->speed.x);
+		exitX = Scalar_div(min.x - Ball_getBound(ball, RIGHT), ball->speed.x);
+	}else if(Ball_getBound(ball, LEFT) >= max.x || Ball_getBound(ball, RIGHT) <= min.x) return 0;
+
+	if(ball->speed.y > 0){
+		entryY = Scalar_div(min.y - Ball_getBound(ball, BOTTOM), ball->speed.y);
+		exitY = Scalar_div(max.y - Ball_getBound(ball, TOP), ball->speed.y);
+	}else if(ball->speed.y < 0){
+		entryY = Scalar_div(max.y - Ball_getBound(ball, TOP), ball->speed.y);
+		exitY = Scalar_div(min.y - Ball_getBound(ball, BOTTOM), ball->speed.y);
+	}else if(Ball_getBound(ball, TOP) >= max.y || Ball_getBound(ball, BOTTOM) <= min.y) return 0;
+
+	/* The ball hits when it has entered on both axes before leaving on either */
+	Scalar entry = MAX(entryX, entryY), exit = MIN(exitX, exitY);
+	if(entry >= exit || entry < 0 || entry > limit) return 0;
+
+	*time = entry;
+	if(entryX >= entryY) *side = (ball->speed.x > 0) ? LEFT : RIGHT;
+	else *side = (ball->speed.y > 0) ? TOP : BOTTOM;
+	return 1;
+
+}
+
+/* Resets the match to the start prompt. The seed drives every random
+   decision made by the match, so equal seeds and inputs give equal games. */
+void Match_init(Match *match, unsigned int seed){
+
+	match->ball = (Ball){{SCALAR(BALL_START_X), SCALAR(BALL_START_Y)}, {SCALAR(BALL_SPEED), SCALAR(BALL_SPEED)}};
+	match->p1 = (Paddle){{SCALAR(P1_START_X), SCALAR(P1_START_Y)}, 0};
+	match->p2 = (Paddle){{SCALAR(P2_START_X), SCALAR(P2_START_Y)}, 0};
+	match->gameState = 0;
+	match->gameStarting = 0;
+	match->countdown = 0;
+	match->rng = seed;
+	match->events = 0;
+
+}
+
+/* Returns a pseudo random number between 0 and 'MATCH_RAND_MAX' from the match's own generator.
+   Unlike rand() the state lives in the match, so independent matches never share a sequence. */
+int Match_random(Match *match){
+
+	match->rng = match->rng * 214013u + 2531011u;
+	return (int)((match->rng >> 16) & MATCH_RAND_MAX);
+
+}
+
+/* Advances the match by one simulation tick using the given input bits */
+void Match_tick(Match *match, Input input){
+
+	Match_tickContacts(match, input, NULL);
+
+}
+
+/* Advances the match by one tick like 'Match_tick' and, unless 'contacts' is NULL, lists every bounce of the ball in it */
+void Match_tickContacts(Match *match, Input input, MatchContacts *contacts){
+
+	Match_tickLayout(match, NULL, input, contacts);
+
+}
+
+/* Advances the match by one tick like 'Match_tickContacts' in a field with the obstacles of 'layout', or none if it is NULL */
+void Match_tickLayout(Match *match, const Layout *layout, Input input, MatchContacts *contacts){
+
+	match->events = 0;
+	if(contacts) contacts->count = 0;
+
+	if(match->gameState == 0){			/* Startup state */
+
+		if(match->gameStarting){
+
+			if(--match->countdown <= 0){
+				Match_serve(match);
+				match->p1.score = 0; match->p2.score = 0;
+				match->gameStarting = 0;
+				++match->gameState;
+			}
+
+		/* Wait for the start input to begin the match */
+		}else if(input & INPUT_START){
+
+			match->gameStarting = 1;
+			match->countdown = START_DELAY_TICKS;
+			match->events |= MATCH_EVENT_COUNTDOWN;
+
+		}
+
+	}else if(match->gameState == 1){		/* Round loop state */
+
+		Match_updateRound(match, layout, input, contacts);
+
+	}else if(match->gameState == 2){		/* New round state */
+
+		if(match->gameStarting){
+
+			if(--match->countdown <= 0){
+				Match_serve(match);
+				match->gameStarting = 0;
+				--match->gameState;
+			}
+
+		}else if(match->p1.score >= WIN_SCORE || match->p2.score >= WIN_SCORE){
+			match->events |= MATCH_EVENT_GAME_OVER;
+			match->gameState = 0;
+		}else{
+			match->countdown = ROUND_DELAY_TICKS;
+			match->gameStarting = 1;
+		}
+
+	}
+
+}
+
+/* Advances 'count' independent matches by one tick each.
+   inputs[i] is applied to matches[i]. */
+void Match_step(Match *matches, const Input *inputs, size_t count){
+
+	for(size_t i = 0; i < count; ++i) Match_tick(&matches[i], inputs[i]);
+
+}
+
+/* Returns the number of the player that has reached 'WIN_SCORE', or 0 if neither has */
+int Match_getWinner(const Match *match){
+
+	if(match->p1.score < WIN_SCORE && match->p2.score < WIN_SCORE) return 0;
+	return (MAX(match->p1.score, match->p2.score) == match->p1.score) ? 1 : 2;
+
+}
+
+/* Returns the paddle of player 1 or 2 */
+const Paddle *Match_getPaddle(const Match *match, int player){
+
+	return (player == 1) ? &match->p1 : &match->p2;
+
+}
+
+/* Sets object positions and generates a random ball speed and direction */
+static void Match_serve(Match *match){
+
+	match->ball.position = (Point){SCALAR(BALL_START_X), SCALAR(BALL_START_Y)};
+	match->ball.speed = (Point){SCALAR(BALL_SPEED), SCALAR(BALL_SERVE_RISE)};
+	if(Match_random(match) % 2) match->ball.speed.x = -match->ball.speed.x;
+
+	/* The random calls are sequenced explicitly so that the serve does not depend on evaluation order */
+	Scalar magnitude = Scalar_div(Scalar_fromInt(Match_random(match)), Scalar_fromInt(MATCH_RAND_MAX));
+	Scalar sign = (Match_random(match) % 2) ? SCALAR(-1.0f) : SCALAR(1.0f);
+	match->ball.speed.y = Scalar_mul(match->ball.speed.y, Scalar_mul(magnitude, sign) + SCALAR(0.1f));
+
+	match->p1.position = (Point){SCALAR(P1_START_X), SCALAR(P1_START_Y)};
+	match->p2.position = (Point){SCALAR(P2_START_X), SCALAR(P2_START_Y)};
+	match->events |= MATCH_EVENT_ROUND_START;
+
+}
+
+/* Moves the paddle vertically by the given distance, keeping it inside the playfield,
+   and adds 'step' to the direction the paddle moved in this tick */
+static void Match_movePaddle(Paddle *paddle, Scalar distance, int *dir, int step){
+
+	Scalar newY = paddle->position.y + distance;
+	if(distance < 0) newY = (newY > 0) ? newY : 0;
+	else newY = (newY < SCALAR(WINDOW_HEIGHT - PADDLE_HEIGHT)) ? newY : SCALAR(WINDOW_HEIGHT - PADDLE_HEIGHT);
+	paddle->position.y = newY;
+	*dir += step;
+
+}
+
+/* Runs one tick of a round: paddle movement, collision detection and scoring */
+static void Match_updateRound(Match *match, const Layout *layout, Input input, MatchContacts *trace){
+
+	Ball *ball = &match->ball;
+	Paddle *p1 = &match->p1, *p2 = &match->p2;
+
+	/* Stores direction of player paddles and ball for later collision detection */
+	int p1Dir = 0, p2Dir = 0;
+	int ballXDir = (ball->speed.x >= 0) ? 1 : 0;
+
+	/* Check movement controls and update paddle positions */
+	if(input & INPUT_P1_UP) Match_movePaddle(p1, -SCALAR(PADDLE_SPEED), &p1Dir, -1);
+	if(input & INPUT_P1_DOWN) Match_movePaddle(p1, SCALAR(PADDLE_SPEED), &p1Dir, 1);
+	if(input & INPUT_P2_UP) Match_movePaddle(p2, -SCALAR(PADDLE_SPEED), &p2Dir, -1);
+	if(input & INPUT_P2_DOWN) Match_movePaddle(p2, SCALAR(PADDLE_SPEED), &p2Dir, 1);
+
+	/* Check if the ball intersects a paddle after paddle movement */
+	const Paddle *paddle = (ballXDir == 1) ? p2 : p1;
+	int *pDir = (ballXDir == 1) ? &p2Dir : &p1Dir;
+
+	if(Paddle_intersectsBall(paddle, ball)){
+
+		if(*pDir != 0){
+			ball->speed.y = Scalar_fromInt(abs(Scalar_toInt(ball->speed.y)) * *pDir);
+			ball->speed.y += (*pDir == 1) ? SCALAR(PADDLE_SPEED) : -SCALAR(PADDLE_SPEED);
+		}
+
+	}
+
+	Match_moveBall(match, layout, trace);
+
+}
+
+/* Moves the ball through one tick, resolving the walls, paddles, obstacles and goal lines it meets in the order
+   it meets them. Each contact is found with its exact time of impact; the ball is placed there, bounced, and
+   the rest of the tick continues along the new path, so no contact is skipped however fast the ball is. */
+static void Match_moveBall(Match *match, const Layout *layout, MatchContacts *trace){
+
+	Ball *ball = &match->ball;
+	const Paddle *paddles[2] = {&match->p1, &match->p2};
+	Scalar remaining = SCALAR(1.0f);
+
+	for(int contacts = 0; contacts < MATCH_MAX_CONTACTS; ++contacts){
+
+		/* Earliest contact within the rest of the tick. 'paddle' and 'obstacle' are -1 unless one was hit. */
+		Scalar time = remaining;
+		int paddle = -1, obstacle = -1, found = 0;
+		Side side = TOP;
+
+		if(ball->speed.y < 0 && Scalar_div(Ball_getBound(ball, TOP), -ball->speed.y) <= time){
+			time = Scalar_div(Ball_getBound(ball, TOP), -ball->speed.y); side = TOP; found = 1;
+		}else if(ball->speed.y > 0 && Scalar_div(SCALAR(WINDOW_HEIGHT) - Ball_getBound(ball, BOTTOM), ball->speed.y) <= time){
+			time = Scalar_div(SCALAR(WINDOW_HEIGHT) - Ball_getBound(ball, BOTTOM), ball->speed.y); side = BOTTOM; found = 1;
+		}
+
+		if(ball->speed.x < 0 && Scalar_div(Ball_getBound(ball, LEFT), -ball->speed.x) < time){
+			time = Scalar_div(Ball_getBound(ball, LEFT), -ball->speed.x); side = LEFT; found = 1;
+		}else if(ball->speed.x > 0 && Scalar_div(SCALAR(WINDOW_WIDTH) - Ball_getBound(ball, RIGHT), ball->speed.x) < time){
+			time = Scalar_div(SCALAR(WINDOW_WIDTH) - Ball_getBound(ball, RIGHT), ball->speed.x); side = RIGHT; found = 1;
+		}
+
+		for(int i = 0; i < 2; ++i){
+			Point min = Paddle_getVertex(paddles[i], 0), max = Paddle_getVertex(paddles[i], 2);
+			Scalar paddleTime; Side paddleSide;
+			if(Ball_sweepRect(ball, min, max, time, &paddleTime, &paddleSide) && (!found || paddleTime < time)){
+				time = paddleTime; side = paddleSide; paddle = i; found = 1;
+			}
+		}
+
+		Scalar obstacleTime; Side obstacleSide;
+		int hit = Layout_sweep(layout, ball, time, &obstacleTime, &obstacleSide);
+		if(hit >= 0 && (!found || obstacleTime < time)){
+			time = obstacleTime; side = obstacleSide; paddle = -1; obstacle = hit; found = 1;
+		}
+
+		/* No contact, the ball travels freely for the rest of the tick */
+		if(!found){
+			ball->position.x += Scalar_mul(ball->speed.x, remaining); ball->position.y += Scalar_mul(ball->speed.y, remaining);
+			return;
+		}
+
+		time = MAX(time, 0);
+		ball->position.x += Scalar_mul(ball->speed.x, time); ball->position.y += Scalar_mul(ball->speed.y, time);
+		remaining -= time;
+
+		if(paddle >= 0){
+			Match_returnBall(ball, paddles[paddle], side);
+			match->events |= MATCH_EVENT_PADDLE_HIT;
+		}else if(obstacle >= 0){
+			Match_hitObstacle(match, &layout->obstacles[obstacle], side);
+		}else if(side == TOP || side == BOTTOM){
+			ball->position.y = (side == TOP) ? 0 : SCALAR(WINDOW_HEIGHT - BALL_SIZE);
+			ball->speed.y = -ball->speed.y;
+			match->events |= MATCH_EVENT_WALL_BOUNCE;
+		}else{
+			ball->position.x = (side == LEFT) ? 0 : SCALAR(WINDOW_WIDTH - BALL_SIZE);
+			if(side == LEFT) ++match->p2.score;
+			else ++match->p1.score;
+			++match->gameState;
+			match->events |= MATCH_EVENT_SCORE;
+		}
+
+		if(trace) trace->contacts[trace->count++] = (MatchContact){ball->position, ball->speed, side, paddle + 1, obstacle};
+		if(match->events & MATCH_EVENT_SCORE) return;
+
+	}
+
+	/* Out of contacts: the ball waits at its last contact point for the next tick */
+
+}
+
+/* Bounces the ball off the given side of a paddle it has just touched. A hit on the front or back face
+   returns the ball faster, with extra vertical speed the further from the paddle's center it lands. */
+static void Match_returnBall(Ball *ball, const Paddle *paddle, Side side){
+
+	if(side == LEFT || side == RIGHT){
+		ball->position.x = (side == LEFT) ? Paddle_getBound(paddle, LEFT) - SCALAR(BALL_SIZE) : Paddle_getBound(paddle, RIGHT);
+		ball->speed.x = -ball->speed.x + ((side == LEFT) ? SCALAR(-BALL_SPEEDUP) : SCALAR(BALL_SPEEDUP));
+		ball->speed.y += Scalar_div(ball->position.y + SCALAR(0.5f * BALL_SIZE) - (paddle->position.y + SCALAR(0.5f * PADDLE_HEIGHT)),
+			SCALAR(BALL_SPIN_OFFSET));
+	}else{
+		ball->position.y = (side == TOP) ? Paddle_getBound(paddle, TOP) - SCALAR(BALL_SIZE) : Paddle_getBound(paddle, BOTTOM);
+		ball->speed.y = -ball->speed.y;
+	}
+
+	if(ball->speed.x > SCALAR(BALL_MAX_SPEED)) ball->speed.x = SCALAR(BALL_MAX_SPEED);
+	else if(ball->speed.x < -SCALAR(BALL_MAX_SPEED)) ball->speed.x = -SCALAR(BALL_MAX_SPEED);
+
+	Scalar limitA = Scalar_mul(ball->speed.x, SCALAR(3.0f)), limitB = Scalar_mul(ball->speed.x, SCALAR(-3.0f));
+	if(ball->speed.y >= MAX(limitA, limitB)) ball->speed.y = MAX(limitA, limitB);
+	else if(ball->speed.y <= MIN(limitA, limitB)) ball->speed.y = MIN(limitA, limitB);
+
+}
+
+/* Resolves the ball touching a side of a layout obstacle. Walls and bumpers bounce it off that side, a bumper
+   also speeding it up; a goal scores for its player like a goal line. */
+static void Match_hitObstacle(Match *match, const Obstacle *obstacle, Side side){
+
+	Ball *ball = &match->ball;
+	match->events |= MATCH_EVENT_OBSTACLE_HIT;
+
+	if(obstacle->kind == OBSTACLE_GOAL){
+		if(obstacle->player == 1) ++match->p1.score;
+		else ++match->p2.score;
+		++match->gameState;
+		match->events |= MATCH_EVENT_SCORE;
+		return;
+	}
+
+	if(side == LEFT || side == RIGHT){
+		ball->position.x = (side == LEFT) ? obstacle->min.x - SCALAR(BALL_SIZE) : obstacle->max.x;
+		ball->speed.x = -ball->speed.x;
+	}else{
+		ball->position.y = (side == TOP) ? obstacle->min.y - SCALAR(BALL_SIZE) : obstacle->max.y;
+		ball->speed.y = -ball->speed.y;
+	}
+
+	if(obstacle->kind == OBSTACLE_BUMPER){
+		ball->speed.x = Scalar_mul(ball->speed.x, SCALAR(LAYOUT_BUMPER_BOOST));
+		ball->speed.y = Scalar_mul(ball->speed.y, SCALAR(LAYOUT_BUMPER_BOOST));
+		ball->speed.x = MAX(MIN(ball->speed.x, SCALAR(BALL_MAX_SPEED)), -SCALAR(BALL_MAX_SPEED));
+		ball->speed.y = MAX(MIN(ball->speed.y, SCALAR(BALL_MAX_SPEED)), -SCALAR(BALL_MAX_SPEED));
+	}
+
+}
+
+#ifdef PONG_FIXED
+
+/* Returns the integer square root of the value, rounded down. The double square root is correctly
+   rounded on every platform and lands within one of the result, which the integer steps then correct. */
+static uint64_t squareRoot(uint64_t value){
+
+	uint64_t root = (uint64_t)sqrt((double)value);
+	while(root * root > value) --root;
+	while((root + 1) * (root + 1) <= value) ++root;
+	return root;
+
+}
+
+#endif
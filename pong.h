@@ -0,0 +1,288 @@
+/*
+   CPong
+   Headless simulation core. Owns the game objects, the collision
+   detection routines and the game state machine so that matches can
+   be advanced without a window. The SFML front end in main.c is one
+   client of this interface.
+
+   Coordinates, sizes and speeds are stored as 'Scalar', which is float by
+   default. Building the core and every client with PONG_FIXED switches it
+   to signed Q16.16 fixed point. Fixed point arithmetic is plain integer
+   arithmetic, so a match played with the same seed and inputs ends in the
+   same bits on every x86-64 and ARM64 build whatever the compiler flags.
+   The batch kernels of collide_simd.h only partly vectorize it; see there.
+*/
+
+#ifndef PONG_H
+#define PONG_H
+
+#include <stddef.h>
+
+#ifdef PONG_FIXED
+#include <stdint.h>
+#endif
+
+/* Playfield property definitions */
+#define WINDOW_WIDTH 800
+#define WINDOW_HEIGHT 600
+
+/* Game object starting position definitions */
+#define P1_START_X 75.0f
+#define P1_START_Y 250.0f
+#define P2_START_X 700.0f
+#define P2_START_Y 250.0f
+#define BALL_START_X 390.0f
+#define BALL_START_Y 290.0f
+
+/* Simulation tick definitions. The simulation always advances in steps of
+   'TICK_TIME' seconds, independent of the rate frames are rendered at. */
+#define TICK_RATE 60
+#define TICK_TIME (1.0 / TICK_RATE)
+
+/* Game object size definitions */
+#define BALL_SIZE 20.0f
+#define PADDLE_WIDTH 25.0f
+#define PADDLE_HEIGHT 100.0f
+
+/* Game object speed definitions in units per second. A serve's vertical speed is
+   'BALL_SERVE_RISE_PER_SECOND' scaled by a random factor from -0.9 to 1.1. Every
+   return off a paddle's face adds 'BALL_SPEEDUP_PER_SECOND' to the horizontal speed,
+   and 'BALL_SPIN_PER_SECOND' of vertical speed for each unit the ball lands off the
+   paddle's center. */
+#define BALL_SPEED_PER_SECOND 300.0f
+#define PADDLE_SPEED_PER_SECOND 480.0f
+#define BALL_SERVE_RISE_PER_SECOND 180.0f
+#define BALL_SPEEDUP_PER_SECOND 30.0f
+#define BALL_SPIN_PER_SECOND 12.0f
+
+/* Game object speeds converted to the distance covered in one tick. The spin is kept
+   as the distance off center that adds one unit per tick, which the return divides by. */
+#define BALL_SPEED (BALL_SPEED_PER_SECOND / TICK_RATE)
+#define PADDLE_SPEED (PADDLE_SPEED_PER_SECOND / TICK_RATE)
+#define BALL_SERVE_RISE (BALL_SERVE_RISE_PER_SECOND / TICK_RATE)
+#define BALL_SPEEDUP (BALL_SPEEDUP_PER_SECOND / TICK_RATE)
+#define BALL_SPIN_OFFSET (TICK_RATE / BALL_SPIN_PER_SECOND)
+
+/* The ball gains speed on every return. Its horizontal speed is capped at
+   'BALL_MAX_SPEED', five ball widths per tick, which the swept collision
+   solver handles without tunnelling. */
+#define BALL_MAX_SPEED_PER_SECOND 6000.0f
+#define BALL_MAX_SPEED (BALL_MAX_SPEED_PER_SECOND / TICK_RATE)
+
+/* Most contacts resolved within one tick. Once reached, the ball stops at
+   the last contact until the next tick, which bounds the cost of a tick. */
+#define MATCH_MAX_CONTACTS 8
+
+/* Game rule definitions. Delays are counted in simulation ticks. */
+#define START_DELAY_TICKS (3 * TICK_RATE)
+#define ROUND_DELAY_TICKS (1 * TICK_RATE)
+#define WIN_SCORE 9
+
+/* Min and max macros */
+#define MIN(a, b) (((a)<(b))?(a):(b))
+#define MAX(a, b) (((a)>(b))?(a):(b))
+
+/* Scalar type definitions. Constants are converted with 'SCALAR', products and quotients go through
+   'Scalar_mul' and 'Scalar_div', and the conversion macros are used where scalars meet ints or floats.
+   With the float backend they are the plain float operations. */
+#ifdef PONG_FIXED
+
+typedef int32_t Scalar;
+
+#define SCALAR_FRACTION_BITS 16
+#define SCALAR_MAX INT32_MAX
+#define SCALAR(x) ((Scalar)((x) * 65536.0 + (((x) < 0) ? -0.5 : 0.5)))
+#define Scalar_fromInt(i) ((Scalar)((i) * (1 << SCALAR_FRACTION_BITS)))
+#define Scalar_toInt(s) ((int)((s) / (1 << SCALAR_FRACTION_BITS)))		/* Truncates toward zero like a float cast */
+#define Scalar_fromFloat(f) ((Scalar)((double)(f) * 65536.0 + (((f) < 0) ? -0.5 : 0.5)))
+#define Scalar_toFloat(s) ((float)((double)(s) / 65536.0))
+
+/* Results outside the range saturate to +-SCALAR_MAX, and a division by zero gives +-SCALAR_MAX
+   with the sign of the dividend, so every operation is defined for every input. The product is
+   rounded toward negative infinity by an arithmetic shift, which GCC, Clang and MSVC all emit. */
+static inline Scalar Scalar_mul(Scalar a, Scalar b){
+
+	int64_t product = ((int64_t)a * b) >> SCALAR_FRACTION_BITS;
+	return (Scalar)MAX(MIN(product, (int64_t)SCALAR_MAX), -(int64_t)SCALAR_MAX);
+
+}
+
+static inline Scalar Scalar_div(Scalar a, Scalar b){
+
+	if(b == 0) return (a < 0) ? -SCALAR_MAX : SCALAR_MAX;
+	int64_t quotient = ((int64_t)a * (1 << SCALAR_FRACTION_BITS)) / b;
+	return (Scalar)MAX(MIN(quotient, (int64_t)SCALAR_MAX), -(int64_t)SCALAR_MAX);
+
+}
+
+#else
+
+typedef float Scalar;
+
+#define SCALAR(x) ((Scalar)(x))
+#define Scalar_fromInt(i) ((Scalar)(i))
+#define Scalar_toInt(s) ((int)(s))
+#define Scalar_fromFloat(f) ((Scalar)(f))
+#define Scalar_toFloat(s) ((float)(s))
+#define Scalar_mul(a, b) ((a) * (b))
+#define Scalar_div(a, b) ((a) / (b))
+
+#endif
+
+/* Side enum definition used for collision detection */
+typedef enum {TOP, RIGHT, BOTTOM, LEFT} Side;
+
+/* Define a 'Point' struct. With the float backend its layout matches the SFML sfVector2f type. */
+typedef struct Point{
+
+	Scalar x;
+	Scalar y;
+
+} Point;
+
+/* Define a 'Line' struct as two points */
+typedef struct Line{
+
+	Point a;
+	Point b;
+
+} Line;
+
+/* Define the 'Ball' struct. Its speed is the distance travelled in one tick. */
+typedef struct Ball{
+
+	Point position;
+	Point speed;
+
+} Ball;
+
+/* Define the 'Paddle' struct */
+typedef struct Paddle{
+
+	Point position;
+	int score;
+
+} Paddle;
+
+/* Define the 'Collision' struct used to store collision detection return information */
+typedef struct Collision{
+
+	int collides;
+	Point position;
+	Side side;
+
+} Collision;
+
+/* Define the 'MatchContact' struct describing one bounce of the ball during a tick */
+typedef struct MatchContact{
+
+	Point position;			/* Ball position after the bounce */
+	Point speed;			/* Ball speed after the bounce */
+	Side side;			/* Face of the paddle, obstacle, wall or goal line that was hit */
+	int paddle;			/* Player whose paddle was hit, 0 for anything else */
+	int obstacle;			/* Layout obstacle that was hit, or -1 */
+
+} MatchContact;
+
+/* Define the 'MatchContacts' struct holding every bounce of one tick */
+typedef struct MatchContacts{
+
+	int count;
+	MatchContact contacts[MATCH_MAX_CONTACTS];
+
+} MatchContacts;
+
+/* Per-tick input bits for both players. These mirror the keyboard controls
+   of the front end: W/S for player one, Up/Down for player two and Return
+   to start a match. */
+typedef unsigned char Input;
+
+#define INPUT_P1_UP 0x01
+#define INPUT_P1_DOWN 0x02
+#define INPUT_P2_UP 0x04
+#define INPUT_P2_DOWN 0x08
+#define INPUT_START 0x10
+
+/* Event bits raised by 'Match_tick' and left in 'Match.events' until the next tick */
+#define MATCH_EVENT_COUNTDOWN 0x01		/* The start prompt was accepted */
+#define MATCH_EVENT_ROUND_START 0x02		/* The ball was served */
+#define MATCH_EVENT_PADDLE_HIT 0x04		/* The ball bounced off a paddle */
+#define MATCH_EVENT_WALL_BOUNCE 0x08		/* The ball bounced off the top or bottom wall */
+#define MATCH_EVENT_SCORE 0x10			/* The ball left the field and a point was awarded */
+#define MATCH_EVENT_GAME_OVER 0x20		/* A player reached 'WIN_SCORE' */
+#define MATCH_EVENT_OBSTACLE_HIT 0x40		/* The ball hit an obstacle of the arena layout */
+
+/* Outcomes of the collision functions. When the core is built with
+   PONG_BRANCH_STATS each outcome increments its entry in 'branchHits'. */
+typedef enum {
+	BRANCH_PADDLE_NO_SLOPE,		/* Ball moving straight up or down, no test done */
+	BRANCH_PADDLE_PAST,		/* Ball already past the paddle */
+	BRANCH_PADDLE_HORIZONTAL,	/* Hit on the paddle's left or right edge */
+	BRANCH_PADDLE_VERTICAL,		/* Hit on the paddle's top or bottom edge */
+	BRANCH_PADDLE_BOTH,		/* Both edges crossed, the closer hit is kept */
+	BRANCH_PADDLE_MISS,
+	BRANCH_WALL_NO_SLOPE,
+	BRANCH_WALL_HORIZONTAL,		/* Ball reaching the left or right boundary */
+	BRANCH_WALL_VERTICAL,		/* Ball reaching the top or bottom boundary */
+	BRANCH_WALL_BOTH,
+	BRANCH_WALL_MISS,
+	BRANCH_COUNT
+} Branch;
+
+#ifdef PONG_BRANCH_STATS
+extern unsigned long long branchHits[BRANCH_COUNT];
+#endif
+
+/* Range of the values returned by 'Match_random' */
+#define MATCH_RAND_MAX 0x7fff
+
+/* Define the 'Match' struct holding the complete state of one game.
+   It holds no pointers, so a match can be copied with a plain assignment.
+
+   gameState 0 waits for the start input, 1 plays a round and 2 sits
+   between rounds. 'countdown' counts the ticks left before the serve
+   while 'gameStarting' is set. */
+typedef struct Match{
+
+	Ball ball;
+	Paddle p1;
+	Paddle p2;
+	int gameState;
+	int gameStarting;
+	int countdown;
+	unsigned int rng;
+	unsigned int events;
+
+} Match;
+
+/* Arena layout with obstacles, see layout.h */
+typedef struct Layout Layout;
+
+/* Geometry function declarations */
+Scalar Point_getDistance(Point a, Point b);
+Point Ball_getVertex(const Ball *ball, int vertex);
+Line Ball_getSide(const Ball *ball, Side side);
+Scalar Ball_getBound(const Ball *ball, Side side);
+Point Paddle_getVertex(const Paddle *paddle, int vertex);
+Line Paddle_getSide(const Paddle *paddle, Side side);
+Scalar Paddle_getBound(const Paddle *paddle, Side side);
+int Paddle_intersectsBall(const Paddle *paddle, const Ball *ball);
+
+/* Collision function declarations. The tick sweeps the ball with 'Ball_sweepRect'. The one-contact tests before it
+   are no longer called by the simulation; they and their batch kernels in collide_simd.h are kept for bench only,
+   as a timing baseline and for their golden traces. */
+int Ball_sweepRect(const Ball *ball, Point min, Point max, Scalar limit, Scalar *time, Side *side);
+Collision getPaddleCollision(const Ball *ball, const Paddle *paddle, Point *newPosition);
+Collision getWallCollision(const Ball *ball, Point *newPosition);
+
+/* Match function declarations */
+void Match_init(Match *match, unsigned int seed);
+int Match_random(Match *match);
+void Match_tick(Match *match, Input input);
+void Match_tickContacts(Match *match, Input input, MatchContacts *contacts);
+void Match_tickLayout(Match *match, const Layout *layout, Input input, MatchContacts *contacts);
+void Match_step(Match *matches, const Input *inputs, size_t count);
+int Match_getWinner(const Match *match);
+const Paddle *Match_getPaddle(const Match *match, int player);
+
+#endif
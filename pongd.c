@@ -0,0 +1,93 @@
+/*
+   CPong
+   Headless match server. Hosts matches for every pair of clients that
+   joins and prints the tick timing and traffic once per second.
+
+   Usage: pongd [-port <port>] [-matches <count>] [-io <threads>]
+                [-tick <threads>] [-seconds <count>]
+
+   Thread counts default to the number of processors. The server runs
+   until it is interrupted, or for the given number of seconds.
+*/
+
+/* Standard C includes */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "pong.h"
+#include "server.h"
+
+/* Server being run, for the interrupt handler */
+static Server *running;
+
+/* Function declarations */
+void handleInterrupt(int signal);
+void printStats(double time, const ServerStats *stats, const ServerStats *last);
+
+/* Program entrypoint */
+int main(int argc, char **argv){
+
+	ServerConfig config = {SERVER_DEFAULT_PORT, 0, 0, SERVER_DEFAULT_MATCHES};
+	double seconds = 0.0;
+
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "-port") == 0 && i + 1 < argc) config.port = (unsigned short)atoi(argv[++i]);
+		else if(strcmp(argv[i], "-matches") == 0 && i + 1 < argc) config.maxMatches = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-io") == 0 && i + 1 < argc) config.ioThreads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-tick") == 0 && i + 1 < argc) config.tickThreads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-seconds") == 0 && i + 1 < argc) seconds = atof(argv[++i]);
+		else{
+			fprintf(stderr, "Usage: %s [-port n] [-matches n] [-io threads] [-tick threads] [-seconds n]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	running = Server_create(&config);
+	if(!running){
+		fprintf(stderr, "Could not start the server on port %u\n", config.port);
+		return EXIT_FAILURE;
+	}
+	signal(SIGINT, handleInterrupt);
+	signal(SIGTERM, handleInterrupt);
+
+	fprintf(stdout, "%6s %8s %8s %9s %9s %9s %7s %9s %9s %7s\n", "time", "clients", "matches",
+		"tick p50", "tick p99", "tick max", "missed", "in/s", "out/s", "drops");
+
+	ServerStats stats, last;
+	Server_getStats(running, &last);
+	double time = 0.0;
+	while((seconds <= 0.0 || time < seconds) && Server_run(running, 1.0)){
+		time += 1.0;
+		Server_getStats(running, &stats);
+		printStats(time, &stats, &last);
+		last = stats;
+	}
+
+	Server_getStats(running, &stats);
+	fprintf(stdout, "\n%llu ticks, %llu missed deadlines, %llu packets in, %llu out, %llu dropped, %llu joins refused\n",
+		stats.ticks, stats.missedTicks, stats.packetsIn, stats.packetsOut, stats.sendDrops, stats.rejectedJoins);
+	Server_destroy(running);
+	return EXIT_SUCCESS;
+
+}
+
+/* Stops the server after the current tick */
+void handleInterrupt(int signal){
+
+	(void)signal;
+	Server_stop(running);
+
+}
+
+/* Prints one row of the per-second statistics */
+void printStats(double time, const ServerStats *stats, const ServerStats *last){
+
+	fprintf(stdout, "%6.0f %8d %8d %7.0fus %7.0fus %7.0fus %7llu %9llu %9llu %7llu\n", time, stats->clients, stats->matches,
+		stats->tickP50 * 1e6, stats->tickP99 * 1e6, stats->tickMax * 1e6, stats->missedTicks - last->missedTicks,
+		stats->packetsIn - last->packetsIn, stats->packetsOut - last->packetsOut, stats->sendDrops - last->sendDrops);
+	fflush(stdout);
+
+}
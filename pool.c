@@ -0,0 +1,329 @@
+/*
+   CPong
+   Work-stealing thread pool. See pool.h.
+
+   The deque follows "Correct and Efficient Work-Stealing for Weak Memory
+   Models" (Le, Pop, Cohen, Zappa Nardelli, 2013). Its buffer is sized
+   for a whole batch before the workers are woken, so it never grows
+   while tasks run.
+*/
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+/* Standard C includes */
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/* Platform includes */
+#include <pthread.h>
+#include <sched.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+/* Local includes */
+#include "pool.h"
+
+/* Cache line size used to keep per-worker data apart */
+#define CACHE_LINE 64
+
+/* Result of a failed deque operation */
+#define DEQUE_EMPTY ((size_t)-1)
+
+/* Define the 'Deque' struct, a Chase-Lev work-stealing deque of task indices */
+typedef struct Deque{
+
+	atomic_llong top;
+	char topPadding[CACHE_LINE];		/* Keeps thieves and the owner on separate cache lines */
+	atomic_llong bottom;
+	atomic_size_t *buffer;
+	long long mask;
+
+} Deque;
+
+/* Define the 'Worker' struct */
+typedef struct Worker{
+
+	Deque deque;
+	Pool *pool;
+	int index;
+	unsigned int rng;
+	pthread_t thread;
+	char padding[CACHE_LINE];
+
+} Worker;
+
+/* Define the 'Pool' struct */
+struct Pool{
+
+	Worker *workers;
+	int threadCount;
+
+	/* Current batch */
+	PoolTask task;
+	void *arg;
+	size_t count;
+	char countPadding[CACHE_LINE];
+	atomic_size_t remaining;
+	char remainingPadding[CACHE_LINE];
+
+	/* Batch start and completion signalling */
+	pthread_mutex_t mutex;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned long generation;
+	int active;
+	int shutdown;
+
+};
+
+/* Static function declarations */
+static void *Worker_main(void *arg);
+static void Worker_runBatch(Worker *worker);
+static void Deque_push(Deque *deque, size_t value);
+static size_t Deque_take(Deque *deque);
+static size_t Deque_steal(Deque *deque);
+
+/* Creates a pool with the given number of worker threads */
+Pool *Pool_create(int threads){
+
+	if(threads < 1) threads = 1;
+
+	Pool *pool = calloc(1, sizeof(Pool));
+	if(!pool) return NULL;
+	pool->workers = calloc((size_t)threads, sizeof(Worker));
+	if(!pool->workers){ free(pool); return NULL; }
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	atomic_init(&pool->remaining, 0);
+
+	for(int i = 0; i < threads; ++i){
+		Worker *worker = &pool->workers[i];
+		atomic_init(&worker->deque.top, 0);
+		atomic_init(&worker->deque.bottom, 0);
+		worker->deque.buffer = NULL;
+		worker->deque.mask = 0;
+		worker->pool = pool;
+		worker->index = i;
+		worker->rng = 2654435761u * (unsigned int)(i + 1);
+	}
+
+	for(int i = 0; i < threads; ++i){
+		if(pthread_create(&pool->workers[i].thread, NULL, Worker_main, &pool->workers[i]) != 0){
+			pool->threadCount = i;
+			Pool_destroy(pool);
+			return NULL;
+		}
+		pool->threadCount = i + 1;
+	}
+
+	return pool;
+
+}
+
+/* Runs 'count' tasks and waits for all of them to finish */
+void Pool_run(Pool *pool, size_t count, PoolTask task, void *arg){
+
+	if(count == 0) return;
+
+	/* Size every deque for the worst case share before any worker starts */
+	size_t share = (count + (size_t)pool->threadCount - 1) / (size_t)pool->threadCount;
+	size_t capacity = 1;
+	while(capacity < share) capacity <<= 1;
+
+	for(int i = 0; i < pool->threadCount; ++i){
+		Deque *deque = &pool->workers[i].deque;
+		if(!deque->buffer || (size_t)deque->mask + 1 < capacity){
+			free(deque->buffer);
+			deque->buffer = malloc(capacity * sizeof(atomic_size_t));
+			deque->mask = (long long)capacity - 1;
+
+			/* Without room for the batch, run it on the calling thread instead */
+			if(!deque->buffer){
+				for(size_t index = 0; index < count; ++index) task(arg, index, 0);
+				return;
+			}
+		}
+		atomic_store_explicit(&deque->top, 0, memory_order_relaxed);
+		atomic_store_explicit(&deque->bottom, 0, memory_order_relaxed);
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->arg = arg;
+	pool->count = count;
+	atomic_store(&pool->remaining, count);
+	pool->active = pool->threadCount;
+	++pool->generation;
+	pthread_cond_broadcast(&pool->start);
+
+	/* Wait until every worker has left the batch, so the deques can be reused */
+	while(pool->active > 0) pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+
+}
+
+/* Returns the number of worker threads */
+int Pool_getThreadCount(const Pool *pool){
+
+	return pool->threadCount;
+
+}
+
+/* Stops the worker threads and frees the pool */
+void Pool_destroy(Pool *pool){
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for(int i = 0; i < pool->threadCount; ++i) pthread_join(pool->workers[i].thread, NULL);
+	for(int i = 0; i < pool->threadCount; ++i) free(pool->workers[i].deque.buffer);
+
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	free(pool->workers);
+	free(pool);
+
+}
+
+/* Returns the number of processors available to the process */
+int Pool_getCpuCount(void){
+
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (int)count : 1;
+#endif
+
+}
+
+/* Worker thread entrypoint. Sleeps between batches. */
+static void *Worker_main(void *arg){
+
+	Worker *worker = arg;
+	Pool *pool = worker->pool;
+	unsigned long seen = 0;
+
+	for(;;){
+
+		pthread_mutex_lock(&pool->mutex);
+		while(!pool->shutdown && pool->generation == seen) pthread_cond_wait(&pool->start, &pool->mutex);
+		if(pool->shutdown){
+			pthread_mutex_unlock(&pool->mutex);
+			return NULL;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		Worker_runBatch(worker);
+
+		pthread_mutex_lock(&pool->mutex);
+		if(--pool->active == 0) pthread_cond_signal(&pool->done);
+		pthread_mutex_unlock(&pool->mutex);
+
+	}
+
+}
+
+/* Pushes this worker's share of the batch, then runs tasks until none are left anywhere */
+static void Worker_runBatch(Worker *worker){
+
+	Pool *pool = worker->pool;
+	int threads = pool->threadCount;
+
+	/* Indices are dealt round robin, pushed in reverse so the lowest runs first */
+	size_t last = pool->count - 1;
+	size_t first = (size_t)worker->index;
+	if(first <= last){
+		size_t top = first + (last - first) / (size_t)threads * (size_t)threads;
+		for(size_t i = top + (size_t)threads; i > first; ){
+			i -= (size_t)threads;
+			Deque_push(&worker->deque, i);
+		}
+	}
+
+	while(atomic_load_explicit(&pool->remaining, memory_order_acquire) > 0){
+
+		size_t index = Deque_take(&worker->deque);
+
+		/* Out of local work, try a random victim */
+		if(index == DEQUE_EMPTY && threads > 1){
+			worker->rng ^= worker->rng << 13; worker->rng ^= worker->rng >> 17; worker->rng ^= worker->rng << 5;
+			int victim = (int)(worker->rng % (unsigned int)(threads - 1));
+			if(victim >= worker->index) ++victim;
+			index = Deque_steal(&pool->workers[victim].deque);
+		}
+
+		if(index == DEQUE_EMPTY){
+			sched_yield();
+			continue;
+		}
+
+		pool->task(pool->arg, index, worker->index);
+		atomic_fetch_sub_explicit(&pool->remaining, 1, memory_order_acq_rel);
+
+	}
+
+}
+
+/* Pushes a value at the bottom. Only called by the owning worker. */
+static void Deque_push(Deque *deque, size_t value){
+
+	long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	atomic_store_explicit(&deque->buffer[bottom & deque->mask], value, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+}
+
+/* Takes a value from the bottom. Only called by the owning worker. */
+static size_t Deque_take(Deque *deque){
+
+	long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	if(top > bottom){
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+		return DEQUE_EMPTY;
+	}
+
+	size_t value = atomic_load_explicit(&deque->buffer[bottom & deque->mask], memory_order_relaxed);
+	if(top == bottom){
+		/* Last element, race against thieves for it */
+		if(!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+			memory_order_seq_cst, memory_order_relaxed)) value = DEQUE_EMPTY;
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+	}
+	return value;
+
+}
+
+/* Steals a value from the top. Called by any other worker. */
+static size_t Deque_steal(Deque *deque){
+
+	long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+	if(top >= bottom) return DEQUE_EMPTY;
+
+	size_t value = atomic_load_explicit(&deque->buffer[top & deque->mask], memory_order_relaxed);
+	if(!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+		memory_order_seq_cst, memory_order_relaxed)) return DEQUE_EMPTY;
+	return value;
+
+}
@@ -0,0 +1,39 @@
+/*
+   CPong
+   Work-stealing thread pool for batches of independent tasks.
+
+   'Pool_run' executes task indices 0 to count - 1 across all worker
+   threads and returns once every task has finished. Each worker owns a
+   Chase-Lev deque: it pushes its share of the indices, pops them from
+   the bottom, and steals from the top of other workers' deques when its
+   own runs dry. Tasks are handed the index of the worker running them so
+   they can accumulate results in per-worker storage without locking.
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/* Task function type. 'worker' is in [0, Pool_getThreadCount()). */
+typedef void (*PoolTask)(void *arg, size_t index, int worker);
+
+/* Opaque pool type */
+typedef struct Pool Pool;
+
+/* Creates a pool with the given number of worker threads. Returns NULL on failure. */
+Pool *Pool_create(int threads);
+
+/* Runs 'count' tasks and waits for all of them to finish */
+void Pool_run(Pool *pool, size_t count, PoolTask task, void *arg);
+
+/* Returns the number of worker threads */
+int Pool_getThreadCount(const Pool *pool);
+
+/* Stops the worker threads and frees the pool */
+void Pool_destroy(Pool *pool);
+
+/* Returns the number of processors available to the process */
+int Pool_getCpuCount(void);
+
+#endif
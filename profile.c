@@ -0,0 +1,153 @@
+/*
+   CPong
+   Per-phase frame timing. See profile.h.
+*/
+
+/* Standard C includes */
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "profile.h"
+#include "timer.h"
+
+/* The profiler of the running program */
+Profiler profiler;
+
+/* Phase names, used in traces and by the overlay */
+static const char *phaseNames[PHASE_COUNT] = {"events", "input", "simulation", "draw", "display"};
+
+/* Static function declarations */
+static void Profile_writeSlice(const char *name, unsigned long long start, unsigned long long duration);
+static int compareNanos(const void *a, const void *b);
+
+/* Starts timing a new frame */
+void Profile_beginFrame(void){
+
+	memset(&profiler.current, 0, sizeof(profiler.current));
+	profiler.current.start = Timer_now();
+
+}
+
+/* Finishes the current frame and adds it to the history */
+void Profile_endFrame(void){
+
+	ProfileFrame *frame = &profiler.current;
+	if(frame->start == 0) return;		/* Enabled in the middle of a frame */
+
+	frame->total = Timer_now() - frame->start;
+	profiler.history[profiler.frameCount % PROFILE_HISTORY] = *frame;
+	++profiler.frameCount;
+
+	if(profiler.trace) Profile_writeSlice("frame", frame->start, frame->total);
+	frame->start = 0;
+
+}
+
+/* Starts timing a phase. A phase may run several times in one frame; its times add up. */
+void Profile_begin(Phase phase){
+
+	profiler.phaseStart[phase] = Timer_now();
+
+}
+
+/* Stops timing a phase */
+void Profile_end(Phase phase){
+
+	unsigned long long start = profiler.phaseStart[phase];
+	if(start == 0) return;
+
+	unsigned long long duration = Timer_now() - start;
+	profiler.current.phases[phase] += duration;
+	profiler.phaseStart[phase] = 0;
+
+	if(profiler.trace) Profile_writeSlice(phaseNames[phase], start, duration);
+
+}
+
+/* Records an instant event in the trace, such as a change of input */
+void Profile_mark(const char *name){
+
+	Profile_markAt(name, Timer_now());
+
+}
+
+/* Records an instant event that happened at an earlier time, such as one reported by another thread */
+void Profile_markAt(const char *name, unsigned long long time){
+
+	if(!profiler.trace) return;
+	fprintf(profiler.trace, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":1,\"ts\":%.3f}",
+		profiler.traceEvents++ ? ",\n" : "", name, ((long long)time - (long long)profiler.traceStart) / 1000.0);
+
+}
+
+/* Starts writing a trace file. Returns 0 if it cannot be created. */
+int Profile_openTrace(const char *path){
+
+	profiler.trace = fopen(path, "w");
+	if(!profiler.trace) return 0;
+
+	fprintf(profiler.trace, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	profiler.traceStart = Timer_now();
+	profiler.traceEvents = 0;
+	profiler.enabled = 1;
+	return 1;
+
+}
+
+/* Finishes and closes the trace file */
+void Profile_closeTrace(void){
+
+	if(!profiler.trace) return;
+	fprintf(profiler.trace, "\n]}\n");
+	fclose(profiler.trace);
+	profiler.trace = NULL;
+
+}
+
+/* Computes frame time percentiles and mean phase times over the history */
+void Profile_getStats(ProfileStats *stats){
+
+	unsigned long long totals[PROFILE_HISTORY];
+	unsigned int count = (profiler.frameCount < PROFILE_HISTORY) ? profiler.frameCount : PROFILE_HISTORY;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->frames = count;
+	if(count == 0) return;
+
+	for(unsigned int i = 0; i < count; ++i){
+		const ProfileFrame *frame = &profiler.history[i];
+		totals[i] = frame->total;
+		for(int phase = 0; phase < PHASE_COUNT; ++phase) stats->phaseMeans[phase] += frame->phases[phase];
+	}
+	for(int phase = 0; phase < PHASE_COUNT; ++phase) stats->phaseMeans[phase] /= count;
+
+	qsort(totals, count, sizeof(unsigned long long), compareNanos);
+	stats->p50 = totals[(count - 1) / 2];
+	stats->p99 = totals[(count - 1) * 99 / 100];
+	stats->max = totals[count - 1];
+
+}
+
+/* Returns the display name of a phase */
+const char *Profile_getPhaseName(Phase phase){
+
+	return phaseNames[phase];
+
+}
+
+/* Writes one complete event to the trace */
+static void Profile_writeSlice(const char *name, unsigned long long start, unsigned long long duration){
+
+	fprintf(profiler.trace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+		profiler.traceEvents++ ? ",\n" : "", name, (start - profiler.traceStart) / 1000.0, duration / 1000.0);
+
+}
+
+/* Orders nanosecond values ascending */
+static int compareNanos(const void *a, const void *b){
+
+	unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+
+}
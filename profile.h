@@ -0,0 +1,104 @@
+/*
+   CPong
+   Per-phase frame timing.
+
+   The front end wraps each part of a frame in PROFILE_BEGIN/PROFILE_END.
+   While the profiler is off every probe is a single test of
+   'profiler.enabled'; building with PONG_NO_PROFILE removes the probes
+   entirely. While it is on, the time of each phase is summed per frame
+   and the last PROFILE_HISTORY frames are kept for the overlay.
+
+   A trace file can be written at the same time. It uses the Chrome
+   trace event JSON format, so it opens in chrome://tracing or Perfetto
+   with one slice per phase and an instant event for every mark.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+/* Number of frames kept for statistics */
+#define PROFILE_HISTORY 240
+
+/* Phases of a frame, in the order they run */
+typedef enum {
+	PHASE_EVENTS,		/* Window event polling */
+	PHASE_INPUT,		/* Sampling the keyboard or network */
+	PHASE_SIMULATION,	/* Match ticks, including collision */
+	PHASE_DRAW,		/* Clearing and drawing */
+	PHASE_DISPLAY,		/* Presenting the frame, including any vsync wait */
+	PHASE_COUNT
+} Phase;
+
+/* Define the 'ProfileFrame' struct holding the time spent per phase in one frame, in nanoseconds */
+typedef struct ProfileFrame{
+
+	unsigned long long start;
+	unsigned long long total;
+	unsigned long long phases[PHASE_COUNT];
+
+} ProfileFrame;
+
+/* Define the 'ProfileStats' struct summarizing the frames in the history, in nanoseconds */
+typedef struct ProfileStats{
+
+	unsigned int frames;
+	unsigned long long p50;
+	unsigned long long p99;
+	unsigned long long max;
+	unsigned long long phaseMeans[PHASE_COUNT];
+
+} ProfileStats;
+
+/* Define the 'Profiler' struct */
+typedef struct Profiler{
+
+	int enabled;
+	ProfileFrame history[PROFILE_HISTORY];
+	unsigned int frameCount;		/* Frames recorded so far, the newest at (frameCount - 1) % PROFILE_HISTORY */
+	ProfileFrame current;
+	unsigned long long phaseStart[PHASE_COUNT];
+	FILE *trace;
+	unsigned long long traceStart;
+	int traceEvents;
+
+} Profiler;
+
+/* The profiler of the running program */
+extern Profiler profiler;
+
+/* Probe macros */
+#ifdef PONG_NO_PROFILE
+#define PROFILE_FRAME_BEGIN() ((void)0)
+#define PROFILE_FRAME_END() ((void)0)
+#define PROFILE_BEGIN(phase) ((void)0)
+#define PROFILE_END(phase) ((void)0)
+#define PROFILE_MARK(name) ((void)0)
+#define PROFILE_MARK_AT(name, time) ((void)0)
+#else
+#define PROFILE_FRAME_BEGIN() do{ if(profiler.enabled) Profile_beginFrame(); }while(0)
+#define PROFILE_FRAME_END() do{ if(profiler.enabled) Profile_endFrame(); }while(0)
+#define PROFILE_BEGIN(phase) do{ if(profiler.enabled) Profile_begin(phase); }while(0)
+#define PROFILE_END(phase) do{ if(profiler.enabled) Profile_end(phase); }while(0)
+#define PROFILE_MARK(name) do{ if(profiler.enabled) Profile_mark(name); }while(0)
+#define PROFILE_MARK_AT(name, time) do{ if(profiler.enabled) Profile_markAt(name, time); }while(0)
+#endif
+
+/* Profiler function declarations. Call through the macros above. */
+void Profile_beginFrame(void);
+void Profile_endFrame(void);
+void Profile_begin(Phase phase);
+void Profile_end(Phase phase);
+void Profile_mark(const char *name);
+void Profile_markAt(const char *name, unsigned long long time);
+
+/* Trace function declarations. The profiler stays enabled while a trace is open. */
+int Profile_openTrace(const char *path);
+void Profile_closeTrace(void);
+
+/* Summary function declarations */
+void Profile_getStats(ProfileStats *stats);
+const char *Profile_getPhaseName(Phase phase);
+
+#endif
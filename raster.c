@@ -0,0 +1,223 @@
+/*
+   CPong
+   Software rasterizer. See raster.h.
+*/
+
+/* Standard C includes */
+#include <math.h>
+#include <string.h>
+
+/* Local includes */
+#include "raster.h"
+
+/* Most values a pixel holds, the three channels of RGB */
+#define MAX_CHANNELS 3
+
+/* Define the 'Plane' struct, one plane of a frame */
+typedef struct Plane{
+
+	unsigned char *pixels;
+	int width;
+	int height;
+	int channels;			/* Bytes per pixel */
+	float scale;			/* Plane pixels per frame pixel */
+	unsigned char value[MAX_CHANNELS];
+
+} Plane;
+
+/* Colors of the arena, as in 'ArenaRenderer' */
+static const RasterColor BACKGROUND = {0, 0, 0};
+static const RasterColor FIELD = {255, 255, 255};
+static const RasterColor PLAYER_ONE = {255, 0, 0};
+static const RasterColor PLAYER_TWO = {0, 0, 255};
+static const RasterColor BALL = {0, 255, 0};
+
+/* Static function declarations */
+static int Framebuffer_getPlanes(const Framebuffer *frame, RasterColor color, Plane *planes);
+static void Plane_fillRect(const Plane *plane, float x, float y, float width, float height);
+static void Plane_fillRow(const Plane *plane, unsigned char *row, int first, int last, int firstCover, int lastCover, int rowCover);
+static void Plane_store(const Plane *plane, unsigned char *pixel, int count);
+static void Plane_blend(const Plane *plane, unsigned char *pixel, int cover);
+static int coverSpan(float low, float high, int limit, int *first, int *last, int *firstCover, int *lastCover);
+static unsigned char toByte(int value);
+static float blend(Scalar previous, Scalar current, float alpha);
+
+/* Returns the bytes a frame takes */
+size_t Framebuffer_getSize(int width, int height, FramebufferFormat format){
+
+	if(width < 1 || height < 1) return 0;
+	size_t pixels = (size_t)width * height;
+	if(format == FRAMEBUFFER_RGB) return pixels * 3;
+	if(width % 2 || height % 2) return 0;
+	return pixels + pixels / 2;
+
+}
+
+/* Points a framebuffer at memory owned by the caller */
+int Framebuffer_wrap(Framebuffer *frame, unsigned char *pixels, int width, int height, FramebufferFormat format){
+
+	frame->pixels = pixels;
+	frame->width = width;
+	frame->height = height;
+	frame->format = format;
+	return pixels != NULL && Framebuffer_getSize(width, height, format) > 0;
+
+}
+
+/* Fills every pixel with a color */
+void Framebuffer_clear(Framebuffer *frame, RasterColor color){
+
+	Plane planes[3];
+	int count = Framebuffer_getPlanes(frame, color, planes);
+	for(int i = 0; i < count; ++i) Plane_store(&planes[i], planes[i].pixels, planes[i].width * planes[i].height);
+
+}
+
+/* Fills a rectangle in pixel units, blending its edges by how much of each pixel they cover */
+void Framebuffer_fillRect(Framebuffer *frame, float x, float y, float width, float height, RasterColor color){
+
+	Plane planes[3];
+	int count = Framebuffer_getPlanes(frame, color, planes);
+	for(int i = 0; i < count; ++i){
+		float scale = planes[i].scale;
+		Plane_fillRect(&planes[i], x * scale, y * scale, width * scale, height * scale);
+	}
+
+}
+
+/* Draws the field, both paddles and the ball */
+void Framebuffer_drawMatch(Framebuffer *frame, const Match *previous, const Match *current, float alpha){
+
+	/* The field keeps its aspect ratio and is centered, as a single arena fills the window */
+	float scale = MIN((float)frame->width / WINDOW_WIDTH, (float)frame->height / WINDOW_HEIGHT);
+	float x = (frame->width - WINDOW_WIDTH * scale) * 0.5f, y = (frame->height - WINDOW_HEIGHT * scale) * 0.5f;
+	float t = (previous->gameState == 1 && current->gameState == 1) ? alpha : 1.0f;
+
+	if(x > 0.0f || y > 0.0f) Framebuffer_clear(frame, BACKGROUND);
+	Framebuffer_fillRect(frame, x, y, WINDOW_WIDTH * scale, WINDOW_HEIGHT * scale, FIELD);
+
+	const Paddle *paddles[2][2] = {{&previous->p1, &current->p1}, {&previous->p2, &current->p2}};
+	const RasterColor colors[2] = {PLAYER_ONE, PLAYER_TWO};
+	for(int i = 0; i < 2; ++i){
+		float paddleX = blend(paddles[i][0]->position.x, paddles[i][1]->position.x, t);
+		float paddleY = blend(paddles[i][0]->position.y, paddles[i][1]->position.y, t);
+		Framebuffer_fillRect(frame, x + paddleX * scale, y + paddleY * scale, PADDLE_WIDTH * scale, PADDLE_HEIGHT * scale, colors[i]);
+	}
+
+	float ballX = blend(previous->ball.position.x, current->ball.position.x, t);
+	float ballY = blend(previous->ball.position.y, current->ball.position.y, t);
+	Framebuffer_fillRect(frame, x + ballX * scale, y + ballY * scale, BALL_SIZE * scale, BALL_SIZE * scale, BALL);
+
+}
+
+/* Splits a frame into its planes, each holding the color converted to its format. Returns the number of planes.
+   The conversion is BT.601 in 16 bit fixed point; each row of coefficients sums to 65536 or 0, so white stays
+   exactly 255 and grays carry no color. Pure red and blue round to 256 and are clamped. */
+static int Framebuffer_getPlanes(const Framebuffer *frame, RasterColor color, Plane *planes){
+
+	if(frame->format == FRAMEBUFFER_RGB){
+		planes[0] = (Plane){frame->pixels, frame->width, frame->height, 3, 1.0f, {color.r, color.g, color.b}};
+		return 1;
+	}
+
+	int r = color.r, g = color.g, b = color.b;
+	int width = frame->width / 2, height = frame->height / 2;
+	unsigned char *u = frame->pixels + (size_t)frame->width * frame->height, *v = u + (size_t)width * height;
+	planes[0] = (Plane){frame->pixels, frame->width, frame->height, 1, 1.0f, {toByte((19595 * r + 38470 * g + 7471 * b + 32768) >> 16)}};
+	planes[1] = (Plane){u, width, height, 1, 0.5f, {toByte((-11059 * r - 21709 * g + 32768 * b + (128 << 16) + 32768) >> 16)}};
+	planes[2] = (Plane){v, width, height, 1, 0.5f, {toByte((32768 * r - 27439 * g - 5329 * b + (128 << 16) + 32768) >> 16)}};
+	return 3;
+
+}
+
+/* Fills a rectangle in the plane's own pixel units */
+static void Plane_fillRect(const Plane *plane, float x, float y, float width, float height){
+
+	int left, right, leftCover, rightCover, top, bottom, topCover, bottomCover;
+	if(!coverSpan(x, x + width, plane->width, &left, &right, &leftCover, &rightCover) ||
+		!coverSpan(y, y + height, plane->height, &top, &bottom, &topCover, &bottomCover))
+		return;
+
+	size_t stride = (size_t)plane->width * plane->channels;
+	for(int row = top; row <= bottom; ++row){
+		int rowCover = (row == top) ? topCover : (row == bottom) ? bottomCover : 256;
+		Plane_fillRow(plane, plane->pixels + row * stride, left, right, leftCover, rightCover, rowCover);
+	}
+
+}
+
+/* Fills the pixels from 'first' to 'last' of one row. Only the end pixels, or a whole row on the edge of the
+   rectangle, are blended; the rest are stored. */
+static void Plane_fillRow(const Plane *plane, unsigned char *row, int first, int last, int firstCover, int lastCover, int rowCover){
+
+	int channels = plane->channels;
+	Plane_blend(plane, row + first * channels, (firstCover * rowCover) >> 8);
+	if(first == last) return;
+
+	unsigned char *pixel = row + (first + 1) * channels;
+	if(rowCover >= 256) Plane_store(plane, pixel, last - first - 1);
+	else for(int column = first + 1; column < last; ++column, pixel += channels) Plane_blend(plane, pixel, rowCover);
+	Plane_blend(plane, row + last * channels, (lastCover * rowCover) >> 8);
+
+}
+
+/* Stores the plane's value in 'count' pixels. A single channel or a gray is a memset. */
+static void Plane_store(const Plane *plane, unsigned char *pixel, int count){
+
+	const unsigned char *value = plane->value;
+	if(plane->channels == 1 || (value[0] == value[1] && value[1] == value[2])){
+		memset(pixel, value[0], (size_t)count * plane->channels);
+		return;
+	}
+
+	for(int i = 0; i < count; ++i, pixel += 3){
+		pixel[0] = value[0];
+		pixel[1] = value[1];
+		pixel[2] = value[2];
+	}
+
+}
+
+/* Blends the plane's value over a pixel by 'cover' out of 256 */
+static void Plane_blend(const Plane *plane, unsigned char *pixel, int cover){
+
+	for(int i = 0; i < plane->channels; ++i) pixel[i] = (unsigned char)(pixel[i] + (((plane->value[i] - pixel[i]) * cover) >> 8));
+
+}
+
+/* Finds the pixels from 'first' to 'last' a span covers, clipped to [0, limit), and how much of the first and last
+   pixels it covers out of 256. Returns 0 if it covers none. */
+static int coverSpan(float low, float high, int limit, int *first, int *last, int *firstCover, int *lastCover){
+
+	low = MAX(low, 0.0f);
+	high = MIN(high, (float)limit);
+	if(!(high > low)) return 0;
+
+	*first = (int)low;
+	*last = (int)ceilf(high) - 1;
+	if(*last >= limit) *last = limit - 1;
+
+	if(*first == *last){
+		*firstCover = *lastCover = (int)((high - low) * 256.0f + 0.5f);
+	}else{
+		*firstCover = (int)((*first + 1 - low) * 256.0f + 0.5f);
+		*lastCover = (int)((high - *last) * 256.0f + 0.5f);
+	}
+	return *firstCover > 0 || *first != *last;
+
+}
+
+/* Clamps a channel to a byte */
+static unsigned char toByte(int value){
+
+	return (unsigned char)MAX(0, MIN(value, 255));
+
+}
+
+/* Blends two positions for drawing */
+static float blend(Scalar previous, Scalar current, float alpha){
+
+	float a = Scalar_toFloat(previous), b = Scalar_toFloat(current);
+	return a + (b - a) * alpha;
+
+}
@@ -0,0 +1,64 @@
+/*
+   CPong
+   Software rasterizer for drawing matches without a window or GPU.
+
+   A 'Framebuffer' is a frame in memory, either packed 8-bit RGB or
+   planar YUV 4:2:0 (a full size Y plane, then U and V planes at half the
+   width and height, the 'C420jpeg' layout of Y4M files). A match is
+   drawn into it with the colors of 'ArenaRenderer': the white field
+   scaled to fit the frame and centered on black, the red and blue
+   paddles and the green ball.
+
+   Every shape is a flat colored, axis aligned rectangle, so it is drawn
+   straight into each plane in that plane's own format: the color is
+   converted once per rectangle with full range BT.601 coefficients, and
+   the chroma planes take the rectangle at half scale. Edges are
+   antialiased by the fraction of each edge pixel the rectangle covers,
+   which for a chroma sample is the same as averaging the 2x2 pixels it
+   stands for, and pixels inside a rectangle are plain stores. A frame
+   only touches its own memory, so any number of threads can each draw
+   into their own at once.
+*/
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stddef.h>
+
+#include "pong.h"
+
+/* Pixel formats. YUV 4:2:0 needs an even width and height. */
+typedef enum {FRAMEBUFFER_RGB, FRAMEBUFFER_YUV420} FramebufferFormat;
+
+/* Define the 'RasterColor' struct */
+typedef struct RasterColor{
+
+	unsigned char r, g, b;
+
+} RasterColor;
+
+/* Define the 'Framebuffer' struct. Rows are stored from the top, with no padding. */
+typedef struct Framebuffer{
+
+	unsigned char *pixels;
+	int width;
+	int height;
+	FramebufferFormat format;
+
+} Framebuffer;
+
+/* Framebuffer function declarations. Functions returning int return nonzero on success. */
+
+/* Returns the bytes a frame of the given size and format takes, or 0 if the size is not valid for the format */
+size_t Framebuffer_getSize(int width, int height, FramebufferFormat format);
+
+/* Points 'frame' at a frame stored in 'pixels', which must hold 'Framebuffer_getSize' bytes */
+int Framebuffer_wrap(Framebuffer *frame, unsigned char *pixels, int width, int height, FramebufferFormat format);
+
+void Framebuffer_clear(Framebuffer *frame, RasterColor color);
+void Framebuffer_fillRect(Framebuffer *frame, float x, float y, float width, float height, RasterColor color);
+
+/* Draws the match at the given fraction between two consecutive states, blended as 'ArenaRenderer_update' does */
+void Framebuffer_drawMatch(Framebuffer *frame, const Match *previous, const Match *current, float alpha);
+
+#endif
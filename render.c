@@ -0,0 +1,215 @@
+/*
+   CPong
+   Batched renderer for one or many arenas. See render.h.
+*/
+
+/* Standard C includes */
+#include <math.h>
+
+/* Local includes */
+#include "render.h"
+
+/* Layout definitions */
+#define ARENA_QUADS 4			/* Field, player one, player two, ball */
+#define ARENA_VERTICES (ARENA_QUADS * 4)
+#define ARENA_MARGIN 2.0f		/* Gap between arenas in the grid, in pixels */
+
+/* Static function declarations */
+static void setQuad(sfVertex *quad, float x, float y, float width, float height);
+static sfVector2f blend(Point previous, Point current, float alpha);
+
+/* Creates a renderer for a number of arenas filling a window of the given size */
+int ArenaRenderer_create(ArenaRenderer *renderer, size_t arenaCount, unsigned int width, unsigned int height){
+
+	if(arenaCount == 0) return 0;
+	renderer->vertices = sfVertexArray_create();
+	if(!renderer->vertices) return 0;
+	sfVertexArray_setPrimitiveType(renderer->vertices, sfQuads);
+	sfVertexArray_resize(renderer->vertices, arenaCount * ARENA_VERTICES);
+	if(sfVertexArray_getVertexCount(renderer->vertices) != arenaCount * ARENA_VERTICES){
+		sfVertexArray_destroy(renderer->vertices);
+		return 0;
+	}
+
+	/* The smallest grid with the playfield's aspect ratio that holds every arena. A single
+	   arena fills the window exactly, with no margin. */
+	unsigned int columns = (unsigned int)ceil(sqrt((double)arenaCount));
+	unsigned int rows = (unsigned int)((arenaCount + columns - 1) / columns);
+	float margin = (arenaCount > 1) ? ARENA_MARGIN : 0.0f;
+	renderer->arenaCount = arenaCount;
+	renderer->columns = columns;
+	renderer->cellWidth = (float)width / columns;
+	renderer->cellHeight = (float)height / rows;
+	renderer->scale = MIN((renderer->cellWidth - margin) / WINDOW_WIDTH, (renderer->cellHeight - margin) / WINDOW_HEIGHT);
+
+	/* Colors and fields are written once */
+	sfVertex *vertices = sfVertexArray_getVertex(renderer->vertices, 0);
+	const sfColor colors[ARENA_QUADS] = {sfWhite, sfRed, sfBlue, sfGreen};
+	for(size_t arena = 0; arena < arenaCount; ++arena){
+		sfVertex *quads = vertices + arena * ARENA_VERTICES;
+		for(int i = 0; i < ARENA_VERTICES; ++i){
+			quads[i].color = colors[i / 4];
+			quads[i].texCoords = (sfVector2f){0.0f, 0.0f};
+		}
+		float x = (float)(arena % columns) * renderer->cellWidth, y = (float)(arena / columns) * renderer->cellHeight;
+		setQuad(quads, x, y, WINDOW_WIDTH * renderer->scale, WINDOW_HEIGHT * renderer->scale);
+	}
+
+	return 1;
+
+}
+
+/* Moves the paddles and balls of every arena to the given fraction between the previous and current states.
+   As in the single window, positions are not blended across a serve or outside of a round. */
+void ArenaRenderer_update(ArenaRenderer *renderer, const Match *previous, const Match *current, float alpha){
+
+	sfVertex *vertices = sfVertexArray_getVertex(renderer->vertices, 0);
+	float scale = renderer->scale;
+
+	for(size_t arena = 0; arena < renderer->arenaCount; ++arena){
+
+		const Match *a = &previous[arena], *b = &current[arena];
+		float t = (a->gameState == 1 && b->gameState == 1) ? alpha : 1.0f;
+		sfVertex *quads = vertices + arena * ARENA_VERTICES;
+		float x = quads[0].position.x, y = quads[0].position.y;
+
+		sfVector2f p1 = blend(a->p1.position, b->p1.position, t);
+		sfVector2f p2 = blend(a->p2.position, b->p2.position, t);
+		sfVector2f ball = blend(a->ball.position, b->ball.position, t);
+		setQuad(quads + 4, x + p1.x * scale, y + p1.y * scale, PADDLE_WIDTH * scale, PADDLE_HEIGHT * scale);
+		setQuad(quads + 8, x + p2.x * scale, y + p2.y * scale, PADDLE_WIDTH * scale, PADDLE_HEIGHT * scale);
+		setQuad(quads + 12, x + ball.x * scale, y + ball.y * scale, BALL_SIZE * scale, BALL_SIZE * scale);
+
+	}
+
+}
+
+/* Draws every arena with one draw call */
+void ArenaRenderer_draw(const ArenaRenderer *renderer, sfRenderWindow *window){
+
+	sfRenderWindow_drawVertexArray(window, renderer->vertices, NULL);
+
+}
+
+/* Frees the renderer */
+void ArenaRenderer_destroy(ArenaRenderer *renderer){
+
+	sfVertexArray_destroy(renderer->vertices);
+
+}
+
+/* Creates a renderer for a ball field with the given number of balls */
+int FieldRenderer_create(FieldRenderer *renderer, size_t ballCount){
+
+	size_t quads = ballCount + 3;
+	renderer->vertices = sfVertexArray_create();
+	if(!renderer->vertices) return 0;
+	sfVertexArray_setPrimitiveType(renderer->vertices, sfQuads);
+	sfVertexArray_resize(renderer->vertices, quads * 4);
+	if(sfVertexArray_getVertexCount(renderer->vertices) != quads * 4){
+		sfVertexArray_destroy(renderer->vertices);
+		return 0;
+	}
+	renderer->ballCount = ballCount;
+
+	/* The field first, then the paddles, then the balls */
+	sfVertex *vertices = sfVertexArray_getVertex(renderer->vertices, 0);
+	for(size_t i = 0; i < quads * 4; ++i){
+		size_t quad = i / 4;
+		vertices[i].color = (quad == 0) ? sfWhite : (quad == 1) ? sfRed : (quad == 2) ? sfBlue : sfGreen;
+		vertices[i].texCoords = (sfVector2f){0.0f, 0.0f};
+	}
+	setQuad(vertices, 0.0f, 0.0f, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+	return 1;
+
+}
+
+/* Moves the paddle and ball quads to the field's current positions */
+void FieldRenderer_update(FieldRenderer *renderer, const BallField *field){
+
+	sfVertex *vertices = sfVertexArray_getVertex(renderer->vertices, 0);
+	setQuad(vertices + 4, Scalar_toFloat(field->p1.position.x), Scalar_toFloat(field->p1.position.y), PADDLE_WIDTH, PADDLE_HEIGHT);
+	setQuad(vertices + 8, Scalar_toFloat(field->p2.position.x), Scalar_toFloat(field->p2.position.y), PADDLE_WIDTH, PADDLE_HEIGHT);
+
+	sfVertex *balls = vertices + 12;
+	size_t count = MIN(renderer->ballCount, field->count);
+	for(size_t i = 0; i < count; ++i) setQuad(balls + i * 4, field->x[i], field->y[i], field->size, field->size);
+
+}
+
+/* Draws the whole field with one draw call */
+void FieldRenderer_draw(const FieldRenderer *renderer, sfRenderWindow *window){
+
+	sfRenderWindow_drawVertexArray(window, renderer->vertices, NULL);
+
+}
+
+/* Frees the renderer */
+void FieldRenderer_destroy(FieldRenderer *renderer){
+
+	sfVertexArray_destroy(renderer->vertices);
+
+}
+
+/* Creates a renderer with one quad per obstacle of the layout, colored by kind */
+int LayoutRenderer_create(LayoutRenderer *renderer, const Layout *layout){
+
+	renderer->vertices = sfVertexArray_create();
+	if(!renderer->vertices) return 0;
+	sfVertexArray_setPrimitiveType(renderer->vertices, sfQuads);
+	sfVertexArray_resize(renderer->vertices, layout->count * 4);
+	if(sfVertexArray_getVertexCount(renderer->vertices) != layout->count * 4){
+		sfVertexArray_destroy(renderer->vertices);
+		return 0;
+	}
+
+	/* Walls are gray, bumpers yellow and goals a pale shade of the color of the player they score for */
+	const sfColor wall = {96, 96, 96, 255}, bumper = {230, 200, 40, 255}, goals[2] = {{255, 150, 150, 255}, {150, 150, 255, 255}};
+	for(size_t i = 0; i < layout->count; ++i){
+		const Obstacle *obstacle = &layout->obstacles[i];
+		sfVertex *quad = sfVertexArray_getVertex(renderer->vertices, i * 4);
+		sfColor color = (obstacle->kind == OBSTACLE_WALL) ? wall : (obstacle->kind == OBSTACLE_BUMPER) ? bumper : goals[obstacle->player == 2];
+		for(int corner = 0; corner < 4; ++corner){
+			quad[corner].color = color;
+			quad[corner].texCoords = (sfVector2f){0.0f, 0.0f};
+		}
+		float x = Scalar_toFloat(obstacle->min.x), y = Scalar_toFloat(obstacle->min.y);
+		setQuad(quad, x, y, Scalar_toFloat(obstacle->max.x) - x, Scalar_toFloat(obstacle->max.y) - y);
+	}
+
+	return 1;
+
+}
+
+/* Draws every obstacle with one draw call */
+void LayoutRenderer_draw(const LayoutRenderer *renderer, sfRenderWindow *window){
+
+	sfRenderWindow_drawVertexArray(window, renderer->vertices, NULL);
+
+}
+
+/* Frees the renderer */
+void LayoutRenderer_destroy(LayoutRenderer *renderer){
+
+	sfVertexArray_destroy(renderer->vertices);
+
+}
+
+/* Writes the corners of an axis aligned quad, clockwise from the top-left */
+static void setQuad(sfVertex *quad, float x, float y, float width, float height){
+
+	quad[0].position = (sfVector2f){x, y};
+	quad[1].position = (sfVector2f){x + width, y};
+	quad[2].position = (sfVector2f){x + width, y + height};
+	quad[3].position = (sfVector2f){x, y + height};
+
+}
+
+/* Returns the point between two simulation points at the given fraction, in screen coordinates */
+static sfVector2f blend(Point previous, Point current, float alpha){
+
+	float x = Scalar_toFloat(previous.x), y = Scalar_toFloat(previous.y);
+	return (sfVector2f){x + (Scalar_toFloat(current.x) - x) * alpha, y + (Scalar_toFloat(current.y) - y) * alpha};
+
+}
@@ -0,0 +1,74 @@
+/*
+   CPong
+   Batched renderer for one or many arenas.
+
+   All arenas are laid out in a grid filling the window. Each arena is
+   four quads in a single vertex array: the field, both paddles and the
+   ball. The array is sized once when the renderer is created, the field
+   quads never change, and each frame only the paddle and ball vertices
+   are rewritten in place, so drawing any number of arenas is one draw
+   call with no allocation.
+
+   'FieldRenderer' does the same for the many-ball mode: the field,
+   both paddles and every ball are quads in one vertex array.
+
+   'LayoutRenderer' draws the obstacles of an arena layout over a single
+   arena. They never move, so their quads are written once.
+*/
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+
+#include <SFML/Graphics.h>
+
+#include "pong.h"
+#include "balls.h"
+#include "layout.h"
+
+/* Define the 'ArenaRenderer' struct */
+typedef struct ArenaRenderer{
+
+	sfVertexArray *vertices;
+	size_t arenaCount;
+	unsigned int columns;
+	float scale;			/* Window pixels per playfield unit */
+	float cellWidth;
+	float cellHeight;
+
+} ArenaRenderer;
+
+/* Renderer function declarations. Functions returning int return nonzero on success. */
+int ArenaRenderer_create(ArenaRenderer *renderer, size_t arenaCount, unsigned int width, unsigned int height);
+void ArenaRenderer_update(ArenaRenderer *renderer, const Match *previous, const Match *current, float alpha);
+void ArenaRenderer_draw(const ArenaRenderer *renderer, sfRenderWindow *window);
+void ArenaRenderer_destroy(ArenaRenderer *renderer);
+
+/* Define the 'FieldRenderer' struct */
+typedef struct FieldRenderer{
+
+	sfVertexArray *vertices;
+	size_t ballCount;
+
+} FieldRenderer;
+
+/* Field renderer function declarations */
+int FieldRenderer_create(FieldRenderer *renderer, size_t ballCount);
+void FieldRenderer_update(FieldRenderer *renderer, const BallField *field);
+void FieldRenderer_draw(const FieldRenderer *renderer, sfRenderWindow *window);
+void FieldRenderer_destroy(FieldRenderer *renderer);
+
+/* Define the 'LayoutRenderer' struct */
+typedef struct LayoutRenderer{
+
+	sfVertexArray *vertices;
+
+} LayoutRenderer;
+
+/* Layout renderer function declarations */
+int LayoutRenderer_create(LayoutRenderer *renderer, const Layout *layout);
+void LayoutRenderer_draw(const LayoutRenderer *renderer, sfRenderWindow *window);
+void LayoutRenderer_destroy(LayoutRenderer *renderer);
+
+#endif
@@ -0,0 +1,451 @@
+/*
+   CPong
+   Compact binary match recordings. See replay.h for the file layout.
+*/
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+/* Standard C includes */
+#include <stdlib.h>
+#include <string.h>
+
+/* Platform includes */
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Local includes */
+#include "replay.h"
+
+/* File format definitions. Keyframes hold the raw scalars of the backend the core is built with,
+   so fixed point builds write and accept their own version. */
+#ifdef PONG_FIXED
+#define REPLAY_VERSION 0x10002
+#else
+#define REPLAY_VERSION 2
+#endif
+#define REPLAY_HEADER_SIZE 16
+#define REPLAY_FOOTER_SIZE 12
+#define REPLAY_MATCH_SIZE 60
+#define REPLAY_TOKEN_KEYFRAME 'K'
+#define REPLAY_TOKEN_END 'E'
+
+/* Static function declarations */
+static int writeBytes(ReplayWriter *writer, const void *bytes, size_t size);
+static int writeU32(ReplayWriter *writer, unsigned int value);
+static int writeVarint(ReplayWriter *writer, unsigned int value);
+static int flushRun(ReplayWriter *writer);
+static int writeKeyframe(ReplayWriter *writer, const Match *match);
+static void putU32(unsigned char *bytes, unsigned int value);
+static unsigned int getU32(const unsigned char *bytes);
+static int readVarint(const Replay *replay, size_t *offset, unsigned int *value);
+static void packMatch(unsigned char *bytes, const Match *match);
+static void unpackMatch(const unsigned char *bytes, Match *match);
+static int scanStream(Replay *replay);
+static int mapFile(Replay *replay, const char *path);
+
+/* Creates the replay file and writes its header */
+int ReplayWriter_open(ReplayWriter *writer, const char *path, unsigned int seed, unsigned int interval){
+
+	memset(writer, 0, sizeof(*writer));
+	writer->interval = interval ? interval : REPLAY_KEYFRAME_INTERVAL;
+	writer->file = fopen(path, "wb");
+	if(!writer->file) return 0;
+
+	if(!writeBytes(writer, "CPRP", 4) || !writeU32(writer, REPLAY_VERSION) ||
+		!writeU32(writer, seed) || !writeU32(writer, writer->interval)){
+		fclose(writer->file);
+		writer->file = NULL;
+		return 0;
+	}
+
+	return 1;
+
+}
+
+/* Records one tick. Call this with the match state before the tick and the input the tick is run with. */
+int ReplayWriter_record(ReplayWriter *writer, const Match *match, Input input){
+
+	if(writer->tick % writer->interval == 0 && !writeKeyframe(writer, match)) return 0;
+
+	if(writer->runLength && input != writer->runInput && !flushRun(writer)) return 0;
+	writer->runInput = input;
+	++writer->runLength;
+	++writer->tick;
+	return 1;
+
+}
+
+/* Finishes the stream, writes the keyframe index and closes the file */
+int ReplayWriter_close(ReplayWriter *writer){
+
+	if(!writer->file) return 0;
+
+	int ok = flushRun(writer) && writeVarint(writer, 0);
+	unsigned char end = REPLAY_TOKEN_END;
+	ok = ok && writeBytes(writer, &end, 1);
+
+	/* Keyframe index */
+	unsigned int indexOffset = writer->offset;
+	ok = ok && writeU32(writer, writer->keyframeCount);
+	for(unsigned int i = 0; ok && i < writer->keyframeCount; ++i)
+		ok = writeU32(writer, writer->keyframes[i].tick) && writeU32(writer, writer->keyframes[i].offset);
+
+	/* Footer */
+	ok = ok && writeU32(writer, indexOffset) && writeU32(writer, writer->tick) && writeBytes(writer, "CPRE", 4);
+
+	if(fclose(writer->file) != 0) ok = 0;
+	free(writer->keyframes);
+	memset(writer, 0, sizeof(*writer));
+	return ok;
+
+}
+
+/* Maps a replay file into memory and loads its keyframe index */
+int Replay_open(Replay *replay, const char *path){
+
+	memset(replay, 0, sizeof(*replay));
+	if(!mapFile(replay, path)) return 0;
+
+	if(replay->size < REPLAY_HEADER_SIZE || memcmp(replay->data, "CPRP", 4) != 0 ||
+		getU32(replay->data + 4) != REPLAY_VERSION){
+		Replay_close(replay);
+		return 0;
+	}
+	replay->seed = getU32(replay->data + 8);
+
+	/* Use the index if the file was closed properly, otherwise rebuild it from the stream */
+	const unsigned char *footer = replay->data + replay->size - REPLAY_FOOTER_SIZE;
+	if(replay->size >= REPLAY_HEADER_SIZE + REPLAY_FOOTER_SIZE + 4 && memcmp(footer + 8, "CPRE", 4) == 0){
+
+		size_t indexOffset = getU32(footer);
+		unsigned int count = (indexOffset + 4 <= replay->size) ? getU32(replay->data + indexOffset) : 0;
+
+		if(indexOffset + 4 + (size_t)count * 8 + REPLAY_FOOTER_SIZE == replay->size){
+			replay->keyframes = malloc((count ? count : 1) * sizeof(ReplayKeyframe));
+			if(!replay->keyframes){ Replay_close(replay); return 0; }
+			for(unsigned int i = 0; i < count; ++i){
+				replay->keyframes[i].tick = getU32(replay->data + indexOffset + 4 + i * 8);
+				replay->keyframes[i].offset = getU32(replay->data + indexOffset + 8 + i * 8);
+			}
+			replay->keyframeCount = count;
+			replay->tickCount = getU32(footer + 4);
+			replay->streamEnd = indexOffset;
+			return 1;
+		}
+
+	}
+
+	replay->streamEnd = replay->size;
+	if(!scanStream(replay)){ Replay_close(replay); return 0; }
+	return 1;
+
+}
+
+/* Unmaps the replay and frees its index */
+void Replay_close(Replay *replay){
+
+	if(replay->data){
+#ifdef _WIN32
+		UnmapViewOfFile(replay->data);
+		CloseHandle((HANDLE)replay->mapping);
+#else
+		munmap((void*)replay->data, replay->size);
+#endif
+	}
+	free(replay->keyframes);
+	memset(replay, 0, sizeof(*replay));
+
+}
+
+/* Positions the cursor so that its match holds the state before the given tick.
+   Starts from the closest keyframe at or before the tick and simulates the rest. */
+int Replay_seek(const Replay *replay, ReplayCursor *cursor, unsigned int tick){
+
+	memset(cursor, 0, sizeof(*cursor));
+	cursor->replay = replay;
+	cursor->offset = REPLAY_HEADER_SIZE;
+	Match_init(&cursor->match, replay->seed);
+
+	/* Binary search for the last keyframe at or before the tick */
+	unsigned int low = 0, high = replay->keyframeCount;
+	while(low < high){
+		unsigned int middle = low + (high - low) / 2;
+		if(replay->keyframes[middle].tick <= tick) low = middle + 1;
+		else high = middle;
+	}
+
+	if(low > 0){
+		const ReplayKeyframe *keyframe = &replay->keyframes[low - 1];
+		size_t start = keyframe->offset + 2;
+		if(start + 4 + REPLAY_MATCH_SIZE > replay->streamEnd) return 0;
+		unpackMatch(replay->data + start + 4, &cursor->match);
+		cursor->tick = keyframe->tick;
+		cursor->offset = start + 4 + REPLAY_MATCH_SIZE;
+	}
+
+	while(cursor->tick < tick){
+		Input input;
+		if(!ReplayCursor_next(cursor, &input)) return 0;
+	}
+
+	return 1;
+
+}
+
+/* Advances the cursor's match by one recorded tick. Returns 0 at the end of the replay. */
+int ReplayCursor_next(ReplayCursor *cursor, Input *input){
+
+	const Replay *replay = cursor->replay;
+
+	while(cursor->runLeft == 0){
+
+		unsigned int length;
+		if(!readVarint(replay, &cursor->offset, &length)) return 0;
+
+		if(length == 0){
+			if(cursor->offset >= replay->streamEnd) return 0;
+			unsigned char token = replay->data[cursor->offset++];
+			if(token != REPLAY_TOKEN_KEYFRAME) return 0;
+			cursor->offset += 4 + REPLAY_MATCH_SIZE;
+			continue;
+		}
+
+		unsigned int value;
+		if(!readVarint(replay, &cursor->offset, &value)) return 0;
+		cursor->runLeft = length;
+		cursor->runInput = (Input)value;
+
+	}
+
+	--cursor->runLeft;
+	*input = cursor->runInput;
+	Match_tick(&cursor->match, cursor->runInput);
+	++cursor->tick;
+	return 1;
+
+}
+
+/* Writes raw bytes and keeps track of the stream offset */
+static int writeBytes(ReplayWriter *writer, const void *bytes, size_t size){
+
+	if(fwrite(bytes, 1, size, writer->file) != size) return 0;
+	writer->offset += (unsigned int)size;
+	return 1;
+
+}
+
+/* Writes a little-endian 32 bit integer */
+static int writeU32(ReplayWriter *writer, unsigned int value){
+
+	unsigned char bytes[4];
+	putU32(bytes, value);
+	return writeBytes(writer, bytes, 4);
+
+}
+
+/* Writes an unsigned LEB128 varint */
+static int writeVarint(ReplayWriter *writer, unsigned int value){
+
+	unsigned char bytes[5];
+	size_t size = 0;
+	do{
+		bytes[size] = value & 0x7f;
+		value >>= 7;
+		if(value) bytes[size] |= 0x80;
+		++size;
+	}while(value);
+	return writeBytes(writer, bytes, size);
+
+}
+
+/* Writes out the pending run of equal inputs */
+static int flushRun(ReplayWriter *writer){
+
+	if(writer->runLength == 0) return 1;
+	int ok = writeVarint(writer, writer->runLength) && writeVarint(writer, writer->runInput);
+	writer->runLength = 0;
+	return ok;
+
+}
+
+/* Writes a keyframe token holding the match state and adds it to the index */
+static int writeKeyframe(ReplayWriter *writer, const Match *match){
+
+	/* Keyframes must sit between runs so playback can resume right after them */
+	if(!flushRun(writer)) return 0;
+
+	if(writer->keyframeCount == writer->keyframeCapacity){
+		unsigned int capacity = writer->keyframeCapacity ? writer->keyframeCapacity * 2 : 64;
+		ReplayKeyframe *keyframes = realloc(writer->keyframes, capacity * sizeof(ReplayKeyframe));
+		if(!keyframes) return 0;
+		writer->keyframes = keyframes;
+		writer->keyframeCapacity = capacity;
+	}
+	writer->keyframes[writer->keyframeCount++] = (ReplayKeyframe){writer->tick, writer->offset};
+
+	unsigned char bytes[2 + 4 + REPLAY_MATCH_SIZE];
+	bytes[0] = 0;
+	bytes[1] = REPLAY_TOKEN_KEYFRAME;
+	putU32(bytes + 2, writer->tick);
+	packMatch(bytes + 6, match);
+	return writeBytes(writer, bytes, sizeof(bytes));
+
+}
+
+/* Stores a little-endian 32 bit integer */
+static void putU32(unsigned char *bytes, unsigned int value){
+
+	bytes[0] = value & 0xff; bytes[1] = (value >> 8) & 0xff;
+	bytes[2] = (value >> 16) & 0xff; bytes[3] = (value >> 24) & 0xff;
+
+}
+
+/* Loads a little-endian 32 bit integer */
+static unsigned int getU32(const unsigned char *bytes){
+
+	return (unsigned int)bytes[0] | ((unsigned int)bytes[1] << 8) |
+		((unsigned int)bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+
+}
+
+/* Reads an unsigned LEB128 varint from the stream, failing at the end of the stream */
+static int readVarint(const Replay *replay, size_t *offset, unsigned int *value){
+
+	*value = 0;
+	for(int shift = 0; shift < 35; shift += 7){
+		if(*offset >= replay->streamEnd) return 0;
+		unsigned char byte = replay->data[(*offset)++];
+		*value |= (unsigned int)(byte & 0x7f) << shift;
+		if(!(byte & 0x80)) return 1;
+	}
+	return 0;
+
+}
+
+/* Serializes every field of the match in a fixed, platform independent layout */
+static void packMatch(unsigned char *bytes, const Match *match){
+
+	Scalar scalars[8] = {match->ball.position.x, match->ball.position.y, match->ball.speed.x, match->ball.speed.y,
+		match->p1.position.x, match->p1.position.y, match->p2.position.x, match->p2.position.y};
+	unsigned int ints[7] = {(unsigned int)match->p1.score, (unsigned int)match->p2.score, (unsigned int)match->gameState,
+		(unsigned int)match->gameStarting, (unsigned int)match->countdown, match->rng, match->events};
+
+	for(int i = 0; i < 8; ++i){
+		unsigned int bits;
+		memcpy(&bits, &scalars[i], 4);
+		putU32(bytes + i * 4, bits);
+	}
+	for(int i = 0; i < 7; ++i) putU32(bytes + 32 + i * 4, ints[i]);
+
+}
+
+/* Restores a match serialized by 'packMatch' */
+static void unpackMatch(const unsigned char *bytes, Match *match){
+
+	Scalar scalars[8];
+	for(int i = 0; i < 8; ++i){
+		unsigned int bits = getU32(bytes + i * 4);
+		memcpy(&scalars[i], &bits, 4);
+	}
+
+	match->ball.position = (Point){scalars[0], scalars[1]};
+	match->ball.speed = (Point){scalars[2], scalars[3]};
+	match->p1.position = (Point){scalars[4], scalars[5]};
+	match->p2.position = (Point){scalars[6], scalars[7]};
+	match->p1.score = (int)getU32(bytes + 32);
+	match->p2.score = (int)getU32(bytes + 36);
+	match->gameState = (int)getU32(bytes + 40);
+	match->gameStarting = (int)getU32(bytes + 44);
+	match->countdown = (int)getU32(bytes + 48);
+	match->rng = getU32(bytes + 52);
+	match->events = getU32(bytes + 56);
+
+}
+
+/* Rebuilds the keyframe index and tick count by walking the whole stream.
+   Used for files that were not closed properly. */
+static int scanStream(Replay *replay){
+
+	size_t offset = REPLAY_HEADER_SIZE;
+	unsigned int capacity = 0;
+
+	while(offset < replay->streamEnd){
+
+		size_t tokenOffset = offset;
+		unsigned int length, value;
+		if(!readVarint(replay, &offset, &length)) break;
+
+		if(length == 0){
+
+			if(offset >= replay->streamEnd || replay->data[offset] != REPLAY_TOKEN_KEYFRAME) break;
+			if(offset + 1 + 4 + REPLAY_MATCH_SIZE > replay->streamEnd) break;
+
+			if(replay->keyframeCount == capacity){
+				capacity = capacity ? capacity * 2 : 64;
+				ReplayKeyframe *keyframes = realloc(replay->keyframes, capacity * sizeof(ReplayKeyframe));
+				if(!keyframes) return 0;
+				replay->keyframes = keyframes;
+			}
+			replay->keyframes[replay->keyframeCount++] =
+				(ReplayKeyframe){getU32(replay->data + offset + 1), (unsigned int)tokenOffset};
+			offset += 1 + 4 + REPLAY_MATCH_SIZE;
+
+		}else{
+
+			if(!readVarint(replay, &offset, &value)) break;
+			replay->tickCount += length;
+
+		}
+
+	}
+
+	return 1;
+
+}
+
+/* Maps the whole file read-only */
+static int mapFile(Replay *replay, const char *path){
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return 0;
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart == 0){ CloseHandle(file); return 0; }
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if(!mapping) return 0;
+
+	const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!data){ CloseHandle(mapping); return 0; }
+
+	replay->data = data;
+	replay->size = (size_t)size.QuadPart;
+	replay->mapping = mapping;
+	return 1;
+#else
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) return 0;
+
+	struct stat info;
+	if(fstat(fd, &info) != 0 || info.st_size == 0){ close(fd); return 0; }
+
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED) return 0;
+
+	replay->data = data;
+	replay->size = (size_t)info.st_size;
+	return 1;
+#endif
+
+}
@@ -0,0 +1,96 @@
+/*
+   CPong
+   Compact binary match recordings.
+
+   A replay stores the seed the match was created with and the input bits
+   of every tick. Since the simulation is deterministic this is enough to
+   reproduce the match exactly. Inputs are run-length encoded as varint
+   pairs, so ticks where nobody touches the keys cost almost nothing.
+   Periodic keyframes hold a full copy of the match state, which lets
+   playback seek to any tick without re-simulating from the start.
+
+   File layout, all integers little-endian:
+
+   header    "CPRP", u32 version, u32 seed, u32 keyframe interval
+   stream    tokens until the end token:
+             varint run length (> 0), varint input   a run of equal inputs
+             varint 0, 'K', u32 tick, match state    a keyframe
+             varint 0, 'E'                           end of the stream
+   index     u32 count, count * (u32 tick, u32 stream offset)
+   footer    u32 index offset, u32 tick count, "CPRE"
+
+   A file cut short before the index is written (for example by a crash)
+   can still be played; the reader rebuilds the index by scanning.
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+
+#include "pong.h"
+
+/* Default number of ticks between keyframes, ten seconds of play */
+#define REPLAY_KEYFRAME_INTERVAL (10 * TICK_RATE)
+
+/* Define a 'ReplayKeyframe' struct locating one keyframe in the stream */
+typedef struct ReplayKeyframe{
+
+	unsigned int tick;
+	unsigned int offset;
+
+} ReplayKeyframe;
+
+/* Define the 'ReplayWriter' struct used to record a match */
+typedef struct ReplayWriter{
+
+	FILE *file;
+	unsigned int interval;
+	unsigned int tick;
+	unsigned int offset;		/* Bytes written so far */
+	Input runInput;
+	unsigned int runLength;
+	ReplayKeyframe *keyframes;
+	unsigned int keyframeCount;
+	unsigned int keyframeCapacity;
+
+} ReplayWriter;
+
+/* Define the 'Replay' struct holding a memory-mapped recording */
+typedef struct Replay{
+
+	const unsigned char *data;
+	size_t size;
+	unsigned int seed;
+	unsigned int tickCount;
+	size_t streamEnd;
+	ReplayKeyframe *keyframes;
+	unsigned int keyframeCount;
+	void *mapping;			/* Platform specific mapping handle */
+
+} Replay;
+
+/* Define the 'ReplayCursor' struct used to walk through a replay tick by tick */
+typedef struct ReplayCursor{
+
+	const Replay *replay;
+	size_t offset;
+	unsigned int tick;
+	Input runInput;
+	unsigned int runLeft;
+	Match match;
+
+} ReplayCursor;
+
+/* Writer function declarations. Functions returning int return nonzero on success. */
+int ReplayWriter_open(ReplayWriter *writer, const char *path, unsigned int seed, unsigned int interval);
+int ReplayWriter_record(ReplayWriter *writer, const Match *match, Input input);
+int ReplayWriter_close(ReplayWriter *writer);
+
+/* Reader function declarations */
+int Replay_open(Replay *replay, const char *path);
+void Replay_close(Replay *replay);
+int Replay_seek(const Replay *replay, ReplayCursor *cursor, unsigned int tick);
+int ReplayCursor_next(ReplayCursor *cursor, Input *input);
+
+#endif
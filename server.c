@@ -0,0 +1,876 @@
+/*
+   CPong
+   Headless match server. See server.h.
+
+   Each I/O thread keeps the clients it has heard from in an open
+   addressing table keyed by address, which only that thread touches.
+   Joining and leaving take the server mutex to hand out match slots.
+   A slot is only ever reused by the tick thread between two ticks, so a
+   tick worker never sees a match change owner under it.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+/* Standard C includes */
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Platform includes */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Local includes */
+#include "server.h"
+#include "netplay.h"
+#include "pool.h"
+#include "timer.h"
+
+/* Cache line size used to keep per-thread data apart */
+#define CACHE_LINE 64
+
+/* Packet definitions */
+#define SERVER_MAGIC_0 'C'
+#define SERVER_MAGIC_1 'S'
+
+/* Server tuning definitions */
+#define SERVER_TICK_CHUNK 64			/* Matches advanced by one pool task */
+#define SERVER_RECEIVE_BATCH 64			/* Datagrams read by one call */
+#define SERVER_SOCKET_BUFFER (4 << 20)
+#define SERVER_POLL_MS 100
+#define SERVER_REAP_NANOS 1000000000ull		/* Time between scans for silent clients */
+#define SERVER_MAX_CATCHUP 4			/* Ticks the tick thread may fall behind before it skips ahead */
+#define TICK_NANOS (1000000000ull / TICK_RATE)
+
+/* Match slot states. Only running slots are ticked, and closing slots are freed between ticks. */
+enum {SLOT_FREE, SLOT_WAITING, SLOT_RUNNING, SLOT_CLOSING};
+
+/* Define the 'ServerPlayer' struct. The address is set before the match runs, the input by the I/O thread. */
+typedef struct ServerPlayer{
+
+	struct sockaddr_in address;
+	atomic_uchar input;
+	atomic_ullong echo;			/* Client time of the latest input */
+
+} ServerPlayer;
+
+/* Define the 'ServerMatch' struct, one match slot */
+typedef struct ServerMatch{
+
+	Match match;
+	unsigned int tick;
+	unsigned int seed;
+	atomic_int state;
+	atomic_uint id;				/* Changes every time the slot is handed out */
+	char matchPadding[CACHE_LINE];		/* Keeps the inputs off the lines the tick writes */
+	ServerPlayer players[2];
+
+} ServerMatch;
+
+/* Define the 'ServerClient' struct, an entry of an I/O thread's client table */
+typedef struct ServerClient{
+
+	unsigned long long key;			/* Address and port, 0 for an empty entry */
+	unsigned long long lastHeard;
+	unsigned int matchId;
+	unsigned int sequence;			/* Latest input sequence taken */
+	int slot;
+	int player;
+
+} ServerClient;
+
+/* Define the 'IoThread' struct */
+typedef struct IoThread{
+
+	Server *server;
+	int socket;
+	int epoll;
+	int wake;				/* Event file written to stop the thread */
+	int started;
+	pthread_t thread;
+
+	ServerClient *clients;
+	size_t mask;
+	atomic_int clientCount;
+	atomic_ullong packetsIn;
+	unsigned long long lastReap;
+
+	/* Receive batch */
+	struct mmsghdr messages[SERVER_RECEIVE_BATCH];
+	struct iovec vectors[SERVER_RECEIVE_BATCH];
+	struct sockaddr_in addresses[SERVER_RECEIVE_BATCH];
+	unsigned char buffers[SERVER_RECEIVE_BATCH][SERVER_MAX_PACKET];
+	char padding[CACHE_LINE];
+
+} IoThread;
+
+/* Define the 'Outbox' struct, the state packets of one tick worker */
+typedef struct Outbox{
+
+	struct mmsghdr messages[2 * SERVER_TICK_CHUNK];
+	struct iovec vectors[2 * SERVER_TICK_CHUNK];
+	unsigned char buffers[2 * SERVER_TICK_CHUNK][SERVER_STATE_SIZE];
+	unsigned long long packetsOut;
+	unsigned long long sendDrops;
+	char padding[CACHE_LINE];
+
+} Outbox;
+
+/* Define the 'Server' struct */
+struct Server{
+
+	ServerMatch *matches;
+	int maxMatches;
+	atomic_int highWater;			/* Slots ever handed out */
+	atomic_int running;
+	atomic_ullong rejectedJoins;
+
+	/* Slot bookkeeping, guarded by 'mutex' */
+	pthread_mutex_t mutex;
+	int *freeSlots;
+	int freeCount;
+	int *closingSlots;
+	int closingCount;
+	int waitingSlot;			/* Slot with one player waiting for a second, or -1 */
+	unsigned int nextId;
+
+	IoThread *io;
+	int ioCount;
+	Pool *pool;
+	Outbox *outboxes;
+	atomic_int stopping;
+	atomic_int shutdown;
+
+	/* Tick schedule, only touched by the thread in 'Server_run' */
+	unsigned long long nextTick;
+	int tickHighWater;
+	unsigned long long ticks;
+	unsigned long long missedTicks;
+	unsigned long long tickNanos[SERVER_TICK_HISTORY];
+
+};
+
+/* Static function declarations */
+static void Server_tick(Server *server);
+static void Server_tickChunk(void *arg, size_t index, int worker);
+static void *IoThread_main(void *arg);
+static void IoThread_receive(IoThread *io);
+static void IoThread_handle(IoThread *io, const unsigned char *packet, size_t size, const struct sockaddr_in *address, unsigned long long now);
+static void IoThread_join(IoThread *io, ServerClient *client, const struct sockaddr_in *address, unsigned long long key, unsigned long long now);
+static void IoThread_release(IoThread *io, int slot, unsigned int id);
+static void IoThread_reap(IoThread *io, unsigned long long now);
+static void IoThread_send(const IoThread *io, const unsigned char *packet, size_t size, const struct sockaddr_in *address);
+static ServerClient *IoThread_find(IoThread *io, unsigned long long key);
+static ServerClient *IoThread_insert(IoThread *io, unsigned long long key);
+static void IoThread_remove(IoThread *io, ServerClient *client);
+static size_t hashKey(unsigned long long key);
+static int compareNanos(const void *a, const void *b);
+static void putU32(unsigned char *bytes, unsigned int value);
+static void putU64(unsigned char *bytes, unsigned long long value);
+static void putF32(unsigned char *bytes, float value);
+static unsigned int getU32(const unsigned char *bytes);
+static unsigned long long getU64(const unsigned char *bytes);
+static float getF32(const unsigned char *bytes);
+
+/* Creates the server, binds its sockets and starts the I/O threads */
+Server *Server_create(const ServerConfig *config){
+
+	int ioThreads = (config->ioThreads > 0) ? config->ioThreads : Pool_getCpuCount();
+	int tickThreads = (config->tickThreads > 0) ? config->tickThreads : Pool_getCpuCount();
+	int maxMatches = (config->maxMatches > 0) ? config->maxMatches : SERVER_DEFAULT_MATCHES;
+
+	Server *server = calloc(1, sizeof(Server));
+	if(!server) return NULL;
+	pthread_mutex_init(&server->mutex, NULL);
+	server->maxMatches = maxMatches;
+	server->waitingSlot = -1;
+	atomic_init(&server->highWater, 0);
+	atomic_init(&server->running, 0);
+	atomic_init(&server->rejectedJoins, 0);
+	atomic_init(&server->stopping, 0);
+	atomic_init(&server->shutdown, 0);
+
+	server->matches = calloc((size_t)maxMatches, sizeof(ServerMatch));
+	server->freeSlots = malloc(sizeof(int) * (size_t)maxMatches);
+	server->closingSlots = malloc(sizeof(int) * (size_t)maxMatches);
+	server->io = calloc((size_t)ioThreads, sizeof(IoThread));
+	server->pool = Pool_create(tickThreads);
+	if(!server->matches || !server->freeSlots || !server->closingSlots || !server->io || !server->pool){
+		Server_destroy(server);
+		return NULL;
+	}
+
+	/* Hand out the lowest slots first so the ticked range stays short */
+	for(int i = 0; i < maxMatches; ++i){
+		atomic_init(&server->matches[i].state, SLOT_FREE);
+		atomic_init(&server->matches[i].id, 0);
+		server->freeSlots[i] = maxMatches - 1 - i;
+	}
+	server->freeCount = maxMatches;
+
+	server->outboxes = calloc((size_t)Pool_getThreadCount(server->pool), sizeof(Outbox));
+	if(!server->outboxes){
+		Server_destroy(server);
+		return NULL;
+	}
+	for(int i = 0; i < Pool_getThreadCount(server->pool); ++i){
+		Outbox *outbox = &server->outboxes[i];
+		for(int j = 0; j < 2 * SERVER_TICK_CHUNK; ++j){
+			outbox->vectors[j].iov_base = outbox->buffers[j];
+			outbox->vectors[j].iov_len = SERVER_STATE_SIZE;
+			outbox->messages[j].msg_hdr.msg_iov = &outbox->vectors[j];
+			outbox->messages[j].msg_hdr.msg_iovlen = 1;
+			outbox->messages[j].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		}
+	}
+
+	/* Every client could end up on one thread, so each table holds all of them at half load */
+	size_t capacity = 1;
+	while(capacity < (size_t)maxMatches * 4) capacity <<= 1;
+
+	struct sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(config->port);
+
+	for(int i = 0; i < ioThreads; ++i){
+		IoThread *io = &server->io[i];
+		io->server = server;
+		io->socket = io->epoll = io->wake = -1;
+		atomic_init(&io->clientCount, 0);
+		atomic_init(&io->packetsIn, 0);
+		++server->ioCount;
+
+		io->clients = calloc(capacity, sizeof(ServerClient));
+		io->mask = capacity - 1;
+		io->socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP);
+		io->epoll = epoll_create1(0);
+		io->wake = eventfd(0, EFD_NONBLOCK);
+		if(!io->clients || io->socket < 0 || io->epoll < 0 || io->wake < 0){
+			Server_destroy(server);
+			return NULL;
+		}
+
+		int one = 1, buffer = SERVER_SOCKET_BUFFER;
+		setsockopt(io->socket, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+		setsockopt(io->socket, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+		setsockopt(io->socket, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+		if(bind(io->socket, (struct sockaddr*)&local, sizeof(local)) != 0){
+			Server_destroy(server);
+			return NULL;
+		}
+
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.fd = io->socket;
+		epoll_ctl(io->epoll, EPOLL_CTL_ADD, io->socket, &event);
+		event.data.fd = io->wake;
+		epoll_ctl(io->epoll, EPOLL_CTL_ADD, io->wake, &event);
+
+		for(int j = 0; j < SERVER_RECEIVE_BATCH; ++j){
+			io->vectors[j].iov_base = io->buffers[j];
+			io->vectors[j].iov_len = SERVER_MAX_PACKET;
+			io->messages[j].msg_hdr.msg_iov = &io->vectors[j];
+			io->messages[j].msg_hdr.msg_iovlen = 1;
+			io->messages[j].msg_hdr.msg_name = &io->addresses[j];
+		}
+	}
+
+	/* Start the threads only once every socket of the port is bound */
+	for(int i = 0; i < ioThreads; ++i){
+		IoThread *io = &server->io[i];
+		io->lastReap = Timer_now();
+		if(pthread_create(&io->thread, NULL, IoThread_main, io) != 0){
+			Server_destroy(server);
+			return NULL;
+		}
+		io->started = 1;
+	}
+
+	return server;
+
+}
+
+/* Ticks the matches at 'TICK_RATE' for the given time. Returns 0 once the server was stopped. */
+int Server_run(Server *server, double seconds){
+
+	unsigned long long now = Timer_now();
+	unsigned long long end = now + (unsigned long long)(seconds * 1e9);
+	if(server->nextTick == 0) server->nextTick = now;
+
+	while(!atomic_load(&server->stopping)){
+
+		if(server->nextTick >= end) return 1;
+
+		now = Timer_now();
+		if(now < server->nextTick){
+			struct timespec wake;
+			wake.tv_sec = (time_t)(server->nextTick / 1000000000ull);
+			wake.tv_nsec = (long)(server->nextTick % 1000000000ull);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+			continue;
+		}
+
+		/* Rather than rushing through a long backlog, count it as missed and start over from now */
+		if(now > server->nextTick + SERVER_MAX_CATCHUP * TICK_NANOS){
+			unsigned long long skipped = (now - server->nextTick) / TICK_NANOS;
+			server->missedTicks += skipped;
+			server->nextTick += skipped * TICK_NANOS;
+		}
+
+		Server_tick(server);
+
+		unsigned long long done = Timer_now();
+		server->tickNanos[server->ticks % SERVER_TICK_HISTORY] = done - now;
+		if(done > server->nextTick + TICK_NANOS) ++server->missedTicks;
+		++server->ticks;
+		server->nextTick += TICK_NANOS;
+
+	}
+
+	return 0;
+
+}
+
+/* Makes 'Server_run' return as soon as the current tick is done */
+void Server_stop(Server *server){
+
+	atomic_store(&server->stopping, 1);
+
+}
+
+/* Fills 'stats'. Call it from the thread running 'Server_run', between runs. */
+void Server_getStats(const Server *server, ServerStats *stats){
+
+	memset(stats, 0, sizeof(*stats));
+	stats->ticks = server->ticks;
+	stats->missedTicks = server->missedTicks;
+	stats->rejectedJoins = atomic_load(&server->rejectedJoins);
+	stats->matches = atomic_load(&server->running);
+	for(int i = 0; i < server->ioCount; ++i){
+		stats->packetsIn += atomic_load(&server->io[i].packetsIn);
+		stats->clients += atomic_load(&server->io[i].clientCount);
+	}
+	for(int i = 0; i < Pool_getThreadCount(server->pool); ++i){
+		stats->packetsOut += server->outboxes[i].packetsOut;
+		stats->sendDrops += server->outboxes[i].sendDrops;
+	}
+
+	size_t count = (size_t)MIN(server->ticks, (unsigned long long)SERVER_TICK_HISTORY);
+	if(count == 0) return;
+	unsigned long long nanos[SERVER_TICK_HISTORY];
+	memcpy(nanos, server->tickNanos, sizeof(unsigned long long) * count);
+	qsort(nanos, count, sizeof(unsigned long long), compareNanos);
+	stats->tickP50 = Timer_toSeconds(nanos[(count - 1) / 2]);
+	stats->tickP99 = Timer_toSeconds(nanos[(count - 1) * 99 / 100]);
+	stats->tickMax = Timer_toSeconds(nanos[count - 1]);
+
+}
+
+/* Stops the I/O and tick threads, closes the sockets and frees the server */
+void Server_destroy(Server *server){
+
+	if(!server) return;
+
+	atomic_store(&server->shutdown, 1);
+	for(int i = 0; i < server->ioCount; ++i){
+		IoThread *io = &server->io[i];
+		if(io->started){
+			unsigned long long one = 1;
+			if(write(io->wake, &one, sizeof(one)) == sizeof(one)) pthread_join(io->thread, NULL);
+		}
+		if(io->socket >= 0) close(io->socket);
+		if(io->epoll >= 0) close(io->epoll);
+		if(io->wake >= 0) close(io->wake);
+		free(io->clients);
+	}
+
+	if(server->pool) Pool_destroy(server->pool);
+	pthread_mutex_destroy(&server->mutex);
+	free(server->io);
+	free(server->outboxes);
+	free(server->closingSlots);
+	free(server->freeSlots);
+	free(server->matches);
+	free(server);
+
+}
+
+/* Returns the type of a server packet, or 0 if it is not one */
+int ServerPacket_getType(const unsigned char *packet, size_t size){
+
+	if(size < 4 || packet[0] != SERVER_MAGIC_0 || packet[1] != SERVER_MAGIC_1) return 0;
+	return packet[2];
+
+}
+
+/* Writes a join request */
+size_t ServerPacket_buildJoin(unsigned char *packet, unsigned int nonce){
+
+	packet[0] = SERVER_MAGIC_0;
+	packet[1] = SERVER_MAGIC_1;
+	packet[2] = SERVER_PACKET_JOIN;
+	packet[3] = 0;
+	putU32(packet + 4, nonce);
+	return SERVER_JOIN_SIZE;
+
+}
+
+/* Writes the input of one tick. 'time' is echoed back in the states that apply it. */
+size_t ServerPacket_buildInput(unsigned char *packet, unsigned char input, unsigned int sequence, unsigned long long time){
+
+	packet[0] = SERVER_MAGIC_0;
+	packet[1] = SERVER_MAGIC_1;
+	packet[2] = SERVER_PACKET_INPUT;
+	packet[3] = input;
+	putU32(packet + 4, sequence);
+	putU64(packet + 8, time);
+	return SERVER_INPUT_SIZE;
+
+}
+
+/* Reads the answer to a join request */
+int ServerPacket_readWelcome(const unsigned char *packet, size_t size, int *player, unsigned int *matchId, unsigned int *seed){
+
+	if(ServerPacket_getType(packet, size) != SERVER_PACKET_WELCOME || size < SERVER_WELCOME_SIZE) return 0;
+	*player = packet[3];
+	*matchId = getU32(packet + 4);
+	*seed = getU32(packet + 8);
+	return 1;
+
+}
+
+/* Reads a match state */
+int ServerPacket_readState(const unsigned char *packet, size_t size, ServerState *state){
+
+	if(ServerPacket_getType(packet, size) != SERVER_PACKET_STATE || size < SERVER_STATE_SIZE) return 0;
+
+	state->player = packet[3];
+	state->tick = getU32(packet + 4);
+	state->missedTicks = getU32(packet + 8);
+	state->echo = getU64(packet + 12);
+
+	Match *match = &state->match;
+	Match_init(match, 0);
+	match->gameState = packet[20];
+	match->events = packet[21];
+	match->p1.score = packet[22];
+	match->p2.score = packet[23];
+	match->ball.position.x = Scalar_fromFloat(getF32(packet + 24));
+	match->ball.position.y = Scalar_fromFloat(getF32(packet + 28));
+	match->ball.speed.x = Scalar_fromFloat(getF32(packet + 32));
+	match->ball.speed.y = Scalar_fromFloat(getF32(packet + 36));
+	match->p1.position.y = Scalar_fromFloat(getF32(packet + 40));
+	match->p2.position.y = Scalar_fromFloat(getF32(packet + 44));
+	return 1;
+
+}
+
+/* Advances every running match by one tick and frees the slots of matches that ended */
+static void Server_tick(Server *server){
+
+	server->tickHighWater = atomic_load(&server->highWater);
+	size_t chunks = ((size_t)server->tickHighWater + SERVER_TICK_CHUNK - 1) / SERVER_TICK_CHUNK;
+	if(chunks > 0) Pool_run(server->pool, chunks, Server_tickChunk, server);
+
+	pthread_mutex_lock(&server->mutex);
+	for(int i = 0; i < server->closingCount; ++i){
+		int slot = server->closingSlots[i];
+		atomic_store(&server->matches[slot].state, SLOT_FREE);
+		server->freeSlots[server->freeCount++] = slot;
+	}
+	server->closingCount = 0;
+	pthread_mutex_unlock(&server->mutex);
+
+}
+
+/* Pool task advancing one chunk of match slots and sending their states */
+static void Server_tickChunk(void *arg, size_t index, int worker){
+
+	Server *server = arg;
+	Outbox *outbox = &server->outboxes[worker];
+	int first = (int)index * SERVER_TICK_CHUNK;
+	int last = MIN(first + SERVER_TICK_CHUNK, server->tickHighWater);
+	unsigned int missed = (unsigned int)server->missedTicks;
+
+	int count = 0;
+	for(int slot = first; slot < last; ++slot){
+
+		ServerMatch *match = &server->matches[slot];
+		if(atomic_load_explicit(&match->state, memory_order_acquire) != SLOT_RUNNING) continue;
+
+		NetInput p1 = atomic_load_explicit(&match->players[0].input, memory_order_relaxed);
+		NetInput p2 = atomic_load_explicit(&match->players[1].input, memory_order_relaxed);
+		Match_tick(&match->match, NetSession_combine(1, p1, p2));
+		++match->tick;
+
+		const Match *state = &match->match;
+		for(int player = 0; player < 2; ++player){
+			unsigned char *packet = outbox->buffers[count];
+			packet[0] = SERVER_MAGIC_0;
+			packet[1] = SERVER_MAGIC_1;
+			packet[2] = SERVER_PACKET_STATE;
+			packet[3] = (unsigned char)(player + 1);
+			putU32(packet + 4, match->tick);
+			putU32(packet + 8, missed);
+			putU64(packet + 12, atomic_load_explicit(&match->players[player].echo, memory_order_relaxed));
+			packet[20] = (unsigned char)state->gameState;
+			packet[21] = (unsigned char)state->events;
+			packet[22] = (unsigned char)state->p1.score;
+			packet[23] = (unsigned char)state->p2.score;
+			putF32(packet + 24, Scalar_toFloat(state->ball.position.x));
+			putF32(packet + 28, Scalar_toFloat(state->ball.position.y));
+			putF32(packet + 32, Scalar_toFloat(state->ball.speed.x));
+			putF32(packet + 36, Scalar_toFloat(state->ball.speed.y));
+			putF32(packet + 40, Scalar_toFloat(state->p1.position.y));
+			putF32(packet + 44, Scalar_toFloat(state->p2.position.y));
+			outbox->messages[count].msg_hdr.msg_name = &match->players[player].address;
+			++count;
+		}
+
+	}
+
+	/* Any socket of the port can answer any client; spread the workers over them */
+	int sock = server->io[worker % server->ioCount].socket;
+	int sent = 0;
+	while(sent < count){
+		int result = sendmmsg(sock, outbox->messages + sent, (unsigned int)(count - sent), MSG_DONTWAIT);
+		if(result > 0){
+			sent += result;
+		}else{
+			/* A full buffer drops the rest of the batch; the next tick's states replace them anyway */
+			outbox->sendDrops += (unsigned long long)(count - sent);
+			break;
+		}
+	}
+	outbox->packetsOut += (unsigned long long)sent;
+
+}
+
+/* I/O thread entrypoint */
+static void *IoThread_main(void *arg){
+
+	IoThread *io = arg;
+	struct epoll_event events[2];
+
+	while(!atomic_load(&io->server->shutdown)){
+
+		int count = epoll_wait(io->epoll, events, 2, SERVER_POLL_MS);
+		for(int i = 0; i < count; ++i)
+			if(events[i].data.fd == io->socket) IoThread_receive(io);
+
+		unsigned long long now = Timer_now();
+		if(now - io->lastReap >= SERVER_REAP_NANOS){
+			IoThread_reap(io, now);
+			io->lastReap = now;
+		}
+
+	}
+
+	return NULL;
+
+}
+
+/* Reads and handles every datagram waiting on the thread's socket */
+static void IoThread_receive(IoThread *io){
+
+	for(;;){
+		for(int i = 0; i < SERVER_RECEIVE_BATCH; ++i) io->messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		int count = recvmmsg(io->socket, io->messages, SERVER_RECEIVE_BATCH, MSG_DONTWAIT, NULL);
+		if(count <= 0) return;
+
+		unsigned long long now = Timer_now();
+		atomic_fetch_add_explicit(&io->packetsIn, (unsigned long long)count, memory_order_relaxed);
+		for(int i = 0; i < count; ++i)
+			IoThread_handle(io, io->buffers[i], io->messages[i].msg_len, &io->addresses[i], now);
+		if(count < SERVER_RECEIVE_BATCH) return;
+	}
+
+}
+
+/* Handles one datagram from a client */
+static void IoThread_handle(IoThread *io, const unsigned char *packet, size_t size, const struct sockaddr_in *address, unsigned long long now){
+
+	int type = ServerPacket_getType(packet, size);
+	if(type == 0) return;
+
+	unsigned long long key = ((unsigned long long)address->sin_addr.s_addr << 16) | address->sin_port | (1ull << 48);
+	ServerClient *client = IoThread_find(io, key);
+	if(type == SERVER_PACKET_JOIN && size >= SERVER_JOIN_SIZE){
+		IoThread_join(io, client, address, key, now);
+		return;
+	}
+
+	/* Tell clients the server does not know to join again */
+	unsigned char leave[SERVER_LEAVE_SIZE] = {SERVER_MAGIC_0, SERVER_MAGIC_1, SERVER_PACKET_LEAVE, 0};
+	if(!client){
+		if(type == SERVER_PACKET_INPUT) IoThread_send(io, leave, sizeof(leave), address);
+		return;
+	}
+
+	/* The match may have ended because the opponent left */
+	ServerMatch *match = &io->server->matches[client->slot];
+	int state = atomic_load_explicit(&match->state, memory_order_acquire);
+	if(atomic_load_explicit(&match->id, memory_order_relaxed) != client->matchId ||
+		(state != SLOT_WAITING && state != SLOT_RUNNING)){
+		IoThread_remove(io, client);
+		IoThread_send(io, leave, sizeof(leave), address);
+		return;
+	}
+
+	client->lastHeard = now;
+	if(type == SERVER_PACKET_INPUT && size >= SERVER_INPUT_SIZE){
+		/* Datagrams may be reordered; older inputs are dropped */
+		unsigned int sequence = getU32(packet + 4);
+		if((int)(sequence - client->sequence) > 0){
+			ServerPlayer *player = &match->players[client->player - 1];
+			client->sequence = sequence;
+			atomic_store_explicit(&player->input, packet[3], memory_order_relaxed);
+			atomic_store_explicit(&player->echo, getU64(packet + 8), memory_order_relaxed);
+		}
+	}else if(type == SERVER_PACKET_LEAVE){
+		IoThread_release(io, client->slot, client->matchId);
+		IoThread_remove(io, client);
+	}
+
+}
+
+/* Pairs a joining client with the waiting one, or makes it wait in a new match */
+static void IoThread_join(IoThread *io, ServerClient *client, const struct sockaddr_in *address, unsigned long long key, unsigned long long now){
+
+	Server *server = io->server;
+
+	/* A repeated join means the welcome was lost */
+	if(client){
+		ServerMatch *match = &server->matches[client->slot];
+		int state = atomic_load(&match->state);
+		if(atomic_load(&match->id) != client->matchId || (state != SLOT_WAITING && state != SLOT_RUNNING)){
+			IoThread_remove(io, client);
+			client = NULL;
+		}
+	}
+
+	if(!client){
+		/* Entries of clients whose match ended linger until they time out; never let them fill the table */
+		if((size_t)atomic_load_explicit(&io->clientCount, memory_order_relaxed) * 4 >= (io->mask + 1) * 3){
+			atomic_fetch_add(&server->rejectedJoins, 1);
+			return;
+		}
+
+		int slot, player;
+		pthread_mutex_lock(&server->mutex);
+		if(server->waitingSlot >= 0){
+			slot = server->waitingSlot;
+			player = 2;
+			server->waitingSlot = -1;
+		}else if(server->freeCount > 0){
+			slot = server->freeSlots[--server->freeCount];
+			player = 1;
+			server->waitingSlot = slot;
+		}else{
+			pthread_mutex_unlock(&server->mutex);
+			atomic_fetch_add(&server->rejectedJoins, 1);
+			return;
+		}
+
+		ServerMatch *match = &server->matches[slot];
+		ServerPlayer *seat = &match->players[player - 1];
+		seat->address = *address;
+		atomic_store(&seat->input, 0);
+		atomic_store(&seat->echo, 0);
+		if(player == 1){
+			match->seed = ++server->nextId * 2654435761u;
+			atomic_store(&match->id, server->nextId);
+			atomic_store(&match->state, SLOT_WAITING);
+			if(slot >= atomic_load(&server->highWater)) atomic_store(&server->highWater, slot + 1);
+		}else{
+			Match_init(&match->match, match->seed);
+			match->tick = 0;
+			atomic_fetch_add(&server->running, 1);
+			atomic_store_explicit(&match->state, SLOT_RUNNING, memory_order_release);
+		}
+		unsigned int id = atomic_load(&match->id);
+		pthread_mutex_unlock(&server->mutex);
+
+		client = IoThread_insert(io, key);
+		client->matchId = id;
+		client->sequence = 0;
+		client->slot = slot;
+		client->player = player;
+	}
+
+	client->lastHeard = now;
+
+	unsigned char welcome[SERVER_WELCOME_SIZE] = {SERVER_MAGIC_0, SERVER_MAGIC_1, SERVER_PACKET_WELCOME, (unsigned char)client->player};
+	putU32(welcome + 4, client->matchId);
+	putU32(welcome + 8, server->matches[client->slot].seed);
+	IoThread_send(io, welcome, sizeof(welcome), address);
+
+}
+
+/* Ends the match in a slot if it is still the one with the given id, and tells both players */
+static void IoThread_release(IoThread *io, int slot, unsigned int id){
+
+	Server *server = io->server;
+	ServerMatch *match = &server->matches[slot];
+	struct sockaddr_in addresses[2];
+	int notify = 0;
+
+	pthread_mutex_lock(&server->mutex);
+	if(atomic_load(&match->id) == id){
+		int state = atomic_load(&match->state);
+		if(state == SLOT_WAITING){
+			/* A waiting match is not ticked, so it can be reused at once */
+			atomic_store(&match->state, SLOT_FREE);
+			if(server->waitingSlot == slot) server->waitingSlot = -1;
+			server->freeSlots[server->freeCount++] = slot;
+		}else if(state == SLOT_RUNNING){
+			atomic_store(&match->state, SLOT_CLOSING);
+			server->closingSlots[server->closingCount++] = slot;
+			atomic_fetch_sub(&server->running, 1);
+			addresses[0] = match->players[0].address;
+			addresses[1] = match->players[1].address;
+			notify = 1;
+		}
+	}
+	pthread_mutex_unlock(&server->mutex);
+
+	if(notify){
+		unsigned char leave[SERVER_LEAVE_SIZE] = {SERVER_MAGIC_0, SERVER_MAGIC_1, SERVER_PACKET_LEAVE, 0};
+		IoThread_send(io, leave, sizeof(leave), &addresses[0]);
+		IoThread_send(io, leave, sizeof(leave), &addresses[1]);
+	}
+
+}
+
+/* Drops the clients that were not heard from in 'SERVER_CLIENT_TIMEOUT', ending their matches */
+static void IoThread_reap(IoThread *io, unsigned long long now){
+
+	unsigned long long timeout = (unsigned long long)(SERVER_CLIENT_TIMEOUT * 1e9);
+	for(size_t i = 0; i <= io->mask; ++i){
+		/* Removing an entry can move a later one into its place, so look at the same index again */
+		while(io->clients[i].key && now - io->clients[i].lastHeard > timeout){
+			IoThread_release(io, io->clients[i].slot, io->clients[i].matchId);
+			IoThread_remove(io, &io->clients[i]);
+		}
+	}
+
+}
+
+/* Sends one datagram from the thread's socket */
+static void IoThread_send(const IoThread *io, const unsigned char *packet, size_t size, const struct sockaddr_in *address){
+
+	sendto(io->socket, packet, size, MSG_DONTWAIT, (const struct sockaddr*)address, sizeof(*address));
+
+}
+
+/* Returns the client with the given key, or NULL */
+static ServerClient *IoThread_find(IoThread *io, unsigned long long key){
+
+	for(size_t i = hashKey(key) & io->mask;; i = (i + 1) & io->mask){
+		if(io->clients[i].key == key) return &io->clients[i];
+		if(io->clients[i].key == 0) return NULL;
+	}
+
+}
+
+/* Adds a client with the given key, which must not be in the table yet */
+static ServerClient *IoThread_insert(IoThread *io, unsigned long long key){
+
+	size_t i = hashKey(key) & io->mask;
+	while(io->clients[i].key) i = (i + 1) & io->mask;
+	io->clients[i].key = key;
+	atomic_fetch_add_explicit(&io->clientCount, 1, memory_order_relaxed);
+	return &io->clients[i];
+
+}
+
+/* Removes a client, shifting later entries of its probe run back so lookups need no tombstones */
+static void IoThread_remove(IoThread *io, ServerClient *client){
+
+	size_t hole = (size_t)(client - io->clients);
+	for(size_t i = (hole + 1) & io->mask; io->clients[i].key; i = (i + 1) & io->mask){
+		size_t home = hashKey(io->clients[i].key) & io->mask;
+		if(((i - home) & io->mask) >= ((i - hole) & io->mask)){
+			io->clients[hole] = io->clients[i];
+			hole = i;
+		}
+	}
+	io->clients[hole].key = 0;
+	atomic_fetch_sub_explicit(&io->clientCount, 1, memory_order_relaxed);
+
+}
+
+/* Mixes the bits of a client key */
+static size_t hashKey(unsigned long long key){
+
+	return (size_t)((key * 11400714819323198485ull) >> 24);
+
+}
+
+/* Orders nanosecond samples ascending */
+static int compareNanos(const void *a, const void *b){
+
+	unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+
+}
+
+/* Stores a little-endian 32 bit integer */
+static void putU32(unsigned char *bytes, unsigned int value){
+
+	bytes[0] = value & 0xff; bytes[1] = (value >> 8) & 0xff;
+	bytes[2] = (value >> 16) & 0xff; bytes[3] = (value >> 24) & 0xff;
+
+}
+
+/* Stores a little-endian 64 bit integer */
+static void putU64(unsigned char *bytes, unsigned long long value){
+
+	putU32(bytes, (unsigned int)value);
+	putU32(bytes + 4, (unsigned int)(value >> 32));
+
+}
+
+/* Stores the bits of a float */
+static void putF32(unsigned char *bytes, float value){
+
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	putU32(bytes, bits);
+
+}
+
+/* Loads a little-endian 32 bit integer */
+static unsigned int getU32(const unsigned char *bytes){
+
+	return (unsigned int)bytes[0] | ((unsigned int)bytes[1] << 8) |
+		((unsigned int)bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+
+}
+
+/* Loads a little-endian 64 bit integer */
+static unsigned long long getU64(const unsigned char *bytes){
+
+	return (unsigned long long)getU32(bytes) | ((unsigned long long)getU32(bytes + 4) << 32);
+
+}
+
+/* Loads the bits of a float */
+static float getF32(const unsigned char *bytes){
+
+	unsigned int bits = getU32(bytes);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+
+}
@@ -0,0 +1,121 @@
+/*
+   CPong
+   Headless match server for thousands of concurrent matches.
+
+   Clients talk to the server over UDP. Every I/O thread owns its own
+   socket bound to the server port with SO_REUSEPORT, so the kernel
+   spreads clients over the threads by address, and waits on it with
+   epoll. A client asks to join, is paired with the next client asking
+   and from then on sends its input and receives the match state once per
+   tick. Matches play the ordinary 'gameState' machine and scoring rules;
+   start from either player starts the next game.
+
+   The matches themselves are not owned by any thread. A tick thread wakes
+   at 'TICK_RATE', advances every running match on the work-stealing pool
+   and sends the new states in batches. Matches, client tables and packet
+   buffers are all allocated when the server is created, so a running
+   server never allocates. The server needs Linux for epoll, SO_REUSEPORT
+   and sendmmsg.
+
+   Packet layout, all integers little-endian, floats as IEEE 754 bits:
+
+   join     "CS", u8 1, u8 0, u32 nonce
+   welcome  "CS", u8 2, u8 player, u32 match id, u32 seed
+   input    "CS", u8 3, u8 input, u32 sequence, u64 client time
+   state    "CS", u8 4, u8 player, u32 tick, u32 missed ticks,
+            u64 client time of the last input applied, u8 gameState,
+            u8 events, u8 p1 score, u8 p2 score, f32 ball x, f32 ball y,
+            f32 ball speed x, f32 ball speed y, f32 p1 y, f32 p2 y
+   leave    "CS", u8 5, u8 0
+
+   Input bits are the 'NetInput' bits of netplay.h. A client that was not
+   heard from for 'SERVER_CLIENT_TIMEOUT' seconds is dropped along with
+   its match, and both players are sent a leave packet.
+*/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+
+#include "pong.h"
+
+/* Packet definitions */
+#define SERVER_PACKET_JOIN 1
+#define SERVER_PACKET_WELCOME 2
+#define SERVER_PACKET_INPUT 3
+#define SERVER_PACKET_STATE 4
+#define SERVER_PACKET_LEAVE 5
+#define SERVER_JOIN_SIZE 8
+#define SERVER_WELCOME_SIZE 12
+#define SERVER_INPUT_SIZE 16
+#define SERVER_STATE_SIZE 48
+#define SERVER_LEAVE_SIZE 4
+#define SERVER_MAX_PACKET 64
+
+/* Server property definitions */
+#define SERVER_DEFAULT_PORT 7700
+#define SERVER_DEFAULT_MATCHES 8192
+#define SERVER_CLIENT_TIMEOUT 5.0		/* Seconds of silence before a client is dropped */
+#define SERVER_TICK_HISTORY 600			/* Tick durations kept for the statistics */
+
+/* Define the 'ServerConfig' struct. Thread counts of 0 or less use every processor. */
+typedef struct ServerConfig{
+
+	unsigned short port;
+	int ioThreads;
+	int tickThreads;
+	int maxMatches;
+
+} ServerConfig;
+
+/* Define the 'ServerStats' struct. Counters are totals since the server was created,
+   tick durations describe the last 'SERVER_TICK_HISTORY' ticks in seconds. */
+typedef struct ServerStats{
+
+	unsigned long long ticks;
+	unsigned long long missedTicks;		/* Ticks that finished after the next was due */
+	unsigned long long packetsIn;
+	unsigned long long packetsOut;
+	unsigned long long sendDrops;		/* States not sent because a socket buffer was full */
+	unsigned long long rejectedJoins;	/* Joins refused because every match was taken */
+	int clients;
+	int matches;				/* Running matches */
+	double tickP50;
+	double tickP99;
+	double tickMax;
+
+} ServerStats;
+
+/* Define the 'ServerState' struct, the decoded contents of a state packet */
+typedef struct ServerState{
+
+	int player;
+	unsigned int tick;
+	unsigned int missedTicks;
+	unsigned long long echo;
+	Match match;				/* Ball, paddles, scores, state and events; the rest as after 'Match_init' */
+
+} ServerState;
+
+/* Opaque server type */
+typedef struct Server Server;
+
+/* Server function declarations. 'Server_create' returns NULL on failure. 'Server_run' ticks the
+   matches for 'seconds' seconds, or until 'Server_stop' is called, and can be called again to
+   carry on. 'Server_stop' may be called from a signal handler. */
+Server *Server_create(const ServerConfig *config);
+int Server_run(Server *server, double seconds);
+void Server_stop(Server *server);
+void Server_getStats(const Server *server, ServerStats *stats);
+void Server_destroy(Server *server);
+
+/* Packet function declarations. The build functions return the packet size, the read functions
+   return 0 if the packet is not of the expected type or is malformed. */
+int ServerPacket_getType(const unsigned char *packet, size_t size);
+size_t ServerPacket_buildJoin(unsigned char *packet, unsigned int nonce);
+size_t ServerPacket_buildInput(unsigned char *packet, unsigned char input, unsigned int sequence, unsigned long long time);
+int ServerPacket_readWelcome(const unsigned char *packet, size_t size, int *player, unsigned int *matchId, unsigned int *seed);
+int ServerPacket_readState(const unsigned char *packet, size_t size, ServerState *state);
+
+#endif
@@ -0,0 +1,262 @@
+/*
+   CPong
+   Delta-compressed snapshot stream for spectators. See snapshot.h.
+*/
+
+/* Standard C includes */
+#include <math.h>
+#include <string.h>
+
+/* Local includes */
+#include "snapshot.h"
+
+/* Frame definitions */
+#define SNAPSHOT_MAGIC_0 'C'
+#define SNAPSHOT_MAGIC_1 'V'
+#define SNAPSHOT_MASK (SNAPSHOT_HISTORY - 1)
+#define SNAPSHOT_SIGNED_FIELDS 6		/* Fields before this one can be negative */
+
+/* Bits of the value of each field. Positions reach 2048 units off the field and speeds 256 units per tick. */
+static const int fieldBits[SNAPSHOT_FIELDS] = {16, 16, 13, 13, 14, 14, 4, 4, 2};
+
+/* Difference bits of each size class below the one holding the value itself */
+static const int classBits[3] = {4, 8, 12};
+
+/* Define the 'BitWriter' struct, least significant bit first */
+typedef struct BitWriter{
+
+	unsigned char *data;
+	size_t size;
+	unsigned long long accumulator;
+	int count;
+
+} BitWriter;
+
+/* Define the 'BitReader' struct */
+typedef struct BitReader{
+
+	const unsigned char *data;
+	size_t size;
+	size_t position;
+	unsigned long long accumulator;
+	int count;
+	int overrun;
+
+} BitReader;
+
+/* Static function declarations */
+static size_t encodeFrame(const Snapshot *snapshot, const Snapshot *baseline, unsigned int distance, unsigned char *data);
+static int predictField(const Snapshot *baseline, unsigned int distance, int field);
+static int quantize(Scalar value, int bits);
+static void BitWriter_write(BitWriter *writer, unsigned int value, int bits);
+static size_t BitWriter_finish(BitWriter *writer);
+static unsigned int BitReader_read(BitReader *reader, int bits);
+
+/* All-zero baseline keyframes are encoded against */
+static const Snapshot zeroSnapshot;
+
+/* Quantizes the state of a match */
+void Snapshot_capture(Snapshot *snapshot, const Match *match, unsigned int tick){
+
+	snapshot->tick = tick;
+	snapshot->fields[SNAPSHOT_BALL_X] = quantize(match->ball.position.x, fieldBits[SNAPSHOT_BALL_X]);
+	snapshot->fields[SNAPSHOT_BALL_Y] = quantize(match->ball.position.y, fieldBits[SNAPSHOT_BALL_Y]);
+	snapshot->fields[SNAPSHOT_SPEED_X] = quantize(match->ball.speed.x, fieldBits[SNAPSHOT_SPEED_X]);
+	snapshot->fields[SNAPSHOT_SPEED_Y] = quantize(match->ball.speed.y, fieldBits[SNAPSHOT_SPEED_Y]);
+	snapshot->fields[SNAPSHOT_P1_Y] = quantize(match->p1.position.y, fieldBits[SNAPSHOT_P1_Y]);
+	snapshot->fields[SNAPSHOT_P2_Y] = quantize(match->p2.position.y, fieldBits[SNAPSHOT_P2_Y]);
+	snapshot->fields[SNAPSHOT_P1_SCORE] = MIN(match->p1.score, 15);
+	snapshot->fields[SNAPSHOT_P2_SCORE] = MIN(match->p2.score, 15);
+	snapshot->fields[SNAPSHOT_GAME_STATE] = match->gameState & 3;
+
+}
+
+/* Starts an empty stream */
+void SnapshotStream_init(SnapshotStream *stream){
+
+	memset(stream, 0, sizeof(*stream));
+
+}
+
+/* Takes the snapshot of the next tick. Frames handed out before are no longer valid. */
+void SnapshotStream_push(SnapshotStream *stream, const Match *match){
+
+	stream->tick = stream->started ? stream->tick + 1 : 0;
+	stream->started = 1;
+	Snapshot_capture(&stream->history[stream->tick & SNAPSHOT_MASK], match, stream->tick);
+
+}
+
+/* Returns the frame of the latest tick for the viewer, encoding it if no viewer on the same baseline asked yet */
+const SnapshotFrame *SnapshotStream_getFrame(SnapshotStream *stream, const SnapshotViewer *viewer){
+
+	unsigned int distance = 0;
+	if(viewer->acked && viewer->ackedTick < stream->tick && stream->tick - viewer->ackedTick < SNAPSHOT_HISTORY)
+		distance = stream->tick - viewer->ackedTick;
+
+	SnapshotFrame *frame = &stream->frames[distance];
+	if(!frame->valid || frame->tick != stream->tick){
+		const Snapshot *baseline = distance ? &stream->history[(stream->tick - distance) & SNAPSHOT_MASK] : &zeroSnapshot;
+		frame->size = encodeFrame(&stream->history[stream->tick & SNAPSHOT_MASK], baseline, distance, frame->data);
+		frame->tick = stream->tick;
+		frame->valid = 1;
+		++stream->encodedFrames;
+	}
+
+	return frame;
+
+}
+
+/* Records that the viewer received a tick. Older acknowledgements arriving late are ignored. */
+void SnapshotViewer_acknowledge(SnapshotViewer *viewer, unsigned int tick){
+
+	if(!viewer->acked || tick > viewer->ackedTick){
+		viewer->ackedTick = tick;
+		viewer->acked = 1;
+	}
+
+}
+
+/* Starts a receiver holding no baselines */
+void SnapshotReceiver_init(SnapshotReceiver *receiver){
+
+	memset(receiver, 0, sizeof(*receiver));
+
+}
+
+/* Decodes a frame against the baseline it names */
+int SnapshotReceiver_decode(SnapshotReceiver *receiver, const unsigned char *data, size_t size, Snapshot *snapshot){
+
+	if(size < SNAPSHOT_HEADER_SIZE || data[0] != SNAPSHOT_MAGIC_0 || data[1] != SNAPSHOT_MAGIC_1) return 0;
+
+	unsigned int tick = (unsigned int)data[2] | ((unsigned int)data[3] << 8) |
+		((unsigned int)data[4] << 16) | ((unsigned int)data[5] << 24);
+	unsigned int distance = data[6];
+	if(distance >= SNAPSHOT_HISTORY) return 0;
+
+	const Snapshot *baseline = &zeroSnapshot;
+	if(distance){
+		unsigned int slot = (tick - distance) & SNAPSHOT_MASK;
+		if(!receiver->held[slot] || receiver->history[slot].tick != tick - distance) return 0;
+		baseline = &receiver->history[slot];
+	}
+
+	BitReader reader = {data + SNAPSHOT_HEADER_SIZE, size - SNAPSHOT_HEADER_SIZE, 0, 0, 0, 0};
+	Snapshot decoded;
+	decoded.tick = tick;
+	for(int field = 0; field < SNAPSHOT_FIELDS; ++field){
+		int predicted = predictField(baseline, distance, field);
+		if(!BitReader_read(&reader, 1)){
+			decoded.fields[field] = predicted;
+			continue;
+		}
+
+		unsigned int sizeClass = BitReader_read(&reader, 2);
+		if(sizeClass < 3){
+			unsigned int zigzag = BitReader_read(&reader, classBits[sizeClass]);
+			decoded.fields[field] = predicted + ((int)(zigzag >> 1) ^ -(int)(zigzag & 1));
+		}else{
+			/* Sign extend the value of signed fields */
+			int bits = fieldBits[field];
+			int value = (int)BitReader_read(&reader, bits);
+			if(field < SNAPSHOT_SIGNED_FIELDS && (value & (1 << (bits - 1)))) value -= 1 << bits;
+			decoded.fields[field] = value;
+		}
+	}
+	if(reader.overrun) return 0;
+
+	unsigned int slot = tick & SNAPSHOT_MASK;
+	receiver->history[slot] = decoded;
+	receiver->held[slot] = 1;
+	*snapshot = decoded;
+	return 1;
+
+}
+
+/* Writes a frame of 'snapshot' encoded against a baseline 'distance' ticks older and returns its size */
+static size_t encodeFrame(const Snapshot *snapshot, const Snapshot *baseline, unsigned int distance, unsigned char *data){
+
+	data[0] = SNAPSHOT_MAGIC_0;
+	data[1] = SNAPSHOT_MAGIC_1;
+	data[2] = snapshot->tick & 0xff; data[3] = (snapshot->tick >> 8) & 0xff;
+	data[4] = (snapshot->tick >> 16) & 0xff; data[5] = (snapshot->tick >> 24) & 0xff;
+	data[6] = (unsigned char)distance;
+
+	BitWriter writer = {data + SNAPSHOT_HEADER_SIZE, 0, 0, 0};
+	for(int field = 0; field < SNAPSHOT_FIELDS; ++field){
+		int difference = snapshot->fields[field] - predictField(baseline, distance, field);
+		if(difference == 0){
+			BitWriter_write(&writer, 0, 1);
+			continue;
+		}
+
+		unsigned int zigzag = ((unsigned int)difference << 1) ^ (unsigned int)(difference >> 31);
+		int sizeClass = 0;
+		while(sizeClass < 3 && zigzag >> classBits[sizeClass]) ++sizeClass;
+
+		BitWriter_write(&writer, 1, 1);
+		BitWriter_write(&writer, (unsigned int)sizeClass, 2);
+		if(sizeClass < 3) BitWriter_write(&writer, zigzag, classBits[sizeClass]);
+		else BitWriter_write(&writer, (unsigned int)snapshot->fields[field] & ((1u << fieldBits[field]) - 1), fieldBits[field]);
+	}
+
+	return SNAPSHOT_HEADER_SIZE + BitWriter_finish(&writer);
+
+}
+
+/* Returns the value a field is expected to have 'distance' ticks after the baseline. The ball keeps its speed. */
+static int predictField(const Snapshot *baseline, unsigned int distance, int field){
+
+	if(field == SNAPSHOT_BALL_X) return baseline->fields[field] + baseline->fields[SNAPSHOT_SPEED_X] * (int)distance;
+	if(field == SNAPSHOT_BALL_Y) return baseline->fields[field] + baseline->fields[SNAPSHOT_SPEED_Y] * (int)distance;
+	return baseline->fields[field];
+
+}
+
+/* Rounds a coordinate or speed to the nearest step, clamped to the range of a signed field */
+static int quantize(Scalar value, int bits){
+
+	float steps = floorf(Scalar_toFloat(value) * SNAPSHOT_QUANTUM + 0.5f);
+	float limit = (float)(1 << (bits - 1));
+	return (int)MAX(MIN(steps, limit - 1.0f), -limit);
+
+}
+
+/* Appends the low bits of a value */
+static void BitWriter_write(BitWriter *writer, unsigned int value, int bits){
+
+	writer->accumulator |= (unsigned long long)value << writer->count;
+	writer->count += bits;
+	while(writer->count >= 8){
+		writer->data[writer->size++] = (unsigned char)writer->accumulator;
+		writer->accumulator >>= 8;
+		writer->count -= 8;
+	}
+
+}
+
+/* Flushes the last partial byte and returns the bytes written */
+static size_t BitWriter_finish(BitWriter *writer){
+
+	if(writer->count > 0) writer->data[writer->size++] = (unsigned char)writer->accumulator;
+	writer->accumulator = 0;
+	writer->count = 0;
+	return writer->size;
+
+}
+
+/* Reads the next bits. Reading past the end returns zeros and sets 'overrun'. */
+static unsigned int BitReader_read(BitReader *reader, int bits){
+
+	while(reader->count < bits){
+		if(reader->position < reader->size) reader->accumulator |= (unsigned long long)reader->data[reader->position++] << reader->count;
+		else reader->overrun = 1;
+		reader->count += 8;
+	}
+
+	unsigned int value = (unsigned int)(reader->accumulator & ((1ull << bits) - 1));
+	reader->accumulator >>= bits;
+	reader->count -= bits;
+	return value;
+
+}
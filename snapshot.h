@@ -0,0 +1,115 @@
+/*
+   CPong
+   Delta-compressed snapshot stream for spectators.
+
+   A snapshot holds what a spectator needs to draw a match: the ball's
+   position and speed, both paddle positions, the scores and the game
+   state, quantized to 1/16 of a unit. Each frame is encoded against the
+   last snapshot the viewer acknowledged and bit-packed: a field that is
+   unchanged costs one bit, and a small change a handful. The ball's
+   position is predicted from the baseline's position and speed, so a
+   ball in free flight costs little more than an unchanged one. A viewer
+   without a usable baseline gets a keyframe, encoded against an all-zero
+   snapshot.
+
+   Viewers only differ in their baseline, and the ones that acknowledge
+   in time share one of a few recent ticks. 'SnapshotStream_getFrame'
+   encodes the frame for a baseline the first time one is asked for and
+   hands out the same buffer to every other viewer on that baseline, so
+   it can be sent to all of them without being copied.
+
+   Frame layout: "CV", u32 tick (little-endian), u8 ticks back to the
+   baseline (0 for a keyframe), then the bit-packed fields, least
+   significant bit first. Each field is a 0 bit if it equals the
+   prediction, or a 1 bit, a 2 bit size class and the zigzag encoded
+   difference in 4, 8 or 12 bits; size class 3 holds the value itself.
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+
+#include "pong.h"
+
+/* Snapshot property definitions */
+#define SNAPSHOT_QUANTUM 16			/* Steps per unit of position and speed */
+#define SNAPSHOT_HISTORY 32			/* Ticks a baseline stays usable. Must be a power of two. */
+#define SNAPSHOT_HEADER_SIZE 7
+#define SNAPSHOT_MAX_FRAME 32
+
+/* Quantized snapshot fields */
+typedef enum {
+	SNAPSHOT_BALL_X,
+	SNAPSHOT_BALL_Y,
+	SNAPSHOT_SPEED_X,
+	SNAPSHOT_SPEED_Y,
+	SNAPSHOT_P1_Y,
+	SNAPSHOT_P2_Y,
+	SNAPSHOT_P1_SCORE,
+	SNAPSHOT_P2_SCORE,
+	SNAPSHOT_GAME_STATE,
+	SNAPSHOT_FIELDS
+} SnapshotField;
+
+/* Define the 'Snapshot' struct, the quantized state of one tick */
+typedef struct Snapshot{
+
+	unsigned int tick;
+	int fields[SNAPSHOT_FIELDS];
+
+} Snapshot;
+
+/* Define the 'SnapshotFrame' struct, one encoded frame. 'tick' tells which tick the cached bytes are for. */
+typedef struct SnapshotFrame{
+
+	unsigned int tick;
+	int valid;
+	size_t size;
+	unsigned char data[SNAPSHOT_MAX_FRAME];
+
+} SnapshotFrame;
+
+/* Define the 'SnapshotViewer' struct, the stream's view of one spectator */
+typedef struct SnapshotViewer{
+
+	unsigned int ackedTick;
+	int acked;
+
+} SnapshotViewer;
+
+/* Define the 'SnapshotStream' struct, the sending side of one match */
+typedef struct SnapshotStream{
+
+	unsigned int tick;			/* Tick of the latest snapshot */
+	int started;
+	Snapshot history[SNAPSHOT_HISTORY];
+	SnapshotFrame frames[SNAPSHOT_HISTORY];	/* Frames of the latest tick, by ticks back to the baseline */
+	unsigned long long encodedFrames;
+
+} SnapshotStream;
+
+/* Define the 'SnapshotReceiver' struct, the receiving side of one spectator */
+typedef struct SnapshotReceiver{
+
+	Snapshot history[SNAPSHOT_HISTORY];
+	unsigned char held[SNAPSHOT_HISTORY];	/* Set for the entries of 'history' that were decoded */
+
+} SnapshotReceiver;
+
+/* Quantizes the state of a match */
+void Snapshot_capture(Snapshot *snapshot, const Match *match, unsigned int tick);
+
+/* Stream function declarations. 'SnapshotStream_getFrame' returns the frame for the viewer's
+   baseline, which stays valid until the next push. */
+void SnapshotStream_init(SnapshotStream *stream);
+void SnapshotStream_push(SnapshotStream *stream, const Match *match);
+const SnapshotFrame *SnapshotStream_getFrame(SnapshotStream *stream, const SnapshotViewer *viewer);
+void SnapshotViewer_acknowledge(SnapshotViewer *viewer, unsigned int tick);
+
+/* Receiver function declarations. 'SnapshotReceiver_decode' returns 0 for a malformed frame or one
+   whose baseline the receiver no longer holds; otherwise the tick in 'snapshot' is the one to acknowledge. */
+void SnapshotReceiver_init(SnapshotReceiver *receiver);
+int SnapshotReceiver_decode(SnapshotReceiver *receiver, const unsigned char *data, size_t size, Snapshot *snapshot);
+
+#endif
@@ -0,0 +1,250 @@
+/*
+   CPong
+   Loopback harness for the spectator snapshot stream. Plays a bot match
+   and streams it to many viewers, each with a UDP socket of its own on
+   the loopback interface, then reports the bytes sent per tick to each
+   viewer and what encoding and sending cost.
+
+   Usage: spectest [-viewers <count>] [-ticks <count>] [-loss <percent>]
+                   [-seed <seed>]
+
+   Viewers acknowledge every frame they decode after a random delay of
+   one to eight ticks, and a '-loss' share of the acknowledgements is
+   dropped, so the viewers spread over several baselines the way real
+   clients do. Every frame of a tick is encoded once per baseline and
+   the same buffer is given to the sends of every viewer on it. Each
+   decoded snapshot is checked against the quantized match state; the
+   harness fails if any differs.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Platform includes */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Local includes */
+#include "pong.h"
+#include "bot.h"
+#include "snapshot.h"
+#include "timer.h"
+
+/* Harness property definitions */
+#define SEND_BATCH 1024				/* Datagrams per sendmmsg call */
+#define MAX_ACK_DELAY 8				/* Ticks */
+#define SOCKET_BUFFER (1 << 20)
+
+/* Define the 'Viewer' struct, one spectator with its socket and pending acknowledgements */
+typedef struct Viewer{
+
+	int socket;
+	struct sockaddr_in address;
+	SnapshotViewer view;			/* What the stream knows */
+	SnapshotReceiver receiver;		/* What the viewer holds */
+	unsigned int delay;
+	unsigned int pendingTicks[MAX_ACK_DELAY + 1];	/* Acknowledgement arriving at each future tick, by tick mod size */
+	unsigned char pending[MAX_ACK_DELAY + 1];
+
+} Viewer;
+
+/* Function declarations */
+int openViewer(Viewer *viewer);
+double randomUnit(unsigned int *rng);
+
+/* Program entrypoint */
+int main(int argc, char **argv){
+
+	int viewerCount = 10000;
+	unsigned int ticks = 10 * TICK_RATE, seed = 1;
+	double loss = 2.0;
+
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "-viewers") == 0 && i + 1 < argc) viewerCount = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-ticks") == 0 && i + 1 < argc) ticks = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-loss") == 0 && i + 1 < argc) loss = atof(argv[++i]);
+		else if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc) seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else{
+			fprintf(stderr, "Usage: %s [-viewers n] [-ticks n] [-loss percent] [-seed n]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if(viewerCount < 1 || ticks < 1){
+		fprintf(stderr, "Needs at least one viewer and one tick\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Every viewer needs a descriptor of its own */
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max){
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	Viewer *viewers = calloc((size_t)viewerCount, sizeof(Viewer));
+	struct mmsghdr *messages = calloc(SEND_BATCH, sizeof(struct mmsghdr));
+	struct iovec *vectors = calloc(SEND_BATCH, sizeof(struct iovec));
+	static SnapshotStream stream;
+	if(!viewers || !messages || !vectors){
+		fprintf(stderr, "Out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	unsigned int rng = seed * 2654435761u + 1;
+	for(int i = 0; i < viewerCount; ++i){
+		viewers[i].delay = 1 + (unsigned int)(randomUnit(&rng) * MAX_ACK_DELAY);
+		if(!openViewer(&viewers[i])){
+			fprintf(stderr, "Could only open %d of %d viewer sockets\n", i, viewerCount);
+			return EXIT_FAILURE;
+		}
+	}
+	int sender = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	int buffer = SOCKET_BUFFER;
+	setsockopt(sender, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+
+	const Controller *p1 = Controller_find("tracker"), *p2 = Controller_find("predictor-medium");
+	ControllerState p1State, p2State;
+	Match match;
+	Match_init(&match, seed);
+	Controller_reset(p1, &p1State, seed);
+	Controller_reset(p2, &p2State, ~seed);
+	SnapshotStream_init(&stream);
+
+	unsigned long long bytes = 0, frames = 0, keyframes = 0, mismatches = 0, undecodable = 0;
+	unsigned long long pushNanos = 0, fanoutNanos = 0, sendNanos = 0;
+	for(unsigned int tick = 0; tick < ticks; ++tick){
+
+		Match_tick(&match, Controller_getInput(p1, &p1State, p2, &p2State, &match));
+
+		unsigned long long start = Timer_now();
+		SnapshotStream_push(&stream, &match);
+		pushNanos += Timer_now() - start;
+
+		/* Acknowledgements due this tick reach the stream */
+		unsigned int due = tick % (MAX_ACK_DELAY + 1);
+		for(int i = 0; i < viewerCount; ++i){
+			Viewer *viewer = &viewers[i];
+			if(viewer->pending[due]){
+				SnapshotViewer_acknowledge(&viewer->view, viewer->pendingTicks[due]);
+				viewer->pending[due] = 0;
+			}
+		}
+
+		/* Hand every viewer the shared frame of its baseline; only the iovec points at it */
+		for(int first = 0; first < viewerCount; first += SEND_BATCH){
+			int count = MIN(SEND_BATCH, viewerCount - first);
+
+			start = Timer_now();
+			for(int i = 0; i < count; ++i){
+				Viewer *viewer = &viewers[first + i];
+				const SnapshotFrame *frame = SnapshotStream_getFrame(&stream, &viewer->view);
+				vectors[i].iov_base = (void*)frame->data;
+				vectors[i].iov_len = frame->size;
+				messages[i].msg_hdr.msg_name = &viewer->address;
+				messages[i].msg_hdr.msg_namelen = sizeof(viewer->address);
+				messages[i].msg_hdr.msg_iov = &vectors[i];
+				messages[i].msg_hdr.msg_iovlen = 1;
+				bytes += frame->size;
+				keyframes += (frame->data[6] == 0);
+			}
+			unsigned long long sending = Timer_now();
+			fanoutNanos += sending - start;
+
+			for(int sent = 0; sent < count;){
+				int result = sendmmsg(sender, messages + sent, (unsigned int)(count - sent), 0);
+				if(result <= 0){
+					fprintf(stderr, "Send failed\n");
+					return EXIT_FAILURE;
+				}
+				sent += result;
+			}
+			sendNanos += Timer_now() - sending;
+		}
+		frames += (unsigned long long)viewerCount;
+
+		/* Viewers decode what arrived, check it and queue their acknowledgements */
+		const Snapshot *truth = &stream.history[stream.tick & (SNAPSHOT_HISTORY - 1)];
+		for(int i = 0; i < viewerCount; ++i){
+			Viewer *viewer = &viewers[i];
+			unsigned char data[SNAPSHOT_MAX_FRAME];
+			ssize_t size;
+			while((size = recv(viewer->socket, data, sizeof(data), MSG_DONTWAIT)) > 0){
+				Snapshot decoded;
+				if(!SnapshotReceiver_decode(&viewer->receiver, data, (size_t)size, &decoded)){
+					++undecodable;
+					continue;
+				}
+				if(decoded.tick != truth->tick || memcmp(decoded.fields, truth->fields, sizeof(truth->fields)) != 0) ++mismatches;
+				if(randomUnit(&rng) * 100.0 >= loss){
+					unsigned int slot = (tick + viewer->delay) % (MAX_ACK_DELAY + 1);
+					viewer->pendingTicks[slot] = decoded.tick;
+					viewer->pending[slot] = 1;
+				}
+			}
+		}
+
+	}
+
+	unsigned long long encoded = stream.encodedFrames;
+	SnapshotViewer fresh = {0, 0};
+	size_t keyframeSize = SnapshotStream_getFrame(&stream, &fresh)->size;
+
+	fprintf(stdout, "%d viewers, %u ticks, %.1f%% acknowledgements lost\n", viewerCount, ticks, loss);
+	fprintf(stdout, "bytes per tick per viewer: %.2f (keyframe %zu, %.1f%% of frames were keyframes)\n",
+		(double)bytes / (double)frames, keyframeSize, 100.0 * (double)keyframes / (double)frames);
+	fprintf(stdout, "frames encoded per tick:   %.2f\n", (double)encoded / ticks);
+	fprintf(stdout, "capture per tick:          %.2f us\n", pushNanos / 1000.0 / ticks);
+	fprintf(stdout, "encode and fan-out:        %.2f us per tick, %.1f ns per viewer\n",
+		fanoutNanos / 1000.0 / ticks, (double)fanoutNanos / (double)frames);
+	fprintf(stdout, "send:                      %.2f us per tick, %.1f ns per viewer\n",
+		sendNanos / 1000.0 / ticks, (double)sendNanos / (double)frames);
+	fprintf(stdout, "undecodable frames:        %llu\n", undecodable);
+	fprintf(stdout, "mismatched snapshots:      %llu\n", mismatches);
+
+	for(int i = 0; i < viewerCount; ++i) close(viewers[i].socket);
+	close(sender);
+	free(viewers);
+	free(messages);
+	free(vectors);
+	return (mismatches == 0 && undecodable == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
+
+/* Opens a viewer's socket on an ephemeral loopback port */
+int openViewer(Viewer *viewer){
+
+	viewer->socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(viewer->socket < 0) return 0;
+
+	memset(&viewer->address, 0, sizeof(viewer->address));
+	viewer->address.sin_family = AF_INET;
+	viewer->address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	viewer->address.sin_port = 0;
+	socklen_t size = sizeof(viewer->address);
+	if(bind(viewer->socket, (struct sockaddr*)&viewer->address, sizeof(viewer->address)) != 0 ||
+		getsockname(viewer->socket, (struct sockaddr*)&viewer->address, &size) != 0){
+		close(viewer->socket);
+		return 0;
+	}
+
+	SnapshotReceiver_init(&viewer->receiver);
+	return 1;
+
+}
+
+/* Returns a uniform random number in [0, 1) */
+double randomUnit(unsigned int *rng){
+
+	*rng ^= *rng << 13; *rng ^= *rng >> 17; *rng ^= *rng << 5;
+	return (*rng >> 8) / 16777216.0;
+
+}
@@ -0,0 +1,772 @@
+/*
+   CPong
+   Trajectory telemetry for tuning the ball response. See telemetry.h.
+*/
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+/* Standard C includes */
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Platform includes */
+#include <pthread.h>
+#include <sched.h>
+
+/* Local includes */
+#include "telemetry.h"
+#include "timer.h"
+
+/* Cache line size used to keep the ends of each ring apart */
+#define CACHE_LINE 64
+
+#define RING_MASK (TELEMETRY_CHANNEL_BLOCKS - 1)
+#define ENCODER_WAIT_MS 20			/* Longest sleep of an encoder between looks at its rings */
+
+/* Bytes of an encoded column at most: a group header, the length bits and every value in four bytes, and
+   three more since the encoder always stores four bytes of a value */
+#define MAX_COLUMN_SIZE ((TELEMETRY_BLOCK_ROWS / TELEMETRY_GROUP + 1) * (1 + TELEMETRY_GROUP / 4) + TELEMETRY_BLOCK_ROWS * 4 + 3)
+
+/* Bytes of an encoded block at most: its header and every column with its size */
+#define MAX_BLOCK_SIZE (12 + (TICK_COLUMNS + BOUNCE_COLUMNS) * (4 + MAX_COLUMN_SIZE))
+
+/* Slots of the table finding the previous row of a match, a power of two well above the rows of a block */
+#define LINK_SLOTS (TELEMETRY_BLOCK_ROWS * 2)
+
+/* Values after each column of a block. Columns a power of two apart would all share the same few cache sets,
+   so appending a row would keep evicting the lines it is about to write. */
+#define COLUMN_PADDING (CACHE_LINE / sizeof(uint32_t))
+
+/* Column indices of the two tables */
+enum {TICK_EVENTS, TICK_MATCH, TICK_TICK, TICK_BALL_X, TICK_BALL_Y, TICK_SPEED_X, TICK_SPEED_Y, TICK_P1_Y, TICK_P2_Y, TICK_COLUMNS};
+enum {BOUNCE_SIDE, BOUNCE_MATCH, BOUNCE_TICK, BOUNCE_X, BOUNCE_Y, BOUNCE_SPEED_X, BOUNCE_SPEED_Y, BOUNCE_COLUMNS};
+
+/* The differencing of contiguous rows uses GCC vector extensions. Other compilers get the scalar loop only. */
+#if defined(__GNUC__)
+#define TELEMETRY_VECTORS
+typedef uint32_t vu4 __attribute__((vector_size(16)));
+typedef int32_t vi4 __attribute__((vector_size(16)));
+#endif
+
+/* Bytes taken by a value with each two bit length code */
+static const int valueBytes[4] = {0, 1, 2, 4};
+
+/* Define the 'TelemetryBlock' struct, both tables stored column by column */
+typedef struct TelemetryBlock{
+
+	size_t ticks;
+	size_t bounces;
+	uint32_t tickColumns[TICK_COLUMNS][TELEMETRY_BLOCK_ROWS + COLUMN_PADDING];
+	uint32_t bounceColumns[BOUNCE_COLUMNS][TELEMETRY_BLOCK_ROWS + COLUMN_PADDING];
+
+} TelemetryBlock;
+
+/* Define the 'TelemetryLinks' struct. A block may hold the interleaved ticks of several matches, so each row is
+   coded against the previous row of the same match rather than the row above it. */
+typedef struct TelemetryLinks{
+
+	int32_t previous[TELEMETRY_BLOCK_ROWS];	/* Row of the same match before each row, or -1 */
+	uint32_t matches[LINK_SLOTS];
+	int32_t last[LINK_SLOTS];		/* Latest row of the match in each slot, or -1 for a free slot */
+	int contiguous;				/* Every row follows the row above or starts its match */
+
+} TelemetryLinks;
+
+/* Define the 'TelemetryRing' struct, a single-producer, single-consumer ring of blocks */
+typedef struct TelemetryRing{
+
+	atomic_size_t head;			/* Written by the producer */
+	char headPadding[CACHE_LINE];
+	atomic_size_t tail;			/* Written by the consumer */
+	char tailPadding[CACHE_LINE];
+	TelemetryBlock *blocks[TELEMETRY_CHANNEL_BLOCKS];
+
+} TelemetryRing;
+
+/* Define the 'TelemetryEncoder' struct, a thread encoding the blocks of every channel 'index' apart */
+typedef struct TelemetryEncoder{
+
+	Telemetry *telemetry;
+	int index;
+	uint32_t *differences;			/* Scratch space for one column */
+	unsigned char *encoded;			/* The block being encoded */
+	TelemetryLinks *links;
+	atomic_ullong nanoseconds;
+
+	/* Thread and its wakeup */
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake;
+	int started;
+
+} TelemetryEncoder;
+
+/* Define the 'TelemetryChannel' struct */
+struct TelemetryChannel{
+
+	Telemetry *telemetry;
+	int index;
+	TelemetryBlock *current;		/* Owned by the producer */
+	TelemetryEncoder *encoder;
+	TelemetryRing full;			/* Producer to encoder */
+	TelemetryRing empty;			/* Encoder to producer */
+	TelemetryBlock *blocks;
+	atomic_ullong rows;
+	atomic_ullong stalls;
+	char padding[CACHE_LINE];
+
+};
+
+/* Define the 'Telemetry' struct */
+struct Telemetry{
+
+	FILE *file;
+	pthread_mutex_t fileMutex;		/* Held while a block is written */
+	TelemetryChannel *channels;
+	int channelCount;
+	TelemetryEncoder *encoders;
+	int encoderCount;
+	atomic_ullong bytes;
+	atomic_int failed;
+	atomic_int stopping;
+
+};
+
+/* Static function declarations */
+static void Telemetry_stop(Telemetry *telemetry);
+static int Telemetry_free(Telemetry *telemetry);
+static void *TelemetryEncoder_run(void *arg);
+static size_t TelemetryEncoder_encodeBlock(TelemetryEncoder *encoder, const TelemetryBlock *block, uint32_t channel);
+static void TelemetryChannel_publish(TelemetryChannel *channel);
+static int TelemetryRing_push(TelemetryRing *ring, TelemetryBlock *block);
+static TelemetryBlock *TelemetryRing_pop(TelemetryRing *ring);
+static uint32_t scalarBits(Scalar value);
+static double bitsToValue(uint32_t bits, int fixed);
+static void linkRows(TelemetryLinks *links, const uint32_t *matches, size_t count);
+static void differenceColumn(const uint32_t *values, size_t count, int order, const int32_t *previous, int contiguous, uint32_t *differences);
+static uint32_t contiguousDifference(const uint32_t *values, int order, const int32_t *previous, size_t i);
+#ifdef TELEMETRY_VECTORS
+static vu4 loadU4(const uint32_t *data);
+static vi4 loadI4(const int32_t *data);
+#endif
+static size_t encodeColumn(const uint32_t *values, size_t count, int order, const int32_t *previous, int contiguous, uint32_t *differences, unsigned char *data);
+static int decodeColumn(const unsigned char *data, size_t size, size_t count, uint32_t *differences);
+static void integrateColumn(uint32_t *values, size_t count, int order, const int32_t *previous);
+static int readTable(FILE *file, unsigned char *data, TelemetryLinks *links, size_t count, int bounceTable, uint32_t (*values)[TELEMETRY_BLOCK_ROWS]);
+static int columnOrder(int bounceTable, int column);
+static void putU32(unsigned char *data, uint32_t value);
+static uint32_t getU32(const unsigned char *data);
+
+/* Creates the file and starts the encoder threads */
+Telemetry *Telemetry_open(const char *path, int channels, int encoders){
+
+	if(channels < 1 || encoders < 1) return NULL;
+	encoders = MIN(encoders, channels);
+	Telemetry *telemetry = calloc(1, sizeof(Telemetry));
+	if(!telemetry) return NULL;
+	telemetry->channels = calloc((size_t)channels, sizeof(TelemetryChannel));
+	telemetry->encoders = calloc((size_t)encoders, sizeof(TelemetryEncoder));
+	telemetry->file = fopen(path, "wb");
+	if(!telemetry->channels || !telemetry->encoders || !telemetry->file || pthread_mutex_init(&telemetry->fileMutex, NULL) != 0){
+		if(telemetry->file) fclose(telemetry->file);
+		free(telemetry->channels);
+		free(telemetry->encoders);
+		free(telemetry);
+		return NULL;
+	}
+	telemetry->channelCount = channels;
+	telemetry->encoderCount = encoders;
+
+	/* Every block starts out empty, one of them already handed to the producer */
+	int ok = 1;
+	for(int i = 0; i < channels; ++i){
+		TelemetryChannel *channel = &telemetry->channels[i];
+		channel->telemetry = telemetry;
+		channel->index = i;
+		channel->encoder = &telemetry->encoders[i % encoders];
+		channel->blocks = malloc(sizeof(TelemetryBlock) * TELEMETRY_CHANNEL_BLOCKS);
+		if(!channel->blocks){
+			ok = 0;
+			continue;
+		}
+		channel->current = &channel->blocks[0];
+		channel->current->ticks = channel->current->bounces = 0;
+		for(int block = 1; block < TELEMETRY_CHANNEL_BLOCKS; ++block) TelemetryRing_push(&channel->empty, &channel->blocks[block]);
+	}
+
+	unsigned char header[8] = {'C', 'T', 'E', 'L', TELEMETRY_VERSION & 0xff, TELEMETRY_VERSION >> 8, 0, 0};
+#ifdef PONG_FIXED
+	header[6] = 1;
+#endif
+	ok = ok && fwrite(header, sizeof(header), 1, telemetry->file) == 1;
+	atomic_store(&telemetry->bytes, sizeof(header));
+
+	for(int i = 0; i < encoders && ok; ++i){
+		TelemetryEncoder *encoder = &telemetry->encoders[i];
+		encoder->telemetry = telemetry;
+		encoder->index = i;
+		encoder->differences = malloc(sizeof(uint32_t) * TELEMETRY_BLOCK_ROWS);
+		encoder->encoded = malloc(MAX_BLOCK_SIZE);
+		encoder->links = malloc(sizeof(TelemetryLinks));
+		ok = encoder->differences && encoder->encoded && encoder->links &&
+			pthread_mutex_init(&encoder->mutex, NULL) == 0 && pthread_cond_init(&encoder->wake, NULL) == 0 &&
+			pthread_create(&encoder->thread, NULL, TelemetryEncoder_run, encoder) == 0;
+		encoder->started = ok;
+	}
+	if(!ok){
+		Telemetry_stop(telemetry);
+		Telemetry_free(telemetry);
+		return NULL;
+	}
+
+	return telemetry;
+
+}
+
+/* Returns channel 'index' */
+TelemetryChannel *Telemetry_getChannel(Telemetry *telemetry, int index){
+
+	return (telemetry && index >= 0 && index < telemetry->channelCount) ? &telemetry->channels[index] : NULL;
+
+}
+
+/* Appends the rows of one tick to the channel's block, handing it over first if they do not fit */
+void TelemetryChannel_record(TelemetryChannel *channel, uint32_t match, uint32_t tick, const Match *state, const MatchContacts *contacts){
+
+	int bounces = contacts ? contacts->count : 0;
+	TelemetryBlock *block = channel->current;
+	if(block->ticks == TELEMETRY_BLOCK_ROWS || block->bounces + (size_t)bounces > TELEMETRY_BLOCK_ROWS){
+		TelemetryChannel_publish(channel);
+		block = channel->current;
+	}
+
+	size_t row = block->ticks++;
+	block->tickColumns[TICK_EVENTS][row] = state->events;
+	block->tickColumns[TICK_MATCH][row] = match;
+	block->tickColumns[TICK_TICK][row] = tick;
+	block->tickColumns[TICK_BALL_X][row] = scalarBits(state->ball.position.x);
+	block->tickColumns[TICK_BALL_Y][row] = scalarBits(state->ball.position.y);
+	block->tickColumns[TICK_SPEED_X][row] = scalarBits(state->ball.speed.x);
+	block->tickColumns[TICK_SPEED_Y][row] = scalarBits(state->ball.speed.y);
+	block->tickColumns[TICK_P1_Y][row] = scalarBits(state->p1.position.y);
+	block->tickColumns[TICK_P2_Y][row] = scalarBits(state->p2.position.y);
+
+	for(int i = 0; i < bounces; ++i){
+		const MatchContact *contact = &contacts->contacts[i];
+		row = block->bounces++;
+		block->bounceColumns[BOUNCE_SIDE][row] = (uint32_t)contact->side | ((uint32_t)contact->paddle << 8);
+		block->bounceColumns[BOUNCE_MATCH][row] = match;
+		block->bounceColumns[BOUNCE_TICK][row] = tick;
+		block->bounceColumns[BOUNCE_X][row] = scalarBits(contact->position.x);
+		block->bounceColumns[BOUNCE_Y][row] = scalarBits(contact->position.y);
+		block->bounceColumns[BOUNCE_SPEED_X][row] = scalarBits(contact->speed.x);
+		block->bounceColumns[BOUNCE_SPEED_Y][row] = scalarBits(contact->speed.y);
+	}
+
+}
+
+/* Hands the partly filled block to the encoder */
+void TelemetryChannel_flush(TelemetryChannel *channel){
+
+	if(channel->current->ticks > 0) TelemetryChannel_publish(channel);
+
+}
+
+/* Reads the counts */
+void Telemetry_getStats(Telemetry *telemetry, TelemetryStats *stats){
+
+	memset(stats, 0, sizeof(*stats));
+	for(int i = 0; i < telemetry->channelCount; ++i){
+		stats->rows += atomic_load_explicit(&telemetry->channels[i].rows, memory_order_relaxed);
+		stats->stalls += atomic_load_explicit(&telemetry->channels[i].stalls, memory_order_relaxed);
+	}
+	for(int i = 0; i < telemetry->encoderCount; ++i)
+		stats->encodeSeconds += Timer_toSeconds(atomic_load_explicit(&telemetry->encoders[i].nanoseconds, memory_order_relaxed));
+	stats->bytes = atomic_load_explicit(&telemetry->bytes, memory_order_relaxed);
+
+}
+
+/* Flushes every channel, stops the encoders and closes the file */
+int Telemetry_close(Telemetry *telemetry, TelemetryStats *stats){
+
+	if(!telemetry) return 0;
+	for(int i = 0; i < telemetry->channelCount; ++i) TelemetryChannel_flush(&telemetry->channels[i]);
+	Telemetry_stop(telemetry);
+	if(stats) Telemetry_getStats(telemetry, stats);
+	int ok = !atomic_load(&telemetry->failed);
+	return Telemetry_free(telemetry) && ok;
+
+}
+
+/* Decodes a file block by block */
+int Telemetry_read(const char *path, TelemetryVisitor visit, void *arg){
+
+	FILE *file = fopen(path, "rb");
+	if(!file) return 0;
+
+	unsigned char header[8];
+	if(fread(header, sizeof(header), 1, file) != 1 || memcmp(header, "CTEL", 4) != 0 ||
+		(header[4] | (header[5] << 8)) != TELEMETRY_VERSION){
+		fclose(file);
+		return 0;
+	}
+	int fixed = header[6] & 1;
+
+	uint32_t (*ticks)[TELEMETRY_BLOCK_ROWS] = malloc(sizeof(uint32_t) * TICK_COLUMNS * TELEMETRY_BLOCK_ROWS);
+	uint32_t (*bounces)[TELEMETRY_BLOCK_ROWS] = malloc(sizeof(uint32_t) * BOUNCE_COLUMNS * TELEMETRY_BLOCK_ROWS);
+	unsigned char *data = malloc(MAX_COLUMN_SIZE);
+	TelemetryLinks *links = malloc(sizeof(TelemetryLinks));
+	int ok = (ticks && bounces && data && links);
+
+	unsigned char blockHeader[12];
+	while(ok && fread(blockHeader, sizeof(blockHeader), 1, file) == 1){
+
+		uint32_t tickCount = getU32(blockHeader), bounceCount = getU32(blockHeader + 4), channel = getU32(blockHeader + 8);
+		ok = tickCount <= TELEMETRY_BLOCK_ROWS && bounceCount <= TELEMETRY_BLOCK_ROWS &&
+			readTable(file, data, links, tickCount, 0, ticks) &&
+			readTable(file, data, links, bounceCount, 1, bounces);
+
+		/* Each tick is followed by the bounces logged with it */
+		uint32_t bounce = 0;
+		for(uint32_t i = 0; i < tickCount && ok; ++i){
+			TelemetryRow row;
+			row.kind = TELEMETRY_TICK;
+			row.flags = ticks[TICK_EVENTS][i];
+			row.paddle = 0;
+			row.match = ticks[TICK_MATCH][i];
+			row.tick = ticks[TICK_TICK][i];
+			row.channel = channel;
+			for(int value = 0; value < TELEMETRY_VALUES; ++value) row.values[value] = bitsToValue(ticks[TICK_BALL_X + value][i], fixed);
+			visit(&row, arg);
+
+			for(; bounce < bounceCount && bounces[BOUNCE_MATCH][bounce] == row.match && bounces[BOUNCE_TICK][bounce] == row.tick; ++bounce){
+				TelemetryRow hit = row;
+				hit.kind = TELEMETRY_BOUNCE;
+				hit.flags = bounces[BOUNCE_SIDE][bounce] & 0xff;
+				hit.paddle = (int)(bounces[BOUNCE_SIDE][bounce] >> 8);
+				for(int value = 0; value < 4; ++value) hit.values[value] = bitsToValue(bounces[BOUNCE_X + value][bounce], fixed);
+				visit(&hit, arg);
+			}
+		}
+		ok = ok && bounce == bounceCount;
+
+	}
+
+	ok = ok && !ferror(file);
+	free(ticks);
+	free(bounces);
+	free(data);
+	free(links);
+	fclose(file);
+	return ok;
+
+}
+
+/* Tells the encoders to stop and waits for them to drain their rings */
+static void Telemetry_stop(Telemetry *telemetry){
+
+	atomic_store(&telemetry->stopping, 1);
+	for(int i = 0; i < telemetry->encoderCount; ++i){
+		TelemetryEncoder *encoder = &telemetry->encoders[i];
+		if(!encoder->started) continue;
+		pthread_mutex_lock(&encoder->mutex);
+		pthread_cond_signal(&encoder->wake);
+		pthread_mutex_unlock(&encoder->mutex);
+		pthread_join(encoder->thread, NULL);
+		pthread_mutex_destroy(&encoder->mutex);
+		pthread_cond_destroy(&encoder->wake);
+		encoder->started = 0;
+	}
+
+}
+
+/* Closes the file and frees everything once the encoders have stopped, returning zero if closing failed */
+static int Telemetry_free(Telemetry *telemetry){
+
+	int ok = (fclose(telemetry->file) == 0);
+	pthread_mutex_destroy(&telemetry->fileMutex);
+	for(int i = 0; i < telemetry->channelCount; ++i) free(telemetry->channels[i].blocks);
+	for(int i = 0; i < telemetry->encoderCount; ++i){
+		free(telemetry->encoders[i].differences);
+		free(telemetry->encoders[i].encoded);
+		free(telemetry->encoders[i].links);
+	}
+	free(telemetry->channels);
+	free(telemetry->encoders);
+	free(telemetry);
+	return ok;
+
+}
+
+/* Encoder thread: encodes and writes the full blocks of its channels as they arrive until told to stop with
+   every ring drained. Only the write itself is done under the file lock. */
+static void *TelemetryEncoder_run(void *arg){
+
+	TelemetryEncoder *encoder = arg;
+	Telemetry *telemetry = encoder->telemetry;
+
+	for(;;){
+
+		int stopping = atomic_load(&telemetry->stopping), written = 0;
+		for(int i = encoder->index; i < telemetry->channelCount; i += telemetry->encoderCount){
+			TelemetryChannel *channel = &telemetry->channels[i];
+			TelemetryBlock *block;
+			while((block = TelemetryRing_pop(&channel->full))){
+				if(!atomic_load_explicit(&telemetry->failed, memory_order_relaxed)){
+					unsigned long long start = Timer_now();
+					size_t size = TelemetryEncoder_encodeBlock(encoder, block, (uint32_t)i);
+					pthread_mutex_lock(&telemetry->fileMutex);
+					if(fwrite(encoder->encoded, size, 1, telemetry->file) != 1) atomic_store(&telemetry->failed, 1);
+					pthread_mutex_unlock(&telemetry->fileMutex);
+					atomic_fetch_add_explicit(&telemetry->bytes, size, memory_order_relaxed);
+					atomic_fetch_add_explicit(&encoder->nanoseconds, Timer_now() - start, memory_order_relaxed);
+				}
+				block->ticks = block->bounces = 0;
+				TelemetryRing_push(&channel->empty, block);
+				written = 1;
+			}
+		}
+		if(stopping) break;
+		if(written) continue;
+
+		/* Producers signal every handed over block; the timeout covers a signal sent between the check and the wait */
+		struct timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_nsec += ENCODER_WAIT_MS * 1000000L;
+		if(until.tv_nsec >= 1000000000L){
+			until.tv_nsec -= 1000000000L;
+			++until.tv_sec;
+		}
+		pthread_mutex_lock(&encoder->mutex);
+		if(!atomic_load(&telemetry->stopping)) pthread_cond_timedwait(&encoder->wake, &encoder->mutex, &until);
+		pthread_mutex_unlock(&encoder->mutex);
+
+	}
+
+	return NULL;
+
+}
+
+/* Encodes one block column by column into the encoder's buffer, returning its size */
+static size_t TelemetryEncoder_encodeBlock(TelemetryEncoder *encoder, const TelemetryBlock *block, uint32_t channel){
+
+	unsigned char *data = encoder->encoded;
+	putU32(data, (uint32_t)block->ticks);
+	putU32(data + 4, (uint32_t)block->bounces);
+	putU32(data + 8, channel);
+	size_t size = 12;
+
+	for(int column = 0; column < TICK_COLUMNS + BOUNCE_COLUMNS; ++column){
+
+		/* The match column itself is coded row after row */
+		int bounceTable = (column >= TICK_COLUMNS);
+		size_t count = bounceTable ? block->bounces : block->ticks;
+		if(column == 0) linkRows(encoder->links, block->tickColumns[TICK_MATCH], count);
+		if(column == TICK_COLUMNS) linkRows(encoder->links, block->bounceColumns[BOUNCE_MATCH], count);
+		const uint32_t *values = bounceTable ? block->bounceColumns[column - TICK_COLUMNS] : block->tickColumns[column];
+		const int32_t *previous = (column == TICK_MATCH || column == TICK_COLUMNS + BOUNCE_MATCH) ? NULL : encoder->links->previous;
+		int order = columnOrder(bounceTable, bounceTable ? column - TICK_COLUMNS : column);
+		size_t columnSize = encodeColumn(values, count, order, previous, encoder->links->contiguous, encoder->differences, data + size + 4);
+		putU32(data + size, (uint32_t)columnSize);
+		size += 4 + columnSize;
+
+	}
+
+	return size;
+
+}
+
+/* Sends the current block to the encoder and takes an empty one, waiting for the encoder if there is none */
+static void TelemetryChannel_publish(TelemetryChannel *channel){
+
+	TelemetryEncoder *encoder = channel->encoder;
+	atomic_fetch_add_explicit(&channel->rows, channel->current->ticks + channel->current->bounces, memory_order_relaxed);
+	TelemetryRing_push(&channel->full, channel->current);
+
+	pthread_mutex_lock(&encoder->mutex);
+	pthread_cond_signal(&encoder->wake);
+	pthread_mutex_unlock(&encoder->mutex);
+
+	TelemetryBlock *block = TelemetryRing_pop(&channel->empty);
+	if(!block){
+		atomic_fetch_add_explicit(&channel->stalls, 1, memory_order_relaxed);
+		while(!(block = TelemetryRing_pop(&channel->empty))) sched_yield();
+	}
+	channel->current = block;
+
+}
+
+/* Adds a block at the head. The ring holds every block of the channel, so it never overflows. */
+static int TelemetryRing_push(TelemetryRing *ring, TelemetryBlock *block){
+
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if(head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= TELEMETRY_CHANNEL_BLOCKS) return 0;
+	ring->blocks[head & RING_MASK] = block;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	return 1;
+
+}
+
+/* Takes the block at the tail, or returns NULL if the ring is empty */
+static TelemetryBlock *TelemetryRing_pop(TelemetryRing *ring){
+
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	if(tail == atomic_load_explicit(&ring->head, memory_order_acquire)) return NULL;
+	TelemetryBlock *block = ring->blocks[tail & RING_MASK];
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+	return block;
+
+}
+
+/* Returns the raw bits of a scalar */
+static uint32_t scalarBits(Scalar value){
+
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+
+}
+
+/* Converts raw scalar bits of either backend back to a number */
+static double bitsToValue(uint32_t bits, int fixed){
+
+	if(fixed) return (double)(int32_t)bits / 65536.0;
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+
+}
+
+/* Finds the previous row of the same match for every row */
+static void linkRows(TelemetryLinks *links, const uint32_t *matches, size_t count){
+
+	for(size_t i = 0; i < LINK_SLOTS; ++i) links->last[i] = -1;
+	links->contiguous = 1;
+	for(size_t i = 0; i < count; ++i){
+		uint32_t slot = (matches[i] * 2654435761u) & (LINK_SLOTS - 1);
+		while(links->last[slot] >= 0 && links->matches[slot] != matches[i]) slot = (slot + 1) & (LINK_SLOTS - 1);
+		links->previous[i] = links->last[slot];
+		links->contiguous &= (links->previous[i] < 0 || links->previous[i] == (int32_t)i - 1);
+		links->matches[slot] = matches[i];
+		links->last[slot] = (int32_t)i;
+	}
+
+}
+
+/* Turns a column into zigzag coded differences of the given order, each row against row 'previous[i]', or the
+   row above it if 'previous' is NULL. 'contiguous' tells that every 'previous[i]' is the row above or none. The first row of a match is coded against zero, so a block needs nothing
+   from the one before it. The masks keep the loops free of branches the data would make hard to predict. */
+static void differenceColumn(const uint32_t *values, size_t count, int order, const int32_t *previous, int contiguous, uint32_t *differences){
+
+	if(count == 0) return;
+
+	/* Rows of one match at a time only ever look one or two rows up, which needs no lookups and vectorizes */
+	if(!previous || contiguous){
+		size_t i = 0;
+		for(; i < MIN(count, 2); ++i) differences[i] = contiguousDifference(values, order, previous, i);
+#ifdef TELEMETRY_VECTORS
+		vu4 all = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+		for(; i + 4 <= count; i += 4){
+			vu4 found = previous ? ~(vu4)(loadI4(previous + i) >> 31) : all;
+			vu4 value = loadU4(values + i) - (loadU4(values + i - 1) & found);
+			if(order == 2){
+				vu4 before = previous ? ~(vu4)(loadI4(previous + i - 1) >> 31) : all;
+				value -= (loadU4(values + i - 1) - (loadU4(values + i - 2) & before)) & found;
+			}
+			value = (value << 1) ^ (vu4)((vi4)value >> 31);
+			memcpy(differences + i, &value, sizeof(value));
+		}
+#endif
+		for(; i < count; ++i) differences[i] = contiguousDifference(values, order, previous, i);
+		return;
+	}
+
+	for(size_t i = 0; i < count; ++i){
+		uint32_t found = ~(uint32_t)(previous[i] >> 31);
+		differences[i] = values[i] - (values[previous[i] & (int32_t)found] & found);
+	}
+
+	/* Going backwards leaves the first differences of earlier rows in place until they are used */
+	if(order == 2){
+		for(size_t i = count; i-- > 0;){
+			uint32_t found = ~(uint32_t)(previous[i] >> 31);
+			differences[i] -= differences[previous[i] & (int32_t)found] & found;
+		}
+	}
+	for(size_t i = 0; i < count; ++i) differences[i] = (differences[i] << 1) ^ (0u - (differences[i] >> 31));
+
+}
+
+/* Returns the zigzag coded difference of row 'i' of a column whose rows all follow the row above or start
+   their match */
+static uint32_t contiguousDifference(const uint32_t *values, int order, const int32_t *previous, size_t i){
+
+	uint32_t found = (i == 0) ? 0 : previous ? ~(uint32_t)(previous[i] >> 31) : UINT32_MAX;
+	uint32_t value = values[i] - (values[i - (i > 0)] & found);
+	if(order == 2 && i > 0){
+		uint32_t before = (i == 1) ? 0 : previous ? ~(uint32_t)(previous[i - 1] >> 31) : UINT32_MAX;
+		value -= (values[i - 1] - (values[i - 1 - (i > 1)] & before)) & found;
+	}
+	return (value << 1) ^ (0u - (value >> 31));
+
+}
+
+#ifdef TELEMETRY_VECTORS
+
+/* Unaligned vector loads */
+static vu4 loadU4(const uint32_t *data){
+
+	vu4 value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+
+}
+
+static vi4 loadI4(const int32_t *data){
+
+	vi4 value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+
+}
+
+#endif
+
+/* Writes a column as zigzag coded differences in byte aligned groups, the differences taken as by
+   'differenceColumn'. Returns the bytes written. */
+static size_t encodeColumn(const uint32_t *values, size_t count, int order, const int32_t *previous, int contiguous, uint32_t *differences, unsigned char *data){
+
+	/* Zeros after the last row let the groups be read four values at a time */
+	differenceColumn(values, count, order, previous, contiguous, differences);
+	for(size_t i = count; i % 4 != 0; ++i) differences[i] = 0;
+
+	size_t size = 0;
+	for(size_t first = 0; first < count; first += TELEMETRY_GROUP){
+
+		/* Two bits of length per value, four values to a byte, then the values in as many bytes as they need.
+		   Every value is stored as four bytes and the position only moves on by its length. */
+		size_t end = MIN(first + TELEMETRY_GROUP, count), start = size;
+		data[size++] = 1;
+		unsigned char *tags = data + size;
+		size += (end - first + 3) / 4;
+		unsigned int any = 0;
+		for(size_t i = first; i < end; i += 4){
+			const uint32_t *four = differences + i;
+			unsigned int tag = 0;
+			if(four[0] | four[1] | four[2] | four[3]){
+				for(int j = 0; j < 4; ++j){
+					unsigned int code = (four[j] != 0) + (four[j] > 0xff) + (four[j] > 0xffff);
+					tag |= code << (2 * j);
+					putU32(data + size, four[j]);
+					size += valueBytes[code];
+				}
+			}
+			tags[(i - first) / 4] = (unsigned char)tag;
+			any |= tag;
+		}
+
+		/* Most groups of most columns are all zero and take a single byte */
+		if(!any){
+			data[start] = 0;
+			size = start + 1;
+		}
+
+	}
+
+	return size;
+
+}
+
+/* Unpacks the differences of a column written by 'encodeColumn', failing if the data is short or left over */
+static int decodeColumn(const unsigned char *data, size_t size, size_t count, uint32_t *differences){
+
+	size_t position = 0;
+	for(size_t first = 0; first < count; first += TELEMETRY_GROUP){
+
+		size_t end = MIN(first + TELEMETRY_GROUP, count);
+		if(position == size || data[position] > 1) return 0;
+		if(!data[position++]){
+			memset(differences + first, 0, sizeof(uint32_t) * (end - first));
+			continue;
+		}
+
+		const unsigned char *tags = data + position;
+		size_t tagBytes = (end - first + 3) / 4;
+		if(size - position < tagBytes) return 0;
+		position += tagBytes;
+		for(size_t i = first; i < end; ++i){
+			int bytes = valueBytes[(tags[(i - first) / 4] >> (2 * ((i - first) % 4))) & 3];
+			if(size - position < (size_t)bytes) return 0;
+			uint32_t value = 0;
+			for(int byte = 0; byte < bytes; ++byte) value |= (uint32_t)data[position++] << (8 * byte);
+			differences[i] = (value >> 1) ^ (0u - (value & 1));
+		}
+
+	}
+
+	return position == size;
+
+}
+
+/* Turns the differences of a column back into values, the reverse of the first part of 'encodeColumn' */
+static void integrateColumn(uint32_t *values, size_t count, int order, const int32_t *previous){
+
+	for(int pass = 0; pass < order; ++pass){
+		for(size_t i = 0; i < count; ++i){
+			int32_t before = previous ? previous[i] : (int32_t)i - 1;
+			if(before >= 0) values[i] += values[before];
+		}
+	}
+
+}
+
+/* Reads the columns of the tick or the bounce table */
+static int readTable(FILE *file, unsigned char *data, TelemetryLinks *links, size_t count, int bounceTable, uint32_t (*values)[TELEMETRY_BLOCK_ROWS]){
+
+	int columns = bounceTable ? BOUNCE_COLUMNS : TICK_COLUMNS, matchColumn = bounceTable ? BOUNCE_MATCH : TICK_MATCH;
+	for(int column = 0; column < columns; ++column){
+		unsigned char sizeBytes[4];
+		if(fread(sizeBytes, 4, 1, file) != 1) return 0;
+		uint32_t size = getU32(sizeBytes);
+		if(size > MAX_COLUMN_SIZE || (size > 0 && fread(data, size, 1, file) != 1)) return 0;
+		if(!decodeColumn(data, size, count, values[column])) return 0;
+	}
+
+	/* The matches come first since every other column refers to them */
+	integrateColumn(values[matchColumn], count, 1, NULL);
+	linkRows(links, values[matchColumn], count);
+	for(int column = 0; column < columns; ++column){
+		if(column == matchColumn) continue;
+		integrateColumn(values[column], count, columnOrder(bounceTable, column), links->previous);
+	}
+	return 1;
+
+}
+
+/* Returns 2 for the tick columns that change steadily from tick to tick, coded as differences of differences */
+static int columnOrder(int bounceTable, int column){
+
+	if(bounceTable) return 1;
+	return (column == TICK_TICK || column == TICK_BALL_X || column == TICK_BALL_Y || column == TICK_P1_Y || column == TICK_P2_Y) ? 2 : 1;
+
+}
+
+/* Writes a little endian 32 bit value */
+static void putU32(unsigned char *data, uint32_t value){
+
+	data[0] = value & 0xff; data[1] = (value >> 8) & 0xff;
+	data[2] = (value >> 16) & 0xff; data[3] = (value >> 24) & 0xff;
+
+}
+
+/* Reads a little endian 32 bit value */
+static uint32_t getU32(const unsigned char *data){
+
+	return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+
+}
@@ -0,0 +1,127 @@
+/*
+   CPong
+   Trajectory telemetry for tuning the ball response.
+
+   Every tick of a match can be logged as a row with the ball position
+   and speed, both paddle positions and the tick's event bits, followed
+   by one row per bounce of the ball with the face that was hit and the
+   ball's position and speed right after it. The rows go to a columnar
+   file for offline analysis.
+
+   Simulation threads only append values to a block of memory they own.
+   Each producer has a 'TelemetryChannel' with two single-producer,
+   single-consumer rings of blocks between it and an encoder thread: full
+   blocks travel to the encoder, which encodes and writes them, and
+   emptied blocks travel back. Appending a tick is a handful of stores;
+   only handing over a full block touches shared memory. A producer that
+   runs out of empty blocks waits for its encoder rather than losing
+   rows, and the wait is counted.
+
+   Encoding a row takes about half as long as simulating it, so one
+   encoder cannot keep up with many producers. Each encoder serves every
+   channel a fixed number apart, which keeps the blocks of a channel in
+   order, and only takes the file lock to write a finished block.
+
+   Blocks are already stored column by column, one table for ticks and
+   one for bounces, so an encoder codes each column in two passes. A
+   producer may interleave the ticks of several matches, so every row
+   is coded against the previous row of the same match: values become
+   differences from it, or for the tick number, ball and paddle
+   positions the difference of differences, zigzag coded so small
+   changes either way are small numbers. When a block holds one match
+   after another, as the tournament's do, this needs no lookups and is
+   vectorized. The differences are then stored in groups of 128 in as
+   few whole bytes as each needs, which is none for most of them.
+
+   File layout, little endian throughout:
+
+   header   "CTEL", u16 version, u16 flags (bit 0: values are Q16.16)
+   block    u32 tick rows, u32 bounce rows, u32 channel, then each
+            column of the tick table followed by each column of the
+            bounce table as u32 size and 'size' bytes of groups
+   group    u8 kind, 0 when every value of the group is zero and
+            nothing follows, or 1 followed by a 2 bit length code per
+            value, four to a byte and least significant bits first,
+            then the values that are not zero in 1, 2 or 4 bytes for
+            codes 1, 2 and 3
+
+   Tick columns are event bits, match, tick, ball x, ball y, speed x,
+   speed y, left paddle y and right paddle y. Bounce columns are side
+   and paddle (side | paddle << 8), match, tick and the ball's x, y,
+   speed x and speed y right after the bounce. Values are the raw bits
+   of the simulation's scalars. A block decodes on its own.
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+#include "pong.h"
+
+/* Telemetry property definitions */
+#define TELEMETRY_VERSION 2
+#define TELEMETRY_BLOCK_ROWS 8192		/* Rows of each table in a block */
+#define TELEMETRY_CHANNEL_BLOCKS 8		/* Blocks per channel, a power of two */
+#define TELEMETRY_GROUP 128			/* Values sharing a group header */
+#define TELEMETRY_VALUES 6
+
+/* Row kinds */
+#define TELEMETRY_TICK 0
+#define TELEMETRY_BOUNCE 1
+
+/* Define the 'TelemetryRow' struct, one decoded row. A bounce row carries the paddle positions of its tick. */
+typedef struct TelemetryRow{
+
+	int kind;
+	unsigned int flags;
+	int paddle;
+	uint32_t match;
+	uint32_t tick;
+	uint32_t channel;
+	double values[TELEMETRY_VALUES];
+
+} TelemetryRow;
+
+/* Define the 'TelemetryStats' struct */
+typedef struct TelemetryStats{
+
+	unsigned long long rows;
+	unsigned long long bytes;		/* Written to the file so far */
+	unsigned long long stalls;		/* Times a producer waited for an empty block */
+	double encodeSeconds;			/* Wall clock time all encoders took to encode and write blocks */
+
+} TelemetryStats;
+
+/* Opaque telemetry types */
+typedef struct Telemetry Telemetry;
+typedef struct TelemetryChannel TelemetryChannel;
+
+/* Row visitor type for 'Telemetry_read' */
+typedef void (*TelemetryVisitor)(const TelemetryRow *row, void *arg);
+
+/* Telemetry function declarations. Functions returning int return nonzero on success. */
+
+/* Creates the file and starts 'encoders' encoder threads, at most one per channel, with one channel per producer thread */
+Telemetry *Telemetry_open(const char *path, int channels, int encoders);
+
+/* Returns channel 'index', to be used by one thread at a time */
+TelemetryChannel *Telemetry_getChannel(Telemetry *telemetry, int index);
+
+/* Appends a tick row for the match after a tick, then a row for each bounce in 'contacts' if it is not NULL */
+void TelemetryChannel_record(TelemetryChannel *channel, uint32_t match, uint32_t tick, const Match *state, const MatchContacts *contacts);
+
+/* Hands the partly filled block to the encoder. Called by the producer, or by anyone once it has stopped. */
+void TelemetryChannel_flush(TelemetryChannel *channel);
+
+/* Reads the counts. Rows are counted when their block is handed to the encoder. */
+void Telemetry_getStats(Telemetry *telemetry, TelemetryStats *stats);
+
+/* Flushes every channel, waits for the encoders to finish and closes the file, storing the final counts in
+   'stats' unless it is NULL. Every producer must have stopped. */
+int Telemetry_close(Telemetry *telemetry, TelemetryStats *stats);
+
+/* Decodes a file, calling 'visit' for every row in order */
+int Telemetry_read(const char *path, TelemetryVisitor visit, void *arg);
+
+#endif
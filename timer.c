@@ -0,0 +1,65 @@
+/*
+   CPong
+   Monotonic high resolution clock and process time. See timer.h.
+*/
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+/* Platform includes */
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* Local includes */
+#include "timer.h"
+
+/* Returns a monotonic timestamp in nanoseconds */
+unsigned long long Timer_now(void){
+
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if(frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	/* Split the conversion to avoid overflowing the multiplication */
+	unsigned long long seconds = counter.QuadPart / frequency.QuadPart;
+	unsigned long long remainder = counter.QuadPart % frequency.QuadPart;
+	return seconds * 1000000000ull + remainder * 1000000000ull / frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ull + (unsigned long long)now.tv_nsec;
+#endif
+
+}
+
+/* Converts a difference between two timestamps to seconds */
+double Timer_toSeconds(unsigned long long nanoseconds){
+
+	return (double)nanoseconds * 1e-9;
+
+}
+
+/* Returns the processor time used by the process */
+unsigned long long Timer_getCpuTime(void){
+
+#ifdef _WIN32
+	FILETIME creation, exitTime, kernel, user;
+	if(!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user)) return 0;
+
+	/* Both times count 100 ns intervals */
+	unsigned long long kernelTime = ((unsigned long long)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+	unsigned long long userTime = ((unsigned long long)user.dwHighDateTime << 32) | user.dwLowDateTime;
+	return (kernelTime + userTime) * 100ull;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ull + (unsigned long long)now.tv_nsec;
+#endif
+
+}
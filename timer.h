@@ -0,0 +1,20 @@
+/*
+   CPong
+   Monotonic high resolution clock used for benchmarks and frame pacing,
+   and the processor time of the process.
+*/
+
+#ifndef TIMER_H
+#define TIMER_H
+
+/* Returns a monotonic timestamp in nanoseconds. Only differences between
+   two timestamps are meaningful. */
+unsigned long long Timer_now(void);
+
+/* Converts a difference between two timestamps to seconds */
+double Timer_toSeconds(unsigned long long nanoseconds);
+
+/* Returns the processor time used by all threads of the process so far, in nanoseconds */
+unsigned long long Timer_getCpuTime(void);
+
+#endif
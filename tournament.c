@@ -0,0 +1,542 @@
+/*
+   CPong
+   Headless tournament runner. Plays bot controllers against each other
+   in round-robin or Swiss pairings, spreading the matches across all
+   cores with the work-stealing pool, and reports win rates and rally
+   length statistics. Every match is seeded from the tournament seed and
+   its position in the schedule, so results do not depend on the number
+   of threads.
+
+   Usage: tournament [-format roundrobin|swiss] [-games <per pairing>]
+                     [-rounds <swiss rounds>] [-threads <count>]
+                     [-seed <seed>] [-players <name,name,...>] [-scaling]
+                     [-telemetry <file>] [-encoders <count>]
+
+   With -scaling the same tournament is run with 1, 2, 4, ... threads up
+   to the -threads count (the processor count by default) and the speedup
+   curve is printed.
+
+   With -telemetry every tick and every bounce of every game is logged to
+   a telemetry file, each worker thread writing to a channel of its own.
+   The rows are encoded by -encoders threads, one per worker by default;
+   the time they took is printed so it can be set against spare cores.
+*/
+
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local includes */
+#include "pong.h"
+#include "bot.h"
+#include "pool.h"
+#include "telemetry.h"
+#include "timer.h"
+
+/* Tournament property definitions */
+#define MAX_PLAYERS 64
+#define MAX_GAME_TICKS (60 * 60 * TICK_RATE)		/* A match still running after an hour is a draw */
+#define RALLY_BUCKETS 256				/* Rallies of more hits land in the last bucket */
+#define CACHE_LINE 64
+
+/* Pairing formats */
+typedef enum {FORMAT_ROUND_ROBIN, FORMAT_SWISS} Format;
+
+/* Define the 'Player' struct holding one controller's standing */
+typedef struct Player{
+
+	const Controller *controller;
+	int games;
+	int wins;
+	int draws;
+	double points;
+
+} Player;
+
+/* Define the 'Game' struct. The schedule fields are filled before the game runs,
+   the result fields by the worker that plays it. */
+typedef struct Game{
+
+	int a, b;			/* Player indices */
+	int swapSides;			/* Player 'a' plays on the right when set */
+	unsigned int seed;
+	int winner;			/* Index of the winning player, -1 for a draw */
+	int scoreA, scoreB;
+	unsigned int ticks;
+
+} Game;
+
+/* Define the 'WorkerStats' struct. Each worker writes only its own entry, so no locking is needed. */
+typedef struct WorkerStats{
+
+	unsigned long long ticks;
+	unsigned long long rallies;
+	unsigned long long rallyHits;
+	unsigned long long rallyTicks;
+	unsigned long long histogram[RALLY_BUCKETS];
+	unsigned int longestRally;
+	char padding[CACHE_LINE];
+
+} WorkerStats;
+
+/* Define the 'Tournament' struct */
+typedef struct Tournament{
+
+	Format format;
+	int gamesPerPairing;
+	int rounds;
+	unsigned int seed;
+	Player players[MAX_PLAYERS];
+	int playerCount;
+	Game *games;
+	size_t gameCount;
+	size_t batchStart;		/* First game of the batch the pool is playing */
+	WorkerStats *stats;
+	int statsCount;
+	Telemetry *telemetry;		/* NULL unless logging */
+
+} Tournament;
+
+/* Function declarations */
+unsigned int mixSeed(unsigned int seed, unsigned int a, unsigned int b);
+void playGame(void *arg, size_t index, int worker);
+int schedulePairing(Tournament *tournament, Game *games, int a, int b, unsigned int pairingIndex);
+void recordGames(Tournament *tournament, const Game *games, size_t count);
+int comparePlayers(const void *a, const void *b);
+int runTournament(Tournament *tournament, Pool *pool);
+unsigned long long checksumGames(const Tournament *tournament);
+void printStandings(const Tournament *tournament);
+void printRallies(const Tournament *tournament);
+int parsePlayers(Tournament *tournament, char *list);
+
+/* Program entrypoint */
+int main(int argc, char **argv){
+
+	Tournament tournament;
+	memset(&tournament, 0, sizeof(tournament));
+	tournament.format = FORMAT_ROUND_ROBIN;
+	tournament.gamesPerPairing = 20;
+	tournament.rounds = 5;
+	tournament.seed = 1;
+
+	int threads = Pool_getCpuCount();
+	int scaling = 0, encoders = 0;
+	char *playerList = NULL, *telemetryPath = NULL;
+
+	for(int i = 1; i < argc; ++i){
+		if(strcmp(argv[i], "-format") == 0 && i + 1 < argc){
+			++i;
+			if(strcmp(argv[i], "swiss") == 0) tournament.format = FORMAT_SWISS;
+			else if(strcmp(argv[i], "roundrobin") == 0) tournament.format = FORMAT_ROUND_ROBIN;
+			else{ fprintf(stderr, "Unknown format %s\n", argv[i]); return EXIT_FAILURE; }
+		}
+		else if(strcmp(argv[i], "-games") == 0 && i + 1 < argc) tournament.gamesPerPairing = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-rounds") == 0 && i + 1 < argc) tournament.rounds = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc) tournament.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-players") == 0 && i + 1 < argc) playerList = argv[++i];
+		else if(strcmp(argv[i], "-scaling") == 0) scaling = 1;
+		else if(strcmp(argv[i], "-telemetry") == 0 && i + 1 < argc) telemetryPath = argv[++i];
+		else if(strcmp(argv[i], "-encoders") == 0 && i + 1 < argc) encoders = atoi(argv[++i]);
+		else{
+			fprintf(stderr, "Usage: %s [-format roundrobin|swiss] [-games n] [-rounds n] [-threads n] "
+				"[-seed n] [-players a,b,...] [-scaling] [-telemetry file] [-encoders n]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(playerList){
+		if(!parsePlayers(&tournament, playerList)) return EXIT_FAILURE;
+	}else{
+		for(int i = 0; i < Controller_getCount() && i < MAX_PLAYERS; ++i)
+			tournament.players[tournament.playerCount++].controller = Controller_get(i);
+	}
+
+	if(tournament.playerCount < 2 || tournament.gamesPerPairing < 1 || tournament.rounds < 1 || threads < 1 || encoders < 0){
+		fprintf(stderr, "A tournament needs at least two players, one game, one round and one thread\n");
+		return EXIT_FAILURE;
+	}
+	if(telemetryPath && scaling){
+		fprintf(stderr, "Telemetry is only written without -scaling\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Thread counts to run: just the requested one, or a doubling sweep for the scaling curve */
+	int threadCounts[32], runCount = 0;
+	if(scaling){
+		for(int count = 1; count < threads && runCount < 31; count *= 2) threadCounts[runCount++] = count;
+		threadCounts[runCount++] = threads;
+	}else{
+		threadCounts[runCount++] = threads;
+	}
+
+	double baseSeconds = 0.0;
+	unsigned long long baseChecksum = 0;
+	int consistent = 1;
+	Tournament result;
+
+	if(scaling) fprintf(stdout, "%8s %10s %12s %14s %8s %10s\n", "threads", "seconds", "games/s", "ticks/s", "speedup", "efficiency");
+
+	for(int run = 0; run < runCount; ++run){
+
+		Pool *pool = Pool_create(threadCounts[run]);
+		if(!pool){
+			fprintf(stderr, "Could not start %d threads\n", threadCounts[run]);
+			return EXIT_FAILURE;
+		}
+
+		Tournament attempt = tournament;
+		if(telemetryPath){
+			attempt.telemetry = Telemetry_open(telemetryPath, threadCounts[run], encoders ? encoders : threadCounts[run]);
+			if(!attempt.telemetry){
+				fprintf(stderr, "Could not create telemetry file %s\n", telemetryPath);
+				return EXIT_FAILURE;
+			}
+		}
+
+		/* The time includes the encoders finishing the file */
+		unsigned long long start = Timer_now();
+		int ok = runTournament(&attempt, pool);
+		TelemetryStats telemetry;
+		if(attempt.telemetry && !Telemetry_close(attempt.telemetry, &telemetry))
+			fprintf(stderr, "Could not write telemetry file %s\n", telemetryPath);
+		double seconds = Timer_toSeconds(Timer_now() - start);
+		Pool_destroy(pool);
+
+		if(!ok){
+			fprintf(stderr, "Out of memory\n");
+			return EXIT_FAILURE;
+		}
+
+		unsigned long long ticks = 0;
+		for(int i = 0; i < attempt.statsCount; ++i) ticks += attempt.stats[i].ticks;
+		unsigned long long checksum = checksumGames(&attempt);
+
+		if(run == 0){
+			baseSeconds = seconds;
+			baseChecksum = checksum;
+		}else if(checksum != baseChecksum){
+			fprintf(stderr, "Results with %d threads differ from the first run\n", threadCounts[run]);
+			consistent = 0;
+		}
+
+		if(scaling){
+			double speedup = baseSeconds / seconds;
+			fprintf(stdout, "%8d %10.3f %12.1f %14.0f %8.2f %10.2f\n", threadCounts[run], seconds,
+				(double)attempt.gameCount / seconds, (double)ticks / seconds, speedup, speedup / threadCounts[run]);
+		}else{
+			fprintf(stdout, "%zu games, %llu ticks in %.3f s on %d threads (%.0f ticks/s)\n",
+				attempt.gameCount, ticks, seconds, threadCounts[run], (double)ticks / seconds);
+			if(attempt.telemetry)
+				fprintf(stdout, "telemetry: %llu rows, %llu bytes (%.2f per row), %llu stalls, %.3f s encoding\n",
+					telemetry.rows, telemetry.bytes, (double)telemetry.bytes / (double)MAX(telemetry.rows, 1), telemetry.stalls,
+					telemetry.encodeSeconds);
+			fprintf(stdout, "\n");
+		}
+
+		if(run == runCount - 1) result = attempt;
+		else{
+			free(attempt.games);
+			free(attempt.stats);
+		}
+
+	}
+
+	if(scaling) fprintf(stdout, "\n");
+	printStandings(&result);
+	printRallies(&result);
+
+	free(result.games);
+	free(result.stats);
+
+	/* Results must not depend on the thread count */
+	return consistent ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}
+
+/* Derives a match seed from the tournament seed and two schedule coordinates */
+unsigned int mixSeed(unsigned int seed, unsigned int a, unsigned int b){
+
+	unsigned int x = seed ^ (a * 0x9e3779b9u) ^ (b * 0x85ebca6bu);
+	x ^= x >> 16; x *= 0x7feb352du;
+	x ^= x >> 15; x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+
+}
+
+/* Pool task: plays one scheduled game to 'WIN_SCORE' and stores its result */
+void playGame(void *arg, size_t index, int worker){
+
+	Tournament *tournament = arg;
+	Game *game = &tournament->games[tournament->batchStart + index];
+	WorkerStats *stats = &tournament->stats[worker];
+	TelemetryChannel *channel = Telemetry_getChannel(tournament->telemetry, worker);
+
+	const Controller *left = tournament->players[game->swapSides ? game->b : game->a].controller;
+	const Controller *right = tournament->players[game->swapSides ? game->a : game->b].controller;
+
+	Match match;
+	ControllerState leftState, rightState;
+	Match_init(&match, game->seed);
+	Controller_reset(left, &leftState, mixSeed(game->seed, 1, 0));
+	Controller_reset(right, &rightState, mixSeed(game->seed, 2, 0));
+
+	unsigned int ticks = 0, rallyHits = 0, rallyStart = 0;
+
+	for(; ticks < MAX_GAME_TICKS; ++ticks){
+
+		Input input = Controller_getInput(left, &leftState, right, &rightState, &match);
+		if(channel){
+			MatchContacts contacts;
+			Match_tickContacts(&match, input, &contacts);
+			TelemetryChannel_record(channel, (uint32_t)(tournament->batchStart + index), ticks, &match, &contacts);
+		}else{
+			Match_tick(&match, input);
+		}
+
+		if(match.events & MATCH_EVENT_ROUND_START){
+			rallyHits = 0;
+			rallyStart = ticks;
+		}
+		if(match.events & MATCH_EVENT_PADDLE_HIT) ++rallyHits;
+		if(match.events & MATCH_EVENT_SCORE){
+			++stats->rallies;
+			stats->rallyHits += rallyHits;
+			stats->rallyTicks += ticks - rallyStart;
+			++stats->histogram[MIN(rallyHits, RALLY_BUCKETS - 1)];
+			if(rallyHits > stats->longestRally) stats->longestRally = rallyHits;
+		}
+		if(match.events & MATCH_EVENT_GAME_OVER){
+			++ticks;
+			break;
+		}
+
+	}
+
+	stats->ticks += ticks;
+
+	int leftScore = match.p1.score, rightScore = match.p2.score;
+	game->scoreA = game->swapSides ? rightScore : leftScore;
+	game->scoreB = game->swapSides ? leftScore : rightScore;
+	game->ticks = ticks;
+
+	int winner = Match_getWinner(&match);
+	if(winner == 0) game->winner = -1;
+	else if((winner == 1) != (game->swapSides != 0)) game->winner = game->a;
+	else game->winner = game->b;
+
+}
+
+/* Fills in the games of one pairing, alternating sides. Returns the number of games. */
+int schedulePairing(Tournament *tournament, Game *games, int a, int b, unsigned int pairingIndex){
+
+	for(int g = 0; g < tournament->gamesPerPairing; ++g){
+		Game *game = &games[g];
+		memset(game, 0, sizeof(*game));
+		game->a = a;
+		game->b = b;
+		game->swapSides = g % 2;
+		game->seed = mixSeed(tournament->seed, pairingIndex, (unsigned int)g);
+	}
+	return tournament->gamesPerPairing;
+
+}
+
+/* Adds the results of finished games to the standings */
+void recordGames(Tournament *tournament, const Game *games, size_t count){
+
+	for(size_t i = 0; i < count; ++i){
+		Player *a = &tournament->players[games[i].a], *b = &tournament->players[games[i].b];
+		++a->games; ++b->games;
+		if(games[i].winner < 0){
+			++a->draws; ++b->draws;
+			a->points += 0.5; b->points += 0.5;
+		}else{
+			Player *winner = &tournament->players[games[i].winner];
+			++winner->wins;
+			winner->points += 1.0;
+		}
+	}
+
+}
+
+/* Orders player indices by points, best first, keeping the original order on ties */
+static const Tournament *sortedTournament;
+int comparePlayers(const void *a, const void *b){
+
+	int ia = *(const int*)a, ib = *(const int*)b;
+	double pa = sortedTournament->players[ia].points, pb = sortedTournament->players[ib].points;
+	if(pa != pb) return (pa > pb) ? -1 : 1;
+	return ia - ib;
+
+}
+
+/* Schedules and plays the whole tournament on the pool. Returns 0 if memory runs out. */
+int runTournament(Tournament *tournament, Pool *pool){
+
+	int n = tournament->playerCount;
+	int pairingsPerRound = (tournament->format == FORMAT_SWISS) ? n / 2 : n * (n - 1) / 2;
+	int roundCount = (tournament->format == FORMAT_SWISS) ? tournament->rounds : 1;
+	size_t gamesPerRound = (size_t)pairingsPerRound * (size_t)tournament->gamesPerPairing;
+
+	tournament->gameCount = 0;
+	tournament->games = malloc(gamesPerRound * (size_t)roundCount * sizeof(Game));
+	tournament->statsCount = Pool_getThreadCount(pool);
+	tournament->stats = calloc((size_t)tournament->statsCount, sizeof(WorkerStats));
+	if(!tournament->games || !tournament->stats){
+		free(tournament->games);
+		free(tournament->stats);
+		return 0;
+	}
+
+	if(tournament->format == FORMAT_ROUND_ROBIN){
+
+		unsigned int pairing = 0;
+		for(int a = 0; a < n; ++a)
+			for(int b = a + 1; b < n; ++b)
+				tournament->gameCount += schedulePairing(tournament, tournament->games + tournament->gameCount, a, b, pairing++);
+
+		tournament->batchStart = 0;
+		Pool_run(pool, tournament->gameCount, playGame, tournament);
+		recordGames(tournament, tournament->games, tournament->gameCount);
+		return 1;
+
+	}
+
+	/* Swiss: each round pairs players of similar standing who have not met yet */
+	unsigned char met[MAX_PLAYERS][MAX_PLAYERS];
+	memset(met, 0, sizeof(met));
+
+	for(int round = 0; round < roundCount; ++round){
+
+		int order[MAX_PLAYERS], paired[MAX_PLAYERS] = {0};
+		for(int i = 0; i < n; ++i) order[i] = i;
+		sortedTournament = tournament;
+		qsort(order, (size_t)n, sizeof(int), comparePlayers);
+
+		Game *roundGames = tournament->games + tournament->gameCount;
+		size_t scheduled = 0;
+		unsigned int pairing = (unsigned int)(round * pairingsPerRound);
+
+		for(int i = 0; i < n; ++i){
+
+			int a = order[i];
+			if(paired[a]) continue;
+
+			/* Closest unpaired opponent not met yet, or the closest unpaired one if all have been met */
+			int b = -1;
+			for(int j = i + 1; j < n && b < 0; ++j)
+				if(!paired[order[j]] && !met[a][order[j]]) b = order[j];
+			for(int j = i + 1; j < n && b < 0; ++j)
+				if(!paired[order[j]]) b = order[j];
+
+			/* Odd player out gets a bye worth one game */
+			if(b < 0){
+				tournament->players[a].points += 1.0;
+				break;
+			}
+
+			paired[a] = paired[b] = 1;
+			met[a][b] = met[b][a] = 1;
+			scheduled += schedulePairing(tournament, roundGames + scheduled, a, b, pairing++);
+
+		}
+
+		tournament->batchStart = tournament->gameCount;
+		Pool_run(pool, scheduled, playGame, tournament);
+		recordGames(tournament, roundGames, scheduled);
+		tournament->gameCount += scheduled;
+
+	}
+
+	return 1;
+
+}
+
+/* Hashes all game results, used to check that thread count does not change the outcome */
+unsigned long long checksumGames(const Tournament *tournament){
+
+	unsigned long long hash = 14695981039346656037ull;
+	for(size_t i = 0; i < tournament->gameCount; ++i){
+		const Game *game = &tournament->games[i];
+		unsigned int values[4] = {(unsigned int)game->winner, (unsigned int)game->scoreA, (unsigned int)game->scoreB, game->ticks};
+		for(int v = 0; v < 4; ++v){
+			hash ^= values[v];
+			hash *= 1099511628211ull;
+		}
+	}
+	return hash;
+
+}
+
+/* Prints the players ordered by points */
+void printStandings(const Tournament *tournament){
+
+	int order[MAX_PLAYERS];
+	for(int i = 0; i < tournament->playerCount; ++i) order[i] = i;
+	sortedTournament = tournament;
+	qsort(order, (size_t)tournament->playerCount, sizeof(int), comparePlayers);
+
+	fprintf(stdout, "%-16s %7s %7s %7s %7s %9s\n", "player", "games", "wins", "draws", "points", "win rate");
+	for(int i = 0; i < tournament->playerCount; ++i){
+		const Player *player = &tournament->players[order[i]];
+		fprintf(stdout, "%-16s %7d %7d %7d %7.1f %8.1f%%\n", player->controller->name, player->games,
+			player->wins, player->draws, player->points, player->games ? 100.0 * player->wins / player->games : 0.0);
+	}
+
+}
+
+/* Merges the per-worker rally statistics and prints them */
+void printRallies(const Tournament *tournament){
+
+	unsigned long long rallies = 0, hits = 0, ticks = 0, histogram[RALLY_BUCKETS] = {0};
+	unsigned int longest = 0;
+
+	for(int i = 0; i < tournament->statsCount; ++i){
+		const WorkerStats *stats = &tournament->stats[i];
+		rallies += stats->rallies;
+		hits += stats->rallyHits;
+		ticks += stats->rallyTicks;
+		longest = MAX(longest, stats->longestRally);
+		for(int b = 0; b < RALLY_BUCKETS; ++b) histogram[b] += stats->histogram[b];
+	}
+
+	if(rallies == 0) return;
+
+	/* Percentiles of paddle hits per rally from the histogram */
+	double fractions[3] = {0.5, 0.9, 0.99};
+	int percentiles[3];
+	for(int p = 0; p < 3; ++p){
+		unsigned long long target = (unsigned long long)(fractions[p] * (double)rallies), seen = 0;
+		int bucket = 0;
+		while(bucket < RALLY_BUCKETS - 1 && seen + histogram[bucket] <= target) seen += histogram[bucket++];
+		percentiles[p] = bucket;
+	}
+
+	fprintf(stdout, "\n%llu rallies, %.2f hits and %.2f s per rally on average\n", rallies,
+		(double)hits / (double)rallies, (double)ticks / (double)rallies / TICK_RATE);
+	fprintf(stdout, "hits per rally: p50 %d, p90 %d, p99 %d, max %u\n",
+		percentiles[0], percentiles[1], percentiles[2], longest);
+
+}
+
+/* Fills the player list from a comma separated list of controller names */
+int parsePlayers(Tournament *tournament, char *list){
+
+	for(char *name = strtok(list, ","); name; name = strtok(NULL, ",")){
+		const Controller *controller = Controller_find(name);
+		if(!controller){
+			fprintf(stderr, "Unknown controller %s\n", name);
+			return 0;
+		}
+		if(tournament->playerCount == MAX_PLAYERS){
+			fprintf(stderr, "At most %d players are supported\n", MAX_PLAYERS);
+			return 0;
+		}
+		tournament->players[tournament->playerCount++].controller = controller;
+	}
+	return 1;
+
+}
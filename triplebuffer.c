@@ -0,0 +1,36 @@
+/*
+   CPong
+   Lock-free triple buffer. See triplebuffer.h.
+*/
+
+/* Local includes */
+#include "triplebuffer.h"
+
+/* Starts with the writer on slot 0, slot 1 shared and the reader on slot 2 */
+void TripleBuffer_init(TripleBuffer *buffer){
+
+	atomic_init(&buffer->shared, 1u);
+	buffer->write = 0;
+	buffer->read = 2;
+
+}
+
+/* The release half of the exchange makes the writes to the slot visible to the reader that takes it */
+void TripleBuffer_publish(TripleBuffer *buffer){
+
+	unsigned int previous = atomic_exchange_explicit(&buffer->shared, buffer->write | TRIPLE_BUFFER_FRESH, memory_order_acq_rel);
+	buffer->write = previous & ~TRIPLE_BUFFER_FRESH;
+
+}
+
+/* The acquire half of the exchange makes the writer's writes to the slot visible here. A slot published between the
+   load and the exchange is taken as well, as the exchange always returns the newest. */
+int TripleBuffer_acquire(TripleBuffer *buffer){
+
+	if(!(atomic_load_explicit(&buffer->shared, memory_order_relaxed) & TRIPLE_BUFFER_FRESH)) return 0;
+
+	unsigned int previous = atomic_exchange_explicit(&buffer->shared, buffer->read, memory_order_acq_rel);
+	buffer->read = previous & ~TRIPLE_BUFFER_FRESH;
+	return 1;
+
+}
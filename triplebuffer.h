@@ -0,0 +1,45 @@
+/*
+   CPong
+   Lock-free triple buffer for handing the newest of a stream of values
+   from one thread to another.
+
+   Of three slots the writer always owns one to fill and the reader one
+   to read; the third is shared and holds the newest published value.
+   Publishing swaps the writer's slot with the shared one and marks it
+   fresh, and acquiring swaps the reader's slot with the shared one if it
+   is fresh, each with a single atomic exchange. Neither side ever waits
+   for the other: values the reader never took are overwritten, and the
+   reader keeps its slot, still complete, until a newer one is published.
+
+   The slots themselves are arrays of three owned by the caller; the
+   buffer only hands out their indices. All three must hold a valid value
+   before the threads start, as the reader may read its slot at once.
+*/
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <stdatomic.h>
+
+/* Flag set in 'shared' while its slot was published and not yet acquired */
+#define TRIPLE_BUFFER_FRESH 4u
+
+/* Define the 'TripleBuffer' struct */
+typedef struct TripleBuffer{
+
+	atomic_uint shared;			/* Index of the shared slot, or'ed with 'TRIPLE_BUFFER_FRESH' */
+	unsigned int write;			/* Slot owned by the writer */
+	unsigned int read;			/* Slot owned by the reader */
+
+} TripleBuffer;
+
+/* Triple buffer function declarations */
+void TripleBuffer_init(TripleBuffer *buffer);
+
+/* Called by the writer once 'write' is filled. 'write' then names another slot to fill. */
+void TripleBuffer_publish(TripleBuffer *buffer);
+
+/* Called by the reader to take the newest slot into 'read'. Returns nonzero if one was published since the last call. */
+int TripleBuffer_acquire(TripleBuffer *buffer);
+
+#endif